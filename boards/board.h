@@ -2,9 +2,14 @@
 #define BOARD_H__
 
 #include <stdbool.h>
+#include <stddef.h>
 
 #include "cmsis.h"
 
+#ifdef CONFIG_DFU_GANG_CHANNELS
+#include "gang.h"
+#endif /* CONFIG_DFU_GANG_CHANNELS */
+
 /**
  *  @brief  Инициализация системы и периферии MCU.
  **/
@@ -17,6 +22,24 @@ void board_init(void);
  **/
 UART_HandleTypeDef* board_get_serial_handle(void);
 
+#ifdef CONFIG_DFU_HOST_TRANSPORT_SPI
+/**
+ *  @brief  Получить управляющий объект SPI для взаимодействия с бутлоадером.
+ *
+ *  @return Указатель на инициализированный объект SPI.
+ **/
+SPI_HandleTypeDef* board_get_spi_handle(void);
+#endif /* CONFIG_DFU_HOST_TRANSPORT_SPI */
+
+#ifdef CONFIG_DFU_HOST_TRANSPORT_I2C
+/**
+ *  @brief  Получить управляющий объект I2C для взаимодействия с бутлоадером.
+ *
+ *  @return Указатель на инициализированный объект I2C.
+ **/
+I2C_HandleTypeDef* board_get_i2c_handle(void);
+#endif /* CONFIG_DFU_HOST_TRANSPORT_I2C */
+
 /**
  *  @brief  Получить начальный адрес памяти размещения структуры метаинформации
  *  прошивки подчиненного устройства.
@@ -25,6 +48,20 @@ UART_HandleTypeDef* board_get_serial_handle(void);
  **/
 uint32_t board_get_fw_meta_addr(void);
 
+#ifdef CONFIG_DFU_UPDATE
+/**
+ *  @brief  Получить эталонный образ прошивки подчиненного устройства, до
+ *  которого обновляется его Flash.
+ *
+ *  @param  address  Адрес образа во Flash устройства.
+ *  @param  data     Данные образа.
+ *  @param  len      Длина образа в байтах.
+ *
+ *  @return  true - образ есть, false - обновлять нечем.
+ **/
+bool board_get_fw_image(uint32_t* address, const uint8_t** data, size_t* len);
+#endif /* CONFIG_DFU_UPDATE */
+
 /**
  *  @brief  Управление выводом статусного светодиода.
  *  
@@ -46,4 +83,52 @@ void board_reset_write(bool value);
  **/
 void board_boot0_write(bool value);
 
+#ifdef CONFIG_DFU_GANG_CHANNELS
+/**
+ *  @brief  Получить количество каналов проверки нескольких устройств.
+ *
+ *  Канал - линии одного подчиненного устройства: UART загрузчика, RST и
+ *  BOOT0. Канал 0 - те же линии, что у функций для одного устройства.
+ *
+ *  @return  Количество каналов платы, не больше CONFIG_DFU_GANG_CHANNELS.
+ **/
+size_t board_get_channel_count(void);
+
+/**
+ *  @brief  Получить управляющий объект UART канала.
+ *
+ *  @param  channel  Номер канала.
+ *
+ *  @return Указатель на инициализированный объект UART.
+ **/
+UART_HandleTypeDef* board_get_channel_serial_handle(size_t channel);
+
+/**
+ *  @brief  Управление линией сброса устройства канала.
+ *
+ *  @param  channel  Номер канала.
+ *  @param  value    true - отпустить линию RST, false - подтянуть вывод к GND.
+ **/
+void board_channel_reset_write(size_t channel, bool value);
+
+/**
+ *  @brief  Управление линией BOOT0 устройства канала.
+ *
+ *  @param  channel  Номер канала.
+ *  @param  value    true - линия BOOT0 в 1, false - линия BOOT0 в 0.
+ **/
+void board_channel_boot0_write(size_t channel, bool value);
+
+/**
+ *  @brief  Сообщить итог проверки каналов.
+ *
+ *  Вызывается после gang_run() в любой сборке, в том числе без DEBUG: итог
+ *  по каждому каналу - основной результат проверки нескольких устройств.
+ *
+ *  @param  results  Итоги по каналам.
+ *  @param  count    Количество каналов.
+ **/
+void board_gang_report(const gang_result_t* results, size_t count);
+#endif /* CONFIG_DFU_GANG_CHANNELS */
+
 #endif /* !BOARD_H__ */
\ No newline at end of file
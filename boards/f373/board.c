@@ -1,8 +1,10 @@
 #include <errno.h>
+#include <inttypes.h>
 #include <stdio.h>
 
 #include "board.h"
 #include "core/assert.h"
+#include "core/util.h"
 
 #define LED_PIN_PORT GPIOA
 #define LED_PIN_PIN GPIO_PIN_5
@@ -11,6 +13,22 @@
 #define BOOT_LINE_PORT GPIOB
 #define BOOT_LINE_PIN GPIO_PIN_1
 
+/* Каналы проверки нескольких устройств: USART1 и линии одного устройства,
+ * затем USART3 (PC10/PC11) и USART2 (PA2/PA3) со своими RST и BOOT0 */
+#ifdef CONFIG_DFU_GANG_CHANNELS
+#if CONFIG_DFU_GANG_CHANNELS > 3
+#error "f373 board has 3 target channels: USART1, USART3 and USART2"
+#endif
+#define BOARD_CHANNELS CONFIG_DFU_GANG_CHANNELS
+#else
+#define BOARD_CHANNELS 1
+#endif /* CONFIG_DFU_GANG_CHANNELS */
+
+/* USART2 - UART лога, пока его не занял третий канал */
+#if (defined(DEBUG) || defined(CONFIG_CRC_BENCHMARK)) && BOARD_CHANNELS < 3
+#define BOARD_LOG_UART
+#endif
+
 /* Адрес чтения параметров проверяемой прошивки */
 #ifndef CONFIG_FW_META_ADDR
 #define CONFIG_FW_META_ADDR ((uint32_t)0x0803F800) /* 127-th page */
@@ -19,24 +37,70 @@
 
 UART_HandleTypeDef huart1;
 UART_HandleTypeDef huart2;
+#if BOARD_CHANNELS >= 2
+UART_HandleTypeDef huart3;
+#endif /* BOARD_CHANNELS >= 2 */
+#ifdef CONFIG_DFU_HOST_TRANSPORT_I2C
+I2C_HandleTypeDef hi2c1;
+#endif /* CONFIG_DFU_HOST_TRANSPORT_I2C */
 
 void Error_Handler(void);
 
-static void dfu_uart_init(void)
+#ifdef CONFIG_DFU_GANG_CHANNELS
+/* Линии устройства канала */
+typedef struct {
+    UART_HandleTypeDef* huart;
+    USART_TypeDef* instance;
+    GPIO_TypeDef* rst_port;
+    uint16_t rst_pin;
+    GPIO_TypeDef* boot_port;
+    uint16_t boot_pin;
+} board_channel_t;
+
+static const board_channel_t channels[BOARD_CHANNELS] = {
+    { &huart1, USART1, RST_LINE_PORT, RST_LINE_PIN, BOOT_LINE_PORT, BOOT_LINE_PIN },
+#if BOARD_CHANNELS >= 2
+    { &huart3, USART3, GPIOC, GPIO_PIN_0, GPIOC, GPIO_PIN_1 },
+#endif /* BOARD_CHANNELS >= 2 */
+#if BOARD_CHANNELS >= 3
+    { &huart2, USART2, GPIOC, GPIO_PIN_2, GPIOC, GPIO_PIN_3 },
+#endif /* BOARD_CHANNELS >= 3 */
+};
+#endif /* CONFIG_DFU_GANG_CHANNELS */
+
+/* UART загрузчика: 8E1, скорость меняет dfu_host */
+static void dfu_uart_init(UART_HandleTypeDef* huart, USART_TypeDef* instance)
 {
-    huart1.Instance = USART1;
-    huart1.Init.BaudRate = 115200;
-    huart1.Init.WordLength = UART_WORDLENGTH_9B;
-    huart1.Init.StopBits = UART_STOPBITS_1;
-    huart1.Init.Parity = UART_PARITY_EVEN;
-    huart1.Init.Mode = UART_MODE_TX_RX;
-    huart1.Init.HwFlowCtl = UART_HWCONTROL_NONE;
-    huart1.Init.OneBitSampling = UART_ONE_BIT_SAMPLE_DISABLE;
-    huart1.AdvancedInit.AdvFeatureInit = UART_ADVFEATURE_NO_INIT;
-    HAL_UART_Init(&huart1);
+    huart->Instance = instance;
+    huart->Init.BaudRate = 115200;
+    huart->Init.WordLength = UART_WORDLENGTH_9B;
+    huart->Init.StopBits = UART_STOPBITS_1;
+    huart->Init.Parity = UART_PARITY_EVEN;
+    huart->Init.Mode = UART_MODE_TX_RX;
+    huart->Init.HwFlowCtl = UART_HWCONTROL_NONE;
+    huart->Init.OneBitSampling = UART_ONE_BIT_SAMPLE_DISABLE;
+    huart->AdvancedInit.AdvFeatureInit = UART_ADVFEATURE_NO_INIT;
+    HAL_UART_Init(huart);
 }
 
-#ifdef DEBUG
+#ifdef CONFIG_DFU_HOST_TRANSPORT_I2C
+static void dfu_i2c_init(void)
+{
+    /* 400 кГц от HSI 8 МГц (RM0313, пример настройки I2C_TIMINGR) */
+    hi2c1.Instance = I2C1;
+    hi2c1.Init.Timing = 0x00310309;
+    hi2c1.Init.OwnAddress1 = 0;
+    hi2c1.Init.AddressingMode = I2C_ADDRESSINGMODE_7BIT;
+    hi2c1.Init.DualAddressMode = I2C_DUALADDRESS_DISABLE;
+    hi2c1.Init.OwnAddress2 = 0;
+    hi2c1.Init.OwnAddress2Masks = I2C_OA2_NOMASK;
+    hi2c1.Init.GeneralCallMode = I2C_GENERALCALL_DISABLE;
+    hi2c1.Init.NoStretchMode = I2C_NOSTRETCH_DISABLE;
+    HAL_I2C_Init(&hi2c1);
+}
+#endif /* CONFIG_DFU_HOST_TRANSPORT_I2C */
+
+#ifdef BOARD_LOG_UART
 static void log_uart_init(void)
 {
     huart2.Instance = USART2;
@@ -57,7 +121,7 @@ int _write(int fd, char* ptr, int len)
     HAL_UART_Transmit(&huart2, (uint8_t*)ptr, len, HAL_MAX_DELAY);
     return len;
 }
-#endif /* DEBUG */
+#endif /* BOARD_LOG_UART */
 
 static void gpio_init(void)
 {
@@ -92,6 +156,35 @@ static void gpio_init(void)
     HAL_GPIO_Init(BOOT_LINE_PORT, &GPIO_InitStruct);
 }
 
+#ifdef CONFIG_DFU_GANG_CHANNELS
+/* UART и линии RST, BOOT0 каналов после первого, он настроен как одно устройство */
+static void channels_init(void)
+{
+    GPIO_InitTypeDef GPIO_InitStruct = { 0 };
+
+    __HAL_RCC_GPIOC_CLK_ENABLE();
+
+    for (size_t i = 1; i < ARRAY_SIZE(channels); ++i) {
+        const board_channel_t* ch = &channels[i];
+
+        dfu_uart_init(ch->huart, ch->instance);
+
+        HAL_GPIO_WritePin(ch->rst_port, ch->rst_pin, GPIO_PIN_SET);
+        HAL_GPIO_WritePin(ch->boot_port, ch->boot_pin, GPIO_PIN_RESET);
+
+        GPIO_InitStruct.Pin = ch->rst_pin;
+        GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_OD;
+        GPIO_InitStruct.Pull = GPIO_NOPULL;
+        GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+        HAL_GPIO_Init(ch->rst_port, &GPIO_InitStruct);
+
+        GPIO_InitStruct.Pin = ch->boot_pin;
+        GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
+        HAL_GPIO_Init(ch->boot_port, &GPIO_InitStruct);
+    }
+}
+#endif /* CONFIG_DFU_GANG_CHANNELS */
+
 static void SystemClock_Config(void)
 {
     RCC_OscInitTypeDef RCC_OscInitStruct = { 0 };
@@ -126,6 +219,10 @@ static void SystemClock_Config(void)
     PeriphClkInit.PeriphClockSelection = RCC_PERIPHCLK_USART1 | RCC_PERIPHCLK_USART2;
     PeriphClkInit.Usart1ClockSelection = RCC_USART1CLKSOURCE_PCLK2;
     PeriphClkInit.Usart2ClockSelection = RCC_USART2CLKSOURCE_PCLK1;
+#if BOARD_CHANNELS >= 2
+    PeriphClkInit.PeriphClockSelection |= RCC_PERIPHCLK_USART3;
+    PeriphClkInit.Usart3ClockSelection = RCC_USART3CLKSOURCE_PCLK1;
+#endif /* BOARD_CHANNELS >= 2 */
     if (HAL_RCCEx_PeriphCLKConfig(&PeriphClkInit) != HAL_OK) {
         Error_Handler();
     }
@@ -136,12 +233,18 @@ void board_init(void)
     HAL_Init();
     SystemClock_Config();
         
-    dfu_uart_init();
+    dfu_uart_init(&huart1, USART1);
+#ifdef CONFIG_DFU_HOST_TRANSPORT_I2C
+    dfu_i2c_init();
+#endif /* CONFIG_DFU_HOST_TRANSPORT_I2C */
     gpio_init();
+#ifdef CONFIG_DFU_GANG_CHANNELS
+    channels_init();
+#endif /* CONFIG_DFU_GANG_CHANNELS */
 
-#ifdef DEBUG
+#ifdef BOARD_LOG_UART
     log_uart_init();
-#endif /* DEBUG */
+#endif /* BOARD_LOG_UART */
 }
 
 UART_HandleTypeDef* board_get_serial_handle(void) 
@@ -149,6 +252,13 @@ UART_HandleTypeDef* board_get_serial_handle(void)
     return &huart1; 
 }
 
+#ifdef CONFIG_DFU_HOST_TRANSPORT_I2C
+I2C_HandleTypeDef* board_get_i2c_handle(void)
+{
+    return &hi2c1;
+}
+#endif /* CONFIG_DFU_HOST_TRANSPORT_I2C */
+
 void board_led_write(bool value)
 {
     HAL_GPIO_WritePin(LED_PIN_PORT, LED_PIN_PIN, (GPIO_PinState)value);
@@ -169,6 +279,52 @@ uint32_t board_get_fw_meta_addr(void)
     return CONFIG_FW_META_ADDR; 
 }
 
+#ifdef CONFIG_DFU_GANG_CHANNELS
+size_t board_get_channel_count(void)
+{
+    return ARRAY_SIZE(channels);
+}
+
+UART_HandleTypeDef* board_get_channel_serial_handle(size_t channel)
+{
+    ASSERT_NO_MSG(channel < ARRAY_SIZE(channels));
+
+    return channels[channel].huart;
+}
+
+void board_channel_reset_write(size_t channel, bool value)
+{
+    ASSERT_NO_MSG(channel < ARRAY_SIZE(channels));
+
+    HAL_GPIO_WritePin(channels[channel].rst_port, channels[channel].rst_pin, (GPIO_PinState)value);
+}
+
+void board_channel_boot0_write(size_t channel, bool value)
+{
+    ASSERT_NO_MSG(channel < ARRAY_SIZE(channels));
+
+    HAL_GPIO_WritePin(channels[channel].boot_port, channels[channel].boot_pin, (GPIO_PinState)value);
+}
+
+/* Итог по каналам в UART лога. С тремя каналами USART2 занят и итог
+ * показывает только светодиод */
+void board_gang_report(const gang_result_t* results, size_t count)
+{
+#ifdef BOARD_LOG_UART
+    for (size_t i = 0; i < count; ++i) {
+        const gang_result_t* r = &results[i];
+
+        printf("gang: channel %u: %s, PID %04" PRIX16 ", %" PRIu32 " B, CRC %04" PRIX16
+            ", read %04" PRIX16 ", %" PRIu32 " ms\r\n", (unsigned)i, gang_status_name(r->status),
+            r->pid, r->fw_size, r->crc, r->crc_read, r->elapsed_ms);
+    }
+#else
+    ARG_UNUSED(results);
+    ARG_UNUSED(count);
+#endif /* BOARD_LOG_UART */
+}
+#endif /* CONFIG_DFU_GANG_CHANNELS */
+
 /**
  * @brief  This function is executed in case of error occurrence.
  * @retval None
@@ -19,6 +19,47 @@
 
 #include "cmsis.h"
 
+/* Каналы проверки нескольких устройств: USART3 - второй, USART2 - третий
+ * (вместо UART лога). У каждого свое прерывание и канал DMA приема */
+#if defined(CONFIG_DFU_GANG_CHANNELS) && CONFIG_DFU_GANG_CHANNELS >= 2
+#define DFU_USART3
+#endif
+#if defined(CONFIG_DFU_GANG_CHANNELS) && CONFIG_DFU_GANG_CHANNELS >= 3
+#define DFU_USART2
+#endif
+
+#ifdef CONFIG_DFU_HOST_RX_DMA
+/* Прием USART1 по DMA в циклический буфер dfu_host */
+static DMA_HandleTypeDef hdma_usart1_rx;
+#ifdef DFU_USART2
+static DMA_HandleTypeDef hdma_usart2_rx;
+#endif /* DFU_USART2 */
+#ifdef DFU_USART3
+static DMA_HandleTypeDef hdma_usart3_rx;
+#endif /* DFU_USART3 */
+
+/* Канал DMA приема UART загрузчика. Прерывание канала не нужно: dfu_host
+ * читает счетчик CNDTR сам */
+static void dfu_uart_rx_dma_init(UART_HandleTypeDef* huart, DMA_HandleTypeDef* hdma,
+  DMA_Channel_TypeDef* channel)
+{
+  __HAL_RCC_DMA1_CLK_ENABLE();
+
+  hdma->Instance = channel;
+  hdma->Init.Direction = DMA_PERIPH_TO_MEMORY;
+  hdma->Init.PeriphInc = DMA_PINC_DISABLE;
+  hdma->Init.MemInc = DMA_MINC_ENABLE;
+  hdma->Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+  hdma->Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+  hdma->Init.Mode = DMA_CIRCULAR;
+  hdma->Init.Priority = DMA_PRIORITY_HIGH;
+  if (HAL_DMA_Init(hdma) == HAL_OK)
+  {
+    __HAL_LINKDMA(huart, hdmarx, *hdma);
+  }
+}
+#endif /* CONFIG_DFU_HOST_RX_DMA */
+
 void HAL_MspInit(void)
 {
   __HAL_RCC_SYSCFG_CLK_ENABLE();
@@ -51,6 +92,11 @@ void HAL_UART_MspInit(UART_HandleTypeDef* huart)
     GPIO_InitStruct.Alternate = GPIO_AF7_USART1;
     HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
 
+#ifdef CONFIG_DFU_HOST_RX_DMA
+    /* USART1_RX - DMA1 Channel5 */
+    dfu_uart_rx_dma_init(huart, &hdma_usart1_rx, DMA1_Channel5);
+#endif /* CONFIG_DFU_HOST_RX_DMA */
+
     /* USART1 interrupt Init */
     HAL_NVIC_SetPriority(USART1_IRQn, 0, 0);
     HAL_NVIC_EnableIRQ(USART1_IRQn);
@@ -71,7 +117,44 @@ void HAL_UART_MspInit(UART_HandleTypeDef* huart)
     GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_HIGH;
     GPIO_InitStruct.Alternate = GPIO_AF7_USART2;
     HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
+
+#ifdef DFU_USART2
+#ifdef CONFIG_DFU_HOST_RX_DMA
+    /* USART2_RX - DMA1 Channel6 */
+    dfu_uart_rx_dma_init(huart, &hdma_usart2_rx, DMA1_Channel6);
+#endif /* CONFIG_DFU_HOST_RX_DMA */
+
+    HAL_NVIC_SetPriority(USART2_IRQn, 0, 0);
+    HAL_NVIC_EnableIRQ(USART2_IRQn);
+#endif /* DFU_USART2 */
+  }
+#ifdef DFU_USART3
+  else if(huart->Instance==USART3)
+  {
+    /* Peripheral clock enable */
+    __HAL_RCC_USART3_CLK_ENABLE();
+
+    __HAL_RCC_GPIOC_CLK_ENABLE();
+    /**USART3 GPIO Configuration
+    PC10     ------> USART3_TX
+    PC11     ------> USART3_RX
+    */
+    GPIO_InitStruct.Pin = GPIO_PIN_10|GPIO_PIN_11;
+    GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
+    GPIO_InitStruct.Pull = GPIO_NOPULL;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_HIGH;
+    GPIO_InitStruct.Alternate = GPIO_AF7_USART3;
+    HAL_GPIO_Init(GPIOC, &GPIO_InitStruct);
+
+#ifdef CONFIG_DFU_HOST_RX_DMA
+    /* USART3_RX - DMA1 Channel3 */
+    dfu_uart_rx_dma_init(huart, &hdma_usart3_rx, DMA1_Channel3);
+#endif /* CONFIG_DFU_HOST_RX_DMA */
+
+    HAL_NVIC_SetPriority(USART3_IRQn, 0, 0);
+    HAL_NVIC_EnableIRQ(USART3_IRQn);
   }
+#endif /* DFU_USART3 */
 
 }
 
@@ -94,6 +177,10 @@ void HAL_UART_MspDeInit(UART_HandleTypeDef* huart)
     */
     HAL_GPIO_DeInit(GPIOA, GPIO_PIN_9|GPIO_PIN_10);
 
+#ifdef CONFIG_DFU_HOST_RX_DMA
+    HAL_DMA_DeInit(huart->hdmarx);
+#endif /* CONFIG_DFU_HOST_RX_DMA */
+
     /* USART1 interrupt DeInit */
     HAL_NVIC_DisableIRQ(USART1_IRQn);
   }
@@ -107,5 +194,80 @@ void HAL_UART_MspDeInit(UART_HandleTypeDef* huart)
     PA3     ------> USART2_RX
     */
     HAL_GPIO_DeInit(GPIOA, GPIO_PIN_2|GPIO_PIN_3);
+
+#ifdef DFU_USART2
+#ifdef CONFIG_DFU_HOST_RX_DMA
+    HAL_DMA_DeInit(huart->hdmarx);
+#endif /* CONFIG_DFU_HOST_RX_DMA */
+
+    HAL_NVIC_DisableIRQ(USART2_IRQn);
+#endif /* DFU_USART2 */
+  }
+#ifdef DFU_USART3
+  else if(huart->Instance==USART3)
+  {
+    /* Peripheral clock disable */
+    __HAL_RCC_USART3_CLK_DISABLE();
+
+    /**USART3 GPIO Configuration
+    PC10     ------> USART3_TX
+    PC11     ------> USART3_RX
+    */
+    HAL_GPIO_DeInit(GPIOC, GPIO_PIN_10|GPIO_PIN_11);
+
+#ifdef CONFIG_DFU_HOST_RX_DMA
+    HAL_DMA_DeInit(huart->hdmarx);
+#endif /* CONFIG_DFU_HOST_RX_DMA */
+
+    HAL_NVIC_DisableIRQ(USART3_IRQn);
+  }
+#endif /* DFU_USART3 */
+}
+
+/**
+* @brief I2C MSP Initialization
+* @param hi2c: I2C handle pointer
+* @retval None
+*/
+void HAL_I2C_MspInit(I2C_HandleTypeDef* hi2c)
+{
+  GPIO_InitTypeDef GPIO_InitStruct = {0};
+  RCC_PeriphCLKInitTypeDef PeriphClkInit = {0};
+  if(hi2c->Instance==I2C1)
+  {
+    PeriphClkInit.PeriphClockSelection = RCC_PERIPHCLK_I2C1;
+    PeriphClkInit.I2c1ClockSelection = RCC_I2C1CLKSOURCE_HSI;
+    HAL_RCCEx_PeriphCLKConfig(&PeriphClkInit);
+
+    __HAL_RCC_GPIOB_CLK_ENABLE();
+    /**I2C1 GPIO Configuration
+    PB6     ------> I2C1_SCL
+    PB7     ------> I2C1_SDA
+    */
+    GPIO_InitStruct.Pin = GPIO_PIN_6|GPIO_PIN_7;
+    GPIO_InitStruct.Mode = GPIO_MODE_AF_OD;
+    GPIO_InitStruct.Pull = GPIO_PULLUP;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_HIGH;
+    GPIO_InitStruct.Alternate = GPIO_AF4_I2C1;
+    HAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
+
+    /* Peripheral clock enable */
+    __HAL_RCC_I2C1_CLK_ENABLE();
+  }
+}
+
+/**
+* @brief I2C MSP De-Initialization
+* @param hi2c: I2C handle pointer
+* @retval None
+*/
+void HAL_I2C_MspDeInit(I2C_HandleTypeDef* hi2c)
+{
+  if(hi2c->Instance==I2C1)
+  {
+    /* Peripheral clock disable */
+    __HAL_RCC_I2C1_CLK_DISABLE();
+
+    HAL_GPIO_DeInit(GPIOB, GPIO_PIN_6|GPIO_PIN_7);
   }
 }
@@ -19,6 +19,12 @@
 #include "board.h"
 
 extern UART_HandleTypeDef huart1;
+#if defined(CONFIG_DFU_GANG_CHANNELS) && CONFIG_DFU_GANG_CHANNELS >= 2
+extern UART_HandleTypeDef huart3;
+#endif
+#if defined(CONFIG_DFU_GANG_CHANNELS) && CONFIG_DFU_GANG_CHANNELS >= 3
+extern UART_HandleTypeDef huart2;
+#endif
 
 /******************************************************************************/
 /*           Cortex-M4 Processor Interruption and Exception Handlers          */
@@ -116,3 +122,23 @@ void USART1_IRQHandler(void)
 {
   HAL_UART_IRQHandler(&huart1);
 }
+
+#if defined(CONFIG_DFU_GANG_CHANNELS) && CONFIG_DFU_GANG_CHANNELS >= 2
+/**
+  * @brief This function handles USART3 global interrupt (second gang channel).
+  */
+void USART3_IRQHandler(void)
+{
+  HAL_UART_IRQHandler(&huart3);
+}
+#endif
+
+#if defined(CONFIG_DFU_GANG_CHANNELS) && CONFIG_DFU_GANG_CHANNELS >= 3
+/**
+  * @brief This function handles USART2 global interrupt (third gang channel).
+  */
+void USART2_IRQHandler(void)
+{
+  HAL_UART_IRQHandler(&huart2);
+}
+#endif
@@ -0,0 +1,1423 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bl_emu.h"
+#include "dfu_host_crc.h"
+#include "dfu_host_loader.h"
+#include "core/crc.h"
+#include "core/util.h"
+
+#define BL_ACK  0x79
+#define BL_NACK 0x1F
+
+/* Байт начала кадра и синхронизации SPI (AN4286) */
+#define BL_SPI_SOF   0x5A
+/* Холостой байт перед данными ответа SPI */
+#define BL_SPI_DUMMY 0x00
+/* Байт на MISO, пока загрузчику нечего передать */
+#define BL_SPI_IDLE  0xA5
+
+#define BL_CMD_GET               0x00
+#define BL_CMD_GET_VERSION       0x01
+#define BL_CMD_GET_ID            0x02
+#define BL_CMD_READ_MEM          0x11
+#define BL_CMD_GO                0x21
+#define BL_CMD_WRITE_MEM         0x31
+#define BL_CMD_ERASE             0x43
+#define BL_CMD_EXT_ERASE         0x44
+#define BL_CMD_WRITE_PROTECT     0x63
+#define BL_CMD_WRITE_UNPROTECT   0x73
+#define BL_CMD_READOUT_PROTECT   0x82
+#define BL_CMD_READOUT_UNPROTECT 0x92
+
+/* Команды в ответе GET, в порядке AN3155 */
+static const uint8_t supported_cmds[] = {
+    BL_CMD_GET, BL_CMD_GET_VERSION, BL_CMD_GET_ID, BL_CMD_READ_MEM, BL_CMD_GO,
+    BL_CMD_WRITE_MEM, BL_CMD_EXT_ERASE, BL_CMD_WRITE_PROTECT, BL_CMD_WRITE_UNPROTECT,
+    BL_CMD_READOUT_PROTECT, BL_CMD_READOUT_UNPROTECT,
+};
+
+/* Бит на байт в формате 8E1: старт, 8 данных, четность, стоп */
+#define BL_BITS_PER_BYTE 11U
+
+static uint32_t rng_next(bl_emu_t* emu)
+{
+    /* xorshift32 */
+    uint32_t x = emu->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    emu->rng = x;
+    return x;
+}
+
+static inline uint64_t now_us(void)
+{
+    return host_time_us();
+}
+
+/* Идет пачка помех */
+static bool line_burst(const bl_emu_t* emu)
+{
+    return emu->cfg.burst_period_ms != 0 &&
+           (now_us() / 1000U) % emu->cfg.burst_period_ms < emu->cfg.burst_ms;
+}
+
+/* Ошибка, которую приемник USART 8E1 обнаружит в байте-мусоре: нет стоп-бита,
+ * шум при выборке, неверная четность или ничего (четность совпала случайно) */
+static uint32_t line_garbage_error(bl_emu_t* emu)
+{
+    static const uint32_t errors[] = {
+        HAL_UART_ERROR_FE, HAL_UART_ERROR_NE, HAL_UART_ERROR_PE, HAL_UART_ERROR_NONE,
+    };
+
+    return errors[rng_next(emu) % ARRAY_SIZE(errors)];
+}
+
+/* Исказить байт на линии с вероятностью ber_ppm, а при несовпадении скорости
+ * или во время пачки помех - всегда. Ошибку, которую при этом обнаружит
+ * приемник USART, сохраняет в line_error */
+static uint8_t line_noise(bl_emu_t* emu, uint8_t data)
+{
+    emu->line_error = HAL_UART_ERROR_NONE;
+
+    if (emu->link == BL_EMU_LINK_UART && emu->synced_baud != 0 &&
+        emu->huart->Init.BaudRate != emu->synced_baud) {
+        emu->stats.corrupted += 1;
+        emu->line_error = line_garbage_error(emu);
+        return (uint8_t)rng_next(emu);
+    }
+
+    if (line_burst(emu)) {
+        emu->stats.corrupted += 1;
+        emu->line_error = line_garbage_error(emu);
+        return (uint8_t)rng_next(emu);
+    }
+
+    if (emu->cfg.ber_ppm != 0 && (rng_next(emu) % 1000000U) < emu->cfg.ber_ppm) {
+        emu->stats.corrupted += 1;
+        /* Одиночную ошибку в бите данных всегда обнаруживает четность */
+        emu->line_error = HAL_UART_ERROR_PE;
+        return data ^ (uint8_t)(1U << (rng_next(emu) % 8U));
+    }
+
+    return data;
+}
+
+/* Время байта на линии. На SPI и I2C его учитывает HAL при обмене */
+static uint64_t byte_time_us(const bl_emu_t* emu)
+{
+    if (emu->link != BL_EMU_LINK_UART) {
+        return 0;
+    }
+
+    const uint32_t baud = emu->huart->Init.BaudRate;
+
+    return (baud != 0) ? (BL_BITS_PER_BYTE * 1000000ULL + baud - 1) / baud : 0;
+}
+
+static inline uint64_t max_u64(uint64_t a, uint64_t b)
+{
+    return (a > b) ? a : b;
+}
+
+/* Поставить байт ответа в очередь передачи */
+static void emit_byte(bl_emu_t* emu, uint8_t data, bool is_ack)
+{
+    if (emu->txq_head - emu->txq_tail == CONFIG_BL_EMU_TX_QUEUE_SIZE) {
+        return;
+    }
+
+    const uint64_t start = max_u64(max_u64(emu->rx_line_us + emu->cfg.latency_us,
+        emu->busy_us), emu->tx_line_us);
+
+    emu->tx_line_us = start + byte_time_us(emu);
+
+    size_t i = emu->txq_head++ % CONFIG_BL_EMU_TX_QUEUE_SIZE;
+    emu->txq[i].due_us = emu->tx_line_us;
+    emu->txq[i].data   = data;
+    emu->txq[i].ack    = is_ack;
+
+    emu->stats.tx_bytes += 1;
+}
+
+static void emit(bl_emu_t* emu, uint8_t data)
+{
+    emit_byte(emu, data, false);
+}
+
+/* Ответ с данными: на SPI им предшествует холостой байт */
+static void data_start(bl_emu_t* emu)
+{
+    if (emu->link == BL_EMU_LINK_SPI) {
+        emit(emu, BL_SPI_DUMMY);
+    }
+}
+
+static void emit_buf(bl_emu_t* emu, const uint8_t* data, size_t len)
+{
+    for (size_t i = 0; i < len; ++i) {
+        emit(emu, data[i]);
+    }
+}
+
+/* Вернуться к ожиданию следующей команды */
+static inline void idle(bl_emu_t* emu)
+{
+    emu->state = BL_EMU_STATE_WAIT_CMD;
+    emu->count = 0;
+}
+
+static void ack(bl_emu_t* emu)
+{
+    emit_byte(emu, BL_ACK, true);
+}
+
+static void nack(bl_emu_t* emu)
+{
+    emu->stats.nacks += 1;
+    emit_byte(emu, BL_NACK, true);
+    idle(emu);
+}
+
+/* Найти регион, целиком содержащий диапазон [address, address + len) */
+static int region_find(const bl_emu_t* emu, uint32_t address, size_t len)
+{
+    for (size_t i = 0; i < emu->cfg.region_count; ++i) {
+        const bl_emu_region_t* r = &emu->cfg.regions[i];
+
+        if (address >= r->base && len <= r->size &&
+            (uint64_t)address - r->base + len <= r->size) {
+            return (int)i;
+        }
+    }
+
+    return -1;
+}
+
+static bool range_has(const bl_emu_t* emu, uint32_t address, size_t len, uint8_t flags)
+{
+    int i = region_find(emu, address, len);
+
+    return i >= 0 && (emu->cfg.regions[i].flags & flags) == flags;
+}
+
+/* Количество секторов региона, 0 - регион не стирается */
+static uint32_t region_sectors(const bl_emu_region_t* r)
+{
+    if (!(r->flags & BL_EMU_MEM_FLASH)) {
+        return 0;
+    }
+
+    if (r->sector_sizes != NULL) {
+        return (uint32_t)r->sector_count;
+    }
+
+    return (r->sector_size != 0) ? r->size / r->sector_size : 0;
+}
+
+/* Смещение и размер сектора index внутри региона */
+static void region_sector(const bl_emu_region_t* r, uint32_t index, uint32_t* offset,
+    uint32_t* size)
+{
+    if (r->sector_sizes == NULL) {
+        *offset = index * r->sector_size;
+        *size   = r->sector_size;
+        return;
+    }
+
+    *offset = 0;
+
+    for (uint32_t i = 0; i < index; ++i) {
+        *offset += r->sector_sizes[i];
+    }
+
+    *size = r->sector_sizes[index];
+}
+
+/* Сквозной номер сектора Flash, содержащего адрес, или -1 */
+static int sector_of(const bl_emu_t* emu, uint32_t address)
+{
+    int index = 0;
+
+    for (size_t i = 0; i < emu->cfg.region_count; ++i) {
+        const bl_emu_region_t* r = &emu->cfg.regions[i];
+        const uint32_t count = region_sectors(r);
+
+        for (uint32_t s = 0; s < count; ++s) {
+            uint32_t offset, size;
+
+            region_sector(r, s, &offset, &size);
+
+            if (address >= r->base + offset && address - (r->base + offset) < size) {
+                return index + (int)s;
+            }
+        }
+
+        index += (int)count;
+    }
+
+    return -1;
+}
+
+/* Стереть сектор Flash по сквозному номеру */
+static bool sector_erase(bl_emu_t* emu, uint32_t sector)
+{
+    for (size_t i = 0; i < emu->cfg.region_count; ++i) {
+        const bl_emu_region_t* r = &emu->cfg.regions[i];
+        const uint32_t count = region_sectors(r);
+
+        if (sector < count) {
+            uint32_t offset, size;
+
+            region_sector(r, sector, &offset, &size);
+            memset(emu->mem[i] + offset, 0xFF, size);
+            emu->busy_us = max_u64(emu->busy_us, emu->rx_line_us) + emu->cfg.erase_us_per_sector;
+            emu->stats.erased += 1;
+            return true;
+        }
+
+        sector -= count;
+    }
+
+    return false;
+}
+
+static void mass_erase(bl_emu_t* emu)
+{
+    for (uint32_t s = 0; sector_erase(emu, s); ++s) {
+    }
+}
+
+static void mem_write(bl_emu_t* emu, uint32_t address, const uint8_t* data, size_t len)
+{
+    const int i = region_find(emu, address, len);
+    const bl_emu_region_t* r = &emu->cfg.regions[i];
+    uint8_t* dst = emu->mem[i] + (address - r->base);
+
+    if (r->flags & BL_EMU_MEM_FLASH) {
+        emu->stats.written += len;
+    }
+
+    for (size_t k = 0; k < len; ++k) {
+        /* Программирование Flash может только сбрасывать биты */
+        dst[k] = (r->flags & BL_EMU_MEM_FLASH) ? (dst[k] & data[k]) : data[k];
+    }
+}
+
+static bool write_protected(const bl_emu_t* emu, uint32_t address, size_t len)
+{
+    for (size_t k = 0; k < len; ++k) {
+        const int s = sector_of(emu, address + k);
+
+        if (s >= 0 && s < 32 && (emu->wp_mask & (1UL << s))) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static uint8_t xor8(const uint8_t* data, size_t len)
+{
+    uint8_t x = 0;
+
+    for (size_t i = 0; i < len; ++i) {
+        x ^= data[i];
+    }
+
+    return x;
+}
+
+/* Ожидать еще need байт параметров команды */
+static inline void expect(bl_emu_t* emu, uint8_t stage, size_t need)
+{
+    emu->state = BL_EMU_STATE_CMD;
+    emu->stage = stage;
+    emu->count = 0;
+    emu->need  = need;
+}
+
+/* Состояние загрузчика после запуска: по I2C синхронизация не нужна */
+static inline void boot(bl_emu_t* emu)
+{
+    if (emu->link == BL_EMU_LINK_I2C) {
+        idle(emu);
+    } else {
+        emu->state = BL_EMU_STATE_WAIT_SYNC;
+    }
+}
+
+/* Команды, после которых загрузчик выполняет системный сброс */
+static void system_reset(bl_emu_t* emu)
+{
+    boot(emu);
+    emu->synced_baud = 0;
+}
+
+/* Полином аппаратного блока CRC STM32 */
+#define CRC_HW_POLY 0x04C11DB7U
+/* Частота ядра, на которой исполняется помощник, МГц */
+#define CRC_HELPER_CPU_MHZ 168U
+/* Тактов на байт: побитовый цикл и слово через блок CRC */
+#define CRC_HELPER_SW_CYCLES 48U
+#define CRC_HELPER_HW_CYCLES 2U
+/* Запуск загрузчика после системного сброса */
+#define CRC_HELPER_BOOT_US 1000U
+
+static uint32_t crc_bits_normal(uint32_t crc, uint32_t poly, uint8_t data)
+{
+    crc ^= (uint32_t)data << 24;
+
+    for (int bit = 0; bit < 8; ++bit) {
+        crc = (crc & 0x80000000U) ? (crc << 1) ^ poly : crc << 1;
+    }
+
+    return crc;
+}
+
+static uint32_t crc_bits_reflect(uint32_t crc, uint32_t poly, uint8_t data)
+{
+    crc ^= data;
+
+    for (int bit = 0; bit < 8; ++bit) {
+        crc = (crc & 1U) ? (crc >> 1) ^ poly : crc >> 1;
+    }
+
+    return crc;
+}
+
+/*
+ * GO на образ помощника расчета CRC (dfu_host_crc.h). Код Thumb модель не
+ * исполняет: результат, который помощник оставил бы в SRAM, считается здесь,
+ * а системный сброс планируется на момент окончания расчета на устройстве.
+ *
+ * @return false - по адресу не помощник.
+ */
+static bool crc_helper_start(bl_emu_t* emu, uint32_t base)
+{
+    uint8_t* image = bl_emu_mem(emu, base, sizeof(dfu_host_crc_helper_params_t));
+    dfu_host_crc_helper_params_t p;
+
+    if (image == NULL) {
+        return false;
+    }
+
+    memcpy(&p, image, sizeof(p));
+
+    if (p.magic != DFU_HOST_CRC_HELPER_MAGIC) {
+        return false;
+    }
+
+    emu->state = BL_EMU_STATE_RUNNING;
+
+    /* Чтение вне памяти - HardFault, устройство зависает до сброса по RST */
+    const uint8_t* data = bl_emu_mem(emu, p.address, p.length);
+    if (data == NULL || p.length == 0) {
+        return true;
+    }
+
+    uint32_t crc = p.state;
+    uint64_t cycles = 0;
+    size_t i = 0;
+
+    if (p.flags & DFU_HOST_CRC_HELPER_FLAG_HW) {
+        /* CRC_CR.RESET, затем слова старшим байтом вперед */
+        crc = 0xFFFFFFFFU;
+
+        for (; i + 4 <= p.length; ++i) {
+            crc = crc_bits_normal(crc, CRC_HW_POLY, data[i]);
+        }
+
+        cycles += (uint64_t)i * CRC_HELPER_HW_CYCLES;
+    }
+
+    cycles += (uint64_t)(p.length - i) * CRC_HELPER_SW_CYCLES;
+
+    for (; i < p.length; ++i) {
+        crc = (p.flags & DFU_HOST_CRC_HELPER_FLAG_REFIN) ? crc_bits_reflect(crc, p.poly, data[i])
+                                                         : crc_bits_normal(crc, p.poly, data[i]);
+    }
+
+    p.state  = crc;
+    p.status = DFU_HOST_CRC_HELPER_DONE;
+    memcpy(image, &p, sizeof(p));
+
+    emu->reset_us = emu->rx_line_us + cycles / CRC_HELPER_CPU_MHZ + CRC_HELPER_BOOT_US;
+    return true;
+}
+
+/* Частота USART1 системного загрузчика F4, Гц */
+#define LOADER_PCLK_HZ 60000000U
+/* Программирование слова Flash (PSIZE x32), мкс */
+#define LOADER_WORD_US 16U
+/* Ошибка скорости, при которой USART еще принимает без искажений, 1/1000 */
+#define LOADER_BAUD_ERROR_PERMILLE 25U
+/* Кадров DATA без подтверждения, как в dfu_host_loader_f4.S */
+#define LOADER_WINDOW 4U
+
+static inline uint32_t le32(const uint8_t* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void loader_frame(bl_emu_t* emu, uint8_t type, uint8_t seq, const uint8_t* data, size_t len)
+{
+    const uint8_t head[] = { DFU_HOST_LOADER_SOF, type, seq, len & 0xFF, len >> 8 };
+    uint32_t crc = crc32_ieee(head + 1, sizeof(head) - 1);
+
+    if (len != 0) {
+        crc = crc32_ieee_update(crc, data, len);
+    }
+
+    const uint8_t tail[] = { crc & 0xFF, (crc >> 8) & 0xFF, (crc >> 16) & 0xFF, crc >> 24 };
+
+    emit_buf(emu, head, sizeof(head));
+    emit_buf(emu, data, len);
+    emit_buf(emu, tail, sizeof(tail));
+}
+
+static inline void loader_reply(bl_emu_t* emu, uint8_t type, uint8_t seq)
+{
+    loader_frame(emu, type, seq, NULL, 0);
+}
+
+static inline void loader_status(bl_emu_t* emu, uint8_t seq, uint8_t status)
+{
+    loader_frame(emu, DFU_HOST_LOADER_STATUS, seq, &status, 1);
+}
+
+/*
+ * GO на загрузчик в SRAM (dfu_host_loader.h): загрузчик передает HELLO и
+ * дальше работает с хостом кадрами. Загрузчик подключен к USART, на SPI и
+ * I2C устройство замолкает.
+ *
+ * @return false - по адресу не загрузчик.
+ */
+static bool loader_start(bl_emu_t* emu, uint32_t base)
+{
+    const uint8_t* image = bl_emu_mem(emu, base, sizeof(dfu_host_loader_params_t));
+
+    if (image == NULL ||
+        le32(image + offsetof(dfu_host_loader_params_t, magic)) != DFU_HOST_LOADER_MAGIC) {
+        return false;
+    }
+
+    if (emu->link != BL_EMU_LINK_UART || emu->synced_baud == 0) {
+        emu->state = BL_EMU_STATE_RUNNING;
+        return true;
+    }
+
+    memset(&emu->ldr, 0, sizeof(emu->ldr));
+    emu->ldr.brr = (LOADER_PCLK_HZ + emu->synced_baud / 2) / emu->synced_baud;
+    emu->state = BL_EMU_STATE_LOADER;
+    emu->count = 0;
+
+    const uint8_t hello[] = {
+        DFU_HOST_LOADER_VERSION, LOADER_WINDOW,
+        DFU_HOST_LOADER_DATA_MAX & 0xFF, DFU_HOST_LOADER_DATA_MAX >> 8,
+        emu->ldr.brr & 0xFF, (emu->ldr.brr >> 8) & 0xFF, 0, 0,
+    };
+
+    loader_frame(emu, DFU_HOST_LOADER_HELLO, 0, hello, sizeof(hello));
+    return true;
+}
+
+/* Передать кадры DATA, сколько позволяет окно. Как и загрузчик, который
+ * между кадрами проверяет прием, модель ставит в очередь следующий кадр
+ * только после передачи предыдущего */
+static void loader_read_pump(bl_emu_t* emu)
+{
+    while (emu->tx_line_us <= now_us() && emu->ldr.rd_next < emu->ldr.rd_len &&
+           emu->ldr.rd_next - emu->ldr.rd_acked < LOADER_WINDOW * DFU_HOST_LOADER_DATA_MAX) {
+        const uint32_t offset = emu->ldr.rd_next;
+        const uint32_t n = MIN(emu->ldr.rd_len - offset, DFU_HOST_LOADER_DATA_MAX);
+
+        loader_frame(emu, DFU_HOST_LOADER_DATA, emu->ldr.rd_seq + offset / DFU_HOST_LOADER_DATA_MAX,
+            bl_emu_mem(emu, emu->ldr.rd_address + offset, n), n);
+        emu->ldr.rd_next = offset + n;
+    }
+}
+
+/* ACK/NAK хоста во время READ: seq следующего ожидаемого кадра */
+static void loader_read_ack(bl_emu_t* emu, uint8_t type, uint8_t seq)
+{
+    const uint32_t base = emu->ldr.rd_acked / DFU_HOST_LOADER_DATA_MAX;
+    const uint32_t frame = base + (uint8_t)(seq - emu->ldr.rd_seq - base);
+    const uint32_t offset = MIN(frame * DFU_HOST_LOADER_DATA_MAX, emu->ldr.rd_len);
+
+    /* Больше отправленного - чужой кадр */
+    if (offset > emu->ldr.rd_next) {
+        return;
+    }
+
+    emu->ldr.rd_acked = offset;
+
+    if (type == DFU_HOST_LOADER_NAK) {
+        emu->ldr.rd_next = offset;
+    }
+
+    if (emu->ldr.rd_acked >= emu->ldr.rd_len) {
+        emu->ldr.reading = false;
+        return;
+    }
+
+    loader_read_pump(emu);
+}
+
+static uint8_t loader_write(bl_emu_t* emu, uint32_t address, const uint8_t* data, size_t len)
+{
+    if (len == 0 || !range_has(emu, address, len, BL_EMU_MEM_READ)) {
+        return DFU_HOST_LOADER_ST_ADDR;
+    }
+
+    if (range_has(emu, address, len, BL_EMU_MEM_FLASH)) {
+        if ((address | len) & 3U) {
+            return DFU_HOST_LOADER_ST_ADDR;
+        }
+
+        /* WRPERR */
+        if (write_protected(emu, address, len)) {
+            return DFU_HOST_LOADER_ST_FLASH;
+        }
+
+        emu->busy_us = max_u64(emu->busy_us, emu->rx_line_us) + (len / 4) * LOADER_WORD_US;
+    } else if (!range_has(emu, address, len, BL_EMU_MEM_WRITE)) {
+        return DFU_HOST_LOADER_ST_ADDR;
+    }
+
+    mem_write(emu, address, data, len);
+    return DFU_HOST_LOADER_ST_OK;
+}
+
+static uint8_t loader_erase(bl_emu_t* emu, uint32_t address, uint32_t len)
+{
+    if (len == 0 || !range_has(emu, address, len, BL_EMU_MEM_FLASH)) {
+        return DFU_HOST_LOADER_ST_ADDR;
+    }
+
+    const int last = sector_of(emu, address + len - 1);
+
+    for (int s = sector_of(emu, address); s <= last; ++s) {
+        if (s < 32 && (emu->wp_mask & (1UL << s))) {
+            return DFU_HOST_LOADER_ST_FLASH;
+        }
+
+        sector_erase(emu, s);
+    }
+
+    return DFU_HOST_LOADER_ST_OK;
+}
+
+/* Обработать принятый кадр, ok - CRC совпала */
+static void loader_command(bl_emu_t* emu, bool ok)
+{
+    const uint8_t type = emu->buf[1];
+    const uint8_t seq = emu->buf[2];
+    const size_t len = emu->buf[3] | ((size_t)emu->buf[4] << 8);
+    const uint8_t* p = emu->buf + 5;
+
+    emu->stats.commands += 1;
+
+    if (emu->ldr.reading) {
+        /* Искаженные кадры во время чтения пропускаются, по таймауту хост повторит */
+        if (!ok) {
+            return;
+        }
+
+        if (type == DFU_HOST_LOADER_ACK || type == DFU_HOST_LOADER_NAK) {
+            loader_read_ack(emu, type, seq);
+            return;
+        }
+
+        emu->ldr.reading = false;
+    }
+
+    /* Искаженный кадр или пропуск WRITE - NAK с ожидаемым seq, один раз */
+    if (!ok || (type == DFU_HOST_LOADER_WRITE && seq != emu->ldr.wr_seq &&
+                (uint8_t)(emu->ldr.wr_seq - seq) > 128)) {
+        if (!emu->ldr.nak_sent) {
+            emu->ldr.nak_sent = true;
+            emu->stats.nacks += 1;
+            loader_reply(emu, DFU_HOST_LOADER_NAK, emu->ldr.wr_seq);
+        }
+        return;
+    }
+
+    if (type != DFU_HOST_LOADER_WRITE) {
+        emu->ldr.nak_sent = false;
+    }
+
+    switch (type) {
+    case DFU_HOST_LOADER_PING:
+        loader_frame(emu, DFU_HOST_LOADER_ACK, seq, &emu->ldr.wr_seq, 1);
+        break;
+
+    case DFU_HOST_LOADER_BAUD:
+        if (len < 8) {
+            break;
+        }
+
+        /* Новый BRR - после передачи ACK */
+        loader_reply(emu, DFU_HOST_LOADER_ACK, seq);
+        emu->ldr.baud = le32(p);
+        emu->ldr.baud_brr = le32(p + 4);
+        emu->ldr.baud_us = emu->tx_line_us;
+        break;
+
+    case DFU_HOST_LOADER_WRITE: {
+        /* Повтор уже записанного кадра - подтвердить заново */
+        if (seq != emu->ldr.wr_seq) {
+            loader_reply(emu, DFU_HOST_LOADER_ACK, emu->ldr.wr_seq);
+            break;
+        }
+
+        const uint8_t st = (len < 4) ? DFU_HOST_LOADER_ST_ADDR
+                                     : loader_write(emu, le32(p), p + 4, len - 4);
+
+        if (st != DFU_HOST_LOADER_ST_OK) {
+            loader_status(emu, seq, st);
+            break;
+        }
+
+        emu->ldr.wr_seq += 1;
+        emu->ldr.nak_sent = false;
+        loader_reply(emu, DFU_HOST_LOADER_ACK, emu->ldr.wr_seq);
+        break;
+    }
+
+    case DFU_HOST_LOADER_READ:
+        if (len < 8) {
+            break;
+        }
+
+        if (le32(p + 4) == 0 || !range_has(emu, le32(p), le32(p + 4), BL_EMU_MEM_READ)) {
+            loader_status(emu, seq, DFU_HOST_LOADER_ST_ADDR);
+            break;
+        }
+
+        emu->ldr.reading    = true;
+        emu->ldr.rd_seq     = seq;
+        emu->ldr.rd_address = le32(p);
+        emu->ldr.rd_len     = le32(p + 4);
+        emu->ldr.rd_next    = 0;
+        emu->ldr.rd_acked   = 0;
+        loader_read_pump(emu);
+        break;
+
+    case DFU_HOST_LOADER_ERASE:
+        if (len < 8) {
+            break;
+        }
+
+        loader_status(emu, seq, loader_erase(emu, le32(p), le32(p + 4)));
+        break;
+
+    case DFU_HOST_LOADER_GO:
+        if (len < 4) {
+            break;
+        }
+
+        loader_reply(emu, DFU_HOST_LOADER_ACK, seq);
+        emu->state = BL_EMU_STATE_RUNNING;
+
+        if (emu->cfg.on_go != NULL) {
+            emu->cfg.on_go(emu->cfg.ctx, le32(p));
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+/* Собрать кадр загрузчика из принятых байт */
+static void loader_rx(bl_emu_t* emu, uint8_t data)
+{
+    if (emu->count == 0 && data != DFU_HOST_LOADER_SOF) {
+        return;
+    }
+
+    emu->buf[emu->count++] = data;
+
+    if (emu->count < 5) {
+        return;
+    }
+
+    const size_t len = emu->buf[3] | ((size_t)emu->buf[4] << 8);
+
+    /* Длина искажена - искать следующий SOF */
+    if (len > DFU_HOST_LOADER_PAYLOAD_MAX) {
+        emu->count = 0;
+        return;
+    }
+
+    if (emu->count < len + DFU_HOST_LOADER_OVERHEAD) {
+        return;
+    }
+
+    emu->count = 0;
+
+    loader_command(emu, crc32_ieee(emu->buf + 1, 4 + len) == le32(emu->buf + 5 + len));
+}
+
+/* Отложенные события: сброс после помощника CRC, смена BRR загрузчиком */
+static void timers_poll(bl_emu_t* emu)
+{
+    if (emu->reset_us != 0 && now_us() >= emu->reset_us) {
+        emu->reset_us = 0;
+
+        if (emu->state == BL_EMU_STATE_RUNNING) {
+            system_reset(emu);
+            emu->rx_line_us = now_us();
+            emu->tx_line_us = emu->rx_line_us;
+            emu->busy_us = emu->rx_line_us;
+        }
+    }
+
+    if (emu->state == BL_EMU_STATE_LOADER && emu->ldr.reading) {
+        loader_read_pump(emu);
+    }
+
+    if (emu->ldr.baud_brr != 0 && now_us() >= emu->ldr.baud_us) {
+        const uint32_t brr = emu->ldr.baud_brr;
+        const uint32_t actual = LOADER_PCLK_HZ / brr;
+        const uint32_t error = (actual > emu->ldr.baud) ? actual - emu->ldr.baud
+                                                        : emu->ldr.baud - actual;
+
+        emu->ldr.brr = brr;
+        emu->ldr.baud_brr = 0;
+
+        /* Скорость хоста в пределах допуска USART - прием без искажений */
+        emu->synced_baud = ((uint64_t)error * 1000U <= (uint64_t)actual * LOADER_BAUD_ERROR_PERMILLE)
+                               ? emu->ldr.baud : actual;
+    }
+}
+
+/* Разобрать принятый адрес с контрольной суммой */
+static bool parse_address(bl_emu_t* emu)
+{
+    if (xor8(emu->buf, 4) != emu->buf[4]) {
+        return false;
+    }
+
+    emu->address = ((uint32_t)emu->buf[0] << 24) | ((uint32_t)emu->buf[1] << 16) |
+                   ((uint32_t)emu->buf[2] << 8) | emu->buf[3];
+    return true;
+}
+
+static void command_start(bl_emu_t* emu, uint8_t cmd)
+{
+    emu->cmd = cmd;
+    emu->stats.commands += 1;
+
+    switch (cmd) {
+    case BL_CMD_GET:
+        ack(emu);
+        data_start(emu);
+        emit(emu, sizeof(supported_cmds));
+        emit(emu, emu->cfg.version);
+
+        for (size_t i = 0; i < sizeof(supported_cmds); ++i) {
+            /* Старый загрузчик стирает командой Erase на месте Extended Erase */
+            emit(emu, (supported_cmds[i] == BL_CMD_EXT_ERASE && emu->cfg.legacy_erase) ?
+                BL_CMD_ERASE : supported_cmds[i]);
+        }
+
+        ack(emu);
+        break;
+
+    case BL_CMD_GET_VERSION:
+        ack(emu);
+        data_start(emu);
+        emit(emu, emu->cfg.version);
+
+        /* Байты совместимости с опциями есть только в протоколе USART */
+        if (emu->link == BL_EMU_LINK_UART) {
+            emit(emu, 0x00);
+            emit(emu, 0x00);
+        }
+
+        ack(emu);
+        break;
+
+    case BL_CMD_GET_ID:
+        ack(emu);
+        data_start(emu);
+        emit(emu, 1);
+        emit(emu, emu->cfg.pid >> 8);
+        emit(emu, emu->cfg.pid & 0xFF);
+        ack(emu);
+        break;
+
+    case BL_CMD_READ_MEM:
+    case BL_CMD_WRITE_MEM:
+    case BL_CMD_GO:
+        if (emu->rdp) {
+            nack(emu);
+            return;
+        }
+
+        ack(emu);
+        expect(emu, 0, 5);
+        return;
+
+    case BL_CMD_ERASE:
+    case BL_CMD_EXT_ERASE:
+    case BL_CMD_WRITE_PROTECT:
+        /* Загрузчик поддерживает только одну из команд стирания */
+        if (emu->rdp || (cmd == BL_CMD_ERASE && !emu->cfg.legacy_erase) ||
+            (cmd == BL_CMD_EXT_ERASE && emu->cfg.legacy_erase)) {
+            nack(emu);
+            return;
+        }
+
+        ack(emu);
+        expect(emu, 0, (cmd == BL_CMD_WRITE_PROTECT) ? 1 : 2);
+        return;
+
+    case BL_CMD_WRITE_UNPROTECT:
+        ack(emu);
+        emu->wp_mask = 0;
+        ack(emu);
+        system_reset(emu);
+        return;
+
+    case BL_CMD_READOUT_PROTECT:
+        ack(emu);
+        emu->rdp = true;
+        ack(emu);
+        system_reset(emu);
+        return;
+
+    case BL_CMD_READOUT_UNPROTECT:
+        ack(emu);
+        mass_erase(emu);
+        emu->rdp = false;
+        emu->wp_mask = 0;
+        ack(emu);
+        system_reset(emu);
+        return;
+
+    default:
+        nack(emu);
+        return;
+    }
+
+    idle(emu);
+}
+
+/* Обработать очередную принятую порцию параметров команды */
+static void command_stage(bl_emu_t* emu)
+{
+    switch (emu->cmd) {
+    case BL_CMD_READ_MEM:
+        if (emu->stage == 0) {
+            if (!parse_address(emu) || !range_has(emu, emu->address, 1, BL_EMU_MEM_READ)) {
+                nack(emu);
+                return;
+            }
+
+            ack(emu);
+            expect(emu, 1, 2);
+            return;
+        }
+
+        if ((emu->buf[0] ^ emu->buf[1]) != 0xFF ||
+            !range_has(emu, emu->address, emu->buf[0] + 1U, BL_EMU_MEM_READ)) {
+            nack(emu);
+            return;
+        }
+
+        ack(emu);
+        data_start(emu);
+        emit_buf(emu, bl_emu_mem(emu, emu->address, emu->buf[0] + 1U), emu->buf[0] + 1U);
+        break;
+
+    case BL_CMD_WRITE_MEM:
+        if (emu->stage == 0) {
+            if (!parse_address(emu) || !range_has(emu, emu->address, 1, BL_EMU_MEM_WRITE)) {
+                nack(emu);
+                return;
+            }
+
+            ack(emu);
+            expect(emu, 1, 1);
+            return;
+        }
+
+        if (emu->stage == 1) {
+            /* N, затем N + 1 байт данных и контрольная сумма */
+            emu->stage = 2;
+            emu->need  = 1 + emu->buf[0] + 1U + 1U;
+            return;
+        }
+
+        {
+            const size_t len = emu->buf[0] + 1U;
+
+            if (xor8(emu->buf, len + 1) != emu->buf[len + 1] ||
+                !range_has(emu, emu->address, len, BL_EMU_MEM_WRITE) ||
+                write_protected(emu, emu->address, len)) {
+                nack(emu);
+                return;
+            }
+
+            mem_write(emu, emu->address, emu->buf + 1, len);
+            ack(emu);
+        }
+        break;
+
+    case BL_CMD_GO:
+        if (!parse_address(emu) || !range_has(emu, emu->address, 1, BL_EMU_MEM_EXEC)) {
+            nack(emu);
+            return;
+        }
+
+        ack(emu);
+
+        if (crc_helper_start(emu, emu->address) || loader_start(emu, emu->address)) {
+            return;
+        }
+
+        emu->state = BL_EMU_STATE_RUNNING;
+
+        if (emu->cfg.on_go != NULL) {
+            emu->cfg.on_go(emu->cfg.ctx, emu->address);
+        }
+        return;
+
+    case BL_CMD_ERASE:
+        /* FF 00 - глобальное стирание, иначе N, N + 1 номеров страниц и контрольная сумма */
+        if (emu->stage == 0 && !(emu->buf[0] == 0xFF && emu->buf[1] == 0x00)) {
+            emu->stage = 1;
+            emu->need  = 1 + emu->buf[0] + 1U + 1U;
+            return;
+        }
+
+        if (emu->stage == 0) {
+            mass_erase(emu);
+            ack(emu);
+            break;
+        }
+
+        if (xor8(emu->buf, emu->need - 1) != emu->buf[emu->need - 1]) {
+            nack(emu);
+            return;
+        }
+
+        for (size_t i = 0; i <= emu->buf[0]; ++i) {
+            const uint8_t page = emu->buf[1 + i];
+
+            if ((page < 32 && (emu->wp_mask & (1UL << page))) || !sector_erase(emu, page)) {
+                nack(emu);
+                return;
+            }
+        }
+
+        ack(emu);
+        break;
+
+    case BL_CMD_EXT_ERASE: {
+        const uint16_t n = ((uint16_t)emu->buf[0] << 8) | emu->buf[1];
+
+        if (emu->stage == 0) {
+            emu->stage = 1;
+            /* Спецкоды 0xFFFx - только контрольная сумма, иначе N + 1 номеров страниц */
+            emu->need = (n >= 0xFFF0) ? 3 : 2 + 2 * ((size_t)n + 1) + 1;
+            return;
+        }
+
+        if (xor8(emu->buf, emu->need - 1) != emu->buf[emu->need - 1]) {
+            nack(emu);
+            return;
+        }
+
+        if (n >= 0xFFF0) {
+            /* Mass erase или стирание банка: банк в модели один */
+            if (n < 0xFFFD) {
+                nack(emu);
+                return;
+            }
+
+            mass_erase(emu);
+        } else {
+            for (size_t i = 0; i <= n; ++i) {
+                const uint16_t page = ((uint16_t)emu->buf[2 + 2 * i] << 8) | emu->buf[3 + 2 * i];
+
+                if ((page < 32 && (emu->wp_mask & (1UL << page))) || !sector_erase(emu, page)) {
+                    nack(emu);
+                    return;
+                }
+            }
+        }
+
+        ack(emu);
+        break;
+    }
+
+    case BL_CMD_WRITE_PROTECT:
+        if (emu->stage == 0) {
+            emu->stage = 1;
+            emu->need  = 1 + emu->buf[0] + 1U + 1U;
+            return;
+        }
+
+        if (xor8(emu->buf, emu->need - 1) != emu->buf[emu->need - 1]) {
+            nack(emu);
+            return;
+        }
+
+        for (size_t i = 0; i <= emu->buf[0]; ++i) {
+            if (emu->buf[1 + i] < 32) {
+                emu->wp_mask |= 1UL << emu->buf[1 + i];
+            }
+        }
+
+        ack(emu);
+        system_reset(emu);
+        return;
+
+    default:
+        break;
+    }
+
+    idle(emu);
+}
+
+/* Обработать байт, принятый от хоста */
+static void rx_byte(bl_emu_t* emu, uint8_t data)
+{
+    switch (emu->state) {
+    case BL_EMU_STATE_HELD:
+    case BL_EMU_STATE_RUNNING:
+        break;
+
+    case BL_EMU_STATE_WAIT_SYNC:
+        if (emu->link == BL_EMU_LINK_SPI) {
+            if (data == BL_SPI_SOF) {
+                idle(emu);
+                ack(emu);
+            }
+            break;
+        }
+
+        /* Автоопределение скорости работает только до max_baud */
+        if (data == 0x7F && emu->huart->Init.BaudRate <= emu->cfg.max_baud) {
+            emu->synced_baud = emu->huart->Init.BaudRate;
+            idle(emu);
+            ack(emu);
+        }
+        break;
+
+    case BL_EMU_STATE_WAIT_CMD:
+        /* Кадр команды SPI начинается с байта 0x5A */
+        if (emu->link == BL_EMU_LINK_SPI && emu->count == 0 && data == BL_SPI_SOF) {
+            break;
+        }
+
+        emu->buf[emu->count++] = data;
+
+        if (emu->count == 2) {
+            emu->count = 0;
+
+            if ((emu->buf[0] ^ emu->buf[1]) != 0xFF) {
+                nack(emu);
+                break;
+            }
+
+            command_start(emu, emu->buf[0]);
+        }
+        break;
+
+    case BL_EMU_STATE_CMD:
+        emu->buf[emu->count++] = data;
+
+        if (emu->count == emu->need) {
+            command_stage(emu);
+        }
+        break;
+
+    case BL_EMU_STATE_LOADER:
+        loader_rx(emu, data);
+        break;
+    }
+}
+
+static void peer_receive(void* ctx, const uint8_t* data, size_t len)
+{
+    bl_emu_t* emu = ctx;
+    const uint64_t byte_us = byte_time_us(emu);
+
+    timers_poll(emu);
+
+    for (size_t i = 0; i < len; ++i) {
+        emu->rx_line_us = max_u64(emu->rx_line_us, now_us()) + byte_us;
+        emu->stats.rx_bytes += 1;
+
+        rx_byte(emu, line_noise(emu, data[i]));
+    }
+}
+
+static void peer_poll(void* ctx, uint32_t now)
+{
+    (void)now;
+
+    bl_emu_t* emu = ctx;
+    const uint64_t t = now_us();
+
+    while (emu->txq_tail != emu->txq_head) {
+        size_t i = emu->txq_tail % CONFIG_BL_EMU_TX_QUEUE_SIZE;
+
+        if (emu->txq[i].due_us > t) {
+            break;
+        }
+
+        uint8_t data = line_noise(emu, emu->txq[i].data);
+
+        host_uart_rx_push(emu->huart, &data, 1);
+        if (emu->line_error != HAL_UART_ERROR_NONE) {
+            host_uart_rx_error(emu->huart, emu->line_error);
+        }
+        emu->txq_tail += 1;
+    }
+
+    /* После доставки: ACK команды BAUD уходит еще на старой скорости */
+    timers_poll(emu);
+}
+
+/* Обмен байтом по SPI: одновременно принимается байт хоста и выдается байт ответа */
+static uint8_t spi_byte(bl_emu_t* emu, uint8_t in)
+{
+    const bool confirm = emu->spi_confirm;
+    const bool pending = emu->txq_tail != emu->txq_head;
+    uint8_t out = BL_SPI_IDLE;
+
+    emu->spi_confirm = false;
+
+    timers_poll(emu);
+
+    /* После GO загрузчик успевает выдать только уже стоящий в очереди ACK */
+    if (emu->state == BL_EMU_STATE_HELD ||
+        (emu->state == BL_EMU_STATE_RUNNING && !pending && !confirm)) {
+        return 0xFF;
+    }
+
+    /* Пока хост подтверждает ACK/NACK, ответ не выдается */
+    if (!confirm && pending) {
+        size_t i = emu->txq_tail % CONFIG_BL_EMU_TX_QUEUE_SIZE;
+
+        if (emu->txq[i].due_us <= now_us()) {
+            out = line_noise(emu, emu->txq[i].data);
+            emu->spi_confirm = emu->txq[i].ack;
+            emu->txq_tail += 1;
+        }
+    }
+
+    /* Байты хоста во время выдачи ответа - холостые, подтверждение ACK не анализируется */
+    if (!confirm && !pending) {
+        emu->rx_line_us = now_us();
+        emu->stats.rx_bytes += 1;
+
+        rx_byte(emu, line_noise(emu, in));
+    }
+
+    return out;
+}
+
+static void spi_exchange(void* ctx, const uint8_t* tx, uint8_t* rx, size_t len)
+{
+    bl_emu_t* emu = ctx;
+
+    for (size_t i = 0; i < len; ++i) {
+        rx[i] = spi_byte(emu, tx[i]);
+    }
+}
+
+/* Загрузчик отвечает на свой адрес, только когда исполняется или еще не выдал ACK команды GO */
+static inline bool i2c_selected(const bl_emu_t* emu, uint16_t address)
+{
+    return address == emu->i2c_address && emu->state != BL_EMU_STATE_HELD &&
+           (emu->state != BL_EMU_STATE_RUNNING || emu->txq_head != emu->txq_tail);
+}
+
+static bool i2c_write(void* ctx, uint16_t address, const uint8_t* data, size_t len)
+{
+    bl_emu_t* emu = ctx;
+
+    timers_poll(emu);
+
+    if (!i2c_selected(emu, address)) {
+        return false;
+    }
+
+    for (size_t i = 0; i < len; ++i) {
+        emu->rx_line_us = now_us();
+        emu->stats.rx_bytes += 1;
+
+        rx_byte(emu, line_noise(emu, data[i]));
+    }
+
+    return true;
+}
+
+static bool i2c_read(void* ctx, uint16_t address, uint8_t* data, size_t len)
+{
+    bl_emu_t* emu = ctx;
+
+    timers_poll(emu);
+
+    if (!i2c_selected(emu, address) || emu->txq_head - emu->txq_tail < len) {
+        return false;
+    }
+
+    /* Пока ответ не готов целиком, адрес не подтверждается */
+    const size_t last = (emu->txq_tail + len - 1) % CONFIG_BL_EMU_TX_QUEUE_SIZE;
+
+    if (emu->txq[last].due_us > now_us()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < len; ++i) {
+        data[i] = line_noise(emu, emu->txq[emu->txq_tail++ % CONFIG_BL_EMU_TX_QUEUE_SIZE].data);
+    }
+
+    return true;
+}
+
+int bl_emu_init(bl_emu_t* emu, const bl_emu_config_t* cfg)
+{
+    if (emu == NULL || cfg == NULL || cfg->regions == NULL || cfg->region_count == 0) {
+        return -EINVAL;
+    }
+
+    memset(emu, 0, sizeof(*emu));
+
+    emu->cfg = *cfg;
+    emu->rng = (cfg->seed != 0) ? cfg->seed : 0x2545F491U;
+    emu->rdp = cfg->readout_protected;
+    emu->state = BL_EMU_STATE_HELD;
+
+    emu->mem = calloc(cfg->region_count, sizeof(*emu->mem));
+    if (emu->mem == NULL) {
+        return -ENOMEM;
+    }
+
+    for (size_t i = 0; i < cfg->region_count; ++i) {
+        emu->mem[i] = malloc(cfg->regions[i].size);
+        if (emu->mem[i] == NULL) {
+            bl_emu_deinit(emu);
+            return -ENOMEM;
+        }
+
+        memset(emu->mem[i], (cfg->regions[i].flags & BL_EMU_MEM_FLASH) ? 0xFF : 0x00,
+            cfg->regions[i].size);
+    }
+
+    emu->peer.receive = peer_receive;
+    emu->peer.poll    = peer_poll;
+    emu->peer.ctx     = emu;
+
+    emu->spi_peer.exchange = spi_exchange;
+    emu->spi_peer.ctx      = emu;
+
+    emu->i2c_peer.write = i2c_write;
+    emu->i2c_peer.read  = i2c_read;
+    emu->i2c_peer.ctx   = emu;
+
+    return 0;
+}
+
+void bl_emu_deinit(bl_emu_t* emu)
+{
+    if (emu->mem == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < emu->cfg.region_count; ++i) {
+        free(emu->mem[i]);
+    }
+
+    free(emu->mem);
+    emu->mem = NULL;
+}
+
+void bl_emu_attach(bl_emu_t* emu, UART_HandleTypeDef* huart)
+{
+    emu->link  = BL_EMU_LINK_UART;
+    emu->huart = huart;
+    host_uart_attach(huart, &emu->peer);
+}
+
+void bl_emu_attach_spi(bl_emu_t* emu, SPI_HandleTypeDef* hspi)
+{
+    emu->link = BL_EMU_LINK_SPI;
+    host_spi_attach(hspi, &emu->spi_peer);
+}
+
+void bl_emu_attach_i2c(bl_emu_t* emu, I2C_HandleTypeDef* hi2c, uint16_t address)
+{
+    emu->link = BL_EMU_LINK_I2C;
+    emu->i2c_address = address;
+    host_i2c_attach(hi2c, &emu->i2c_peer);
+}
+
+uint8_t* bl_emu_mem(bl_emu_t* emu, uint32_t address, size_t len)
+{
+    const int i = region_find(emu, address, len);
+
+    if (i < 0) {
+        return NULL;
+    }
+
+    return emu->mem[i] + (address - emu->cfg.regions[i].base);
+}
+
+int bl_emu_load(bl_emu_t* emu, uint32_t address, const uint8_t* data, size_t len)
+{
+    uint8_t* dst = bl_emu_mem(emu, address, len);
+
+    if (dst == NULL) {
+        return -EFAULT;
+    }
+
+    memcpy(dst, data, len);
+    return 0;
+}
+
+void bl_emu_set_pins(bl_emu_t* emu, bool nrst, bool boot0)
+{
+    const bool released = nrst && !emu->nrst;
+
+    emu->nrst  = nrst;
+    emu->boot0 = boot0;
+
+    if (!nrst) {
+        /* Сброс: недоставленный ответ теряется */
+        emu->state = BL_EMU_STATE_HELD;
+        emu->txq_tail = emu->txq_head;
+        emu->synced_baud = 0;
+        emu->spi_confirm = false;
+        emu->reset_us = 0;
+        memset(&emu->ldr, 0, sizeof(emu->ldr));
+        return;
+    }
+
+    if (released) {
+        if (boot0) {
+            boot(emu);
+        } else {
+            emu->state = BL_EMU_STATE_RUNNING;
+        }
+
+        emu->rx_line_us = now_us();
+        emu->tx_line_us = emu->rx_line_us;
+        emu->busy_us = emu->rx_line_us;
+    }
+}
+
+const bl_emu_stats_t* bl_emu_get_stats(const bl_emu_t* emu)
+{
+    return &emu->stats;
+}
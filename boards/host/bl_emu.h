@@ -0,0 +1,233 @@
+#ifndef BOARDS_HOST_BL_EMU_H__
+#define BOARDS_HOST_BL_EMU_H__
+
+/*
+ * Программная модель системного загрузчика STM32 (AN3155) для сборки под
+ * хост. Модель подключается к UART, SPI (AN4286) или I2C (AN4221) из
+ * targets/host и работает в виртуальном времени HAL: на UART каждый байт
+ * занимает на линии 11 бит (8E1) при текущей скорости, ответ начинается
+ * через latency_us после приема последнего байта запроса. На SPI и I2C
+ * время передачи байт учитывает сам HAL, а модель отдает ответ не раньше,
+ * чем через latency_us.
+ *
+ * GO на образ помощника расчета CRC (dfu_host_crc.h, признак magic в блоке
+ * параметров) моделируется без исполнения кода: модель записывает результат
+ * в блок параметров и через время расчета на 168 МГц выполняет системный
+ * сброс обратно в загрузчик. on_go для помощника не вызывается.
+ *
+ * GO на загрузчик в SRAM (dfu_host_loader.h, признак magic) тоже
+ * моделируется без исполнения кода: модель переходит на протокол кадров
+ * загрузчика с частотой USART 60 МГц, как у системного загрузчика F4.
+ * Запись во Flash занимает 16 мкс на слово, стирание - erase_us_per_sector.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "cmsis.h"
+
+/* Флаги регионов памяти */
+#define BL_EMU_MEM_READ  0x01U /* Доступен для READ_MEM            */
+#define BL_EMU_MEM_WRITE 0x02U /* Доступен для WRITE_MEM           */
+#define BL_EMU_MEM_FLASH 0x04U /* Flash: запись 1->0, стирание секторами */
+#define BL_EMU_MEM_EXEC  0x08U /* Допустимый адрес для GO          */
+
+/* Размер выходной очереди модели в байтах */
+#ifndef CONFIG_BL_EMU_TX_QUEUE_SIZE
+#define CONFIG_BL_EMU_TX_QUEUE_SIZE 8192
+#endif /* CONFIG_BL_EMU_TX_QUEUE_SIZE */
+
+/**
+ *  @brief  Регион карты памяти устройства.
+ *
+ *  Секторы Flash нумеруются подряд по всем FLASH-регионам в порядке их
+ *  перечисления - эти номера принимает команда Extended Erase (0x44).
+ */
+typedef struct {
+    uint32_t base;                /* Начальный адрес                                  */
+    uint32_t size;                /* Размер в байтах                                  */
+    uint32_t sector_size;         /* Размер сектора FLASH-региона с равными секторами */
+    const uint32_t* sector_sizes; /* Размеры секторов подряд, если они разные, или NULL */
+    size_t   sector_count;        /* Количество элементов sector_sizes                */
+    uint8_t  flags;               /* BL_EMU_MEM_*                                     */
+} bl_emu_region_t;
+
+/**
+ *  @brief  Параметры модели загрузчика.
+ */
+typedef struct {
+    const bl_emu_region_t* regions; /* Карта памяти                                   */
+    size_t   region_count;          /* Количество регионов                            */
+    uint16_t pid;                   /* Ответ GET_ID                                   */
+    uint8_t  version;               /* Версия протокола загрузчика (0x31 - v3.1)     */
+    uint32_t max_baud;              /* Максимальная скорость, на которой проходит синхронизация */
+    uint32_t latency_us;            /* Задержка ответа после приема запроса           */
+    uint32_t erase_us_per_sector;   /* Время стирания одного сектора                  */
+    uint32_t ber_ppm;               /* Вероятность искажения байта на линии, 1e-6     */
+    uint32_t seed;                  /* Начальное значение генератора ошибок           */
+    uint32_t burst_period_ms;       /* Период пачек помех, 0 - пачек нет              */
+    uint32_t burst_ms;              /* Длительность пачки: все байты на линии искажены */
+    bool     readout_protected;     /* Начальное состояние защиты чтения (RDP)        */
+    bool     legacy_erase;          /* Стирание командой Erase (0x43) вместо Extended Erase */
+
+    /* Вызывается после исполнения команды GO */
+    void (*on_go)(void* ctx, uint32_t address);
+    void* ctx;
+} bl_emu_config_t;
+
+/**
+ *  @brief  Счетчики модели загрузчика.
+ */
+typedef struct {
+    uint32_t rx_bytes;  /* Принято байт от хоста              */
+    uint32_t tx_bytes;  /* Отправлено байт хосту              */
+    uint32_t commands;  /* Принято команд                     */
+    uint32_t nacks;     /* Отправлено NACK                    */
+    uint32_t corrupted; /* Искажено байт на линии             */
+    uint32_t erased;    /* Стерто секторов Flash              */
+    uint32_t written;   /* Записано байт во Flash             */
+} bl_emu_stats_t;
+
+/* Интерфейс, к которому подключена модель */
+typedef enum {
+    BL_EMU_LINK_UART,
+    BL_EMU_LINK_SPI,
+    BL_EMU_LINK_I2C,
+} bl_emu_link_t;
+
+typedef enum {
+    BL_EMU_STATE_HELD,       /* Линия RST в 0                       */
+    BL_EMU_STATE_RUNNING,    /* Исполняется прошивка, загрузчик молчит */
+    BL_EMU_STATE_WAIT_SYNC,  /* Ожидание 0x7F для определения скорости */
+    BL_EMU_STATE_WAIT_CMD,   /* Ожидание команды                    */
+    BL_EMU_STATE_CMD,        /* Прием параметров команды            */
+    BL_EMU_STATE_LOADER,     /* Исполняется загрузчик в SRAM        */
+} bl_emu_state_t;
+
+typedef struct {
+    bl_emu_config_t cfg;
+    bl_emu_link_t link;
+    host_uart_peer_t peer;
+    host_spi_peer_t spi_peer;
+    host_i2c_peer_t i2c_peer;
+    UART_HandleTypeDef* huart;
+    uint16_t i2c_address;   /* 7-битный адрес на шине I2C */
+    bool     spi_confirm;   /* Выдан ACK/NACK, следующий байт хоста - подтверждение */
+
+    uint8_t** mem;          /* Содержимое регионов, по одному буферу на регион */
+
+    bl_emu_state_t state;
+    bool     nrst;
+    bool     boot0;
+    bool     rdp;
+    uint32_t synced_baud;   /* Скорость, определенная по 0x7F */
+    uint32_t line_error;    /* Ошибка приема искаженного байта (HAL_UART_ERROR_*) */
+    uint32_t wp_mask;       /* Защищенные от записи секторы (первые 32) */
+    uint32_t rng;
+
+    /* Разбор текущей команды */
+    uint8_t  cmd;
+    uint8_t  stage;
+    uint32_t address;
+    uint8_t  buf[2 * 0x10000 + 4];
+    size_t   count;
+    size_t   need;
+
+    /* Время на линии в микросекундах */
+    uint64_t rx_line_us;    /* Окончание приема последнего байта запроса */
+    uint64_t tx_line_us;    /* Окончание передачи последнего байта ответа */
+    uint64_t busy_us;       /* Окончание внутренней операции (стирание) */
+    uint64_t reset_us;      /* Системный сброс по окончании помощника CRC, 0 - нет */
+
+    /* Загрузчик в SRAM */
+    struct {
+        uint32_t brr;       /* BRR USART                                  */
+        uint32_t baud_brr;  /* BRR после передачи ACK команды BAUD, 0 - нет */
+        uint32_t baud;      /* Скорость из команды BAUD                   */
+        uint64_t baud_us;   /* Окончание передачи ACK команды BAUD        */
+        uint8_t  wr_seq;    /* Ожидаемый seq кадра WRITE                  */
+        bool     nak_sent;  /* NAK на пропуск кадра WRITE уже отправлен   */
+        bool     reading;   /* Идет передача READ                         */
+        uint8_t  rd_seq;    /* seq первого кадра DATA                     */
+        uint32_t rd_address;
+        uint32_t rd_len;
+        uint32_t rd_next;   /* Смещение следующего кадра DATA             */
+        uint32_t rd_acked;  /* Подтвержденное смещение                    */
+    } ldr;
+
+    /* Очередь байт ответа с моментами их прихода к хосту */
+    struct {
+        uint64_t due_us;
+        uint8_t  data;
+        bool     ack;       /* Байт ACK/NACK, а не данные */
+    } txq[CONFIG_BL_EMU_TX_QUEUE_SIZE];
+    size_t txq_head;
+    size_t txq_tail;
+
+    bl_emu_stats_t stats;
+} bl_emu_t;
+
+/**
+ *  @brief  Инициализировать модель: выделить память регионов (Flash - 0xFF,
+ *  остальные - 0x00) и перевести устройство в состояние сброса.
+ *
+ *  @return 0 или -ENOMEM, -EINVAL.
+ */
+int bl_emu_init(bl_emu_t* emu, const bl_emu_config_t* cfg);
+
+/**
+ *  @brief  Освободить память регионов.
+ */
+void bl_emu_deinit(bl_emu_t* emu);
+
+/**
+ *  @brief  Подключить модель к UART хоста.
+ */
+void bl_emu_attach(bl_emu_t* emu, UART_HandleTypeDef* huart);
+
+/**
+ *  @brief  Подключить модель к SPI хоста. Загрузчик ждет байт синхронизации
+ *  0x5A, пока ответа нет, выдает 0xA5.
+ */
+void bl_emu_attach_spi(bl_emu_t* emu, SPI_HandleTypeDef* hspi);
+
+/**
+ *  @brief  Подключить модель к I2C хоста. Пока ответ не готов, загрузчик не
+ *  подтверждает свой адрес при чтении.
+ *
+ *  @param  address  7-битный адрес загрузчика.
+ */
+void bl_emu_attach_i2c(bl_emu_t* emu, I2C_HandleTypeDef* hi2c, uint16_t address);
+
+/**
+ *  @brief  Записать данные в память устройства в обход протокола.
+ *
+ *  @return 0 или -EFAULT, если диапазон не целиком в одном регионе.
+ */
+int bl_emu_load(bl_emu_t* emu, uint32_t address, const uint8_t* data, size_t len);
+
+/**
+ *  @brief  Получить указатель на содержимое памяти устройства.
+ *
+ *  @return Указатель или NULL, если диапазон не целиком в одном регионе.
+ */
+uint8_t* bl_emu_mem(bl_emu_t* emu, uint32_t address, size_t len);
+
+/**
+ *  @brief  Изменение линий RST и BOOT0 устройства.
+ *
+ *  Отпускание RST при BOOT0 = 1 запускает загрузчик, при BOOT0 = 0 -
+ *  прошивку (модель перестает отвечать).
+ *
+ *  @param  nrst   true - линия RST отпущена.
+ *  @param  boot0  Состояние линии BOOT0.
+ */
+void bl_emu_set_pins(bl_emu_t* emu, bool nrst, bool boot0);
+
+/**
+ *  @brief  Текущие счетчики модели.
+ */
+const bl_emu_stats_t* bl_emu_get_stats(const bl_emu_t* emu);
+
+#endif /* !BOARDS_HOST_BL_EMU_H__ */
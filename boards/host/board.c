@@ -0,0 +1,455 @@
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "board.h"
+#include "bl_emu.h"
+#include "core/crc_model.h"
+#include "core/util.h"
+#include "core/assert.h"
+
+/* Адрес чтения параметров проверяемой прошивки */
+#ifndef CONFIG_FW_META_ADDR
+#define CONFIG_FW_META_ADDR ((uint32_t)0x0803F800)
+#endif /* CONFIG_FW_META_ADDR */
+
+/* Алгоритм CRC метаинформации прошивки, тот же, что проверяет приложение */
+#ifndef CONFIG_FW_META_CRC_MODEL
+#define CONFIG_FW_META_CRC_MODEL "CRC-16/MODBUS"
+#endif /* CONFIG_FW_META_CRC_MODEL */
+
+/* 7-битный адрес I2C загрузчика проверяемого устройства (AN2606) */
+#ifndef CONFIG_DFU_HOST_I2C_ADDR
+#define CONFIG_DFU_HOST_I2C_ADDR 0x39
+#endif /* CONFIG_DFU_HOST_I2C_ADDR */
+
+/* Каналы с отдельными UART, RST и BOOT0 и своей моделью загрузчика на каждом.
+ * HAL хоста обслуживает не больше 4 UART (HOST_UART_MAX) */
+#ifdef CONFIG_DFU_GANG_CHANNELS
+#define BOARD_CHANNELS CONFIG_DFU_GANG_CHANNELS
+/* Итог по каналам приложение выводит после GO на всех, не завершать его на первом */
+#define BOARD_EXIT_ON_GO 0
+#else
+#define BOARD_CHANNELS 1
+#define BOARD_EXIT_ON_GO 1
+#endif /* CONFIG_DFU_GANG_CHANNELS */
+
+#if BOARD_CHANNELS < 1 || BOARD_CHANNELS > 4
+#error "Host board supports 1..4 target channels"
+#endif
+
+/* Начальный адрес прошивки проверяемого устройства */
+#define FW_BASE_ADDR ((uint32_t)0x08000000)
+
+/* Карта памяти STM32F405 (RM0090, AN2606: первые 8 КБ SRAM заняты загрузчиком) */
+static const uint32_t f405_flash_sectors[] = {
+    0x4000, 0x4000, 0x4000, 0x4000, 0x10000,
+    0x20000, 0x20000, 0x20000, 0x20000, 0x20000, 0x20000, 0x20000,
+};
+
+static const bl_emu_region_t f405_memory_map[] = {
+    {
+        .base = 0x08000000, .size = 0x00100000,
+        .sector_sizes = f405_flash_sectors, .sector_count = ARRAY_SIZE(f405_flash_sectors),
+        .flags = BL_EMU_MEM_FLASH | BL_EMU_MEM_READ | BL_EMU_MEM_WRITE | BL_EMU_MEM_EXEC,
+    },
+    {
+        .base = 0x20002000, .size = 0x0001E000,
+        .flags = BL_EMU_MEM_READ | BL_EMU_MEM_WRITE | BL_EMU_MEM_EXEC,
+    },
+    { .base = 0x1FFF0000, .size = 0x00007800, .flags = BL_EMU_MEM_READ }, /* System memory */
+    { .base = 0x1FFF7800, .size = 0x00000210, .flags = BL_EMU_MEM_READ }, /* OTP           */
+    { .base = 0x1FFFC000, .size = 0x00000010, .flags = BL_EMU_MEM_READ }, /* Option bytes  */
+};
+
+/* UART линий загрузчика, к ним подключены модели загрузчика */
+static UART_HandleTypeDef huart_dfu[BOARD_CHANNELS];
+#ifdef CONFIG_DFU_HOST_RX_DMA
+static DMA_HandleTypeDef hdma_dfu_rx[BOARD_CHANNELS];
+#endif /* CONFIG_DFU_HOST_RX_DMA */
+#if defined(CONFIG_DFU_HOST_TRANSPORT_SPI)
+static SPI_HandleTypeDef hspi_dfu;
+#elif defined(CONFIG_DFU_HOST_TRANSPORT_I2C)
+static I2C_HandleTypeDef hi2c_dfu;
+#endif
+/* Модели загрузчиков проверяемых устройств */
+static bl_emu_t bl_emu[BOARD_CHANNELS];
+
+/* Состояние выходов платы */
+static bool led_state;
+static bool reset_state[BOARD_CHANNELS] = { [0 ... BOARD_CHANNELS - 1] = true };
+static bool boot0_state[BOARD_CHANNELS];
+
+/* Момент последнего отпускания линии RST */
+static uint32_t reset_release_tick[BOARD_CHANNELS];
+/* Размер прошивки, загруженной в модель */
+static uint32_t fw_size;
+/* Алгоритм CRC метаинформации */
+static struct crc_engine fw_engine;
+
+#ifdef CONFIG_DFU_UPDATE
+/* Эталонный образ: прошивка и метаинформация устройства с BL_EMU_UPDATE_PATCH
+ * измененными байтами */
+static uint8_t fw_update_image[CONFIG_FW_META_ADDR - FW_BASE_ADDR + 6];
+static bool fw_update_ready;
+#endif /* CONFIG_DFU_UPDATE */
+
+/* Прочитать числовой параметр модели из переменной окружения */
+static uint32_t env_u32(const char* name, uint32_t def)
+{
+    const char* value = getenv(name);
+
+    return (value != NULL && *value != '\0') ? (uint32_t)strtoul(value, NULL, 0) : def;
+}
+
+static void dfu_uart_init(size_t channel)
+{
+    UART_HandleTypeDef* huart = &huart_dfu[channel];
+
+    huart->Init.BaudRate = 115200;
+    huart->Init.WordLength = UART_WORDLENGTH_9B;
+    huart->Init.StopBits = UART_STOPBITS_1;
+    huart->Init.Parity = UART_PARITY_EVEN;
+    huart->Init.Mode = UART_MODE_TX_RX;
+    HAL_UART_Init(huart);
+
+#ifdef CONFIG_DFU_HOST_RX_DMA
+    __HAL_LINKDMA(huart, hdmarx, hdma_dfu_rx[channel]);
+#endif /* CONFIG_DFU_HOST_RX_DMA */
+}
+
+#if defined(CONFIG_DFU_HOST_TRANSPORT_SPI)
+static void dfu_spi_init(void)
+{
+    hspi_dfu.Init.Mode = SPI_MODE_MASTER;
+    hspi_dfu.Init.Direction = SPI_DIRECTION_2LINES;
+    hspi_dfu.Init.DataSize = SPI_DATASIZE_8BIT;
+    hspi_dfu.Init.CLKPolarity = SPI_POLARITY_LOW;
+    hspi_dfu.Init.CLKPhase = SPI_PHASE_1EDGE;
+    hspi_dfu.Init.NSS = SPI_NSS_SOFT;
+    hspi_dfu.Init.BaudRatePrescaler = SPI_BAUDRATEPRESCALER_8;
+    hspi_dfu.Init.FirstBit = SPI_FIRSTBIT_MSB;
+    HAL_SPI_Init(&hspi_dfu);
+}
+#elif defined(CONFIG_DFU_HOST_TRANSPORT_I2C)
+static void dfu_i2c_init(void)
+{
+    hi2c_dfu.Init.AddressingMode = I2C_ADDRESSINGMODE_7BIT;
+    hi2c_dfu.Init.DualAddressMode = I2C_DUALADDRESS_DISABLE;
+    hi2c_dfu.Init.GeneralCallMode = I2C_GENERALCALL_DISABLE;
+    hi2c_dfu.Init.NoStretchMode = I2C_NOSTRETCH_DISABLE;
+    HAL_I2C_Init(&hi2c_dfu);
+}
+#endif
+
+/* Скорость линии загрузчика для отчета, бит/с */
+static uint32_t dfu_link_rate(size_t channel)
+{
+#if defined(CONFIG_DFU_HOST_TRANSPORT_SPI)
+    return CONFIG_HOST_SPI_PCLK_HZ / (2U << (hspi_dfu.Init.BaudRatePrescaler >> 3));
+#elif defined(CONFIG_DFU_HOST_TRANSPORT_I2C)
+    return CONFIG_HOST_I2C_CLOCK_HZ;
+#else
+    return huart_dfu[channel].Init.BaudRate;
+#endif
+}
+
+/* CRC прошивки во Flash модели по ее текущей метаинформации */
+static uint16_t fw_flash_crc(bl_emu_t* emu)
+{
+    const uint8_t* meta = bl_emu_mem(emu, CONFIG_FW_META_ADDR, 6);
+    const uint32_t size = meta[0] | (meta[1] << 8) | (meta[2] << 16) | ((uint32_t)meta[3] << 24);
+    const uint8_t* fw = bl_emu_mem(emu, FW_BASE_ADDR, size);
+
+    return (fw != NULL) ? (uint16_t)crc_engine_compute(&fw_engine, fw, size) : 0;
+}
+
+/* Итог проверки: приложение запустило прошивку устройства канала ctx */
+static void bl_emu_on_go(void* ctx, uint32_t address)
+{
+    const size_t channel = (uintptr_t)ctx;
+    const bl_emu_stats_t* stats = bl_emu_get_stats(&bl_emu[channel]);
+    char name[16] = "bl_emu";
+
+#if BOARD_CHANNELS > 1
+    snprintf(name, sizeof(name), "bl_emu[%u]", (unsigned)channel);
+#endif
+
+    printf("%s: GO 0x%08" PRIX32 " after %" PRIu32 " ms, image %" PRIu32 " B, baud %" PRIu32
+        ", rx %" PRIu32 " B, tx %" PRIu32 " B, commands %" PRIu32 ", NACK %" PRIu32
+        ", corrupted %" PRIu32 ", erased %" PRIu32 " sectors, flash written %" PRIu32 " B"
+        ", firmware CRC %04" PRIX16 "\n",
+        name, address, host_tick_now() - reset_release_tick[channel], fw_size, dfu_link_rate(channel),
+        stats->rx_bytes, stats->tx_bytes, stats->commands, stats->nacks, stats->corrupted,
+        stats->erased, stats->written, fw_flash_crc(&bl_emu[channel]));
+
+    if (env_u32("BL_EMU_EXIT_ON_GO", BOARD_EXIT_ON_GO) != 0) {
+        exit(EXIT_SUCCESS);
+    }
+}
+
+/* Загрузить прошивку из BL_EMU_FW_FILE или сгенерировать BL_EMU_FW_SIZE случайных байт */
+static uint32_t fw_image_load(uint8_t* dst, uint32_t max_size)
+{
+    const char* path = getenv("BL_EMU_FW_FILE");
+
+    if (path != NULL) {
+        FILE* f = fopen(path, "rb");
+
+        if (f == NULL) {
+            perror(path);
+            exit(EXIT_FAILURE);
+        }
+
+        size_t size = fread(dst, 1, max_size, f);
+        fclose(f);
+        return (uint32_t)size;
+    }
+
+    uint32_t size = MIN(env_u32("BL_EMU_FW_SIZE", 64 * 1024), max_size);
+    uint32_t seed = 0x12345678;
+
+    for (uint32_t i = 0; i < size; ++i) {
+        seed = seed * 1664525U + 1013904223U;
+        dst[i] = (uint8_t)(seed >> 24);
+    }
+
+    return size;
+}
+
+#ifdef CONFIG_DFU_UPDATE
+/* Собрать эталонный образ из содержимого Flash модели: BL_EMU_UPDATE_PATCH байт
+ * с BL_EMU_UPDATE_OFFSET инвертируются, CRC в метаинформации пересчитывается */
+static void fw_update_setup(const struct crc_engine* engine)
+{
+    const uint32_t patch = env_u32("BL_EMU_UPDATE_PATCH", 0);
+    const uint32_t offset = env_u32("BL_EMU_UPDATE_OFFSET", 0x1000);
+
+    if (patch == 0) {
+        return;
+    }
+
+    if (offset >= fw_size || patch > fw_size - offset) {
+        fprintf(stderr, "bl_emu: update patch is outside the firmware\n");
+        exit(EXIT_FAILURE);
+    }
+
+    memcpy(fw_update_image, bl_emu_mem(&bl_emu[0], FW_BASE_ADDR, sizeof(fw_update_image)),
+        sizeof(fw_update_image));
+
+    for (uint32_t i = 0; i < patch; ++i) {
+        fw_update_image[offset + i] ^= 0xFF;
+    }
+
+    const uint16_t crc = (uint16_t)crc_engine_compute(engine, fw_update_image, fw_size);
+    uint8_t* meta = fw_update_image + (CONFIG_FW_META_ADDR - FW_BASE_ADDR);
+
+    meta[4] = crc;
+    meta[5] = crc >> 8;
+
+    fw_update_ready = true;
+}
+#endif /* CONFIG_DFU_UPDATE */
+
+/* Создать модель загрузчика канала с прошивкой и метаинформацией о ней.
+ * Все каналы получают одну и ту же прошивку */
+static void bl_emu_setup(size_t channel)
+{
+    bl_emu_t* emu = &bl_emu[channel];
+    const bl_emu_config_t cfg = {
+        .regions = f405_memory_map,
+        .region_count = ARRAY_SIZE(f405_memory_map),
+        .pid = env_u32("BL_EMU_PID", 0x0413),
+        .version = env_u32("BL_EMU_VERSION", 0x31),
+        .max_baud = env_u32("BL_EMU_MAX_BAUD", 115200),
+        .latency_us = env_u32("BL_EMU_LATENCY_US", 50),
+        .erase_us_per_sector = env_u32("BL_EMU_ERASE_US", 20000),
+        .ber_ppm = env_u32("BL_EMU_BER_PPM", 0),
+        .seed = env_u32("BL_EMU_SEED", 1) + channel,
+        .burst_period_ms = env_u32("BL_EMU_BURST_PERIOD_MS", 0),
+        .burst_ms = env_u32("BL_EMU_BURST_MS", 0),
+        .readout_protected = env_u32("BL_EMU_RDP", 0) != 0,
+        .legacy_erase = env_u32("BL_EMU_LEGACY_ERASE", 0) != 0,
+        .on_go = bl_emu_on_go,
+        .ctx = (void*)(uintptr_t)channel,
+    };
+
+    if (bl_emu_init(emu, &cfg) < 0) {
+        fprintf(stderr, "bl_emu: init failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    uint8_t* fw = bl_emu_mem(emu, FW_BASE_ADDR, CONFIG_FW_META_ADDR - FW_BASE_ADDR);
+    fw_size = fw_image_load(fw, CONFIG_FW_META_ADDR - FW_BASE_ADDR);
+
+    const struct crc_model* model = crc_model_find(CONFIG_FW_META_CRC_MODEL);
+    if (model == NULL || model->width > 16) {
+        model = crc_model_find("CRC-16/MODBUS");
+    }
+
+    crc_engine_init(&fw_engine, model);
+
+    uint16_t crc = (uint16_t)crc_engine_compute(&fw_engine, fw, fw_size);
+
+    /* BL_EMU_BAD_CRC - записать неверную CRC для проверки ветки ошибки,
+     * при нескольких каналах - маска каналов с неверной CRC */
+    const uint32_t bad_crc = env_u32("BL_EMU_BAD_CRC", 0);
+
+    if ((BOARD_CHANNELS == 1) ? (bad_crc != 0) : ((bad_crc >> channel) & 1U) != 0) {
+        crc ^= 0x0001;
+    }
+
+    const uint8_t meta[6] = {
+        fw_size, fw_size >> 8, fw_size >> 16, fw_size >> 24, crc, crc >> 8,
+    };
+
+    bl_emu_load(emu, CONFIG_FW_META_ADDR, meta, sizeof(meta));
+
+#ifdef CONFIG_DFU_UPDATE
+    fw_update_setup(&fw_engine);
+#endif /* CONFIG_DFU_UPDATE */
+
+#if defined(CONFIG_DFU_HOST_TRANSPORT_SPI)
+    bl_emu_attach_spi(emu, &hspi_dfu);
+#elif defined(CONFIG_DFU_HOST_TRANSPORT_I2C)
+    bl_emu_attach_i2c(emu, &hi2c_dfu, CONFIG_DFU_HOST_I2C_ADDR);
+#else
+    bl_emu_attach(emu, &huart_dfu[channel]);
+#endif
+}
+
+void board_init(void)
+{
+    HAL_Init();
+
+    for (size_t i = 0; i < BOARD_CHANNELS; ++i) {
+        dfu_uart_init(i);
+    }
+#if defined(CONFIG_DFU_HOST_TRANSPORT_SPI)
+    dfu_spi_init();
+#elif defined(CONFIG_DFU_HOST_TRANSPORT_I2C)
+    dfu_i2c_init();
+#endif
+    for (size_t i = 0; i < BOARD_CHANNELS; ++i) {
+        bl_emu_setup(i);
+    }
+
+    /* Вывод логов без буферизации, как на UART отладки */
+    setvbuf(stdout, NULL, _IONBF, 0);
+}
+
+UART_HandleTypeDef* board_get_serial_handle(void)
+{
+    return &huart_dfu[0];
+}
+
+#if defined(CONFIG_DFU_HOST_TRANSPORT_SPI)
+SPI_HandleTypeDef* board_get_spi_handle(void)
+{
+    return &hspi_dfu;
+}
+#elif defined(CONFIG_DFU_HOST_TRANSPORT_I2C)
+I2C_HandleTypeDef* board_get_i2c_handle(void)
+{
+    return &hi2c_dfu;
+}
+#endif
+
+void board_led_write(bool value)
+{
+    led_state = value;
+}
+
+/* Линия RST устройства канала */
+static void channel_reset_write(size_t channel, bool value)
+{
+    if (value && !reset_state[channel]) {
+        reset_release_tick[channel] = host_tick_now();
+    }
+
+    reset_state[channel] = value;
+    bl_emu_set_pins(&bl_emu[channel], reset_state[channel], boot0_state[channel]);
+}
+
+/* Линия BOOT0 устройства канала */
+static void channel_boot0_write(size_t channel, bool value)
+{
+    boot0_state[channel] = value;
+    bl_emu_set_pins(&bl_emu[channel], reset_state[channel], boot0_state[channel]);
+}
+
+void board_reset_write(bool value)
+{
+    channel_reset_write(0, value);
+}
+
+void board_boot0_write(bool value)
+{
+    channel_boot0_write(0, value);
+}
+
+#ifdef CONFIG_DFU_GANG_CHANNELS
+size_t board_get_channel_count(void)
+{
+    return BOARD_CHANNELS;
+}
+
+UART_HandleTypeDef* board_get_channel_serial_handle(size_t channel)
+{
+    ASSERT_NO_MSG(channel < BOARD_CHANNELS);
+
+    return &huart_dfu[channel];
+}
+
+void board_channel_reset_write(size_t channel, bool value)
+{
+    ASSERT_NO_MSG(channel < BOARD_CHANNELS);
+
+    channel_reset_write(channel, value);
+}
+
+void board_channel_boot0_write(size_t channel, bool value)
+{
+    ASSERT_NO_MSG(channel < BOARD_CHANNELS);
+
+    channel_boot0_write(channel, value);
+}
+
+/* Итог по каналам в stdout; код завершения - все ли прошивки верны */
+void board_gang_report(const gang_result_t* results, size_t count)
+{
+    size_t passed = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        const gang_result_t* r = &results[i];
+
+        printf("gang: channel %u: %s, PID %04" PRIX16 ", %" PRIu32 " B, CRC %04" PRIX16
+            ", read %04" PRIX16 ", %" PRIu32 " ms\n", (unsigned)i, gang_status_name(r->status),
+            r->pid, r->fw_size, r->crc, r->crc_read, r->elapsed_ms);
+
+        passed += (r->status == GANG_STATUS_PASS) ? 1 : 0;
+    }
+
+    printf("gang: %u of %u targets passed\n", (unsigned)passed, (unsigned)count);
+
+    exit((count != 0 && passed == count) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+#endif /* CONFIG_DFU_GANG_CHANNELS */
+
+uint32_t board_get_fw_meta_addr(void)
+{
+    return CONFIG_FW_META_ADDR;
+}
+
+#ifdef CONFIG_DFU_UPDATE
+bool board_get_fw_image(uint32_t* address, const uint8_t** data, size_t* len)
+{
+    *address = FW_BASE_ADDR;
+    *data    = fw_update_image;
+    *len     = sizeof(fw_update_image);
+
+    return fw_update_ready;
+}
+#endif /* CONFIG_DFU_UPDATE */
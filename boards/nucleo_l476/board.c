@@ -19,6 +19,9 @@ extern void SetSysClock(void);
 
 UART_HandleTypeDef hlpuart1;
 UART_HandleTypeDef huart2;
+#ifdef CONFIG_DFU_HOST_TRANSPORT_I2C
+I2C_HandleTypeDef hi2c1;
+#endif /* CONFIG_DFU_HOST_TRANSPORT_I2C */
 
 static void dfu_uart_init(void)
 {
@@ -34,7 +37,24 @@ static void dfu_uart_init(void)
     HAL_UART_Init(&hlpuart1);
 }
 
-#ifdef DEBUG
+#ifdef CONFIG_DFU_HOST_TRANSPORT_I2C
+static void dfu_i2c_init(void)
+{
+    /* 400 кГц от HSI 16 МГц (RM0351, пример настройки I2C_TIMINGR) */
+    hi2c1.Instance = I2C1;
+    hi2c1.Init.Timing = 0x10320309;
+    hi2c1.Init.OwnAddress1 = 0;
+    hi2c1.Init.AddressingMode = I2C_ADDRESSINGMODE_7BIT;
+    hi2c1.Init.DualAddressMode = I2C_DUALADDRESS_DISABLE;
+    hi2c1.Init.OwnAddress2 = 0;
+    hi2c1.Init.OwnAddress2Masks = I2C_OA2_NOMASK;
+    hi2c1.Init.GeneralCallMode = I2C_GENERALCALL_DISABLE;
+    hi2c1.Init.NoStretchMode = I2C_NOSTRETCH_DISABLE;
+    HAL_I2C_Init(&hi2c1);
+}
+#endif /* CONFIG_DFU_HOST_TRANSPORT_I2C */
+
+#if defined(DEBUG) || defined(CONFIG_CRC_BENCHMARK)
 static void log_usart_init(void)
 {
     huart2.Instance = USART2;
@@ -56,7 +76,7 @@ int _write(int fd, char* ptr, int len)
     return len;
 }
 
-#endif /* DEBUG */
+#endif /* DEBUG || CONFIG_CRC_BENCHMARK */
 
 static void gpio_init(void)
 {
@@ -97,11 +117,14 @@ void board_init(void)
     SetSysClock();
         
     dfu_uart_init();
+#ifdef CONFIG_DFU_HOST_TRANSPORT_I2C
+    dfu_i2c_init();
+#endif /* CONFIG_DFU_HOST_TRANSPORT_I2C */
     gpio_init();
 
-#ifdef DEBUG
+#if defined(DEBUG) || defined(CONFIG_CRC_BENCHMARK)
     log_usart_init();
-#endif /* DEBUG */
+#endif /* DEBUG || CONFIG_CRC_BENCHMARK */
 }
 
 UART_HandleTypeDef* board_get_serial_handle(void) 
@@ -109,6 +132,13 @@ UART_HandleTypeDef* board_get_serial_handle(void)
     return &hlpuart1; 
 }
 
+#ifdef CONFIG_DFU_HOST_TRANSPORT_I2C
+I2C_HandleTypeDef* board_get_i2c_handle(void)
+{
+    return &hi2c1;
+}
+#endif /* CONFIG_DFU_HOST_TRANSPORT_I2C */
+
 void board_led_write(bool value)
 {
     HAL_GPIO_WritePin(LED_PIN_PORT, LED_PIN_PIN, (GPIO_PinState)value);
@@ -1,6 +1,11 @@
 #include "cmsis.h"
 #include "core/assert.h"
 
+#ifdef CONFIG_DFU_HOST_RX_DMA
+/* Прием LPUART1 по DMA в циклический буфер dfu_host */
+static DMA_HandleTypeDef hdma_lpuart1_rx;
+#endif /* CONFIG_DFU_HOST_RX_DMA */
+
 void HAL_MspInit(void)
 {
     __HAL_RCC_SYSCFG_CLK_ENABLE();
@@ -41,6 +46,26 @@ void HAL_UART_MspInit(UART_HandleTypeDef* huart)
         GPIO_InitStruct.Alternate = GPIO_AF8_LPUART1;
         HAL_GPIO_Init(GPIOC, &GPIO_InitStruct);
 
+#ifdef CONFIG_DFU_HOST_RX_DMA
+        /* LPUART1_RX - DMA2 Channel7, request 4. Прерывание канала не нужно:
+         * dfu_host читает счетчик CNDTR сам */
+        __HAL_RCC_DMA2_CLK_ENABLE();
+
+        hdma_lpuart1_rx.Instance = DMA2_Channel7;
+        hdma_lpuart1_rx.Init.Request = DMA_REQUEST_4;
+        hdma_lpuart1_rx.Init.Direction = DMA_PERIPH_TO_MEMORY;
+        hdma_lpuart1_rx.Init.PeriphInc = DMA_PINC_DISABLE;
+        hdma_lpuart1_rx.Init.MemInc = DMA_MINC_ENABLE;
+        hdma_lpuart1_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+        hdma_lpuart1_rx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+        hdma_lpuart1_rx.Init.Mode = DMA_CIRCULAR;
+        hdma_lpuart1_rx.Init.Priority = DMA_PRIORITY_HIGH;
+        if (HAL_DMA_Init(&hdma_lpuart1_rx) == HAL_OK)
+        {
+            __HAL_LINKDMA(huart, hdmarx, hdma_lpuart1_rx);
+        }
+#endif /* CONFIG_DFU_HOST_RX_DMA */
+
         /* LPUART1 interrupt Init */
         HAL_NVIC_SetPriority(LPUART1_IRQn, 0, 0);
         HAL_NVIC_EnableIRQ(LPUART1_IRQn);
@@ -96,4 +121,53 @@ void HAL_UART_MspDeInit(UART_HandleTypeDef* huart)
         /* USART2 interrupt DeInit */
         HAL_NVIC_DisableIRQ(USART2_IRQn);
     }
-}
\ No newline at end of file
+}
+
+/**
+* @brief I2C MSP Initialization
+* @param hi2c: I2C handle pointer
+* @retval None
+*/
+void HAL_I2C_MspInit(I2C_HandleTypeDef* hi2c)
+{
+    GPIO_InitTypeDef GPIO_InitStruct = { 0 };
+    RCC_PeriphCLKInitTypeDef PeriphClkInit = { 0 };
+
+    if (hi2c->Instance == I2C1)
+    {
+        PeriphClkInit.PeriphClockSelection = RCC_PERIPHCLK_I2C1;
+        PeriphClkInit.I2c1ClockSelection = RCC_I2C1CLKSOURCE_HSI;
+        HAL_RCCEx_PeriphCLKConfig(&PeriphClkInit);
+
+        __HAL_RCC_GPIOB_CLK_ENABLE();
+        /**I2C1 GPIO Configuration
+        PB8     ------> I2C1_SCL
+        PB9     ------> I2C1_SDA
+        */
+        GPIO_InitStruct.Pin = GPIO_PIN_8 | GPIO_PIN_9;
+        GPIO_InitStruct.Mode = GPIO_MODE_AF_OD;
+        GPIO_InitStruct.Pull = GPIO_PULLUP;
+        GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
+        GPIO_InitStruct.Alternate = GPIO_AF4_I2C1;
+        HAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
+
+        /* Peripheral clock enable */
+        __HAL_RCC_I2C1_CLK_ENABLE();
+    }
+}
+
+/**
+* @brief I2C MSP De-Initialization
+* @param hi2c: I2C handle pointer
+* @retval None
+*/
+void HAL_I2C_MspDeInit(I2C_HandleTypeDef* hi2c)
+{
+    if (hi2c->Instance == I2C1)
+    {
+        /* Peripheral clock disable */
+        __HAL_RCC_I2C1_CLK_DISABLE();
+
+        HAL_GPIO_DeInit(GPIOB, GPIO_PIN_8 | GPIO_PIN_9);
+    }
+}
@@ -0,0 +1,19 @@
+# Сборка под хост (BOARD=host): компилятор системы по умолчанию, без toolchain-файла
+
+# Флаги предупреждений
+set(GEN_WARN_FLAGS "-Wall -Wextra -Wno-unused-parameter -Wno-missing-field-initializers -Wno-expansion-to-defined")
+# Строки форматирования в source/ рассчитаны на uint32_t == unsigned long (newlib)
+set(C_WARN_FLAGS   "${GEN_WARN_FLAGS} -Wno-format")
+
+# Общие флаги компиляции для Debug конфигурации
+set(GEN_FLAGS_DEBUG "-O0 -g -DDEBUG=1")
+# Общие флаги компиляции для Release конфигурации
+set(GEN_FLAGS_RELEASE "-O2 -DNDEBUG=1 -DRELEASE=1")
+# Общие флаги компиляции для RelWithDebInfo конфигурации
+set(GEN_FLAGS_RELDEB "-O2 -g -DDEBUG=1")
+# Общие флаги компиляции
+set(GEN_FLAGS "-funsigned-char -fno-strict-aliasing")
+
+set(CMAKE_C_FLAGS_DEBUG          "${GEN_FLAGS} ${GEN_FLAGS_DEBUG} ${C_WARN_FLAGS} -std=gnu11" CACHE INTERNAL "C Compiler debug options")
+set(CMAKE_C_FLAGS_RELWITHDEBINFO "${GEN_FLAGS} ${GEN_FLAGS_RELDEB} ${C_WARN_FLAGS} -std=gnu11" CACHE INTERNAL "C Compiler debug options")
+set(CMAKE_C_FLAGS_RELEASE        "${GEN_FLAGS} ${GEN_FLAGS_RELEASE} ${C_WARN_FLAGS} -std=gnu11" CACHE INTERNAL "C Compiler release options")
@@ -14,6 +14,43 @@ extern "C" {
  */
 #define CRC8_CCITT_INITIAL_VALUE 0xFF
 
+/* Number of 256-entry lookup tables used by the crc16_reflect() engine:
+ * 0 - bitwise loop only (no RAM table), 1 - byte table (512 B),
+ * 4 - slice-by-4 (2 KB), 8 - slice-by-8 (4 KB).
+ */
+#ifndef CONFIG_CRC16_REFLECT_SLICES
+#define CONFIG_CRC16_REFLECT_SLICES 4
+#endif /* CONFIG_CRC16_REFLECT_SLICES */
+
+#if (CONFIG_CRC16_REFLECT_SLICES != 0) && (CONFIG_CRC16_REFLECT_SLICES != 1) &&        \
+	(CONFIG_CRC16_REFLECT_SLICES != 4) && (CONFIG_CRC16_REFLECT_SLICES != 8)
+#error CONFIG_CRC16_REFLECT_SLICES must be one of 0, 1, 4 or 8
+#endif
+
+/* Lookup tables used by crc32_ieee_update_sw(), all in flash:
+ * 0 - nibble table (64 B), 1 - byte table (1 KB), 8 - slice-by-8 (8 KB).
+ */
+#ifndef CONFIG_CRC32_IEEE_SLICES
+#define CONFIG_CRC32_IEEE_SLICES 0
+#endif /* CONFIG_CRC32_IEEE_SLICES */
+
+#if (CONFIG_CRC32_IEEE_SLICES != 0) && (CONFIG_CRC32_IEEE_SLICES != 1) &&              \
+	(CONFIG_CRC32_IEEE_SLICES != 8)
+#error CONFIG_CRC32_IEEE_SLICES must be one of 0, 1 or 8
+#endif
+
+/**
+ * @brief Lookup tables of the table-driven reflected CRC-16 engine.
+ *
+ * Table @c t[k][i] holds the CRC register contribution of byte @c i followed
+ * by @c k zero bytes, so @c t[0] is the classic byte table and the others are
+ * used by the slice-by-N loop.
+ */
+struct crc16_reflect_table {
+	uint16_t poly; /* Reflected polynomial the table was built for */
+	uint16_t t[CONFIG_CRC16_REFLECT_SLICES > 0 ? CONFIG_CRC16_REFLECT_SLICES : 1][256];
+};
+
 /**
  * @brief Generic function for computing a CRC-16 without input or output
  *        reflection.
@@ -40,8 +77,10 @@ uint16_t crc16(uint16_t poly, uint16_t seed, const uint8_t *src, size_t len);
  *        reflection.
  *
  * Compute CRC-16 by passing in the address of the input, the input length
- * and polynomial used in addition to the initial value. This is O(n*8) where n
- * is the length of the buffer provided. Both input and output are reflected.
+ * and polynomial used in addition to the initial value. Both input and output
+ * are reflected. The computation is table driven (see
+ * CONFIG_CRC16_REFLECT_SLICES) and runs in O(n) time, where n is the length of
+ * the buffer provided.
  *
  * @note If you are planning to use a CRC based on poly 0x1012 the function
  * crc16_ccitt() is faster and thus recommended over this one.
@@ -64,7 +103,61 @@ uint16_t crc16(uint16_t poly, uint16_t seed, const uint8_t *src, size_t len);
  * @return The computed CRC16 value (without any XOR applied to it)
  */
 uint16_t crc16_reflect(uint16_t poly, uint16_t seed, const uint8_t *src, size_t len);
-	
+
+/**
+ * @brief Reference bit-at-a-time implementation of crc16_reflect().
+ *
+ * Produces exactly the same result as crc16_reflect() without using any lookup
+ * table. It is O(n*8) and is kept for table generation and benchmarking.
+ *
+ * @param poly The reflected polynomial omitting the leading x^16 coefficient
+ * @param seed Initial value for the CRC computation
+ * @param src Input bytes for the computation
+ * @param len Length of the input in bytes
+ *
+ * @return The computed CRC16 value (without any XOR applied to it)
+ */
+uint16_t crc16_reflect_bitwise(uint16_t poly, uint16_t seed, const uint8_t *src,
+	size_t len);
+
+/**
+ * @brief Build the lookup tables of the reflected CRC-16 engine.
+ *
+ * @param table Tables to fill in
+ * @param poly The reflected polynomial omitting the leading x^16 coefficient
+ */
+void crc16_reflect_table_init(struct crc16_reflect_table *table, uint16_t poly);
+
+/**
+ * @brief Compute a reflected CRC-16 using prebuilt lookup tables.
+ *
+ * Uses the slice-by-N loop selected by CONFIG_CRC16_REFLECT_SLICES. The result
+ * is bit-identical to crc16_reflect_bitwise() called with the polynomial the
+ * @p table was built for.
+ *
+ * @param table Tables built by crc16_reflect_table_init()
+ * @param seed Initial value for the CRC computation
+ * @param src Input bytes for the computation
+ * @param len Length of the input in bytes
+ *
+ * @return The computed CRC16 value (without any XOR applied to it)
+ */
+uint16_t crc16_reflect_table(const struct crc16_reflect_table *table, uint16_t seed,
+	const uint8_t *src, size_t len);
+
+/**
+ * @brief Prepare the internal tables used by crc16_reflect() for @p poly.
+ *
+ * crc16_reflect() builds its tables on the first call with a new polynomial.
+ * Calling this function at init time moves that cost out of the data path.
+ * The engine caches the tables of a single polynomial, so alternating between
+ * polynomials rebuilds them on every switch.
+ *
+ * @param poly The reflected polynomial omitting the leading x^16 coefficient
+ */
+void crc16_reflect_init(uint16_t poly);
+
+
 /**
  * @brief Generic function for computing CRC 8
  *
@@ -205,6 +298,74 @@ uint32_t crc32_ieee(const uint8_t *data, size_t len);
  */
 uint32_t crc32_ieee_update(uint32_t crc, const uint8_t *data, size_t len);
 
+/**
+ * @brief Combine two CRC-16 values computed by crc16() over adjacent segments.
+ *
+ * Given @p crc1 = crc16(poly, seed, A, len1) and
+ * @p crc2 = crc16(poly, seed, B, len2), returns crc16(poly, seed, AB, len1 + len2)
+ * without touching the data. Runs in O(log(len2)) time.
+ *
+ * @param poly The polynomial used for both segments
+ * @param seed The seed used for both segments
+ * @param crc1 CRC of the first segment
+ * @param crc2 CRC of the second segment
+ * @param len2 Length of the second segment in bytes
+ *
+ * @return The CRC16 of the concatenated segments
+ */
+uint16_t crc16_combine(uint16_t poly, uint16_t seed, uint16_t crc1, uint16_t crc2,
+	size_t len2);
+
+/**
+ * @brief Combine two CRC-16 values computed by crc16_reflect() over adjacent
+ *        segments.
+ *
+ * Given @p crc1 = crc16_reflect(poly, seed, A, len1) and
+ * @p crc2 = crc16_reflect(poly, seed, B, len2), returns
+ * crc16_reflect(poly, seed, AB, len1 + len2). This allows segments read out of
+ * order or verified in parallel to be folded into a single CRC-16/MODBUS.
+ * Runs in O(log(len2)) time.
+ *
+ * @param poly The reflected polynomial used for both segments
+ * @param seed The seed used for both segments
+ * @param crc1 CRC of the first segment
+ * @param crc2 CRC of the second segment
+ * @param len2 Length of the second segment in bytes
+ *
+ * @return The CRC16 of the concatenated segments
+ */
+uint16_t crc16_reflect_combine(uint16_t poly, uint16_t seed, uint16_t crc1, uint16_t crc2,
+	size_t len2);
+
+/**
+ * @brief Combine two CRC-32/IEEE values computed over adjacent segments.
+ *
+ * Given @p crc1 = crc32_ieee(A, len1) and @p crc2 = crc32_ieee(B, len2),
+ * returns crc32_ieee(AB, len1 + len2). Runs in O(log(len2)) time.
+ *
+ * @param crc1 CRC32 of the first segment
+ * @param crc2 CRC32 of the second segment
+ * @param len2 Length of the second segment in bytes
+ *
+ * @return The CRC32 of the concatenated segments
+ */
+uint32_t crc32_combine(uint32_t crc1, uint32_t crc2, size_t len2);
+
+/**
+ * @brief Software implementations of the functions above.
+ *
+ * When the hardware CRC backend is selected (CONFIG_CRC_HW) crc16_reflect(),
+ * crc16_ccitt(), crc16_itu_t() and crc32_ieee_update() run on the CRC
+ * peripheral and these functions remain available as the fallback and the
+ * reference the peripheral is checked against. Without the hardware backend
+ * the public functions are plain wrappers around them. Parameters and results
+ * are identical to the corresponding public function.
+ */
+uint16_t crc16_reflect_sw(uint16_t poly, uint16_t seed, const uint8_t *src, size_t len);
+uint16_t crc16_ccitt_sw(uint16_t seed, const uint8_t *src, size_t len);
+uint16_t crc16_itu_t_sw(uint16_t seed, const uint8_t *src, size_t len);
+uint32_t crc32_ieee_update_sw(uint32_t crc, const uint8_t *data, size_t len);
+
 #ifdef __cplusplus
 }
 #endif
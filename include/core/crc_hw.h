@@ -0,0 +1,85 @@
+#ifndef INC_CORE_CRC_HW_H_
+#define INC_CORE_CRC_HW_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Initialize the hardware CRC backend.
+ *
+ * Enables the CRC peripheral clock and checks every accelerated function
+ * against its software implementation (crc16_reflect_sw() and friends) on a
+ * set of reference vectors. If any result differs, the backend stays disabled
+ * and all CRC functions keep running in software.
+ *
+ * Calling this function is optional: the first accelerated call performs the
+ * initialization as well. Calling it again is a no-op.
+ *
+ * @note The CRC peripheral is a single shared resource. The accelerated
+ *       functions are not reentrant and must not be used from interrupt
+ *       context while a thread is computing a CRC.
+ *
+ * @return 0 if the peripheral is used, -EIO if it failed the self-test.
+ */
+int crc_hw_init(void);
+
+/**
+ * @brief Check whether CRC functions are computed by the peripheral.
+ *
+ * @return true if the self-test passed and the peripheral is in use.
+ */
+bool crc_hw_is_active(void);
+
+/**
+ * @brief Start a reflected CRC-16 computation fed to the peripheral by DMA.
+ *
+ * The buffer is copied into the CRC unit by a memory-to-memory DMA transfer,
+ * so the CPU is free until crc16_reflect_dma_finish() is called. The result
+ * is identical to crc16_reflect() with the same arguments, including
+ * seed/continuation semantics.
+ *
+ * If the peripheral cannot be used (self-test failed or @p poly is not
+ * supported) the CRC is computed in software right away and
+ * crc16_reflect_dma_finish() just returns it.
+ *
+ * @note Available with CONFIG_CRC_HW_DMA. @p src must stay unchanged until
+ *       crc16_reflect_dma_finish() returns. No other accelerated CRC function
+ *       may be called in between.
+ *
+ * @param poly The reflected polynomial omitting the leading x^16 coefficient
+ * @param seed Initial value for the CRC computation
+ * @param src Input bytes for the computation
+ * @param len Length of the input in bytes, at most 65535
+ *
+ * @return 0 on success, -EINVAL for an invalid length, -EBUSY if a previous
+ *         computation was not finished, -EIO on a DMA error.
+ */
+int crc16_reflect_dma_start(uint16_t poly, uint16_t seed, const uint8_t *src, size_t len);
+
+/**
+ * @brief Wait for the computation started by crc16_reflect_dma_start().
+ *
+ * @param crc Computed CRC16 value (without any XOR applied to it)
+ *
+ * @return 0 on success, -EINVAL if nothing was started, -EIO on a DMA error.
+ */
+int crc16_reflect_dma_finish(uint16_t *crc);
+
+/**
+ * @brief Check whether a DMA-fed computation is still in flight.
+ *
+ * @return true between crc16_reflect_dma_start() and
+ *         crc16_reflect_dma_finish().
+ */
+bool crc16_reflect_dma_pending(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !INC_CORE_CRC_HW_H_ */
@@ -0,0 +1,135 @@
+#ifndef INC_CORE_CRC_MODEL_H_
+#define INC_CORE_CRC_MODEL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief CRC algorithm description in the Rocksoft^tm model.
+ *
+ * Parameters follow the CRC RevEng catalogue:
+ * https://reveng.sourceforge.io/crc-catalogue/
+ */
+struct crc_model {
+	const char *name;  /* Catalogue name, e.g. "CRC-16/MODBUS" */
+	const char *alias; /* Well-known alternative name or NULL */
+	uint8_t width;     /* Register width in bits, 1..32 */
+	bool refin;        /* Input bytes are reflected (LSB first) */
+	bool refout;       /* Register is reflected before the final XOR */
+	uint32_t poly;     /* Polynomial in normal form omitting the x^width term */
+	uint32_t init;     /* Initial register value (not reflected) */
+	uint32_t xorout;   /* Value XORed to the final register */
+	uint32_t check;    /* CRC of the ASCII string "123456789" */
+};
+
+/**
+ * @brief Table-driven engine instance for a CRC model.
+ *
+ * The register is kept in the form that lets a single 256-entry table serve
+ * any width: right-aligned and reflected for refin models, left-aligned in 32
+ * bits otherwise. The state passed between crc_engine_begin(),
+ * crc_engine_update() and crc_engine_final() is opaque.
+ */
+struct crc_engine {
+	const struct crc_model *model;
+	uint32_t table[256];
+};
+
+/** @brief Standard algorithms known to crc_model_find(). */
+extern const struct crc_model crc_model_catalogue[];
+
+/** @brief Number of entries in crc_model_catalogue. */
+extern const size_t crc_model_catalogue_size;
+
+/**
+ * @brief Look up a standard algorithm by its catalogue name or alias.
+ *
+ * @param name Algorithm name, e.g. "CRC-16/MODBUS" or "CRC-16/CCITT-FALSE"
+ *
+ * @return The model, or NULL if the name is unknown.
+ */
+const struct crc_model *crc_model_find(const char *name);
+
+/**
+ * @brief Reflect the @p width least significant bits of @p value.
+ *
+ * @param value Value to reflect
+ * @param width Number of bits, 1..32
+ *
+ * @return The reflected value
+ */
+uint32_t crc_reflect(uint32_t value, unsigned int width);
+
+/**
+ * @brief Build the lookup table of an engine.
+ *
+ * @param engine Engine to initialize
+ * @param model Algorithm the engine computes; must outlive the engine
+ *
+ * @return 0 on success, -EINVAL if the model is invalid.
+ */
+int crc_engine_init(struct crc_engine *engine, const struct crc_model *model);
+
+/**
+ * @brief Start a computation.
+ *
+ * @param engine Initialized engine
+ *
+ * @return Initial state
+ */
+uint32_t crc_engine_begin(const struct crc_engine *engine);
+
+/**
+ * @brief Feed bytes to a computation.
+ *
+ * Runs one table lookup per byte, with no per-bit branching. Feeding a stream
+ * in several blocks gives the same result as feeding it at once.
+ *
+ * @param engine Initialized engine
+ * @param state State returned by crc_engine_begin() or a previous update
+ * @param src Input bytes for the computation
+ * @param len Length of the input in bytes
+ *
+ * @return Updated state
+ */
+uint32_t crc_engine_update(const struct crc_engine *engine, uint32_t state,
+	const uint8_t *src, size_t len);
+
+/**
+ * @brief Finish a computation.
+ *
+ * Applies output reflection and the final XOR.
+ *
+ * @param engine Initialized engine
+ * @param state State returned by the last crc_engine_update()
+ *
+ * @return The CRC value
+ */
+uint32_t crc_engine_final(const struct crc_engine *engine, uint32_t state);
+
+/**
+ * @brief Compute the CRC of a single buffer.
+ *
+ * @param engine Initialized engine
+ * @param src Input bytes for the computation
+ * @param len Length of the input in bytes
+ *
+ * @return The CRC value
+ */
+static inline uint32_t crc_engine_compute(const struct crc_engine *engine,
+	const uint8_t *src, size_t len)
+{
+	return crc_engine_final(engine,
+		crc_engine_update(engine, crc_engine_begin(engine), src, len));
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !INC_CORE_CRC_MODEL_H_ */
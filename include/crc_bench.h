@@ -0,0 +1,15 @@
+#ifndef INCLUDE_CRC_BENCH_H__
+#define INCLUDE_CRC_BENCH_H__
+
+/**
+ *  @brief  Замер производительности реализаций CRC16 и CRC32.
+ *
+ *  Для каждой реализации выводит через printf() количество тактов ядра,
+ *  затраченных на обработку тестового буфера, число тактов на байт и байт на
+ *  1000 тактов. Вывод не зависит от DEBUG: платы с CONFIG_CRC_BENCHMARK
+ *  включают UART лога и в сборке Release. Такты считаются счетчиком
+ *  DWT->CYCCNT; в сборке под хост вместо тактов выводятся наносекунды.
+ */
+void crc_bench_run(void);
+
+#endif /* !INCLUDE_CRC_BENCH_H__ */
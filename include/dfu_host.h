@@ -1,8 +1,18 @@
 #ifndef INCLUDE_DFU_HOST_H__
 #define INCLUDE_DFU_HOST_H__
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
 #include "cmsis.h"
 
+/* Количество приемных буферов модуля. Ответы записываются в них по очереди,
+ * поэтому данные ответа не меняются, пока не придут еще столько же ответов */
+#ifndef CONFIG_DFU_HOST_RX_BUFFERS
+#define CONFIG_DFU_HOST_RX_BUFFERS 2
+#endif /* CONFIG_DFU_HOST_RX_BUFFERS */
+
 /**
  *  @brief  Перечисление кодов ошибок модуля DFU_HOST.
  */
@@ -14,27 +24,368 @@ typedef enum {
 	DFU_HOST_ERR_TIMEOUT   = -1003,  /* Таймаут ожмдания ответа от устройства */
 	DFU_HOST_ERR_WRONG_ANS = -1004,  /* Неверный формат ответа от устройства */
 	DFU_HOST_ERR_OVERFLOW  = -1005,  /* Переполнение приемного буфера */
+	DFU_HOST_ERR_BUSY      = -1006,  /* Выполняется другая операция */
+	DFU_HOST_ERR_LINE      = -1007,  /* Ошибка приема: четность, кадр, шум, переполнение */
 } dfu_host_err_t;
 
 /**
- *  @brief Инициализация модуля dfu_host.
+ *  @brief  Счетчики ошибок приема на линии с момента создания транспорта.
+ */
+typedef struct {
+    uint32_t parity;  /* Неверная четность (PE)                 */
+    uint32_t framing; /* Нет стоп-бита (FE)                     */
+    uint32_t noise;   /* Шум при выборке бита (NE)              */
+    uint32_t overrun; /* Переполнение приемника (ORE)           */
+    uint32_t aborted; /* Приемов ответа, прерванных этими ошибками */
+} dfu_host_link_stats_t;
+
+/* Записей в кэше возможностей загрузчиков (dfu_host_discover()) */
+#ifndef CONFIG_DFU_HOST_CAPS_CACHE_SIZE
+#define CONFIG_DFU_HOST_CAPS_CACHE_SIZE 4
+#endif /* CONFIG_DFU_HOST_CAPS_CACHE_SIZE */
+
+/* Команд в записи возможностей: AN3155 описывает 15 команд */
+#define DFU_HOST_CAPS_CMDS_MAX 16
+
+/**
+ *  @brief  Команда стирания, которую поддерживает загрузчик.
+ */
+typedef enum {
+    DFU_HOST_ERASE_NONE,     /* Стирание не поддерживается           */
+    DFU_HOST_ERASE_LEGACY,   /* Erase (0x43): номера страниц по 1 байту */
+    DFU_HOST_ERASE_EXTENDED, /* Extended Erase (0x44)                */
+} dfu_host_erase_t;
+
+/**
+ *  @brief  Возможности загрузчика по ответу GET для одного идентификатора продукта.
+ */
+typedef struct {
+    uint16_t pid;                          /* Идентификатор продукта (GET_ID)     */
+    uint8_t  version;                      /* Версия протокола в виде 0xNM        */
+    uint8_t  cmd_count;                    /* Количество поддерживаемых команд    */
+    uint8_t  cmds[DFU_HOST_CAPS_CMDS_MAX]; /* Коды поддерживаемых команд          */
+    dfu_host_erase_t erase;                /* Команда стирания                    */
+    bool     read;                         /* Есть READ_MEM                       */
+    bool     write;                        /* Есть WRITE_MEM                      */
+    bool     go;                           /* Есть GO                             */
+} dfu_host_caps_t;
+
+/* Секторов в одной команде dfu_host_erase_sectors(): кадр с номерами
+ * помещается в буфер кадров транзакции */
+#define DFU_HOST_ERASE_SECTORS_MAX 128
+
+/* Размер приемного буфера ответа в байтах */
+#define DFU_HOST_RX_BUFFER_SIZE 256
+/* Максимальное количество шагов транзакции: READ_MEM - три кадра с ACK и данные */
+#define DFU_HOST_STEPS_MAX 7
+/* Размер буфера кадров транзакции: WRITE_MEM - команда, адрес, N, 256 байт и XOR */
+#define DFU_HOST_TX_BUFFER_SIZE (2 + 5 + 1 + 256 + 1)
+/* Команд, для которых ведется оценка задержки ответа */
+#define DFU_HOST_RTT_CMDS 12
+
+/**
+ *  @brief  Экземпляр модуля: сеанс с загрузчиком одного устройства.
+ */
+typedef struct dfu_host dfu_host_t;
+
+/**
+ *  @brief  Функция ожидания освобождения приемного буфера.
+ *  @param ctx  Аргумент из dfu_host_set_rx_wait_cb().
+ */
+typedef void (*dfu_host_rx_wait_cb_t)(void* ctx);
+
+/**
+ *  @brief  Транспорт протокола загрузчика (см. dfu_host_transport.h).
+ */
+typedef struct dfu_host_transport dfu_host_transport_t;
+
+typedef struct dfu_host_req dfu_host_req_t;
+
+/**
+ *  @brief  Потребитель данных dfu_host_read_range().
+ *
+ *  @param ctx      Аргумент, переданный в dfu_host_read_range().
+ *  @param address  Адрес первого байта блока в памяти устройства.
+ *  @param data     Данные блока в приемном буфере модуля.
+ *  @param len      Длина блока, не больше 256 байт.
+ *
+ *  @return  0 - продолжить чтение, отрицательный код ошибки - прервать его.
+ */
+typedef int (*dfu_host_read_sink_t)(void* ctx, uint32_t address, const uint8_t* data, size_t len);
+
+/**
+ *  @brief  Функция окончания асинхронной операции, вызывается из dfu_host_poll().
+ *  Из нее можно запустить следующую операцию.
+ */
+typedef void (*dfu_host_req_cb_t)(dfu_host_req_t* req);
+
+/**
+ *  @brief  Асинхронная операция с устройством.
+ *
+ *  Поля cb и arg задает пользователь, остальные заполняются перед вызовом cb.
+ *  Объект должен оставаться доступным до окончания операции.
+ */
+struct dfu_host_req {
+    dfu_host_req_cb_t cb;  /* Функция окончания или NULL                           */
+    void* arg;             /* Аргумент пользователя                                */
+
+    dfu_host_t* host;      /* Экземпляр, который выполняет операцию                */
+
+    int rc;                /* Результат, как у соответствующей блокирующей функции */
+    const uint8_t* data;   /* Коды команд (GET), идентификатор (GET_ID), данные (READ_MEM) */
+    size_t len;            /* Длина data                                           */
+    uint8_t version;       /* Версия протокола (GET)                               */
+};
+
+/**
+ *  @brief  Шаг транзакции (внутреннее состояние экземпляра).
+ */
+typedef struct {
+    uint8_t  type;    /* step_type_t                             */
+    uint16_t offset;  /* Начало кадра в буфере кадров транзакции */
+    uint16_t len;     /* Длина кадра или ответа                  */
+    uint32_t timeout; /* Таймаут шага, 0 - адаптивный            */
+} dfu_host_step_t;
+
+/**
+ *  @brief  Оценка задержки ответа загрузчика на шаге команды (RFC 6298).
+ *
+ *  Задержка считается за вычетом времени передачи ответа по линии, поэтому
+ *  оценка не зависит от длины ответа и скорости USART.
+ */
+typedef struct {
+    uint16_t srtt;    /* Сглаженная задержка, 1/8 мс       */
+    uint16_t rttvar;  /* Ее отклонение, 1/4 мс             */
+    uint8_t  backoff; /* Удвоений таймаута после таймаутов */
+    bool     valid;   /* Есть хотя бы один замер           */
+} dfu_host_rtt_t;
+
+/* Разбор ответа по окончании транзакции: rc - результат последнего шага */
+typedef int (*dfu_host_finish_t)(dfu_host_t* host, dfu_host_req_t* req, int rc);
+
+/**
+ *  @brief  Состояние экземпляра. Память выделяет пользователь, поля
+ *  заполняет и использует только модуль.
+ *
+ *  Экземпляры независимы: у каждого свой транспорт, приемные буферы, оценки
+ *  задержки, кэш возможностей и текущая транзакция, поэтому операции с
+ *  разными устройствами можно вести одновременно, вызывая dfu_host_poll()
+ *  для каждого экземпляра.
+ */
+struct dfu_host {
+    const dfu_host_transport_t* tp; /* Транспорт до загрузчика */
+
+    /* Приемные буферы, ответы записываются в них по очереди */
+    uint8_t rcv_buffer[CONFIG_DFU_HOST_RX_BUFFERS][DFU_HOST_RX_BUFFER_SIZE];
+    size_t  rcv_index;                /* Буфер последнего ответа               */
+    dfu_host_rx_wait_cb_t rx_wait_cb; /* Ожидание освобождения приемного буфера */
+    void*   rx_wait_ctx;
+
+    /* Оценки задержки ответа по командам и шагам транзакции */
+    dfu_host_rtt_t rtt_table[DFU_HOST_RTT_CMDS][DFU_HOST_STEPS_MAX];
+
+    /* Кэш возможностей загрузчиков по идентификатору продукта */
+    dfu_host_caps_t caps_cache[CONFIG_DFU_HOST_CAPS_CACHE_SIZE];
+    size_t caps_used;                 /* Заполнено записей                     */
+    size_t caps_next;                 /* Следующая вытесняемая запись          */
+    const dfu_host_caps_t* caps_cur;  /* Возможности устройства или NULL       */
+
+    /* Текущая транзакция */
+    struct {
+        dfu_host_req_t*   req;      /* Операция пользователя, NULL - транзакции нет */
+        dfu_host_finish_t finish;   /* Разбор ответа или NULL                       */
+        dfu_host_step_t   steps[DFU_HOST_STEPS_MAX];
+        uint8_t  count;             /* Количество шагов                             */
+        uint8_t  index;             /* Текущий шаг                                  */
+        dfu_host_rtt_t* rtt;        /* Оценки шагов команды или NULL                */
+        uint8_t  tx_buffer[DFU_HOST_TX_BUFFER_SIZE]; /* Кадры всех шагов подряд      */
+        uint8_t* rx;                /* Приемный буфер ответа транзакции             */
+        uint8_t* rx_user;           /* Буфер пользователя для STEP_RECV_EXACT или NULL */
+        size_t   tx_len;
+        uint32_t sync_timeout;      /* Таймаут шага STEP_SYNC                       */
+        uint32_t timeout;           /* Таймаут текущего шага                        */
+        uint32_t start;             /* Начало текущего шага                         */
+        uint32_t step_tick;         /* Запуск текущего шага, для замера задержки    */
+        bool     started;           /* Начало шага зафиксировано в dfu_host_poll()  */
+        volatile bool step_done;    /* Текущий шаг завершен, результат в step_rc    */
+        volatile int  step_rc;
+    } xfer;
+
+    /* Текущее чтение диапазона */
+    struct {
+        dfu_host_req_t req;
+        uint32_t address;           /* Адрес следующего блока                  */
+        size_t   left;              /* Байт еще не запрошено                   */
+        size_t   len;               /* Длина последнего запрошенного блока     */
+        uint8_t  retries;           /* Повторов этого блока                    */
+        uint8_t* buf;               /* Буфер пользователя или NULL             */
+        dfu_host_read_sink_t sink;
+        void*    ctx;
+        int      rc;                /* Первая ошибка чтения или потребителя    */
+    } range;
+};
+
+/**
+ *  @brief Инициализация экземпляра dfu_host для работы через USART (AN3155).
  *  Должна вызываться до использования остальных функций из API.
  *
+ *  @param host    Экземпляр.
  *  @param handle  Объект UART для взаимодействия с подчиненным устройством.
  *
  *  @return  0 - в случае успеха, код ошибки dfu_host_err_t в противном случае.
  */
-int dfu_host_init(UART_HandleTypeDef* handle);
+int dfu_host_init(dfu_host_t* host, UART_HandleTypeDef* handle);
+
+/**
+ *  @brief Инициализация экземпляра dfu_host для работы через заданный транспорт.
+ *
+ *  Сбрасывает все состояние экземпляра, в том числе функцию ожидания
+ *  dfu_host_set_rx_wait_cb(). Транспорт не должен использоваться другим
+ *  экземпляром.
+ *
+ *  @param host       Экземпляр.
+ *  @param transport  Транспорт USART, SPI или I2C (см. dfu_host_transport.h).
+ *
+ *  @return  0 - в случае успеха, код ошибки dfu_host_err_t в противном случае.
+ */
+int dfu_host_init_transport(dfu_host_t* host, const dfu_host_transport_t* transport);
+
+/**
+ *  @brief  Сменить скорость линии для взаимодействия с устройством (только USART).
+ *
+ *  Загрузчик определяет скорость только по первому 0x7F после сброса, поэтому
+ *  после смены скорости устройство нужно перезапустить и снова выполнить
+ *  dfu_host_ping().
+ *
+ *  @param baudrate  Новая скорость в бит/с.
+ *
+ *  @return  0 - в случае успеха, DFU_HOST_ERR_EINVAL, если транспорт не
+ *           поддерживает смену скорости, код ошибки dfu_host_err_t в противном случае.
+ */
+int dfu_host_set_baudrate(dfu_host_t* host, uint32_t baudrate);
+
+/**
+ *  @brief  Текущая скорость линии в бит/с или 0, если транспорт ее не сообщает.
+ */
+uint32_t dfu_host_get_baudrate(dfu_host_t* host);
+
+/**
+ *  @brief  Получить счетчики ошибок приема на линии (только USART).
+ *
+ *  Ошибка приема прерывает транзакцию сразу, с кодом DFU_HOST_ERR_LINE,
+ *  не дожидаясь таймаута ответа.
+ *
+ *  @param stats  Результат.
+ *
+ *  @return  0 - в случае успеха, DFU_HOST_ERR_EINVAL, если транспорт не
+ *           обнаруживает ошибки приема.
+ */
+int dfu_host_get_link_stats(dfu_host_t* host, dfu_host_link_stats_t* stats);
+
+/**
+ *  @brief  Установить функцию, вызываемую перед каждой записью в приемный буфер модуля.
+ *
+ *  Данные, на которые указывают результаты dfu_host_read_memory() и dfu_host_get_id(),
+ *  остаются неизменными до вызова @p cb перед записью в тот же буфер, то есть
+ *  не раньше чем через CONFIG_DFU_HOST_RX_BUFFERS ответов. Функция вызывается
+ *  из dfu_host_poll() или из функции запуска команды. Это позволяет продолжать обработку
+ *  принятого блока (например, расчет CRC через DMA) во время отправки команды
+ *  следующей транзакции. Функция должна вернуть управление только после того,
+ *  как буфер больше не используется.
+ *
+ *  @param cb   Функция ожидания или NULL, чтобы отключить ожидание.
+ *  @param ctx  Аргумент @p cb.
+ */
+void dfu_host_set_rx_wait_cb(dfu_host_t* host, dfu_host_rx_wait_cb_t cb, void* ctx);
+
+/**
+ *  @brief  Продвинуть текущую асинхронную операцию.
+ *
+ *  Обработка принятых данных, запуск следующего шага транзакции, контроль
+ *  таймаутов и вызов dfu_host_req_t::cb выполняются здесь, поэтому функцию
+ *  нужно вызывать из основного цикла, пока dfu_host_busy() возвращает true.
+ *  Прием и передача между вызовами идут по прерываниям и DMA.
+ */
+void dfu_host_poll(dfu_host_t* host);
+
+/**
+ *  @brief  Выполняется ли асинхронная операция.
+ */
+bool dfu_host_busy(dfu_host_t* host);
+
+/**
+ *  @brief  Дождаться окончания асинхронной операции, вызывая dfu_host_poll().
+ *
+ *  @param req  Запущенная операция.
+ *
+ *  @return  Результат операции dfu_host_req_t::rc.
+ */
+int dfu_host_wait(dfu_host_t* host, dfu_host_req_t* req);
+
+/*
+ * Все функции ниже первым аргументом принимают экземпляр, инициализированный
+ * dfu_host_init() или dfu_host_init_transport().
+ *
+ * Асинхронные варианты команд. Каждая функция запускает транзакцию и сразу
+ * возвращает 0 или код ошибки dfu_host_err_t (в этом случае cb не
+ * вызывается). Одновременно выполняется одна операция, иначе возвращается
+ * DFU_HOST_ERR_BUSY. Результат передается в req->rc и остальные поля req.
+ * Данные по указателю req->data действительны, пока не будут приняты еще
+ * CONFIG_DFU_HOST_RX_BUFFERS ответов (см. dfu_host_set_rx_wait_cb()), поэтому
+ * следующее чтение можно запускать до окончания обработки предыдущего блока.
+ * Передаваемые данные копируются при запуске.
+ */
+int dfu_host_ping_async(dfu_host_t* host, dfu_host_req_t* req, uint32_t timeout);
+int dfu_host_get_async(dfu_host_t* host, dfu_host_req_t* req);
+int dfu_host_get_version_async(dfu_host_t* host, dfu_host_req_t* req);
+int dfu_host_get_id_async(dfu_host_t* host, dfu_host_req_t* req);
+int dfu_host_read_memory_async(dfu_host_t* host, dfu_host_req_t* req, uint32_t address, size_t len);
+int dfu_host_write_memory_async(dfu_host_t* host, dfu_host_req_t* req, uint32_t address, const uint8_t* data, size_t len);
+int dfu_host_go_async(dfu_host_t* host, dfu_host_req_t* req, uint32_t address);
+int dfu_host_erase_all_async(dfu_host_t* host, dfu_host_req_t* req);
+int dfu_host_erase_sectors_async(dfu_host_t* host, dfu_host_req_t* req, const uint16_t* sectors, size_t count);
+int dfu_host_write_protect_sectors_async(dfu_host_t* host, dfu_host_req_t* req, const uint8_t* sectors, size_t count);
+int dfu_host_write_protect_area_async(dfu_host_t* host, dfu_host_req_t* req, uint16_t start, uint16_t end);
+int dfu_host_write_unprotect_async(dfu_host_t* host, dfu_host_req_t* req);
+int dfu_host_readout_protect_async(dfu_host_t* host, dfu_host_req_t* req);
+int dfu_host_readout_unprotect_async(dfu_host_t* host, dfu_host_req_t* req);
 
 /**
- *  @brief Отправить начальный пакет Ping подчиненному устройству.
+ *  @brief Отправить начальный пакет Ping подчиненному устройству
+ *  (синхронизация транспорта с загрузчиком).
  *
  *  @param timeout  Длительность ожидания ответа от устройства в миллисекундах.
  *
  *  @return 0 - в случае успеха (устройство ответило ACK), 
  *          код ошибки dfu_host_err_t в противном случае.
  */
-int dfu_host_ping(uint32_t timeout);
+int dfu_host_ping(dfu_host_t* host, uint32_t timeout);
+
+/**
+ *  @brief  Восстановить синхронизацию с загрузчиком после ошибок обмена без
+ *  сброса устройства.
+ *
+ *  Загрузчик, у которого искажение на линии сбило границы кадров, ждет
+ *  продолжения прерванного кадра. Ему передаются байты-заполнители, пока он
+ *  не ответит NACK, после чего связь проверяется командой GET_VERSION.
+ *
+ *  @param timeout  Общее время попыток в миллисекундах.
+ *
+ *  @return  0 - загрузчик отвечает на команды,
+ *           DFU_HOST_ERR_TIMEOUT - связь не восстановлена.
+ */
+int dfu_host_resync(dfu_host_t* host, uint32_t timeout);
+
+/**
+ *  @brief  Запросить у устройства версию протокола и список поддерживаемых команд (GET).
+ *
+ *  @param version  Результирующая версия протокола в виде 0xNM (см. dfu_host_get_version()).
+ *  @param cmds     Результирующий буфер с кодами поддерживаемых команд.
+ *  @param count    Результирующее количество команд в буфере @p cmds.
+ *
+ *  @return  0 - в случае успеха, код ошибки dfu_host_err_t в противном случае.
+ */
+int dfu_host_get(dfu_host_t* host, uint8_t* version, const uint8_t** cmds, size_t* count);
 
 /**
  *  @brief  Запросить у устройства версию бутлоадера.
@@ -46,7 +397,7 @@ int dfu_host_ping(uint32_t timeout);
  *
  *  В случае ошибки возвращается код ошибки dfu_host_err_t.
  */
-int dfu_host_get_version(void);
+int dfu_host_get_version(dfu_host_t* host);
 
 /**
  *  @brief  Запросить у устройства идентификатор продукта.
@@ -56,7 +407,28 @@ int dfu_host_get_version(void);
  *  
  *  @return  0 - в случае успеха, код ошибки dfu_host_err_t в противном случае.
  */
-int dfu_host_get_id(const uint8_t** id, size_t* id_len);
+int dfu_host_get_id(dfu_host_t* host, const uint8_t** id, size_t* id_len);
+
+/**
+ *  @brief  Определить возможности загрузчика подключенного устройства.
+ *
+ *  Идентификатор продукта запрашивается командой GET_ID. Возможности загрузчика
+ *  с этим идентификатором берутся из кэша, а если их там нет - запрашиваются
+ *  командой GET и сохраняются, вытесняя самую старую запись. Найденная запись
+ *  становится текущей: по ней dfu_host_erase_all() и dfu_host_erase_sectors()
+ *  выбирают команду стирания. Кэш очищается при смене транспорта.
+ *
+ *  @param caps  Результирующий указатель на запись кэша. Запись остается
+ *               действительной, пока не будет вытеснена.
+ *
+ *  @return  0 - в случае успеха, код ошибки dfu_host_err_t в противном случае.
+ */
+int dfu_host_discover(dfu_host_t* host, const dfu_host_caps_t** caps);
+
+/**
+ *  @brief  Поддерживает ли загрузчик команду с кодом @p cmd (AN3155).
+ */
+bool dfu_host_caps_has(const dfu_host_caps_t* caps, uint8_t cmd);
 
 /** 
  *  @brief  Прочитать непрерывный блок памяти устройства начиная с заданного адреса.
@@ -68,7 +440,40 @@ int dfu_host_get_id(const uint8_t** id, size_t* id_len);
  *  @return  Значение количества прочитанных байт из памяти устройства,
  *           код ошибки dfu_host_err_t в противном случае.
  */
-int dfu_host_read_memory(uint32_t address, const uint8_t** result, size_t len);
+int dfu_host_read_memory(dfu_host_t* host, uint32_t address, const uint8_t** result, size_t len);
+
+/**
+ *  @brief  Прочитать диапазон памяти устройства произвольной длины.
+ *
+ *  Диапазон читается блоками READ_MEM по 256 байт, каждый блок передается
+ *  @p sink прямо из приемного буфера модуля. Потребитель вызывается после
+ *  запроса следующего блока, поэтому его обработка идет во время обмена.
+ *  Блок, принятый с ошибкой на линии (DFU_HOST_ERR_LINE), запрашивается
+ *  повторно до CONFIG_DFU_HOST_LINE_RETRIES раз.
+ *
+ *  @param address  Начальный адрес памяти устройства.
+ *  @param len      Длина диапазона в байтах.
+ *  @param sink     Потребитель блоков.
+ *  @param ctx      Аргумент @p sink.
+ *
+ *  @return  0 - в случае успеха, код ошибки dfu_host_err_t или ошибка,
+ *           которую вернул @p sink, в противном случае.
+ */
+int dfu_host_read_range(dfu_host_t* host, uint32_t address, size_t len, dfu_host_read_sink_t sink, void* ctx);
+
+/**
+ *  @brief  Прочитать диапазон памяти устройства произвольной длины в буфер пользователя.
+ *
+ *  Блоки READ_MEM принимаются сразу на свое место в @p buf, без копирования.
+ *
+ *  @param address  Начальный адрес памяти устройства.
+ *  @param buf      Буфер длиной не меньше @p len.
+ *  @param len      Длина диапазона в байтах.
+ *
+ *  @return  0 - в случае успеха, код ошибки dfu_host_err_t в противном случае.
+ *           При ошибке содержимое @p buf не определено.
+ */
+int dfu_host_read_range_buf(dfu_host_t* host, uint32_t address, uint8_t* buf, size_t len);
 
 /**
  *  @brief Записать непрерывный блок данных в память устройства по заданному адресу.
@@ -80,7 +485,7 @@ int dfu_host_read_memory(uint32_t address, const uint8_t** result, size_t len);
  *  @return  Значение количества записанных байт в память устройства,
  *           код ошибки dfu_host_err_t в противном случае.
  */
-int dfu_host_write_memory(uint32_t address, const uint8_t* data, size_t len);
+int dfu_host_write_memory(dfu_host_t* host, uint32_t address, const uint8_t* data, size_t len);
 
 /**
  *  @brief  Запуск приложения на устройстве используя заданный адрес начала программы.
@@ -89,14 +494,31 @@ int dfu_host_write_memory(uint32_t address, const uint8_t* data, size_t len);
  *
  *  @return  0 - в случае успеха, код ошибки dfu_host_err_t в противном случае.
  */
-int dfu_host_go(uint32_t address);
+int dfu_host_go(dfu_host_t* host, uint32_t address);
 
 /**
  *  @brief  Очистить содержимое всей памяти устройства.
  *
+ *  Если возможности устройства определены (dfu_host_discover()) и в них нет
+ *  Extended Erase, используется Erase (0x43).
+ *
+ *  @return  0 - в случае успеха, код ошибки dfu_host_err_t в противном случае.
+ */
+int dfu_host_erase_all(dfu_host_t* host);
+
+/**
+ *  @brief  Стереть заданные секторы Flash устройства командой Extended Erase (0x44).
+ *
+ *  Если возможности устройства определены (dfu_host_discover()) и в них нет
+ *  Extended Erase, используется Erase (0x43): номера секторов меньше 256.
+ *
+ *  @param sectors  Номера секторов (страниц) в нумерации загрузчика (AN2606).
+ *  @param count    Количество секторов, не больше DFU_HOST_ERASE_SECTORS_MAX.
+ *
  *  @return  0 - в случае успеха, код ошибки dfu_host_err_t в противном случае.
+ *           DFU_HOST_ERR_NACK - номер сектора неверен или сектор защищен от записи.
  */
-int dfu_host_erase_all(void);
+int dfu_host_erase_sectors(dfu_host_t* host, const uint16_t* sectors, size_t count);
 
 /**
  *  @brief  Установить защиту от перезаписи для всех заданных секторов памяти устройства.
@@ -107,7 +529,7 @@ int dfu_host_erase_all(void);
  *
  *  @return  0 - в случае успеха, код ошибки dfu_host_err_t в противном случае.
  */
-int dfu_host_write_protect_sectors(const uint8_t* sectors, size_t count);
+int dfu_host_write_protect_sectors(dfu_host_t* host, const uint8_t* sectors, size_t count);
 
 /**
  *  @brief  Установить защиту от перезаписи для заданной области памяти устройства.
@@ -120,27 +542,27 @@ int dfu_host_write_protect_sectors(const uint8_t* sectors, size_t count);
  *
  *  @return  0 - в случае успеха, код ошибки dfu_host_err_t в противном случае.
  */
-int dfu_host_write_protect_area(uint16_t start, uint16_t end);
+int dfu_host_write_protect_area(dfu_host_t* host, uint16_t start, uint16_t end);
 
 /**
  *  @brief  Снять защиту от перезаписи для всей памяти устройства.
  *
  *  @return  0 - в случае успеха, код ошибки dfu_host_err_t в противном случае.
  */
-int dfu_host_write_unprotect(void);
+int dfu_host_write_unprotect(dfu_host_t* host);
 
 /**
  *  @brief  Установить защиту от чтения всей памяти устройства.
  *
  *  @return  0 - в случае успеха, код ошибки dfu_host_err_t в противном случае.
  */
-int dfu_host_readout_protect(void);
+int dfu_host_readout_protect(dfu_host_t* host);
 
 /**
  *  @brief  Снять защиту от чтения всей памяти устройства.
  *
  *  @return  0 - в случае успеха, код ошибки dfu_host_err_t в противном случае.
  */
-int dfu_host_readout_unprotect(void);
+int dfu_host_readout_unprotect(dfu_host_t* host);
 
 #endif /* !INCLUDE_DFU_HOST_H__ */
\ No newline at end of file
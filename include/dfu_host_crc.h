@@ -0,0 +1,74 @@
+#ifndef INCLUDE_DFU_HOST_CRC_H__
+#define INCLUDE_DFU_HOST_CRC_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/crc_model.h"
+#include "dfu_host.h"
+#include "dfu_host_target.h"
+
+/* Адрес загрузки помощника в SRAM устройства: выше области, которую
+ * использует системный загрузчик (AN2606) */
+#ifndef CONFIG_DFU_HOST_CRC_HELPER_ADDR
+#define CONFIG_DFU_HOST_CRC_HELPER_ADDR 0x20004000U
+#endif /* CONFIG_DFU_HOST_CRC_HELPER_ADDR */
+
+/* Ожидание возврата устройства в загрузчик после запуска помощника, мс */
+#ifndef CONFIG_DFU_HOST_CRC_HELPER_TIMEOUT_MS
+#define CONFIG_DFU_HOST_CRC_HELPER_TIMEOUT_MS 3000
+#endif /* CONFIG_DFU_HOST_CRC_HELPER_TIMEOUT_MS */
+
+#define DFU_HOST_CRC_HELPER_MAGIC     0x48435243U /* "CRCH" - параметры заданы   */
+#define DFU_HOST_CRC_HELPER_DONE      0x454E4F44U /* "DONE" - результат записан */
+
+#define DFU_HOST_CRC_HELPER_FLAG_REFIN 0x01U /* Отраженный регистр (crc_model::refin) */
+#define DFU_HOST_CRC_HELPER_FLAG_HW    0x02U /* Целые слова через аппаратный блок CRC */
+
+/**
+ *  @brief  Блок параметров в начале образа помощника (little-endian).
+ *
+ *  Контракт помощника: после GO по адресу образа он считает CRC диапазона
+ *  [address, address + length) начиная с регистра state, записывает регистр
+ *  в state, DONE в status и выполняет системный сброс устройства.
+ */
+typedef struct {
+    uint32_t sp;       /* Начальный SP, загрузчик берет его по адресу GO         */
+    uint32_t entry;    /* Адрес входа | 1, загрузчик переходит по адресу GO + 4  */
+    uint32_t magic;    /* DFU_HOST_CRC_HELPER_MAGIC                              */
+    uint32_t address;  /* Начало диапазона                                       */
+    uint32_t length;   /* Длина диапазона в байтах                               */
+    uint32_t poly;     /* Полином в форме регистра crc_engine                    */
+    uint32_t state;    /* Регистр crc_engine: начальный, затем результат         */
+    uint32_t flags;    /* DFU_HOST_CRC_HELPER_FLAG_*                             */
+    uint32_t hw_crc;   /* Адрес блока CRC (FLAG_HW)                              */
+    uint32_t rcc_reg;  /* Регистр включения тактирования блока CRC (FLAG_HW)     */
+    uint32_t rcc_bit;  /* Бит включения тактирования блока CRC (FLAG_HW)         */
+    uint32_t status;   /* DFU_HOST_CRC_HELPER_DONE после окончания расчета       */
+} dfu_host_crc_helper_params_t;
+
+/**
+ *  @brief  Рассчитать CRC диапазона памяти на самом устройстве.
+ *
+ *  Загружает в SRAM устройства помощник (WRITE_MEM), запускает его (GO),
+ *  дожидается возврата устройства в загрузчик (линия BOOT0 должна оставаться
+ *  в 1) и читает из SRAM только результат. Скорость линии на время расчета
+ *  не влияет.
+ *
+ *  @param host     Экземпляр dfu_host, подключенный к устройству.
+ *  @param engine   Алгоритм CRC; таблица engine не используется.
+ *  @param address  Начало диапазона.
+ *  @param len      Длина диапазона в байтах.
+ *  @param target   Карта памяти устройства или NULL. Блок CRC устройства
+ *                  используется, если алгоритм - CRC-32/MPEG-2 или CRC-32/BZIP2,
+ *                  иначе и без карты - только программный расчет.
+ *  @param crc      Результат.
+ *
+ *  @return  0 - в случае успеха, код ошибки dfu_host_err_t в противном случае.
+ *           DFU_HOST_ERR_EINVAL - помощник не помещается в свободную SRAM устройства.
+ *           DFU_HOST_ERR_TIMEOUT - устройство не вернулось в загрузчик.
+ */
+int dfu_host_crc_remote(dfu_host_t* host, const struct crc_engine* engine,
+    uint32_t address, uint32_t len, const dfu_host_target_t* target, uint32_t* crc);
+
+#endif /* !INCLUDE_DFU_HOST_CRC_H__ */
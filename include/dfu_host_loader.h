@@ -0,0 +1,175 @@
+#ifndef INCLUDE_DFU_HOST_LOADER_H__
+#define INCLUDE_DFU_HOST_LOADER_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dfu_host.h"
+
+/* Адрес загрузки загрузчика в SRAM устройства: выше области, которую
+ * использует системный загрузчик (AN2606) */
+#ifndef CONFIG_DFU_HOST_LOADER_ADDR
+#define CONFIG_DFU_HOST_LOADER_ADDR 0x20004000U
+#endif /* CONFIG_DFU_HOST_LOADER_ADDR */
+
+/* Максимальная скорость линии с загрузчиком, бит/с */
+#ifndef CONFIG_DFU_HOST_LOADER_BAUD_MAX
+#define CONFIG_DFU_HOST_LOADER_BAUD_MAX 2000000
+#endif /* CONFIG_DFU_HOST_LOADER_BAUD_MAX */
+
+/* Скорости, из которых выбирается максимальная, по убыванию */
+#ifndef CONFIG_DFU_HOST_LOADER_BAUD_RATES
+#define CONFIG_DFU_HOST_LOADER_BAUD_RATES \
+    4000000, 3000000, 2000000, 1500000, 1000000, 921600, 460800, 230400, 115200
+#endif /* CONFIG_DFU_HOST_LOADER_BAUD_RATES */
+
+/* Кадров без подтверждения со стороны хоста (не больше окна загрузчика) */
+#ifndef CONFIG_DFU_HOST_LOADER_WINDOW
+#define CONFIG_DFU_HOST_LOADER_WINDOW 4
+#endif /* CONFIG_DFU_HOST_LOADER_WINDOW */
+
+/* Ожидание ответа сверх времени передачи кадров окна, мс */
+#ifndef CONFIG_DFU_HOST_LOADER_TIMEOUT_MS
+#define CONFIG_DFU_HOST_LOADER_TIMEOUT_MS 20
+#endif /* CONFIG_DFU_HOST_LOADER_TIMEOUT_MS */
+
+/* Ожидание окончания стирания, мс */
+#ifndef CONFIG_DFU_HOST_LOADER_ERASE_TIMEOUT_MS
+#define CONFIG_DFU_HOST_LOADER_ERASE_TIMEOUT_MS 30000
+#endif /* CONFIG_DFU_HOST_LOADER_ERASE_TIMEOUT_MS */
+
+/* Повторов подряд без продвижения, после которых операция прерывается */
+#ifndef CONFIG_DFU_HOST_LOADER_RETRIES
+#define CONFIG_DFU_HOST_LOADER_RETRIES 5
+#endif /* CONFIG_DFU_HOST_LOADER_RETRIES */
+
+/*
+ * Протокол загрузчика.
+ *
+ * Кадр: SOF, тип, seq, длина данных (2 байта), данные, CRC-32/ISO-HDLC
+ * (crc32_ieee) от типа до конца данных. Многобайтовые поля - little-endian.
+ *
+ * Загрузчик после запуска передает HELLO на скорости системного загрузчика.
+ * Команды PING, BAUD и GO подтверждаются ACK, ERASE - STATUS, seq ответа
+ * равен seq команды. Ошибка адреса или Flash в любой команде - STATUS с
+ * кодом ошибки.
+ *
+ * WRITE передаются окном: seq идет подряд через все кадры WRITE сеанса,
+ * ACK содержит seq следующего ожидаемого кадра. Искаженный кадр или пропуск
+ * в последовательности - NAK с ожидаемым seq, хост повторяет с него.
+ *
+ * READ: загрузчик передает кадры DATA с seq от seq команды, не больше окна
+ * без подтверждения. Хост подтверждает ACK с seq следующего ожидаемого
+ * кадра, по NAK загрузчик повторяет с указанного кадра. Любая другая
+ * команда завершает передачу.
+ */
+#define DFU_HOST_LOADER_SOF         0xA5U
+#define DFU_HOST_LOADER_MAGIC       0x3152444CU /* "LDR1"                   */
+#define DFU_HOST_LOADER_VERSION     1U
+
+#define DFU_HOST_LOADER_DATA_MAX    1024U /* Данных в кадре WRITE/DATA      */
+#define DFU_HOST_LOADER_PAYLOAD_MAX (DFU_HOST_LOADER_DATA_MAX + 8U)
+#define DFU_HOST_LOADER_OVERHEAD    9U    /* SOF, тип, seq, длина и CRC     */
+
+/* Память за образом: буфер кадра, кольцевой буфер приема и стек */
+#define DFU_HOST_LOADER_RAM_SIZE    (1040U + 8192U + 256U)
+
+typedef enum {
+    DFU_HOST_LOADER_HELLO  = 0x01, /* версия, окно, размер данных (2), BRR (4) */
+    DFU_HOST_LOADER_ACK    = 0x02, /* [PING: ожидаемый seq WRITE]             */
+    DFU_HOST_LOADER_NAK    = 0x03,
+    DFU_HOST_LOADER_STATUS = 0x04, /* dfu_host_loader_status_t                */
+    DFU_HOST_LOADER_PING   = 0x10,
+    DFU_HOST_LOADER_BAUD   = 0x11, /* скорость (4), BRR (4)                   */
+    DFU_HOST_LOADER_WRITE  = 0x12, /* адрес (4), данные                       */
+    DFU_HOST_LOADER_READ   = 0x13, /* адрес (4), длина (4)                    */
+    DFU_HOST_LOADER_ERASE  = 0x14, /* адрес (4), длина (4)                    */
+    DFU_HOST_LOADER_GO     = 0x15, /* адрес (4)                               */
+    DFU_HOST_LOADER_DATA   = 0x20, /* данные                                  */
+} dfu_host_loader_type_t;
+
+typedef enum {
+    DFU_HOST_LOADER_ST_OK    = 0,
+    DFU_HOST_LOADER_ST_ADDR  = 1, /* Диапазон вне Flash/SRAM или не выровнен */
+    DFU_HOST_LOADER_ST_FLASH = 2, /* Ошибка программирования или стирания    */
+} dfu_host_loader_status_t;
+
+/**
+ *  @brief  Блок параметров в начале образа загрузчика (little-endian).
+ */
+typedef struct {
+    uint32_t sp;       /* Начальный SP, загрузчик берет его по адресу GO        */
+    uint32_t entry;    /* Адрес входа | 1, загрузчик переходит по адресу GO + 4 */
+    uint32_t magic;    /* DFU_HOST_LOADER_MAGIC                                 */
+    uint32_t reserved;
+} dfu_host_loader_params_t;
+
+/**
+ *  @brief  Загрузить в SRAM устройства загрузчик и перейти на него.
+ *
+ *  Образ выбирается по PID, загружается командой WRITE_MEM и запускается
+ *  командой GO. Затем скорость линии поднимается до максимальной из
+ *  CONFIG_DFU_HOST_LOADER_BAUD_RATES, не больше CONFIG_DFU_HOST_LOADER_BAUD_MAX,
+ *  которую USART устройства задает с ошибкой не больше 2%. Только для
+ *  транспорта USART.
+ *
+ *  Если загрузчик не ответил на новой скорости, устройство нужно сбросить.
+ *
+ *  Сеанс с загрузчиком один: остальные функции dfu_host_loader_* работают с
+ *  экземпляром, переданным сюда, до dfu_host_loader_reset().
+ *
+ *  @param host  Экземпляр dfu_host, подключенный к устройству.
+ *  @param pid   Идентификатор продукта из dfu_host_get_id().
+ *
+ *  @return  0 - в случае успеха, код ошибки dfu_host_err_t в противном случае.
+ *           DFU_HOST_ERR_EINVAL - для устройства или транспорта нет загрузчика.
+ *           DFU_HOST_ERR_BUSY - загрузчик запущен на другом экземпляре.
+ */
+int dfu_host_loader_start(dfu_host_t* host, uint16_t pid);
+
+/**
+ *  @brief  Забыть загрузчик после сброса устройства и вернуть скорость
+ *  линии, на которой работал системный загрузчик.
+ */
+void dfu_host_loader_reset(void);
+
+/**
+ *  @brief  Загрузчик запущен и отвечает.
+ */
+bool dfu_host_loader_active(void);
+
+/**
+ *  @brief  Прочитать диапазон памяти через загрузчик. Аналог
+ *  dfu_host_read_range(), блоки - до DFU_HOST_LOADER_DATA_MAX байт.
+ *
+ *  @return  0 или код ошибки dfu_host_err_t, код ошибки sink.
+ */
+int dfu_host_loader_read_range(uint32_t address, size_t len, dfu_host_read_sink_t sink, void* ctx);
+
+/**
+ *  @brief  Прочитать диапазон памяти через загрузчик в буфер.
+ */
+int dfu_host_loader_read_range_buf(uint32_t address, uint8_t* buf, size_t len);
+
+/**
+ *  @brief  Записать данные через загрузчик. Для Flash адрес и длина должны
+ *  быть кратны 4, записываемые секторы - стерты.
+ *
+ *  @return  0 или код ошибки dfu_host_err_t. DFU_HOST_ERR_NACK - загрузчик
+ *           отказал в записи (адрес, ошибка Flash).
+ */
+int dfu_host_loader_write(uint32_t address, const uint8_t* data, size_t len);
+
+/**
+ *  @brief  Стереть секторы Flash, содержащие диапазон [address, address + len).
+ */
+int dfu_host_loader_erase(uint32_t address, size_t len);
+
+/**
+ *  @brief  Запустить программу по адресу таблицы векторов. После этого
+ *  загрузчик неактивен.
+ */
+int dfu_host_loader_go(uint32_t address);
+
+#endif /* !INCLUDE_DFU_HOST_LOADER_H__ */
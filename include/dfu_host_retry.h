@@ -0,0 +1,61 @@
+#ifndef INCLUDE_DFU_HOST_RETRY_H__
+#define INCLUDE_DFU_HOST_RETRY_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ *  @brief  Политика повторов транзакции.
+ *
+ *  Повтор откладывается на случайное время от 0 до backoff_ms * 2^(n-1),
+ *  но не больше backoff_max_ms (экспоненциальная задержка с полным
+ *  разбросом), чтобы не попасть повтором в ту же помеху на линии. После
+ *  ошибки приема (DFU_HOST_ERR_LINE) повтор выполняется сразу.
+ */
+typedef struct {
+    uint8_t  attempts;       /* Попыток всего, включая первую                   */
+    uint16_t backoff_ms;     /* Верхняя граница задержки перед первым повтором  */
+    uint16_t backoff_max_ms; /* Предел верхней границы задержки                 */
+    uint32_t budget_ms;      /* Время от первой ошибки, после которого повторов
+                                больше нет; 0 - без ограничения                */
+} dfu_host_retry_cfg_t;
+
+/**
+ *  @brief  Состояние повторов одной операции.
+ */
+typedef struct {
+    const dfu_host_retry_cfg_t* cfg;
+    uint8_t  failures;    /* Ошибок подряд                    */
+    uint32_t first_tick;  /* Время первой ошибки серии        */
+    uint32_t resume_tick; /* Время, с которого можно повторять */
+    uint32_t rng;         /* Состояние генератора разброса    */
+} dfu_host_retry_t;
+
+/**
+ *  @brief  Начать серию операций с политикой cfg.
+ */
+void dfu_host_retry_init(dfu_host_retry_t* retry, const dfu_host_retry_cfg_t* cfg);
+
+/**
+ *  @brief  Учесть ошибку операции и назначить время повтора.
+ *
+ *  @param rc  Код ошибки dfu_host_err_t.
+ *
+ *  @return true - операцию можно повторить, когда dfu_host_retry_ready()
+ *          вернет true; false - повторять бесполезно: ошибка в параметрах
+ *          (DFU_HOST_ERR_EINVAL, DFU_HOST_ERR_BUSY), попытки или время
+ *          исчерпаны.
+ */
+bool dfu_host_retry_failed(dfu_host_retry_t* retry, int rc);
+
+/**
+ *  @brief  Истекла ли задержка перед повтором.
+ */
+bool dfu_host_retry_ready(const dfu_host_retry_t* retry);
+
+/**
+ *  @brief  Учесть успешную операцию: следующая ошибка начнет новую серию.
+ */
+void dfu_host_retry_success(dfu_host_retry_t* retry);
+
+#endif /* !INCLUDE_DFU_HOST_RETRY_H__ */
@@ -0,0 +1,72 @@
+#ifndef INCLUDE_DFU_HOST_TARGET_H__
+#define INCLUDE_DFU_HOST_TARGET_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ *  @brief  Непрерывная область памяти устройства.
+ */
+typedef struct {
+    uint32_t base; /* Начальный адрес  */
+    uint32_t size; /* Размер в байтах  */
+} dfu_host_mem_region_t;
+
+/**
+ *  @brief  Разбиение Flash устройства на секторы (страницы) стирания.
+ */
+typedef struct {
+    uint32_t base;                /* Адрес начала Flash                                  */
+    uint32_t size;                /* Размер Flash в байтах                               */
+    uint32_t sector_size;         /* Размер сектора, если все секторы одного размера     */
+    const uint32_t* sector_sizes; /* Размеры секторов подряд, если они разные, или NULL  */
+    size_t sector_count;          /* Количество секторов                                 */
+} dfu_host_flash_layout_t;
+
+/**
+ *  @brief  Аппаратный блок CRC устройства (CRC-32/MPEG-2 после сброса).
+ */
+typedef struct {
+    uint32_t crc_base; /* Адрес блока CRC, 0 - блока нет           */
+    uint32_t rcc_reg;  /* Регистр включения тактирования блока CRC */
+    uint32_t rcc_bit;  /* Бит CRCEN                                */
+} dfu_host_crc_hw_t;
+
+/**
+ *  @brief  Карта памяти устройства по AN2606 и справочному руководству.
+ */
+typedef struct {
+    uint16_t pid;                  /* Идентификатор продукта (GET_ID)                 */
+    const char* name;              /* Семейство устройств                             */
+    dfu_host_flash_layout_t flash; /* Основная Flash (банк 1)                         */
+    dfu_host_mem_region_t sram;    /* SRAM, доступная загрузчику (WRITE_MEM, GO)      */
+    uint32_t sram_free;            /* Начало SRAM выше области системного загрузчика  */
+    dfu_host_mem_region_t system;  /* Системная память (системный загрузчик)          */
+    dfu_host_mem_region_t option;  /* Байты опций                                     */
+    dfu_host_crc_hw_t crc;         /* Блок CRC                                        */
+} dfu_host_target_t;
+
+/**
+ *  @brief  Найти карту памяти устройства.
+ *
+ *  Поиск за постоянное время: таблица индексируется идентификатором продукта.
+ *
+ *  @param pid  Идентификатор продукта из dfu_host_get_id().
+ *
+ *  @return Описание или NULL, если устройство неизвестно.
+ */
+const dfu_host_target_t* dfu_host_target_find(uint16_t pid);
+
+/**
+ *  @brief  Помещается ли образ длиной @p len по адресу @p address в SRAM
+ *  устройства, не задевая область системного загрузчика.
+ */
+bool dfu_host_target_sram_fits(const dfu_host_target_t* target, uint32_t address, size_t len);
+
+/**
+ *  @brief  Лежит ли диапазон [@p address, @p address + @p len) в основной Flash.
+ */
+bool dfu_host_target_in_flash(const dfu_host_target_t* target, uint32_t address, size_t len);
+
+#endif /* !INCLUDE_DFU_HOST_TARGET_H__ */
@@ -0,0 +1,150 @@
+#ifndef INCLUDE_DFU_HOST_TRANSPORT_H__
+#define INCLUDE_DFU_HOST_TRANSPORT_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "cmsis.h"
+#include "dfu_host.h"
+
+/**
+ *  @brief  Функция завершения асинхронной операции транспорта.
+ *
+ *  @param arg  Аргумент, переданный при запуске операции.
+ *  @param rc   Количество принятых байт или код ошибки dfu_host_err_t.
+ */
+typedef void (*dfu_host_transport_done_t)(void* arg, int rc);
+
+/**
+ *  @brief  Транспорт протокола системного загрузчика STM32.
+ *
+ *  Модуль dfu_host формирует команды AN3155 и разбирает ответы, а транспорт
+ *  отвечает за передачу кадров и поиск ACK/NACK на конкретной шине: USART
+ *  (AN3155), SPI (AN4286) или I2C (AN4221). Все функции возвращают коды
+ *  ошибок dfu_host_err_t.
+ *
+ *  Каждая операция задается блокирующей функцией или асинхронной (_async),
+ *  асинхронная используется, если задана. Блокирующие функции dfu_host
+ *  вызывает из dfu_host_poll(), поэтому на время их работы процессор занят
+ *  (SPI и I2C, где обменом управляет ведущий).
+ */
+struct dfu_host_transport {
+    /* Синхронизация с загрузчиком после сброса: 0x7F (USART), 0x5A (SPI),
+     * проверка ответа на адрес (I2C). 0 - загрузчик ответил ACK */
+    int (*sync)(void* ctx, uint32_t timeout);
+
+    /* Отправить кадр. cmd - кадр команды (в SPI ему предшествует байт 0x5A) */
+    int (*send)(void* ctx, const uint8_t* data, size_t len, bool cmd);
+
+    /* Принять ровно len байт данных ответа */
+    ssize_t (*recv_exact)(void* ctx, uint8_t* buf, size_t len, uint32_t timeout);
+
+    /* Принимать данные до ACK. Возвращает количество байт перед ACK,
+     * DFU_HOST_ERR_NACK или DFU_HOST_ERR_OVERFLOW, если данных больше size */
+    ssize_t (*recv_until_ack)(void* ctx, uint8_t* buf, size_t size, uint32_t timeout);
+    /* Принять ответ с байтом длины (GET, GET_ID): N, еще N + 1 байт и ACK.
+     * Возвращает количество байт перед ACK (N + 2), DFU_HOST_ERR_NACK или
+     * DFU_HOST_ERR_OVERFLOW, если ответ длиннее size */
+    ssize_t (*recv_sized)(void* ctx, uint8_t* buf, size_t size, uint32_t timeout);
+
+    /* Асинхронные варианты: запускают операцию и сразу возвращают управление.
+     * Результат, как у блокирующей функции, передается в done из прерывания
+     * или из poll(). Буферы должны оставаться доступными до вызова done.
+     * Таймауты отслеживает dfu_host и по их истечении вызывает abort() */
+    int (*sync_async)(void* ctx, dfu_host_transport_done_t done, void* arg);
+
+    int (*send_async)(void* ctx, const uint8_t* data, size_t len, bool cmd,
+        dfu_host_transport_done_t done, void* arg);
+
+    int (*recv_exact_async)(void* ctx, uint8_t* buf, size_t len,
+        dfu_host_transport_done_t done, void* arg);
+
+    int (*recv_until_ack_async)(void* ctx, uint8_t* buf, size_t size,
+        dfu_host_transport_done_t done, void* arg);
+    int (*recv_sized_async)(void* ctx, uint8_t* buf, size_t size,
+        dfu_host_transport_done_t done, void* arg);
+
+    /* Продвинуть асинхронные операции, которые завершаются не из прерывания */
+    void (*poll)(void* ctx);
+
+    /* Отменить асинхронные операции, done не вызывается */
+    void (*abort)(void* ctx);
+
+    /* Необязательные функции, NULL - не поддерживаются транспортом */
+
+    /* Скорость линии в бит/с */
+    int (*set_baudrate)(void* ctx, uint32_t baudrate);
+    uint32_t (*get_baudrate)(void* ctx);
+    /* Счетчики ошибок приема. Ошибка приема завершает текущий прием с
+     * DFU_HOST_ERR_LINE */
+    const dfu_host_link_stats_t* (*link_stats)(void* ctx);
+
+    /* Потоковый обмен для загрузчика в ОЗУ (dfu_host_loader.h): передача без
+     * сброса принятых байт и чтение уже принятых байт без ожидания.
+     * stream_recv возвращает количество прочитанных байт */
+    int (*stream_send_async)(void* ctx, const uint8_t* data, size_t len,
+        dfu_host_transport_done_t done, void* arg);
+    size_t (*stream_recv)(void* ctx, uint8_t* buf, size_t size);
+
+    const char* name;
+    void* ctx;
+    /* Байт опций после версии в ответе GET_VERSION: 2 на USART (AN3155),
+     * 0 на SPI и I2C */
+    uint8_t version_options;
+};
+
+/**
+ *  @brief  Транспорт, заданный в dfu_host_init_transport(), или NULL.
+ */
+const dfu_host_transport_t* dfu_host_get_transport(const dfu_host_t* host);
+
+/**
+ *  @brief  Транспорт USART (AN3155): 8E1, асинхронный. Ответ принимается в
+ *  кольцевой буфер по DMA (CONFIG_DFU_HOST_RX_DMA) или по прерыванию на
+ *  каждый байт, кадры передаются по прерываниям.
+ *
+ *  @param huart  Инициализированный UART.
+ *
+ *  Транспорты разных UART независимы, их количество ограничено
+ *  CONFIG_DFU_HOST_UART_PORTS. Повторный вызов для того же UART перезапускает
+ *  его транспорт.
+ *
+ *  @return Транспорт для dfu_host_init_transport() или NULL, если свободных
+ *  портов нет.
+ */
+const dfu_host_transport_t* dfu_host_transport_uart(UART_HandleTypeDef* huart);
+
+#ifdef HAL_SPI_MODULE_ENABLED
+/**
+ *  @brief  Транспорт SPI (AN4286): режим 0, MSB первым, до 8 МГц. Линия NSS
+ *  устройства удерживается в 0 платой.
+ *
+ *  @param hspi  Инициализированный SPI в режиме master.
+ *
+ *  Количество SPI ограничено CONFIG_DFU_HOST_SPI_PORTS.
+ *
+ *  @return Транспорт для dfu_host_init_transport() или NULL, если свободных
+ *  портов нет.
+ */
+const dfu_host_transport_t* dfu_host_transport_spi(SPI_HandleTypeDef* hspi);
+#endif /* HAL_SPI_MODULE_ENABLED */
+
+#ifdef HAL_I2C_MODULE_ENABLED
+/**
+ *  @brief  Транспорт I2C (AN4221).
+ *
+ *  @param hi2c     Инициализированный I2C в режиме master.
+ *  @param address  7-битный адрес загрузчика устройства (см. AN2606).
+ *
+ *  Количество устройств ограничено CONFIG_DFU_HOST_I2C_PORTS, устройства с
+ *  разными адресами могут находиться на одной шине.
+ *
+ *  @return Транспорт для dfu_host_init_transport() или NULL, если свободных
+ *  портов нет.
+ */
+const dfu_host_transport_t* dfu_host_transport_i2c(I2C_HandleTypeDef* hi2c, uint16_t address);
+#endif /* HAL_I2C_MODULE_ENABLED */
+
+#endif /* !INCLUDE_DFU_HOST_TRANSPORT_H__ */
@@ -0,0 +1,83 @@
+#ifndef INCLUDE_DFU_HOST_UPDATE_H__
+#define INCLUDE_DFU_HOST_UPDATE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dfu_host.h"
+#include "dfu_host_target.h"
+
+/* Размер блока WRITE_MEM при записи секторов */
+#define DFU_HOST_UPDATE_WRITE_BLOCK 256U
+
+/**
+ *  @brief  Получить дайджест содержимого диапазона Flash устройства.
+ *
+ *  Дайджест - CRC-32/MPEG-2 диапазона, тот же алгоритм dfu_host_update()
+ *  применяет к эталонному образу.
+ *
+ *  @param host     Экземпляр dfu_host, подключенный к устройству.
+ *  @param ctx      Аргумент из dfu_host_update_cfg_t.
+ *  @param address  Начало диапазона.
+ *  @param len      Длина диапазона в байтах.
+ *  @param digest   Результат.
+ *
+ *  @return  0 - в случае успеха, код ошибки dfu_host_err_t в противном случае.
+ */
+typedef int (*dfu_host_digest_t)(dfu_host_t* host, void* ctx, uint32_t address, size_t len, uint32_t* digest);
+
+/**
+ *  @brief  Дайджест чтением диапазона (READ_MEM). ctx не используется.
+ */
+int dfu_host_digest_readback(dfu_host_t* host, void* ctx, uint32_t address, size_t len, uint32_t* digest);
+
+/**
+ *  @brief  Дайджест помощником в SRAM устройства (dfu_host_crc_remote()).
+ *  ctx - карта памяти устройства (const dfu_host_target_t*) или NULL.
+ */
+int dfu_host_digest_helper(dfu_host_t* host, void* ctx, uint32_t address, size_t len, uint32_t* digest);
+
+/**
+ *  @brief  Параметры обновления.
+ */
+typedef struct {
+    const dfu_host_flash_layout_t* layout; /* Разбиение Flash устройства          */
+    dfu_host_digest_t digest;              /* Дайджест сектора на устройстве      */
+    void* digest_ctx;                      /* Аргумент digest                     */
+} dfu_host_update_cfg_t;
+
+/**
+ *  @brief  Итог обновления.
+ */
+typedef struct {
+    size_t sectors_total;   /* Секторов, которые затрагивает образ        */
+    size_t sectors_changed; /* Из них стерто и записано                   */
+    size_t bytes_written;   /* Байт передано командами WRITE_MEM          */
+    uint32_t elapsed_ms;    /* Длительность обновления в миллисекундах    */
+} dfu_host_update_stats_t;
+
+/**
+ *  @brief  Обновить Flash устройства до эталонного образа, стирая и записывая
+ *  только отличающиеся секторы.
+ *
+ *  Для каждого сектора, который затрагивает образ, дайджест на устройстве
+ *  сравнивается с дайджестом образа; байты сектора вне образа считаются
+ *  стертыми (0xFF). Отличающиеся секторы стираются командой Extended Erase
+ *  списком номеров, записываются блоками WRITE_MEM (блоки из одних 0xFF
+ *  пропускаются) и проверяются повторным расчетом дайджеста.
+ *
+ *  @param host     Экземпляр dfu_host, подключенный к устройству.
+ *  @param cfg      Параметры обновления.
+ *  @param address  Адрес образа во Flash устройства.
+ *  @param image    Эталонный образ.
+ *  @param len      Длина образа в байтах.
+ *  @param stats    Итог обновления или NULL.
+ *
+ *  @return  0 - в случае успеха, код ошибки dfu_host_err_t в противном случае.
+ *           DFU_HOST_ERR_EINVAL - образ выходит за пределы Flash.
+ *           DFU_HOST_ERR_EIO - после записи сектор не совпал с образом.
+ */
+int dfu_host_update(dfu_host_t* host, const dfu_host_update_cfg_t* cfg, uint32_t address,
+    const uint8_t* image, size_t len, dfu_host_update_stats_t* stats);
+
+#endif /* !INCLUDE_DFU_HOST_UPDATE_H__ */
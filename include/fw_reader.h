@@ -0,0 +1,174 @@
+#ifndef INCLUDE_FW_READER_H__
+#define INCLUDE_FW_READER_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dfu_host.h"
+#include "dfu_host_retry.h"
+#include "dfu_host_target.h"
+#include "core/crc_model.h"
+#include "core/toolchain.h"
+
+/* Начало Flash устройства, карта памяти которого неизвестна */
+#define FW_FLASH_BASE 0x08000000U
+
+/* Размер блока READ_MEM при проверке прошивки */
+#define FW_READ_BLOCK_SIZE 256
+
+/* Попыток чтения одного блока прошивки */
+#define FW_READ_RETRIES 5
+
+/* Верхняя граница задержки перед первым повтором чтения блока и ее предел, мс */
+#ifndef CONFIG_DFU_READ_BACKOFF_MS
+#define CONFIG_DFU_READ_BACKOFF_MS 2
+#endif
+#ifndef CONFIG_DFU_READ_BACKOFF_MAX_MS
+#define CONFIG_DFU_READ_BACKOFF_MAX_MS 20
+#endif
+
+/* Время на повторы чтения блока, после которого чтение прерывается, мс */
+#ifndef CONFIG_DFU_READ_RETRY_BUDGET_MS
+#define CONFIG_DFU_READ_RETRY_BUDGET_MS 100
+#endif
+
+/**
+ *  @brief  Структура метаинформации прошивки.
+ */
+typedef struct __packed {
+    uint32_t fw_size; /* Размер прошивки в байтах      */
+    uint16_t crc16; /* CRC области прошивки         */
+} fw_meta_t;
+
+/**
+ *  @brief  Точка продолжения проверки прошивки. Содержимое Flash от сброса
+ *  устройства не меняется, поэтому после ошибок чтения проверка продолжается
+ *  с первого непроверенного блока.
+ */
+typedef struct {
+    fw_meta_t meta;   /* Метаинформация проверяемой прошивки       */
+    uint32_t  base;   /* Начальный адрес прошивки                  */
+    uint32_t  addr;   /* Адрес первого непроверенного блока        */
+    uint32_t  value;  /* Регистр CRC по всем блокам до addr        */
+    bool      valid;
+} fw_checkpoint_t;
+
+/**
+ *  @brief  Функция ошибки чтения блока, после которой блок будет прочитан
+ *  повторно.
+ *
+ *  @return  true - прервать чтение вместо повтора.
+ */
+typedef bool (*fw_reader_error_cb_t)(void* ctx);
+
+/**
+ *  @brief  Конвейерное чтение прошивки.
+ *
+ *  Следующий READ_MEM запускается из функции окончания предыдущего, а CRC
+ *  принятого блока считается в основном цикле, пока по линии идет следующий
+ *  блок. Принятый блок остается в приемном буфере dfu_host, пока не придут
+ *  еще CONFIG_DFU_HOST_RX_BUFFERS ответов, поэтому блоков в очереди на
+ *  расчет и в пути вместе не больше количества приемных буферов.
+ */
+typedef struct {
+    dfu_host_t* host;
+    fw_reader_error_cb_t on_error;
+    void* on_error_ctx;
+
+    dfu_host_req_t req;
+    uint32_t addr;      /* Адрес следующего запроса         */
+    uint32_t left;      /* Байт еще не запрошено            */
+    dfu_host_retry_t retry; /* Повторы чтения текущего блока */
+    bool     failed;    /* Чтение прервано из-за ошибок     */
+    bool     aborted;   /* Чтение прервал on_error          */
+
+    /* Принятые блоки, ожидающие расчета CRC */
+    struct {
+        const uint8_t* data;
+        size_t len;
+    } ready[CONFIG_DFU_HOST_RX_BUFFERS];
+    size_t ready_head;
+    size_t ready_tail;
+} fw_reader_t;
+
+/**
+ *  @brief  Повторы чтения блока прошивки: FW_READ_RETRIES попыток и
+ *  задержки CONFIG_DFU_READ_*.
+ */
+extern const dfu_host_retry_cfg_t fw_read_retry;
+
+/**
+ *  @brief  Привязать чтение к экземпляру dfu_host.
+ *
+ *  @param r         Чтение.
+ *  @param host      Экземпляр dfu_host, подключенный к устройству.
+ *  @param on_error  Функция ошибки чтения блока или NULL.
+ *  @param ctx       Аргумент on_error.
+ */
+void fw_reader_init(fw_reader_t* r, dfu_host_t* host, fw_reader_error_cb_t on_error, void* ctx);
+
+/**
+ *  @brief  Начать чтение len байт с адреса addr.
+ */
+void fw_reader_start(fw_reader_t* r, uint32_t addr, uint32_t len);
+
+/**
+ *  @brief  Запросить следующий блок, если для него есть свободный приемный
+ *  буфер и прошла задержка перед повтором. Вызывается в цикле опроса.
+ */
+void fw_reader_next(fw_reader_t* r);
+
+/**
+ *  @brief  Взять очередной принятый блок.
+ *
+ *  @return  false - блоков в очереди нет.
+ */
+bool fw_reader_get(fw_reader_t* r, const uint8_t** data, size_t* len);
+
+/**
+ *  @brief  Освободить блок, полученный fw_reader_get().
+ */
+void fw_reader_release(fw_reader_t* r);
+
+/**
+ *  @brief  Все данные прочитаны и обработаны.
+ */
+static inline bool fw_reader_finished(const fw_reader_t* r)
+{
+    return r->left == 0 && r->ready_head == r->ready_tail;
+}
+
+/**
+ *  @brief  Начать проверку прошивки или продолжить ее с точки cp.
+ *
+ *  Точка сохраняется, если она относится к той же прошивке (метаинформация и
+ *  начальный адрес), иначе проверка начинается с base.
+ *
+ *  @return  true - проверка продолжается с cp->addr.
+ */
+bool fw_checkpoint_begin(fw_checkpoint_t* cp, const fw_meta_t* meta, uint32_t base,
+    const struct crc_engine* crc);
+
+/**
+ *  @brief  Начальный адрес прошивки: начало Flash по карте памяти или
+ *  FW_FLASH_BASE, если карта неизвестна.
+ */
+static inline uint32_t fw_flash_base(const dfu_host_target_t* target)
+{
+    return (target != NULL) ? target->flash.base : FW_FLASH_BASE;
+}
+
+/**
+ *  @brief  Метаинформация по адресу meta_addr лежит во Flash устройства.
+ *  С неизвестной картой памяти не проверяется.
+ */
+bool fw_meta_addr_valid(const dfu_host_target_t* target, uint32_t meta_addr);
+
+/**
+ *  @brief  Размер прошивки из метаинформации не нулевой и помещается во Flash
+ *  устройства. Стертая или испорченная метаинформация его не проходит.
+ */
+bool fw_meta_size_valid(const dfu_host_target_t* target, const fw_meta_t* meta);
+
+#endif /* !INCLUDE_FW_READER_H__ */
@@ -0,0 +1,58 @@
+#ifndef INCLUDE_GANG_H__
+#define INCLUDE_GANG_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/crc_model.h"
+
+/**
+ *  @brief  Итог проверки устройства канала.
+ */
+typedef enum {
+    GANG_STATUS_PASS,
+    GANG_STATUS_NO_ANSWER,    /* Загрузчик не отвечает              */
+    GANG_STATUS_PROTECTED,    /* Чтение запрещено защитой RDP       */
+    GANG_STATUS_BAD_META,     /* Метаинформация вне Flash           */
+    GANG_STATUS_READ_ERROR,   /* Прошивка не читается               */
+    GANG_STATUS_CRC_MISMATCH, /* CRC прошивки не совпала            */
+    GANG_STATUS_GO_ERROR,     /* Прошивка не запустилась            */
+} gang_status_t;
+
+/**
+ *  @brief  Итог проверки канала. Поля, до которых проверка не дошла, - нули.
+ */
+typedef struct {
+    gang_status_t status;
+    uint16_t pid;         /* Идентификатор продукта                       */
+    uint32_t fw_size;     /* Размер прошивки из метаинформации            */
+    uint16_t crc;         /* CRC прошивки из метаинформации               */
+    uint16_t crc_read;    /* CRC прочитанной прошивки                     */
+    uint32_t elapsed_ms;  /* Длительность проверки канала                 */
+} gang_result_t;
+
+/**
+ *  @brief  Проверить прошивки устройств на всех каналах платы одновременно.
+ *
+ *  Для каждого канала (board_get_channel_count()) работает свой автомат со
+ *  своим экземпляром dfu_host: сброс с BOOT0 = 1, синхронизация, GET_ID,
+ *  чтение метаинформации, чтение прошивки с расчетом CRC и GO. Автоматы не
+ *  блокируют друг друга: операции всех каналов запускаются асинхронно и
+ *  продвигаются в одном цикле, поэтому обмен по всем UART идет параллельно и
+ *  проверка N устройств занимает почти столько же, сколько проверка одного.
+ *
+ *  @param crc      Алгоритм CRC прошивки.
+ *  @param results  Итоги по каналам.
+ *  @param count    Размер results. Каналы сверх него не проверяются.
+ *
+ *  @return  Количество проверенных каналов - заполненных элементов results.
+ */
+size_t gang_run(const struct crc_engine* crc, gang_result_t* results, size_t count);
+
+/**
+ *  @brief  Получить описание итога проверки для вывода.
+ */
+const char* gang_status_name(gang_status_t status);
+
+#endif /* !INCLUDE_GANG_H__ */
@@ -1,4 +1,5 @@
 #include "core/crc.h"
+#include "core/util.h"
 
 uint16_t crc16(uint16_t poly, uint16_t seed, const uint8_t *src, size_t len)
 {
@@ -21,7 +22,8 @@ uint16_t crc16(uint16_t poly, uint16_t seed, const uint8_t *src, size_t len)
 	return crc;
 }
 
-uint16_t crc16_reflect(uint16_t poly, uint16_t seed, const uint8_t *src, size_t len)
+uint16_t crc16_reflect_bitwise(uint16_t poly, uint16_t seed, const uint8_t *src,
+	size_t len)
 {
 	uint16_t crc = seed;
 	size_t i, j;
@@ -42,8 +44,91 @@ uint16_t crc16_reflect(uint16_t poly, uint16_t seed, const uint8_t *src, size_t
 	return crc;
 }
 
+void crc16_reflect_table_init(struct crc16_reflect_table *table, uint16_t poly)
+{
+	size_t i, k;
+
+	table->poly = poly;
 
-uint16_t crc16_ccitt(uint16_t seed, const uint8_t *src, size_t len)
+	for (i = 0; i < 256; i++) {
+		const uint8_t byte = (uint8_t)i;
+
+		table->t[0][i] = crc16_reflect_bitwise(poly, 0, &byte, 1);
+	}
+
+	/* t[k][i] is t[k - 1][i] pushed through one more zero byte */
+	for (k = 1; k < ARRAY_SIZE(table->t); k++) {
+		for (i = 0; i < 256; i++) {
+			const uint16_t prev = table->t[k - 1][i];
+
+			table->t[k][i] = (prev >> 8U) ^ table->t[0][prev & 0xffU];
+		}
+	}
+}
+
+uint16_t crc16_reflect_table(const struct crc16_reflect_table *table, uint16_t seed,
+	const uint8_t *src, size_t len)
+{
+	const uint16_t (*t)[256] = table->t;
+	uint16_t crc = seed;
+
+#if CONFIG_CRC16_REFLECT_SLICES == 8
+	for (; len >= 8; len -= 8, src += 8) {
+		crc ^= (uint16_t)src[0] | ((uint16_t)src[1] << 8U);
+		crc = t[7][crc & 0xffU] ^ t[6][crc >> 8U] ^ t[5][src[2]] ^ t[4][src[3]] ^
+		      t[3][src[4]] ^ t[2][src[5]] ^ t[1][src[6]] ^ t[0][src[7]];
+	}
+#elif CONFIG_CRC16_REFLECT_SLICES == 4
+	for (; len >= 4; len -= 4, src += 4) {
+		crc ^= (uint16_t)src[0] | ((uint16_t)src[1] << 8U);
+		crc = t[3][crc & 0xffU] ^ t[2][crc >> 8U] ^ t[1][src[2]] ^ t[0][src[3]];
+	}
+#endif
+
+	for (; len > 0; len--) {
+		crc = (crc >> 8U) ^ t[0][(crc ^ *src++) & 0xffU];
+	}
+
+	return crc;
+}
+
+#if CONFIG_CRC16_REFLECT_SLICES > 0
+
+/* Tables of the last polynomial used by crc16_reflect() */
+static struct crc16_reflect_table crc16_reflect_cache;
+static bool crc16_reflect_cache_valid;
+
+void crc16_reflect_init(uint16_t poly)
+{
+	if (!crc16_reflect_cache_valid || crc16_reflect_cache.poly != poly) {
+		crc16_reflect_table_init(&crc16_reflect_cache, poly);
+		crc16_reflect_cache_valid = true;
+	}
+}
+
+uint16_t crc16_reflect_sw(uint16_t poly, uint16_t seed, const uint8_t *src, size_t len)
+{
+	crc16_reflect_init(poly);
+
+	return crc16_reflect_table(&crc16_reflect_cache, seed, src, len);
+}
+
+#else
+
+void crc16_reflect_init(uint16_t poly)
+{
+	(void)poly;
+}
+
+uint16_t crc16_reflect_sw(uint16_t poly, uint16_t seed, const uint8_t *src, size_t len)
+{
+	return crc16_reflect_bitwise(poly, seed, src, len);
+}
+
+#endif /* CONFIG_CRC16_REFLECT_SLICES > 0 */
+
+
+uint16_t crc16_ccitt_sw(uint16_t seed, const uint8_t *src, size_t len)
 {
 	for (; len > 0; len--) {
 		uint8_t e, f;
@@ -56,7 +141,7 @@ uint16_t crc16_ccitt(uint16_t seed, const uint8_t *src, size_t len)
 	return seed;
 }
 
-uint16_t crc16_itu_t(uint16_t seed, const uint8_t *src, size_t len)
+uint16_t crc16_itu_t_sw(uint16_t seed, const uint8_t *src, size_t len)
 {
 	for (; len > 0; len--) {
 		seed = (seed >> 8U) | (seed << 8U);
@@ -67,4 +152,23 @@ uint16_t crc16_itu_t(uint16_t seed, const uint8_t *src, size_t len)
 	}
 
 	return seed;
-}
\ No newline at end of file
+}
+
+#ifndef CONFIG_CRC_HW
+
+uint16_t crc16_reflect(uint16_t poly, uint16_t seed, const uint8_t *src, size_t len)
+{
+	return crc16_reflect_sw(poly, seed, src, len);
+}
+
+uint16_t crc16_ccitt(uint16_t seed, const uint8_t *src, size_t len)
+{
+	return crc16_ccitt_sw(seed, src, len);
+}
+
+uint16_t crc16_itu_t(uint16_t seed, const uint8_t *src, size_t len)
+{
+	return crc16_itu_t_sw(seed, src, len);
+}
+
+#endif /* !CONFIG_CRC_HW */
@@ -1,11 +1,42 @@
 #include "core/crc.h"
 
+#if CONFIG_CRC32_IEEE_SLICES > 0
+#include "crc32_sw_table.h"
+#endif
+
 uint32_t crc32_ieee(const uint8_t *data, size_t len)
 {
 	return crc32_ieee_update(0x0, data, len);
 }
 
-uint32_t crc32_ieee_update(uint32_t crc, const uint8_t *data, size_t len)
+#if CONFIG_CRC32_IEEE_SLICES > 0
+
+uint32_t crc32_ieee_update_sw(uint32_t crc, const uint8_t *data, size_t len)
+{
+	const uint32_t (*t)[256] = crc32_ieee_table;
+
+	crc = ~crc;
+
+#if CONFIG_CRC32_IEEE_SLICES == 8
+	for (; len >= 8; len -= 8, data += 8) {
+		crc ^= (uint32_t)data[0] | ((uint32_t)data[1] << 8U) |
+		       ((uint32_t)data[2] << 16U) | ((uint32_t)data[3] << 24U);
+		crc = t[7][crc & 0xffU] ^ t[6][(crc >> 8U) & 0xffU] ^
+		      t[5][(crc >> 16U) & 0xffU] ^ t[4][crc >> 24U] ^
+		      t[3][data[4]] ^ t[2][data[5]] ^ t[1][data[6]] ^ t[0][data[7]];
+	}
+#endif
+
+	for (; len > 0; len--) {
+		crc = (crc >> 8U) ^ t[0][(crc ^ *data++) & 0xffU];
+	}
+
+	return (~crc);
+}
+
+#else
+
+uint32_t crc32_ieee_update_sw(uint32_t crc, const uint8_t *data, size_t len)
 {
 	/* crc table generated from polynomial 0xedb88320 */
 	static const uint32_t table[16] = {
@@ -25,4 +56,15 @@ uint32_t crc32_ieee_update(uint32_t crc, const uint8_t *data, size_t len)
 	}
 
 	return (~crc);
-}
\ No newline at end of file
+}
+
+#endif /* CONFIG_CRC32_IEEE_SLICES > 0 */
+
+#ifndef CONFIG_CRC_HW
+
+uint32_t crc32_ieee_update(uint32_t crc, const uint8_t *data, size_t len)
+{
+	return crc32_ieee_update_sw(crc, data, len);
+}
+
+#endif /* !CONFIG_CRC_HW */
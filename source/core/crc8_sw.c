@@ -24,22 +24,21 @@ uint8_t crc8(const uint8_t *src, size_t len, uint8_t polynomial, uint8_t initial
     uint8_t crc = initial_value;
     size_t i, j;
 
-    for (i = 0; i < len; i++) {
-        crc ^= src[i];
-
-        for (j = 0; j < 8; j++) {
-            if (reversed) {
-                if (crc & 0x01) {
-                    crc = (crc >> 1) ^ polynomial;
-                } else {
-                    crc >>= 1;
-                }
-            } else {
-                if (crc & 0x80) {
-                    crc = (crc << 1) ^ polynomial;
-                } else {
-                    crc <<= 1;
-                }
+    /* Pick the shift direction once instead of testing it for every bit */
+    if (reversed) {
+        for (i = 0; i < len; i++) {
+            crc ^= src[i];
+
+            for (j = 0; j < 8; j++) {
+                crc = (crc & 0x01) ? (crc >> 1) ^ polynomial : (crc >> 1);
+            }
+        }
+    } else {
+        for (i = 0; i < len; i++) {
+            crc ^= src[i];
+
+            for (j = 0; j < 8; j++) {
+                crc = (crc & 0x80) ? (crc << 1) ^ polynomial : (crc << 1);
             }
         }
     }
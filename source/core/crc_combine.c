@@ -0,0 +1,110 @@
+#include "core/crc.h"
+
+/*
+ * The CRC register after feeding n zero bytes is the register multiplied by
+ * x^(8n) modulo the generator polynomial, so the CRC of a concatenation is
+ * obtained from the CRCs of its parts with a handful of GF(2) polynomial
+ * multiplications (see zlib's crc32_combine()).
+ *
+ * Reflected registers store the coefficient of x^0 in the most significant
+ * bit of the CRC width, normal registers store it in bit 0.
+ */
+
+/* a * b mod poly, reflected representation */
+static uint32_t gf2_mulmod_reflect(uint32_t a, uint32_t b, uint32_t poly, unsigned int width)
+{
+	uint32_t m = (uint32_t)1U << (width - 1U);
+	uint32_t p = 0;
+
+	while (m != 0) {
+		if (a & m) {
+			p ^= b;
+		}
+
+		m >>= 1U;
+		b = (b & 1U) ? (b >> 1U) ^ poly : (b >> 1U);
+	}
+
+	return p;
+}
+
+/* a * b mod poly, normal representation */
+static uint32_t gf2_mulmod(uint32_t a, uint32_t b, uint32_t poly, unsigned int width)
+{
+	const uint32_t top = (uint32_t)1U << (width - 1U);
+	const uint32_t mask = top | (top - 1U);
+	uint32_t p = 0;
+
+	for (uint32_t m = top; m != 0; m >>= 1U) {
+		p = (p & top) ? ((p << 1U) ^ poly) & mask : (p << 1U) & mask;
+
+		if (a & m) {
+			p ^= b;
+		}
+	}
+
+	return p;
+}
+
+/* x^(8n) mod poly, reflected representation */
+static uint32_t x8n_mod_reflect(size_t n, uint32_t poly, unsigned int width)
+{
+	/* x^1, squared three times gives x^8 */
+	uint32_t sq = (uint32_t)1U << (width - 2U);
+	uint32_t p = (uint32_t)1U << (width - 1U);
+
+	for (int i = 0; i < 3; i++) {
+		sq = gf2_mulmod_reflect(sq, sq, poly, width);
+	}
+
+	for (; n != 0; n >>= 1U) {
+		if (n & 1U) {
+			p = gf2_mulmod_reflect(sq, p, poly, width);
+		}
+
+		sq = gf2_mulmod_reflect(sq, sq, poly, width);
+	}
+
+	return p;
+}
+
+/* x^(8n) mod poly, normal representation */
+static uint32_t x8n_mod(size_t n, uint32_t poly, unsigned int width)
+{
+	uint32_t sq = 0x100U; /* x^8 */
+	uint32_t p = 1U;
+
+	for (; n != 0; n >>= 1U) {
+		if (n & 1U) {
+			p = gf2_mulmod(sq, p, poly, width);
+		}
+
+		sq = gf2_mulmod(sq, sq, poly, width);
+	}
+
+	return p;
+}
+
+uint16_t crc16_combine(uint16_t poly, uint16_t seed, uint16_t crc1, uint16_t crc2,
+	size_t len2)
+{
+	const uint32_t shift = x8n_mod(len2, poly, 16);
+
+	return (uint16_t)(gf2_mulmod(shift, crc1 ^ seed, poly, 16) ^ crc2);
+}
+
+uint16_t crc16_reflect_combine(uint16_t poly, uint16_t seed, uint16_t crc1, uint16_t crc2,
+	size_t len2)
+{
+	const uint32_t shift = x8n_mod_reflect(len2, poly, 16);
+
+	return (uint16_t)(gf2_mulmod_reflect(shift, crc1 ^ seed, poly, 16) ^ crc2);
+}
+
+uint32_t crc32_combine(uint32_t crc1, uint32_t crc2, size_t len2)
+{
+	const uint32_t poly = 0xedb88320U;
+
+	/* Pre- and post-inversion of CRC-32/IEEE cancel out here */
+	return gf2_mulmod_reflect(x8n_mod_reflect(len2, poly, 32), crc1, poly, 32) ^ crc2;
+}
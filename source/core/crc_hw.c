@@ -0,0 +1,294 @@
+#include <errno.h>
+#include <string.h>
+
+#include "cmsis.h"
+#include "core/crc.h"
+#include "core/crc_hw.h"
+#include "core/util.h"
+#include "core/assert.h"
+
+/* CRC_CR_POLYSIZE field values */
+#define CRC_HW_POLYSIZE_32 0U
+#define CRC_HW_POLYSIZE_16 CRC_CR_POLYSIZE_0
+
+/* Reflected input (bit reversal by byte) and reflected output */
+#define CRC_HW_REFLECT (CRC_CR_REV_IN_0 | CRC_CR_REV_OUT)
+
+#ifdef CONFIG_CRC_HW_DMA
+
+/* DMA channel used for memory-to-memory transfers into CRC->DR */
+#ifndef CONFIG_CRC_HW_DMA_CHANNEL
+#define CONFIG_CRC_HW_DMA_CHANNEL DMA2_Channel1
+#define CONFIG_CRC_HW_DMA_CLK_ENABLE() __HAL_RCC_DMA2_CLK_ENABLE()
+#endif /* CONFIG_CRC_HW_DMA_CHANNEL */
+
+/* Upper bound of a DMA transfer wait in milliseconds */
+#ifndef CONFIG_CRC_HW_DMA_TIMEOUT_MS
+#define CONFIG_CRC_HW_DMA_TIMEOUT_MS 10
+#endif /* CONFIG_CRC_HW_DMA_TIMEOUT_MS */
+
+#endif /* CONFIG_CRC_HW_DMA */
+
+enum crc_hw_state {
+	CRC_HW_STATE_UNKNOWN,
+	CRC_HW_STATE_ACTIVE,
+	CRC_HW_STATE_FAILED,
+};
+
+static enum crc_hw_state crc_hw_state = CRC_HW_STATE_UNKNOWN;
+
+static inline uint16_t reflect16(uint16_t value)
+{
+	return (uint16_t)(__RBIT(value) >> 16U);
+}
+
+/*
+ * Program the peripheral. @p init is the value of the (non reflected) internal
+ * register, so reflected algorithms pass their seed bit-reversed.
+ */
+static inline void crc_hw_setup(uint32_t polysize, uint32_t poly, uint32_t init,
+	uint32_t reflect)
+{
+	CRC->POL = poly;
+	CRC->INIT = init;
+	CRC->CR = polysize | reflect | CRC_CR_RESET;
+}
+
+/* Feed a buffer to the peripheral, a word at a time where possible */
+static inline void crc_hw_feed(const uint8_t *src, size_t len)
+{
+	/* The unit shifts a 32-bit write in starting from bit 31, so the first
+	 * byte of the stream has to be the most significant one. */
+	for (; len >= 4; len -= 4, src += 4) {
+		uint32_t word;
+
+		memcpy(&word, src, sizeof(word));
+		CRC->DR = __REV(word);
+	}
+
+	for (; len > 0; len--) {
+		*(__IO uint8_t *)&CRC->DR = *src++;
+	}
+}
+
+static uint16_t crc16_reflect_hw(uint16_t poly, uint16_t seed, const uint8_t *src,
+	size_t len)
+{
+	crc_hw_setup(CRC_HW_POLYSIZE_16, reflect16(poly), reflect16(seed), CRC_HW_REFLECT);
+	crc_hw_feed(src, len);
+
+	return (uint16_t)CRC->DR;
+}
+
+static uint16_t crc16_hw(uint16_t poly, uint16_t seed, const uint8_t *src, size_t len)
+{
+	crc_hw_setup(CRC_HW_POLYSIZE_16, poly, seed, 0);
+	crc_hw_feed(src, len);
+
+	return (uint16_t)CRC->DR;
+}
+
+static uint32_t crc32_ieee_update_hw(uint32_t crc, const uint8_t *data, size_t len)
+{
+	crc_hw_setup(CRC_HW_POLYSIZE_32, 0x04C11DB7U, __RBIT(~crc), CRC_HW_REFLECT);
+	crc_hw_feed(data, len);
+
+	return ~CRC->DR;
+}
+
+/* Compare the peripheral against the software implementations */
+static bool crc_hw_self_test(void)
+{
+	static const uint8_t check[] = "123456789";
+	static const uint16_t seeds16[] = { 0x0000, 0xFFFF, 0x1D0F, 0xC3A5 };
+	static const uint32_t seeds32[] = { 0x00000000, 0xFFFFFFFF, 0x5A5AC3C3 };
+
+	/* Every length from 0 to 9 covers all word/tail splits */
+	for (size_t len = 0; len < sizeof(check); len++) {
+		for (size_t i = 0; i < ARRAY_SIZE(seeds16); i++) {
+			const uint16_t seed = seeds16[i];
+
+			if (crc16_reflect_hw(0xA001, seed, check, len) !=
+				crc16_reflect_sw(0xA001, seed, check, len)) {
+				return false;
+			}
+
+			if (crc16_reflect_hw(0x8408, seed, check, len) !=
+				crc16_ccitt_sw(seed, check, len)) {
+				return false;
+			}
+
+			if (crc16_hw(0x1021, seed, check, len) != crc16_itu_t_sw(seed, check, len)) {
+				return false;
+			}
+		}
+
+		for (size_t i = 0; i < ARRAY_SIZE(seeds32); i++) {
+			const uint32_t seed = seeds32[i];
+
+			if (crc32_ieee_update_hw(seed, check, len) !=
+				crc32_ieee_update_sw(seed, check, len)) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+int crc_hw_init(void)
+{
+	if (crc_hw_state == CRC_HW_STATE_UNKNOWN) {
+		__HAL_RCC_CRC_CLK_ENABLE();
+
+		crc_hw_state = crc_hw_self_test() ? CRC_HW_STATE_ACTIVE : CRC_HW_STATE_FAILED;
+	}
+
+	return (crc_hw_state == CRC_HW_STATE_ACTIVE) ? 0 : -EIO;
+}
+
+bool crc_hw_is_active(void)
+{
+	return crc_hw_init() == 0;
+}
+
+uint16_t crc16_reflect(uint16_t poly, uint16_t seed, const uint8_t *src, size_t len)
+{
+	/* The peripheral only supports odd polynomials (x^0 term present) */
+	if (!crc_hw_is_active() || (poly & 0x8000U) == 0) {
+		return crc16_reflect_sw(poly, seed, src, len);
+	}
+
+	return crc16_reflect_hw(poly, seed, src, len);
+}
+
+uint16_t crc16_ccitt(uint16_t seed, const uint8_t *src, size_t len)
+{
+	if (!crc_hw_is_active()) {
+		return crc16_ccitt_sw(seed, src, len);
+	}
+
+	return crc16_reflect_hw(0x8408, seed, src, len);
+}
+
+uint16_t crc16_itu_t(uint16_t seed, const uint8_t *src, size_t len)
+{
+	if (!crc_hw_is_active()) {
+		return crc16_itu_t_sw(seed, src, len);
+	}
+
+	return crc16_hw(0x1021, seed, src, len);
+}
+
+uint32_t crc32_ieee_update(uint32_t crc, const uint8_t *data, size_t len)
+{
+	if (!crc_hw_is_active()) {
+		return crc32_ieee_update_sw(crc, data, len);
+	}
+
+	return crc32_ieee_update_hw(crc, data, len);
+}
+
+#ifdef CONFIG_CRC_HW_DMA
+
+enum crc_dma_state {
+	CRC_DMA_STATE_IDLE,
+	CRC_DMA_STATE_RUNNING, /* DMA is feeding the peripheral */
+	CRC_DMA_STATE_DONE,    /* Result is already in crc_dma_result */
+};
+
+static DMA_HandleTypeDef crc_dma;
+static bool crc_dma_initialized;
+static enum crc_dma_state crc_dma_state = CRC_DMA_STATE_IDLE;
+static uint16_t crc_dma_result;
+
+static int crc_dma_init(void)
+{
+	if (crc_dma_initialized) {
+		return 0;
+	}
+
+	CONFIG_CRC_HW_DMA_CLK_ENABLE();
+
+	/* In memory-to-memory mode the "peripheral" side is the source */
+	crc_dma.Instance = CONFIG_CRC_HW_DMA_CHANNEL;
+	crc_dma.Init.Direction = DMA_MEMORY_TO_MEMORY;
+	crc_dma.Init.PeriphInc = DMA_PINC_ENABLE;
+	crc_dma.Init.MemInc = DMA_MINC_DISABLE;
+	crc_dma.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+	crc_dma.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+	crc_dma.Init.Mode = DMA_NORMAL;
+	crc_dma.Init.Priority = DMA_PRIORITY_HIGH;
+
+	if (HAL_DMA_Init(&crc_dma) != HAL_OK) {
+		return -EIO;
+	}
+
+	crc_dma_initialized = true;
+
+	return 0;
+}
+
+int crc16_reflect_dma_start(uint16_t poly, uint16_t seed, const uint8_t *src, size_t len)
+{
+	CHECK(src != NULL || len == 0, return -EINVAL);
+	CHECK(len <= UINT16_MAX, return -EINVAL);
+
+	if (crc_dma_state != CRC_DMA_STATE_IDLE) {
+		return -EBUSY;
+	}
+
+	if (!crc_hw_is_active() || (poly & 0x8000U) == 0 || len == 0 ||
+		crc_dma_init() != 0) {
+		crc_dma_result = crc16_reflect_sw(poly, seed, src, len);
+		crc_dma_state = CRC_DMA_STATE_DONE;
+		return 0;
+	}
+
+	crc_hw_setup(CRC_HW_POLYSIZE_16, reflect16(poly), reflect16(seed), CRC_HW_REFLECT);
+
+	if (HAL_DMA_Start(&crc_dma, (uint32_t)src, (uint32_t)&CRC->DR, len) != HAL_OK) {
+		return -EIO;
+	}
+
+	crc_dma_state = CRC_DMA_STATE_RUNNING;
+
+	return 0;
+}
+
+int crc16_reflect_dma_finish(uint16_t *crc)
+{
+	CHECK(crc != NULL, return -EINVAL);
+
+	int rc = 0;
+
+	switch (crc_dma_state) {
+	case CRC_DMA_STATE_IDLE:
+		return -EINVAL;
+
+	case CRC_DMA_STATE_RUNNING:
+		if (HAL_DMA_PollForTransfer(&crc_dma, HAL_DMA_FULL_TRANSFER,
+				CONFIG_CRC_HW_DMA_TIMEOUT_MS) != HAL_OK) {
+			HAL_DMA_Abort(&crc_dma);
+			rc = -EIO;
+		}
+
+		crc_dma_result = (uint16_t)CRC->DR;
+		break;
+
+	case CRC_DMA_STATE_DONE:
+		break;
+	}
+
+	crc_dma_state = CRC_DMA_STATE_IDLE;
+	*crc = crc_dma_result;
+
+	return rc;
+}
+
+bool crc16_reflect_dma_pending(void)
+{
+	return crc_dma_state != CRC_DMA_STATE_IDLE;
+}
+
+#endif /* CONFIG_CRC_HW_DMA */
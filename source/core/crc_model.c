@@ -0,0 +1,148 @@
+#include <errno.h>
+#include <string.h>
+
+#include "core/crc_model.h"
+#include "core/util.h"
+
+const struct crc_model crc_model_catalogue[] = {
+	/* name, alias, width, refin, refout, poly, init, xorout, check */
+	{ "CRC-8/SMBUS", NULL, 8, false, false, 0x07, 0x00, 0x00, 0xF4 },
+	{ "CRC-8/MAXIM-DOW", "CRC-8/MAXIM", 8, true, true, 0x31, 0x00, 0x00, 0xA1 },
+	{ "CRC-8/AUTOSAR", NULL, 8, false, false, 0x2F, 0xFF, 0xFF, 0xDF },
+	{ "CRC-16/ARC", "CRC-16/ANSI", 16, true, true, 0x8005, 0x0000, 0x0000, 0xBB3D },
+	{ "CRC-16/MODBUS", NULL, 16, true, true, 0x8005, 0xFFFF, 0x0000, 0x4B37 },
+	{ "CRC-16/USB", NULL, 16, true, true, 0x8005, 0xFFFF, 0xFFFF, 0xB4C8 },
+	{ "CRC-16/IBM-3740", "CRC-16/CCITT-FALSE", 16, false, false, 0x1021, 0xFFFF, 0x0000,
+	  0x29B1 },
+	{ "CRC-16/XMODEM", NULL, 16, false, false, 0x1021, 0x0000, 0x0000, 0x31C3 },
+	{ "CRC-16/KERMIT", "CRC-16/CCITT", 16, true, true, 0x1021, 0x0000, 0x0000, 0x2189 },
+	{ "CRC-16/IBM-SDLC", "CRC-16/X-25", 16, true, true, 0x1021, 0xFFFF, 0xFFFF, 0x906E },
+	{ "CRC-16/GSM", NULL, 16, false, false, 0x1021, 0x0000, 0xFFFF, 0xCE3C },
+	{ "CRC-32/ISO-HDLC", "CRC-32/IEEE", 32, true, true, 0x04C11DB7, 0xFFFFFFFF, 0xFFFFFFFF,
+	  0xCBF43926 },
+	{ "CRC-32/ISCSI", "CRC-32/CASTAGNOLI", 32, true, true, 0x1EDC6F41, 0xFFFFFFFF,
+	  0xFFFFFFFF, 0xE3069283 },
+	{ "CRC-32/BZIP2", NULL, 32, false, false, 0x04C11DB7, 0xFFFFFFFF, 0xFFFFFFFF,
+	  0xFC891918 },
+	{ "CRC-32/MPEG-2", NULL, 32, false, false, 0x04C11DB7, 0xFFFFFFFF, 0x00000000,
+	  0x0376E6E7 },
+	{ "CRC-32/CKSUM", "CRC-32/POSIX", 32, false, false, 0x04C11DB7, 0x00000000,
+	  0xFFFFFFFF, 0x765E7680 },
+};
+
+const size_t crc_model_catalogue_size = ARRAY_SIZE(crc_model_catalogue);
+
+/* Mask of the @p width least significant bits */
+static inline uint32_t width_mask(unsigned int width)
+{
+	return (width >= 32U) ? 0xFFFFFFFFU : (((uint32_t)1U << width) - 1U);
+}
+
+const struct crc_model *crc_model_find(const char *name)
+{
+	if (name == NULL) {
+		return NULL;
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(crc_model_catalogue); i++) {
+		const struct crc_model *model = &crc_model_catalogue[i];
+
+		if (strcmp(model->name, name) == 0 ||
+			(model->alias != NULL && strcmp(model->alias, name) == 0)) {
+			return model;
+		}
+	}
+
+	return NULL;
+}
+
+uint32_t crc_reflect(uint32_t value, unsigned int width)
+{
+	uint32_t result = 0;
+
+	for (unsigned int i = 0; i < width; i++) {
+		result = (result << 1U) | (value & 1U);
+		value >>= 1U;
+	}
+
+	return result;
+}
+
+int crc_engine_init(struct crc_engine *engine, const struct crc_model *model)
+{
+	if (engine == NULL || model == NULL || model->width == 0 || model->width > 32) {
+		return -EINVAL;
+	}
+
+	engine->model = model;
+
+	if (model->refin) {
+		const uint32_t poly = crc_reflect(model->poly, model->width);
+
+		for (uint32_t i = 0; i < 256; i++) {
+			uint32_t reg = i;
+
+			for (int j = 0; j < 8; j++) {
+				reg = (reg & 1U) ? (reg >> 1U) ^ poly : (reg >> 1U);
+			}
+
+			engine->table[i] = reg;
+		}
+	} else {
+		const uint32_t poly = model->poly << (32U - model->width);
+
+		for (uint32_t i = 0; i < 256; i++) {
+			uint32_t reg = i << 24U;
+
+			for (int j = 0; j < 8; j++) {
+				reg = (reg & 0x80000000U) ? (reg << 1U) ^ poly : (reg << 1U);
+			}
+
+			engine->table[i] = reg;
+		}
+	}
+
+	return 0;
+}
+
+uint32_t crc_engine_begin(const struct crc_engine *engine)
+{
+	const struct crc_model *model = engine->model;
+	const uint32_t init = model->init & width_mask(model->width);
+
+	if (model->refin) {
+		return crc_reflect(init, model->width);
+	}
+
+	return init << (32U - model->width);
+}
+
+uint32_t crc_engine_update(const struct crc_engine *engine, uint32_t state,
+	const uint8_t *src, size_t len)
+{
+	const uint32_t *table = engine->table;
+
+	if (engine->model->refin) {
+		for (; len > 0; len--) {
+			state = (state >> 8U) ^ table[(state ^ *src++) & 0xFFU];
+		}
+	} else {
+		for (; len > 0; len--) {
+			state = (state << 8U) ^ table[(state >> 24U) ^ *src++];
+		}
+	}
+
+	return state;
+}
+
+uint32_t crc_engine_final(const struct crc_engine *engine, uint32_t state)
+{
+	const struct crc_model *model = engine->model;
+	uint32_t reg = model->refin ? state : (state >> (32U - model->width));
+
+	if (model->refin != model->refout) {
+		reg = crc_reflect(reg, model->width);
+	}
+
+	return (reg ^ model->xorout) & width_mask(model->width);
+}
@@ -0,0 +1,152 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "cmsis.h"
+#include "crc_bench.h"
+#include "core/crc.h"
+#include "core/util.h"
+
+/* Размер тестового буфера в байтах */
+#ifndef CONFIG_CRC_BENCH_BUFFER_SIZE
+#define CONFIG_CRC_BENCH_BUFFER_SIZE 1024
+#endif /* CONFIG_CRC_BENCH_BUFFER_SIZE */
+
+/* Количество проходов по тестовому буферу в одном замере */
+#ifndef CONFIG_CRC_BENCH_ROUNDS
+#define CONFIG_CRC_BENCH_ROUNDS 16
+#endif /* CONFIG_CRC_BENCH_ROUNDS */
+
+/* Порождающий полином CRC-16/MODBUS в отраженном виде */
+#define CRC16_MODBUS_POLY 0xA001
+
+static uint8_t bench_buffer[CONFIG_CRC_BENCH_BUFFER_SIZE];
+
+#ifdef DWT
+
+/* Единица измерения замеров */
+#define BENCH_UNIT "cycles"
+
+/* Включить счетчик тактов ядра */
+static inline void cycle_counter_init(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+static inline uint32_t cycle_counter_get(void)
+{
+    return DWT->CYCCNT;
+}
+
+#else
+
+#include <time.h>
+
+/* Без DWT (сборка под хост) замеры ведутся в наносекундах */
+#define BENCH_UNIT "ns"
+
+static inline void cycle_counter_init(void)
+{
+}
+
+static inline uint32_t cycle_counter_get(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec);
+}
+
+#endif /* DWT */
+
+/* Вывести результат замера. Замер - единственный результат сборки с
+ * CRC_BENCHMARK, поэтому он выводится и без отладочного лога */
+static void bench_report(const char* name, uint32_t cycles, uint32_t crc)
+{
+    const uint32_t total = CONFIG_CRC_BENCH_BUFFER_SIZE * CONFIG_CRC_BENCH_ROUNDS;
+
+    /* Единиц на байт с двумя знаками после запятой */
+    const uint32_t cpb_x100 = (uint32_t)(((uint64_t)cycles * 100U) / total);
+    /* Байт на 1000 единиц */
+    const uint32_t bpkc = (uint32_t)(((uint64_t)total * 1000U) / MAX(cycles, 1U));
+
+    printf("BENCH: %-18s crc %08" PRIX32 ": %10" PRIu32 " " BENCH_UNIT ", %3" PRIu32 ".%02" PRIu32
+        " " BENCH_UNIT "/byte, %5" PRIu32 " bytes/k" BENCH_UNIT "\r\n",
+        name, crc, cycles, cpb_x100 / 100U, cpb_x100 % 100U, bpkc);
+}
+
+void crc_bench_run(void)
+{
+    uint32_t seed = 0x12345678;
+
+    /* Заполнить буфер псевдослучайными данными (LCG) */
+    for (size_t i = 0; i < sizeof(bench_buffer); ++i) {
+        seed = seed * 1664525U + 1013904223U;
+        bench_buffer[i] = (uint8_t)(seed >> 24);
+    }
+
+    cycle_counter_init();
+
+    /* Таблицы строятся вне замеряемого участка */
+    crc16_reflect_init(CRC16_MODBUS_POLY);
+
+    uint32_t start = cycle_counter_get();
+    uint16_t crc_bitwise = 0xFFFF;
+
+    for (int r = 0; r < CONFIG_CRC_BENCH_ROUNDS; ++r) {
+        crc_bitwise = crc16_reflect_bitwise(
+            CRC16_MODBUS_POLY, crc_bitwise, bench_buffer, sizeof(bench_buffer));
+    }
+
+    bench_report("crc16 bitwise", cycle_counter_get() - start, crc_bitwise);
+
+    start = cycle_counter_get();
+    uint16_t crc_table = 0xFFFF;
+
+    for (int r = 0; r < CONFIG_CRC_BENCH_ROUNDS; ++r) {
+        crc_table = crc16_reflect_sw(CRC16_MODBUS_POLY, crc_table, bench_buffer,
+            sizeof(bench_buffer));
+    }
+
+    bench_report("crc16 table", cycle_counter_get() - start, crc_table);
+
+    /* crc16_reflect() использует CRC-блок MCU, если он выбран для платы */
+    start = cycle_counter_get();
+    uint16_t crc_active = 0xFFFF;
+
+    for (int r = 0; r < CONFIG_CRC_BENCH_ROUNDS; ++r) {
+        crc_active = crc16_reflect(CRC16_MODBUS_POLY, crc_active, bench_buffer,
+            sizeof(bench_buffer));
+    }
+
+    bench_report("crc16_reflect", cycle_counter_get() - start, crc_active);
+
+    printf("BENCH: crc16_reflect slices: %d, results %s\r\n", CONFIG_CRC16_REFLECT_SLICES,
+        (crc_bitwise == crc_table && crc_table == crc_active) ? "match" : "MISMATCH");
+
+    /* Вариант таблицы CRC32 выбирается при сборке, для сравнения вариантов
+     * прошивка собирается с разными CONFIG_CRC32_IEEE_SLICES */
+    start = cycle_counter_get();
+    uint32_t crc32_sw = 0;
+
+    for (int r = 0; r < CONFIG_CRC_BENCH_ROUNDS; ++r) {
+        crc32_sw = crc32_ieee_update_sw(crc32_sw, bench_buffer, sizeof(bench_buffer));
+    }
+
+    bench_report("crc32 sw", cycle_counter_get() - start, crc32_sw);
+
+    /* crc32_ieee_update() использует CRC-блок MCU, если он выбран для платы */
+    start = cycle_counter_get();
+    uint32_t crc32_active = 0;
+
+    for (int r = 0; r < CONFIG_CRC_BENCH_ROUNDS; ++r) {
+        crc32_active = crc32_ieee_update(crc32_active, bench_buffer, sizeof(bench_buffer));
+    }
+
+    bench_report("crc32_ieee_update", cycle_counter_get() - start, crc32_active);
+
+    printf("BENCH: crc32 slices: %d, results %s\r\n", CONFIG_CRC32_IEEE_SLICES,
+        (crc32_sw == crc32_active) ? "match" : "MISMATCH");
+}
@@ -1,8 +1,8 @@
 #include <string.h>
 
 #include "dfu_host.h"
+#include "dfu_host_transport.h"
 #include "core/assert.h"
-#include "core/critical_section.h"
 
 /************************* LOG SETTINGS ****************************/
 
@@ -21,23 +21,58 @@
 #pragma GCC diagnostic ignored "-Wimplicit-fallthrough"
 #endif /* __GNUC__ */
 
-/* Размер приемного буфера в байтах */
-#define CONFIG_DFU_HOST_RX_BUFFER_SIZE     256
-/* Тайимаут ожидания прихода ответа от устройства в милисекундах */
+/* Тайимаут ожидания прихода ответа от устройства в милисекундах: до первого
+ * замера задержки ответа и верхняя граница адаптивного таймаута */
 #define CONFIG_DFU_HOST_RECEIVE_TIMEOUT_MS 1000
 
+/* Нижняя граница адаптивного таймаута ответа, мс */
+#ifndef CONFIG_DFU_HOST_RTO_MIN_MS
+#define CONFIG_DFU_HOST_RTO_MIN_MS 5
+#endif /* CONFIG_DFU_HOST_RTO_MIN_MS */
+
+/* Максимальное количество удвоений адаптивного таймаута после таймаутов подряд */
+#define DFU_HOST_RTO_BACKOFF_MAX 8
+
+/* Бит на байт на линии USART загрузчика (8E1) */
+#define DFU_HOST_UART_FRAME_BITS 11
+
+/* Повторов блока dfu_host_read_range() после ошибки приема на линии */
+#ifndef CONFIG_DFU_HOST_LINE_RETRIES
+#define CONFIG_DFU_HOST_LINE_RETRIES 3
+#endif /* CONFIG_DFU_HOST_LINE_RETRIES */
+
+/* Ожидание окончания стирания одного сектора (RM0090: до 2 с на 128 КБ) */
+#ifndef CONFIG_DFU_HOST_SECTOR_ERASE_TIMEOUT_MS
+#define CONFIG_DFU_HOST_SECTOR_ERASE_TIMEOUT_MS 4000
+#endif /* CONFIG_DFU_HOST_SECTOR_ERASE_TIMEOUT_MS */
+
+/* Ожидание окончания стирания всей Flash (RM0090: до 32 с на 1 МБ) */
+#ifndef CONFIG_DFU_HOST_MASS_ERASE_TIMEOUT_MS
+#define CONFIG_DFU_HOST_MASS_ERASE_TIMEOUT_MS 40000
+#endif /* CONFIG_DFU_HOST_MASS_ERASE_TIMEOUT_MS */
+
+/* Ожидание ответа на байт-заполнитель при восстановлении синхронизации */
+#ifndef CONFIG_DFU_HOST_RESYNC_BYTE_TIMEOUT_MS
+#define CONFIG_DFU_HOST_RESYNC_BYTE_TIMEOUT_MS 5
+#endif /* CONFIG_DFU_HOST_RESYNC_BYTE_TIMEOUT_MS */
+
+/* Байт-заполнитель: в любом кадре дает неверную контрольную сумму, а в данных
+ * WRITE_MEM не меняет Flash */
+#define DFU_HOST_RESYNC_FILL 0xFF
+
+
 /**
  * @brief  Перечисление идентификаторов команд протокола USART bootloader в
  * соответствии с (AN3155).
  */
 typedef enum {
-    DFU_HOST_CMD_ID_PING              = 0x7F,
     DFU_HOST_CMD_ID_GET               = 0x00,
     DFU_HOST_CMD_ID_GET_VERSION       = 0x01,
     DFU_HOST_CMD_ID_GET_ID            = 0x02,
     DFU_HOST_CMD_ID_READ_MEM          = 0x11,
     DFU_HOST_CMD_ID_GO                = 0x21,
     DFU_HOST_CMD_ID_WRITE_MEM         = 0x31,
+    DFU_HOST_CMD_ID_ERASE             = 0x43,
     DFU_HOST_CMD_ID_WRITE_EXT_ERASE   = 0x44,
     DFU_HOST_CMD_ID_WRITE_PROTECT     = 0x63,
     DFU_HOST_CMD_ID_WRITE_UNPROTECT   = 0x73,
@@ -46,35 +81,32 @@ typedef enum {
 } cmd_id_t;
 
 /**
- * @brief  Перечисление возможных ответов бутлоадера по USART.
+ * @brief  Шаги транзакции, каждый - одна операция транспорта.
  */
 typedef enum {
-    DFU_HOST_RESP_ACK  = 0x79,
-    DFU_HOST_RESP_NACK = 0x1F,
-} resp_value_t;
-
-static UART_HandleTypeDef* huart = NULL;
-
-static uint8_t rcv_buffer[256] = { 0 }; /* Приемный буфер UART */
-static size_t  rcv_count       = 0;     /* Текущее количество принятых байт */
-
-static volatile bool rcv_cplt  = false; /* Флаг окончания приема данных */
-static volatile int  rcv_err   = 0;     /* Последняя ошибка при приеме данных */
+    STEP_SYNC,        /* Синхронизация с загрузчиком                 */
+    STEP_SEND_CMD,    /* Отправка кадра команды                      */
+    STEP_SEND,        /* Отправка кадра данных                       */
+    STEP_ACK,         /* Ожидание ACK на отправленный кадр           */
+    STEP_RECV_EXACT,  /* Прием ответа известной длины в host->xfer.rx      */
+    STEP_RECV,        /* Прием ответа до ACK в host->xfer.rx               */
+    STEP_RECV_SIZED,  /* Прием ответа с байтом длины N и ACK в host->xfer.rx */
+} step_type_t;
 
-/* Отправить произвольную последовательность данных и дождаться подтверждения */
-static int send_data(const uint8_t* buffer, size_t size, uint32_t ack_timeout);
 
-/* Отправить команду и дождаться подтверждения за отведенный таймаут и дождаться подтверждения */
-static int send_command(cmd_id_t cmd, uint32_t ack_timeout);
+/* Команды, для шагов которых ведется оценка задержки ответа */
+static const uint8_t rtt_cmds[] = {
+    DFU_HOST_CMD_ID_GET, DFU_HOST_CMD_ID_GET_VERSION, DFU_HOST_CMD_ID_GET_ID,
+    DFU_HOST_CMD_ID_READ_MEM, DFU_HOST_CMD_ID_GO, DFU_HOST_CMD_ID_WRITE_MEM,
+    DFU_HOST_CMD_ID_ERASE, DFU_HOST_CMD_ID_WRITE_EXT_ERASE,
+    DFU_HOST_CMD_ID_WRITE_PROTECT, DFU_HOST_CMD_ID_WRITE_UNPROTECT,
+    DFU_HOST_CMD_ID_READOUT_PROTECT, DFU_HOST_CMD_ID_READOUT_UNPROTECT,
+};
 
-/* Принимать данные до тех пор пока не придет ACK/NACK за отведенный таймаут */
-static ssize_t recv(uint32_t timeout);
+/* Размер dfu_host_t::rtt_table задан в заголовке */
+BUILD_ASSERT(ARRAY_SIZE(rtt_cmds) == DFU_HOST_RTT_CMDS);
 
-/* Принимать до тех пор пока не будут получены все данные за отведенный таймаут */
-static ssize_t recv_fixed(size_t len, uint32_t timeout);
 
-/* Коллбэк завершения приема данных */
-static void rcv_complete_cb(UART_HandleTypeDef* handle);
 
 /* Расчет XOR8 для заданной последовательности байт */
 static inline uint8_t calc_xor8(const uint8_t *data, size_t len)
@@ -87,424 +119,1295 @@ static inline uint8_t calc_xor8(const uint8_t *data, size_t len)
     return result;
 }
 
-/* Начать прием следующего байта по UART */
-static inline int start_rcv_next_byte(void)
+/* Взять следующий приемный буфер, дождавшись, пока пользователь его освободит */
+static inline uint8_t* rx_buffer_acquire(dfu_host_t* host)
 {
-    if (rcv_count == ARRAY_SIZE(rcv_buffer)) {
-        return DFU_HOST_ERR_OVERFLOW;
+    if (host->rx_wait_cb != NULL) {
+        host->rx_wait_cb(host->rx_wait_ctx);
     }
-    
-    if(HAL_UART_Receive_IT(huart, rcv_buffer + rcv_count, 1) != HAL_OK) {
-        return DFU_HOST_ERR_EIO;
+
+    host->rcv_index = (host->rcv_index + 1) % ARRAY_SIZE(host->rcv_buffer);
+
+    return host->rcv_buffer[host->rcv_index];
+}
+
+/********************** Построение транзакции **********************/
+
+/* Начать построение транзакции для операции req */
+static int xfer_begin(dfu_host_t* host, dfu_host_req_t* req, dfu_host_finish_t finish)
+{
+    CHECK(host     != NULL, return DFU_HOST_ERR_EINVAL);
+    CHECK(host->tp != NULL, return DFU_HOST_ERR_EINVAL);
+    CHECK(req      != NULL, return DFU_HOST_ERR_EINVAL);
+
+    if (host->xfer.req != NULL) {
+        return DFU_HOST_ERR_BUSY;
     }
-    
+
+    host->xfer.finish  = finish;
+    host->xfer.count   = 0;
+    host->xfer.tx_len  = 0;
+    host->xfer.rx_user = NULL;
+    host->xfer.rtt     = NULL;
+
+    req->host    = host;
+    req->rc      = 0;
+    req->data    = NULL;
+    req->len     = 0;
+    req->version = 0;
+
     return DFU_HOST_ERR_NONE;
 }
 
-static int send_data(const uint8_t* buffer, size_t size, uint32_t rx_timeout_ms)
+/* Добавить шаг; для шагов отправки резервирует в буфере кадр длиной len */
+static uint8_t* xfer_add(dfu_host_t* host, step_type_t type, size_t len)
 {
-    CHECK(buffer        != NULL, return DFU_HOST_ERR_EINVAL);
-    CHECK(size          != 0,    return DFU_HOST_ERR_EINVAL);
-    CHECK(rx_timeout_ms > 0,     return DFU_HOST_ERR_EINVAL);
-    
-    int rc = 0;
-    
-    //LOG_HEX_ARRAY_DBG("> ", buffer, sz);
-    
-    /* Отправить команду бутлоадеру */
-    HAL_StatusTypeDef result = HAL_UART_Transmit(huart, buffer, size, HAL_MAX_DELAY);
-    
-    if (result != HAL_OK) {
-        LOG_ERROR("Send error: %d", result);
-        return DFU_HOST_ERR_EIO;
-    }
-    
-    /* Ожидаем получить ACK или NACK за отведенное время */
-    rc = recv_fixed(1, rx_timeout_ms);
-    
-    if (rc < 0) {
-        return rc;
+    ASSERT_NO_MSG(host->xfer.count < ARRAY_SIZE(host->xfer.steps));
+
+    dfu_host_step_t* step = &host->xfer.steps[host->xfer.count++];
+
+    step->type    = type;
+    step->offset  = host->xfer.tx_len;
+    step->len     = len;
+    step->timeout = 0;
+
+    if (type != STEP_SEND_CMD && type != STEP_SEND) {
+        return NULL;
     }
-    
-    //LOG_HEX_ARRAY_DBG("< ", rcv_buffer, rc);
-    
-    /* Проверить ответ */
-    switch (*rcv_buffer) {
-    case DFU_HOST_RESP_ACK:
-        rc = DFU_HOST_ERR_NONE;
-        break;
-        
-    case DFU_HOST_RESP_NACK:
-        rc = DFU_HOST_ERR_NACK;
-        break;
-        
-    default: 
-        rc = DFU_HOST_ERR_WRONG_ANS;
-        break;
+
+    ASSERT_NO_MSG(host->xfer.tx_len + len <= ARRAY_SIZE(host->xfer.tx_buffer));
+
+    host->xfer.tx_len += len;
+
+    return host->xfer.tx_buffer + step->offset;
+}
+
+/* Отправить команду и дождаться подтверждения */
+static void xfer_command(dfu_host_t* host, cmd_id_t cmd)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(rtt_cmds); ++i) {
+        if (rtt_cmds[i] == cmd) {
+            host->xfer.rtt = host->rtt_table[i];
+        }
     }
-    
-    return rc;
+
+    uint8_t* frame = xfer_add(host, STEP_SEND_CMD, 2);
+
+    frame[0] = cmd;
+    frame[1] = 0xFF ^ cmd;
+
+    xfer_add(host, STEP_ACK, 0);
+}
+
+/* Отправить кадр данных длиной len и дождаться подтверждения; кадр заполняет вызывающий */
+static uint8_t* xfer_frame(dfu_host_t* host, size_t len)
+{
+    uint8_t* frame = xfer_add(host, STEP_SEND, len);
+
+    xfer_add(host, STEP_ACK, 0);
+
+    return frame;
 }
 
-static int send_command(cmd_id_t cmd, uint32_t ack_timeout)
+/* Задать таймаут последнего добавленного шага: ответ на него приходит после
+ * длительной операции устройства */
+static inline void xfer_last_timeout(dfu_host_t* host, uint32_t timeout)
 {
-    uint8_t buffer[2] = { cmd, 0xFF ^ cmd };
-    return send_data(buffer, ARRAY_SIZE(buffer), ack_timeout);
+    host->xfer.steps[host->xfer.count - 1].timeout = timeout;
 }
 
-static ssize_t recv_fixed(size_t len, uint32_t timeout)
+/* Отправить адрес с контрольной суммой и дождаться подтверждения */
+static void xfer_address(dfu_host_t* host, uint32_t address)
 {
-    ASSERT_NO_MSG(len <= ARRAY_SIZE(rcv_buffer));
-    ASSERT_NO_MSG(timeout > 0);
-    
-    if (HAL_UART_Receive(huart, rcv_buffer, len, timeout) != HAL_OK) {
-        return DFU_HOST_ERR_EIO;
+    uint8_t* frame = xfer_frame(host, 5);
+
+    frame[0] = address >> 24;
+    frame[1] = address >> 16;
+    frame[2] = address >> 8;
+    frame[3] = address;
+    frame[4] = calc_xor8(frame, 4);
+}
+
+/******************** Адаптивные таймауты ответа ********************/
+
+/* Время передачи len байт ответа по USART в мс с округлением вверх;
+ * для шин без скорости линии - 0, задержка учитывается в оценке */
+static uint32_t wire_time_ms(dfu_host_t* host, size_t len)
+{
+    const uint32_t baudrate = (host->tp->get_baudrate != NULL) ? host->tp->get_baudrate(host->tp->ctx) : 0;
+
+    if (baudrate == 0) {
+        return 0;
     }
-    
-    return len;
+
+    return ((uint64_t)len * DFU_HOST_UART_FRAME_BITS * 1000U + baudrate - 1) / baudrate;
 }
 
-static ssize_t recv(uint32_t timeout)
+/* Наибольшая длина ответа шага приема с завершающим ACK */
+static size_t step_reply_len(const dfu_host_step_t* step)
 {
-    ASSERT_NO_MSG(timeout > 0);
-    
-    HAL_UART_RegisterCallback(huart, HAL_UART_RX_COMPLETE_CB_ID, rcv_complete_cb);
-    // HAL_UART_RegisterCallback(huart, HAL_UART_ERROR_CB_ID, /* TODO */);
-    
-    rcv_count  = 0;
-    rcv_cplt   = false;
-    
-    /* Начать цепочку приема данных */
-    int rc = start_rcv_next_byte();
-    
-    if (rc < 0) {
-        return rc;
+    switch (step->type) {
+    case STEP_ACK:        return 1;
+    case STEP_RECV_EXACT: return step->len;
+    case STEP_RECV:
+    case STEP_RECV_SIZED: return DFU_HOST_RX_BUFFER_SIZE + 1;
+    default:              return 0;
     }
-    
-    uint32_t end_tp = HAL_GetTick() + timeout;
-    
-    /* Дождаться окончания приема ответного сообщения за отведенное время */
-    while (rcv_cplt == false) {
-        if(HAL_GetTick() >= end_tp) {
-            HAL_UART_AbortReceive_IT(huart);
-            return DFU_HOST_ERR_TIMEOUT;
-        }
+}
+
+/* Оценка текущего шага или NULL, если таймаут шага не адаптивный */
+static dfu_host_rtt_t* step_rtt(dfu_host_t* host)
+{
+    const dfu_host_step_t* step = &host->xfer.steps[host->xfer.index];
+
+    if (host->xfer.rtt == NULL || step->timeout != 0 || step_reply_len(step) == 0) {
+        return NULL;
+    }
+
+    return &host->xfer.rtt[host->xfer.index];
+}
+
+/* Таймаут шага: время передачи ответа + SRTT + 4 * RTTVAR, удвоенный после
+ * каждого таймаута подряд */
+static uint32_t rtt_timeout(dfu_host_t* host, const dfu_host_rtt_t* rtt, const dfu_host_step_t* step)
+{
+    if (!rtt->valid) {
+        return CONFIG_DFU_HOST_RECEIVE_TIMEOUT_MS;
+    }
+
+    /* Погрешность отсчета HAL_GetTick() - 1 мс */
+    uint32_t rto = (rtt->srtt >> 3) + MAX(rtt->rttvar, 1U);
+
+    rto = MAX(rto + wire_time_ms(host, step_reply_len(step)), CONFIG_DFU_HOST_RTO_MIN_MS);
+    rto <<= rtt->backoff;
+
+    return MIN(rto, CONFIG_DFU_HOST_RECEIVE_TIMEOUT_MS);
+}
+
+/* Учесть замер задержки ответа: elapsed - время шага, len - принято байт */
+static void rtt_sample(dfu_host_t* host, dfu_host_rtt_t* rtt, uint32_t elapsed, size_t len)
+{
+    const uint32_t wire = wire_time_ms(host, len);
+    int32_t r = (elapsed > wire) ? (int32_t)MIN(elapsed - wire, CONFIG_DFU_HOST_RECEIVE_TIMEOUT_MS) : 0;
+
+    rtt->backoff = 0;
+
+    if (!rtt->valid) {
+        rtt->srtt   = r << 3;
+        rtt->rttvar = r << 1;
+        rtt->valid  = true;
+        return;
     }
-    
-    /* Если во время приема возникла ошибка - вернуть ее */
-    if (rcv_err != 0) {
-        return rcv_err;
+
+    /* SRTT += (R - SRTT) / 8, RTTVAR += (|R - SRTT| - RTTVAR) / 4 */
+    int32_t err = r - (rtt->srtt >> 3);
+
+    rtt->srtt = (int32_t)rtt->srtt + err;
+
+    if (err < 0) {
+        err = -err;
     }
-    
-    // LOG_HEX_ARRAY_DBG("Recv:", rcv_buffer, rcv_count);
-    
-    /* Сообщение принято нормально - вернуть фактическое количество принятых байт */
-    return rcv_count;
+
+    rtt->rttvar = (int32_t)rtt->rttvar + err - (rtt->rttvar >> 2);
 }
 
-static void rcv_complete_cb(UART_HandleTypeDef* handle)
+/*********************** Исполнение транзакции **********************/
+
+/* Окончание операции транспорта, может вызываться из прерывания */
+static void step_done_cb(void* arg, int rc)
+{
+    dfu_host_t* host = arg;
+
+    host->xfer.step_rc   = rc;
+    host->xfer.step_done = true;
+}
+
+/* Запустить текущий шаг. Блокирующие функции транспорта выполняются здесь же */
+static void step_start(dfu_host_t* host)
 {
-    uint8_t data = *(rcv_buffer + rcv_count);
+    const dfu_host_step_t* step = &host->xfer.steps[host->xfer.index];
+    const uint8_t* frame = host->xfer.tx_buffer + step->offset;
+    void* ctx = host->tp->ctx;
     int rc = 0;
-    
-    switch (data) {
-        
-    /* В ответ пришел NACK - остановить прием с ошибкой */
-    case DFU_HOST_RESP_NACK:
-        rcv_err  = DFU_HOST_ERR_NACK;
-    
-    /* В ответ пришел ACK - остановить прием */
-    case DFU_HOST_RESP_ACK:	
-        rcv_cplt = true;
+
+    const dfu_host_rtt_t* rtt = step_rtt(host);
+
+    host->xfer.step_done = false;
+    host->xfer.timeout   = (step->type == STEP_SYNC) ? host->xfer.sync_timeout :
+                     (step->timeout != 0)       ? step->timeout :
+                     (rtt != NULL)              ? rtt_timeout(host, rtt, step) : CONFIG_DFU_HOST_RECEIVE_TIMEOUT_MS;
+    host->xfer.started   = false;
+
+    /* Время нужно только для замера задержки ответа */
+    if (rtt != NULL) {
+        host->xfer.step_tick = HAL_GetTick();
+    }
+
+    //LOG_HEX_ARRAY_DBG("> ", frame, step->len);
+
+    switch (step->type) {
+    case STEP_SYNC:
+        if (host->tp->sync_async != NULL) {
+            rc = host->tp->sync_async(ctx, step_done_cb, host);
+        } else {
+            step_done_cb(host, host->tp->sync(ctx, host->xfer.timeout));
+        }
         break;
-        
-    default:
-        
-        rcv_count += 1;
-        
-        /* Продолжить прием данных */
-        rc = start_rcv_next_byte();
-        if(rc < 0) {
-            rcv_err  = rc;
-            rcv_cplt = true;
+
+    case STEP_SEND_CMD:
+    case STEP_SEND: {
+        const bool cmd = step->type == STEP_SEND_CMD;
+
+        if (host->tp->send_async != NULL) {
+            rc = host->tp->send_async(ctx, frame, step->len, cmd, step_done_cb, host);
+        } else {
+            step_done_cb(host, host->tp->send(ctx, frame, step->len, cmd));
         }
-        
         break;
     }
-}
 
-////////
+    case STEP_ACK:
+        if (host->tp->recv_until_ack_async != NULL) {
+            rc = host->tp->recv_until_ack_async(ctx, NULL, 0, step_done_cb, host);
+        } else {
+            step_done_cb(host, host->tp->recv_until_ack(ctx, NULL, 0, host->xfer.timeout));
+        }
+        break;
 
-int dfu_host_init(UART_HandleTypeDef* handle)
-{
-    ASSERT_NO_MSG(handle != NULL);
-    
-    huart = handle;	
-    
-    return 0;
+    case STEP_RECV_EXACT:
+        /* Данные принимаются сразу на место, если пользователь дал буфер */
+        host->xfer.rx = (host->xfer.rx_user != NULL) ? host->xfer.rx_user : rx_buffer_acquire(host);
+
+        if (host->tp->recv_exact_async != NULL) {
+            rc = host->tp->recv_exact_async(ctx, host->xfer.rx, step->len, step_done_cb, host);
+        } else {
+            step_done_cb(host, host->tp->recv_exact(ctx, host->xfer.rx, step->len, host->xfer.timeout));
+        }
+        break;
+
+    case STEP_RECV:
+        host->xfer.rx = rx_buffer_acquire(host);
+
+        if (host->tp->recv_until_ack_async != NULL) {
+            rc = host->tp->recv_until_ack_async(ctx, host->xfer.rx, DFU_HOST_RX_BUFFER_SIZE,
+                step_done_cb, host);
+        } else {
+            step_done_cb(host, host->tp->recv_until_ack(ctx, host->xfer.rx, DFU_HOST_RX_BUFFER_SIZE,
+                host->xfer.timeout));
+        }
+        break;
+
+    case STEP_RECV_SIZED:
+        host->xfer.rx = rx_buffer_acquire(host);
+
+        if (host->tp->recv_sized_async != NULL) {
+            rc = host->tp->recv_sized_async(ctx, host->xfer.rx, DFU_HOST_RX_BUFFER_SIZE,
+                step_done_cb, host);
+        } else {
+            step_done_cb(host, host->tp->recv_sized(ctx, host->xfer.rx, DFU_HOST_RX_BUFFER_SIZE,
+                host->xfer.timeout));
+        }
+        break;
+    }
+
+    if (rc < 0) {
+        step_done_cb(host, rc);
+    }
 }
 
-int dfu_host_ping(uint32_t timeout)
+/* Завершить транзакцию и сообщить результат пользователю */
+static void xfer_complete(dfu_host_t* host, int rc)
 {
-    CHECK(timeout > 0, return DFU_HOST_ERR_EINVAL);
-    
-    uint8_t data = DFU_HOST_CMD_ID_PING;
-    return send_data(&data, sizeof(data), timeout);
+    dfu_host_req_t* req = host->xfer.req;
+
+    if (rc >= 0 && host->xfer.finish != NULL) {
+        rc = host->xfer.finish(host, req, rc);
+    }
+
+    req->rc  = rc;
+    host->xfer.req = NULL;
+
+    if (req->cb != NULL) {
+        req->cb(req);
+    }
 }
 
-int dfu_host_get_version(void)
+/* Обработать результат завершенного шага и перейти к следующему */
+static void step_next(dfu_host_t* host)
 {
-    int rc = 0;
-    
-    /* Отправка команды 01 FE */
-    rc = send_command(DFU_HOST_CMD_ID_GET_VERSION, CONFIG_DFU_HOST_RECEIVE_TIMEOUT_MS);
-    if (rc < 0) {
-        return rc;
+    const step_type_t type = host->xfer.steps[host->xfer.index].type;
+    int rc = host->xfer.step_rc;
+
+    /* Вместо ACK/NACK пришли данные */
+    if ((type == STEP_ACK || type == STEP_SYNC) && (rc > 0 || rc == DFU_HOST_ERR_OVERFLOW)) {
+        rc = DFU_HOST_ERR_WRONG_ANS;
     }
-    
-    /* Принять данные */
-    rc = recv(CONFIG_DFU_HOST_RECEIVE_TIMEOUT_MS);
-    if(rc < 0) {
-        return rc;
+
+    if ((type == STEP_SEND_CMD || type == STEP_SEND) && rc < 0) {
+        LOG_ERROR("Send error: %d", rc);
     }
-    
-    /* Длина ответа известна заранее */
-    if (rc != 3) {
-        return DFU_HOST_ERR_WRONG_ANS;
+
+    /* Замер задержки - только по принятому ответу: после NACK загрузчик
+     * мог ответить раньше, чем закончил бы команду */
+    dfu_host_rtt_t* rtt = step_rtt(host);
+
+    if (rtt != NULL && rc >= 0) {
+        rtt_sample(host, rtt, HAL_GetTick() - host->xfer.step_tick,
+            (type == STEP_RECV || type == STEP_RECV_SIZED) ?
+                (size_t)rc + 1 : step_reply_len(&host->xfer.steps[host->xfer.index]));
     }
 
-    return bcd2bin(*rcv_buffer);
+    if (rc < 0 || ++host->xfer.index == host->xfer.count) {
+        xfer_complete(host, rc);
+        return;
+    }
+
+    step_start(host);
 }
 
-int dfu_host_get_id(const uint8_t** id, size_t* id_len)
+/* Обработать завершенные шаги. Шаги с блокирующим транспортом завершаются
+ * сразу при запуске, поэтому цепочка может пройти до конца транзакции */
+static void xfer_advance(dfu_host_t* host)
 {
-    CHECK(id     != NULL, return DFU_HOST_ERR_EINVAL);
-    CHECK(id_len != NULL, return DFU_HOST_ERR_EINVAL);
-    
-    int rc = 0;
-    
-    /* Отправка команды 02 FD */
-    rc = send_command(DFU_HOST_CMD_ID_GET_ID, CONFIG_DFU_HOST_RECEIVE_TIMEOUT_MS);
-    if (rc < 0) {
-        return rc;
-    }
-    
-    /* Принять данные */
-    rc = recv(CONFIG_DFU_HOST_RECEIVE_TIMEOUT_MS);
-    if (rc < 0) {
-        return rc;
+    if (host->tp->poll != NULL) {
+        host->tp->poll(host->tp->ctx);
     }
-    
-    if (rc == 0) {
-        return DFU_HOST_ERR_WRONG_ANS;
+
+    while (host->xfer.req != NULL && host->xfer.step_done) {
+        step_next(host);
     }
-    
-    *id     = rcv_buffer + 1;
-    *id_len = rc - 1;
-    
+}
+
+/* Запустить построенную транзакцию */
+static int xfer_start(dfu_host_t* host, dfu_host_req_t* req)
+{
+    host->xfer.req   = req;
+    host->xfer.index = 0;
+
+    step_start(host);
+
     return DFU_HOST_ERR_NONE;
 }
 
-int dfu_host_read_memory(uint32_t address, const uint8_t** result, size_t len)
+/* Выполнить операцию синхронно: rc - результат ее запуска */
+static int xfer_run(dfu_host_t* host, int rc, dfu_host_req_t* req)
 {
-    CHECK(result != NULL, return DFU_HOST_ERR_EINVAL);
-    CHECK(len    != 0,    return DFU_HOST_ERR_EINVAL);
-    CHECK(len <= sizeof(rcv_buffer), return DFU_HOST_ERR_EINVAL);
+    return (rc < 0) ? rc : dfu_host_wait(host, req);
+}
 
-    int rc = 0;
-    
-    /* Отправка команды 11 EE */
-    rc = send_command(DFU_HOST_CMD_ID_READ_MEM, CONFIG_DFU_HOST_RECEIVE_TIMEOUT_MS);
-    if (rc < 0) {
-        return rc;
-    }
-    
-    uint8_t buff[5] = { 0 };
-    
-    buff[0] = address >> 24;
-    buff[1] = address >> 16;
-    buff[2] = address >> 8;
-    buff[3] = address;
-    buff[4] = calc_xor8(buff, 4);
-    
-    /* Отправить начальный адрес чтения памяти */
-    rc = send_data(buff, 5, CONFIG_DFU_HOST_RECEIVE_TIMEOUT_MS);
-    if(rc < 0) {
-        return rc;
+////////
+
+int dfu_host_init(dfu_host_t* host, UART_HandleTypeDef* handle)
+{
+    ASSERT_NO_MSG(host   != NULL);
+    ASSERT_NO_MSG(handle != NULL);
+
+    return dfu_host_init_transport(host, dfu_host_transport_uart(handle));
+}
+
+int dfu_host_init_transport(dfu_host_t* host, const dfu_host_transport_t* transport)
+{
+    ASSERT_NO_MSG(host != NULL);
+
+    /* Свободных портов транспорта может не остаться */
+    CHECK(transport != NULL, return DFU_HOST_ERR_EINVAL);
+
+    /* Задержки ответа и набор команд на другом транспорте другие */
+    memset(host, 0, sizeof(*host));
+
+    host->tp = transport;
+
+    LOG_DBG("Transport: %s", host->tp->name);
+
+    return 0;
+}
+
+const dfu_host_transport_t* dfu_host_get_transport(const dfu_host_t* host)
+{
+    return host->tp;
+}
+
+int dfu_host_set_baudrate(dfu_host_t* host, uint32_t baudrate)
+{
+    CHECK(host->tp != NULL, return DFU_HOST_ERR_EINVAL);
+    CHECK(baudrate != 0,    return DFU_HOST_ERR_EINVAL);
+
+    if (host->tp->set_baudrate == NULL) {
+        return DFU_HOST_ERR_EINVAL;
     }
-    
-    buff[0] = len - 1;
-    buff[1] = 0xFF ^ buff[0];
-    
-    /* Отправить количество считываемых байт */
-    rc = send_data(buff, 2, CONFIG_DFU_HOST_RECEIVE_TIMEOUT_MS);
-    if (rc < 0) {
-        return rc;
+
+    if (host->xfer.req != NULL) {
+        return DFU_HOST_ERR_BUSY;
     }
-    
-    /* Принять содержимое памяти по заданному адресу */
-    rc = recv_fixed(len, CONFIG_DFU_HOST_RECEIVE_TIMEOUT_MS);
-    
-    if(rc < 0) {
-        return rc;
+
+    int rc = host->tp->set_baudrate(host->tp->ctx, baudrate);
+
+    if (rc == 0) {
+        LOG_DBG("Baudrate: %lu", baudrate);
     }
-    
-    *result = rcv_buffer;
-    
+
     return rc;
 }
 
-int dfu_host_write_memory(uint32_t address, const uint8_t* data, size_t len)
+uint32_t dfu_host_get_baudrate(dfu_host_t* host)
 {
-    CHECK(data != NULL, return DFU_HOST_ERR_EINVAL);
-    CHECK(len  != 0,    return DFU_HOST_ERR_EINVAL);
-    CHECK(len  <= 256,  return DFU_HOST_ERR_EINVAL);
-    
-    int rc = 0;
-    
-    /* Отправка команды 31 СE */
-    rc = send_command(DFU_HOST_CMD_ID_WRITE_MEM, CONFIG_DFU_HOST_RECEIVE_TIMEOUT_MS);
-    if(rc < 0) {
-        return rc;
-    }
-    
-    uint8_t buff[5] = { 0 };
-    
-    buff[0] = address >> 24;
-    buff[1] = address >> 16;
-    buff[2] = address >> 8;
-    buff[3] = address;
-    buff[4] = calc_xor8(buff, 4);
-    
-    /* Отправить начальный адрес записи данных */
-    rc = send_data(buff, 5, CONFIG_DFU_HOST_RECEIVE_TIMEOUT_MS);
-    if (rc < 0) {
-        return rc;
+    if (host->tp == NULL || host->tp->get_baudrate == NULL) {
+        return 0;
     }
-    
-    uint8_t buf[256 + 1];
-    
-    buf[0] = len - 1;
-    memcpy(buf + 1, data, len);
-    buf[len + 1] = calc_xor8(buf, len + 1);
-    
-    /* Отправить блок данных для записи в память устройства */
-    rc = send_data(buf, len + 2, CONFIG_DFU_HOST_RECEIVE_TIMEOUT_MS);
-    if(rc < 0) {
-        return rc;
-    }
-    
-    return len;
+
+    return host->tp->get_baudrate(host->tp->ctx);
 }
 
-int dfu_host_go(uint32_t address)
-{			
-    /* Отправка команды 21 DE */
-    int rc = send_command(DFU_HOST_CMD_ID_GO, CONFIG_DFU_HOST_RECEIVE_TIMEOUT_MS);
-    if (rc < 0) {
-        return rc;
+int dfu_host_get_link_stats(dfu_host_t* host, dfu_host_link_stats_t* stats)
+{
+    CHECK(stats != NULL, return DFU_HOST_ERR_EINVAL);
+
+    if (host->tp == NULL || host->tp->link_stats == NULL) {
+        return DFU_HOST_ERR_EINVAL;
     }
-    
-    uint8_t buff[5] = { 0 };
-    
-    buff[0] = address >> 24;
-    buff[1] = address >> 16;
-    buff[2] = address >> 8;
-    buff[3] = address;
-    buff[4] = calc_xor8(buff, 4);
-    
-    /* Отправить адрес исполнения программы */
-    return send_data(buff, 5, CONFIG_DFU_HOST_RECEIVE_TIMEOUT_MS);
+
+    *stats = *host->tp->link_stats(host->tp->ctx);
+
+    return DFU_HOST_ERR_NONE;
 }
 
-int dfu_host_erase_all(void)
+void dfu_host_set_rx_wait_cb(dfu_host_t* host, dfu_host_rx_wait_cb_t cb, void* ctx)
 {
-	/* Отправка команды 44 BB */
-	int rc = send_command(DFU_HOST_CMD_ID_WRITE_EXT_ERASE, CONFIG_DFU_HOST_RECEIVE_TIMEOUT_MS);
-	if (rc < 0) {
-		return rc;
-	}
-	
-	uint8_t buf[3] = { 0 };
-	
-	buf[0] = 0xFF;
-	buf[1] = 0xFF;
-	buf[2] = calc_xor8(buf, 2);
-	
-	/* Отправить спец значение для стирания всей внутренней Flash */
-	return send_data(buf, ARRAY_SIZE(buf), CONFIG_DFU_HOST_RECEIVE_TIMEOUT_MS);
+    host->rx_wait_cb  = cb;
+    host->rx_wait_ctx = ctx;
 }
 
-int dfu_host_write_protect_sectors(const uint8_t* sectors, size_t count)
+void dfu_host_poll(dfu_host_t* host)
 {
-	CHECK(sectors != NULL, return DFU_HOST_ERR_EINVAL);
-	CHECK(count   != 0,    return DFU_HOST_ERR_EINVAL);
-	
-	int rc = 0;
-	
-	/* Отправка команды 63 9C */
-	rc = send_command(DFU_HOST_CMD_ID_WRITE_PROTECT, CONFIG_DFU_HOST_RECEIVE_TIMEOUT_MS);
-	if(rc < 0) {
-		return rc;
-	}
-	
-	uint8_t buf[count + 2];
-	
-	buf[0] = count - 1;
-	memcpy(buf + 1, sectors, count);
-	buf[count + 1] = calc_xor8(buf, count + 1);
-	
-	/* Отправить номера секторов для установки защиты на запись */
-	return send_data(buf, count + 2, CONFIG_DFU_HOST_RECEIVE_TIMEOUT_MS);
+    if (host->xfer.req == NULL) {
+        return;
+    }
+
+    xfer_advance(host);
+
+    /* Время читается после шагов: блокирующий транспорт сам опрашивает
+     * HAL_GetTick(). Завершения, пришедшие за это время, обрабатываются сразу */
+    const uint32_t now = HAL_GetTick();
+
+    xfer_advance(host);
+
+    if (host->xfer.req == NULL) {
+        return;
+    }
+
+    /* Таймаут шага отсчитывается от первого опроса после его запуска */
+    if (!host->xfer.started) {
+        host->xfer.start   = now;
+        host->xfer.started = true;
+        return;
+    }
+
+    if (now - host->xfer.start >= host->xfer.timeout) {
+        if (host->tp->abort != NULL) {
+            host->tp->abort(host->tp->ctx);
+        }
+
+        /* Ответ задерживается сильнее оценки - удвоить таймаут шага */
+        dfu_host_rtt_t* rtt = step_rtt(host);
+
+        if (rtt != NULL && rtt->valid && rtt->backoff < DFU_HOST_RTO_BACKOFF_MAX) {
+            rtt->backoff += 1;
+        }
+
+        xfer_complete(host, DFU_HOST_ERR_TIMEOUT);
+    }
 }
 
-int dfu_host_write_protect_area(uint16_t start, uint16_t end)
+bool dfu_host_busy(dfu_host_t* host)
 {
-	CHECK(start <= end, return DFU_HOST_ERR_EINVAL);
-	
-	const uint8_t len = end - start + 1;
-	
-	uint8_t sectors[len];
-	
-	for(uint8_t i = 0; i < len; ++i) {
-		sectors[i] = start + i;
-	}
-	
-	return dfu_host_write_protect_sectors(sectors, len);
+    return host->xfer.req != NULL;
 }
 
-int dfu_host_write_unprotect(void)
+int dfu_host_wait(dfu_host_t* host, dfu_host_req_t* req)
 {
-	/* Отправка команды 73 8C */
-	int rc = send_command(DFU_HOST_CMD_ID_WRITE_UNPROTECT, CONFIG_DFU_HOST_RECEIVE_TIMEOUT_MS);
-	if (rc < 0) {
-		return rc;
-	}
-	
-	/* Дождаться ACK */
-	return recv(CONFIG_DFU_HOST_RECEIVE_TIMEOUT_MS);
+    ASSERT_NO_MSG(req != NULL);
+
+    while (host->xfer.req == req) {
+        dfu_host_poll(host);
+    }
+
+    return req->rc;
 }
 
-int dfu_host_readout_protect(void)
-{	
-	/* Отправка команды 82 7D */
-	int rc = send_command(DFU_HOST_CMD_ID_READOUT_PROTECT, CONFIG_DFU_HOST_RECEIVE_TIMEOUT_MS);
-	if (rc < 0) {
-		return rc;
-	}
-	
-	/* Дождаться ACK */
-	return recv(CONFIG_DFU_HOST_RECEIVE_TIMEOUT_MS);
+/************************ Асинхронные команды ***********************/
+
+int dfu_host_ping_async(dfu_host_t* host, dfu_host_req_t* req, uint32_t timeout)
+{
+    CHECK(timeout > 0, return DFU_HOST_ERR_EINVAL);
+
+    int rc = xfer_begin(host, req, NULL);
+    if (rc < 0) {
+        return rc;
+    }
+
+    /* После синхронизации на линии может оказаться другое устройство */
+    host->caps_cur = NULL;
+
+    host->xfer.sync_timeout = timeout;
+    xfer_add(host, STEP_SYNC, 0);
+
+    return xfer_start(host, req);
 }
 
-int dfu_host_readout_unprotect(void)
+/* Отправить один байт-заполнитель и дождаться ACK/NACK */
+static int resync_fill_async(dfu_host_t* host, dfu_host_req_t* req)
 {
-	/* Отправка команды 92 6D */
-	int rc = send_command(DFU_HOST_CMD_ID_READOUT_UNPROTECT, CONFIG_DFU_HOST_RECEIVE_TIMEOUT_MS);
+    int rc = xfer_begin(host, req, NULL);
+    if (rc < 0) {
+        return rc;
+    }
+
+    uint8_t* frame = xfer_frame(host, 1);
+
+    frame[0] = DFU_HOST_RESYNC_FILL;
+    xfer_last_timeout(host, CONFIG_DFU_HOST_RESYNC_BYTE_TIMEOUT_MS);
+
+    return xfer_start(host, req);
+}
+
+static int get_finish(dfu_host_t* host, dfu_host_req_t* req, int rc)
+{
+    /* N, версия, N команд */
+    if (rc < 2 || host->xfer.rx[0] != rc - 2) {
+        return DFU_HOST_ERR_WRONG_ANS;
+    }
+
+    req->version = host->xfer.rx[1];
+    req->data    = host->xfer.rx + 2;
+    req->len     = rc - 2;
+
+    return DFU_HOST_ERR_NONE;
+}
+
+int dfu_host_get_async(dfu_host_t* host, dfu_host_req_t* req)
+{
+    int rc = xfer_begin(host, req, get_finish);
+    if (rc < 0) {
+        return rc;
+    }
+
+    /* Отправка команды 00 FF, прием N + 2 байт и ACK */
+    xfer_command(host, DFU_HOST_CMD_ID_GET);
+    xfer_add(host, STEP_RECV_SIZED, 0);
+
+    return xfer_start(host, req);
+}
+
+static int get_version_finish(dfu_host_t* host, dfu_host_req_t* req, int rc)
+{
+    (void)rc;
+
+    req->version = host->xfer.rx[0];
+
+    return bcd2bin(host->xfer.rx[0]);
+}
+
+int dfu_host_get_version_async(dfu_host_t* host, dfu_host_req_t* req)
+{
+    int rc = xfer_begin(host, req, get_version_finish);
+    if (rc < 0) {
+        return rc;
+    }
+
+    /* Отправка команды 01 FE. Длина ответа известна заранее: версия и два
+     * байта опций (USART) или только версия (SPI, I2C) */
+    xfer_command(host, DFU_HOST_CMD_ID_GET_VERSION);
+    xfer_add(host, STEP_RECV_EXACT, 1 + host->tp->version_options);
+    xfer_add(host, STEP_ACK, 0);
+
+    return xfer_start(host, req);
+}
+
+static int get_id_finish(dfu_host_t* host, dfu_host_req_t* req, int rc)
+{
+    if (rc == 0) {
+        return DFU_HOST_ERR_WRONG_ANS;
+    }
+
+    req->data = host->xfer.rx + 1;
+    req->len  = rc - 1;
+
+    return DFU_HOST_ERR_NONE;
+}
+
+int dfu_host_get_id_async(dfu_host_t* host, dfu_host_req_t* req)
+{
+    int rc = xfer_begin(host, req, get_id_finish);
+    if (rc < 0) {
+        return rc;
+    }
+
+    /* Отправка команды 02 FD, прием N + 2 байт и ACK */
+    xfer_command(host, DFU_HOST_CMD_ID_GET_ID);
+    xfer_add(host, STEP_RECV_SIZED, 0);
+
+    return xfer_start(host, req);
+}
+
+static int read_memory_finish(dfu_host_t* host, dfu_host_req_t* req, int rc)
+{
+    req->data = host->xfer.rx;
+    req->len  = rc;
+
+    return rc;
+}
+
+/* Запустить READ_MEM одного блока в buf или, если buf == NULL, в приемный буфер модуля */
+static int read_block_async(dfu_host_t* host, dfu_host_req_t* req, uint32_t address, uint8_t* buf, size_t len)
+{
+    CHECK(len != 0,                       return DFU_HOST_ERR_EINVAL);
+    CHECK(len <= DFU_HOST_RX_BUFFER_SIZE, return DFU_HOST_ERR_EINVAL);
+
+    int rc = xfer_begin(host, req, read_memory_finish);
+    if (rc < 0) {
+        return rc;
+    }
+
+    host->xfer.rx_user = buf;
+
+    /* Отправка команды 11 EE и начального адреса чтения памяти */
+    xfer_command(host, DFU_HOST_CMD_ID_READ_MEM);
+    xfer_address(host, address);
+
+    /* Отправить количество считываемых байт */
+    uint8_t* frame = xfer_frame(host, 2);
+
+    frame[0] = len - 1;
+    frame[1] = 0xFF ^ frame[0];
+
+    /* Принять содержимое памяти по заданному адресу */
+    xfer_add(host, STEP_RECV_EXACT, len);
+
+    return xfer_start(host, req);
+}
+
+int dfu_host_read_memory_async(dfu_host_t* host, dfu_host_req_t* req, uint32_t address, size_t len)
+{
+    return read_block_async(host, req, address, NULL, len);
+}
+
+
+static void range_done(dfu_host_req_t* req);
+
+/* Запросить следующий блок диапазона */
+static void range_next(dfu_host_t* host)
+{
+    const size_t len = MIN(host->range.left, DFU_HOST_RX_BUFFER_SIZE);
+
+    host->range.req.cb = range_done;
+
+    int rc = read_block_async(host, &host->range.req, host->range.address, host->range.buf, len);
+    if (rc < 0) {
+        host->range.rc = rc;
+        return;
+    }
+
+    host->range.address += len;
+    host->range.left    -= len;
+    host->range.len      = len;
+
+    if (host->range.buf != NULL) {
+        host->range.buf += len;
+    }
+}
+
+/* Блок принят: сначала запросить следующий, затем отдать этот потребителю,
+ * пока по линии идет следующий блок */
+static void range_done(dfu_host_req_t* req)
+{
+    dfu_host_t* host = req->host;
+
+    if (host->range.rc < 0) {
+        return;
+    }
+
+    /* Искаженный ответ обнаружен сразу - запросить блок еще раз */
+    if (req->rc == DFU_HOST_ERR_LINE && host->range.retries < CONFIG_DFU_HOST_LINE_RETRIES) {
+        host->range.retries += 1;
+        host->range.address -= host->range.len;
+        host->range.left    += host->range.len;
+
+        if (host->range.buf != NULL) {
+            host->range.buf -= host->range.len;
+        }
+
+        range_next(host);
+        return;
+    }
+
+    if (req->rc < 0) {
+        host->range.rc = req->rc;
+        return;
+    }
+
+    host->range.retries = 0;
+
+    const uint8_t* data = req->data;
+    const size_t len = req->len;
+    const uint32_t address = host->range.address - len;
+
+    if (host->range.left != 0) {
+        range_next(host);
+    }
+
+    if (host->range.sink != NULL) {
+        int rc = host->range.sink(host->range.ctx, address, data, len);
+        if (rc < 0 && host->range.rc == 0) {
+            host->range.rc = rc;
+        }
+    }
+}
+
+/* Прочитать диапазон блоками READ_MEM, дожидаясь окончания */
+static int read_range(dfu_host_t* host, uint32_t address, size_t len, uint8_t* buf,
+    dfu_host_read_sink_t sink, void* ctx)
+{
+    CHECK(len != 0,                      return DFU_HOST_ERR_EINVAL);
+    CHECK(len - 1 <= UINT32_MAX - address, return DFU_HOST_ERR_EINVAL);
+
+    if (host->xfer.req != NULL) {
+        return DFU_HOST_ERR_BUSY;
+    }
+
+    memset(&host->range, 0, sizeof(host->range));
+
+    host->range.address = address;
+    host->range.left    = len;
+    host->range.buf     = buf;
+    host->range.sink    = sink;
+    host->range.ctx     = ctx;
+
+    range_next(host);
+
+    /* Ошибка потребителя останавливает запросы, но начатый блок дочитывается */
+    while (host->xfer.req != NULL) {
+        dfu_host_poll(host);
+    }
+
+    return host->range.rc;
+}
+
+int dfu_host_read_range(dfu_host_t* host, uint32_t address, size_t len, dfu_host_read_sink_t sink, void* ctx)
+{
+    CHECK(sink != NULL, return DFU_HOST_ERR_EINVAL);
+
+    return read_range(host, address, len, NULL, sink, ctx);
+}
+
+int dfu_host_read_range_buf(dfu_host_t* host, uint32_t address, uint8_t* buf, size_t len)
+{
+    CHECK(buf != NULL, return DFU_HOST_ERR_EINVAL);
+
+    return read_range(host, address, len, buf, NULL, NULL);
+}
+
+static int write_memory_finish(dfu_host_t* host, dfu_host_req_t* req, int rc)
+{
+    (void)host;
+    (void)rc;
+
+    return req->len;
+}
+
+int dfu_host_write_memory_async(dfu_host_t* host, dfu_host_req_t* req, uint32_t address, const uint8_t* data, size_t len)
+{
+    CHECK(data != NULL, return DFU_HOST_ERR_EINVAL);
+    CHECK(len  != 0,    return DFU_HOST_ERR_EINVAL);
+    CHECK(len  <= 256,  return DFU_HOST_ERR_EINVAL);
+
+    int rc = xfer_begin(host, req, write_memory_finish);
+    if (rc < 0) {
+        return rc;
+    }
+
+    req->len = len;
+
+    /* Отправка команды 31 СE и начального адреса записи данных */
+    xfer_command(host, DFU_HOST_CMD_ID_WRITE_MEM);
+    xfer_address(host, address);
+
+    /* Отправить блок данных для записи в память устройства */
+    uint8_t* frame = xfer_frame(host, len + 2);
+
+    frame[0] = len - 1;
+    memcpy(frame + 1, data, len);
+    frame[len + 1] = calc_xor8(frame, len + 1);
+
+    return xfer_start(host, req);
+}
+
+int dfu_host_go_async(dfu_host_t* host, dfu_host_req_t* req, uint32_t address)
+{
+    int rc = xfer_begin(host, req, NULL);
+    if (rc < 0) {
+        return rc;
+    }
+
+    /* Отправка команды 21 DE и адреса исполнения программы */
+    xfer_command(host, DFU_HOST_CMD_ID_GO);
+    xfer_address(host, address);
+
+    return xfer_start(host, req);
+}
+
+/* Команда стирания подключенного устройства; без dfu_host_discover() - Extended Erase */
+static dfu_host_erase_t erase_type(dfu_host_t* host)
+{
+	return (host->caps_cur != NULL) ? host->caps_cur->erase : DFU_HOST_ERASE_EXTENDED;
+}
+
+int dfu_host_erase_all_async(dfu_host_t* host, dfu_host_req_t* req)
+{
+	const dfu_host_erase_t erase = erase_type(host);
+
+	/* Загрузчик ответил бы на команду NACK */
+	if (erase == DFU_HOST_ERASE_NONE) {
+		return DFU_HOST_ERR_NACK;
+	}
+
+	int rc = xfer_begin(host, req, NULL);
 	if (rc < 0) {
 		return rc;
 	}
-	
-	/* Дождаться ACK */
-	return recv(CONFIG_DFU_HOST_RECEIVE_TIMEOUT_MS);
-}
\ No newline at end of file
+
+	if (erase == DFU_HOST_ERASE_LEGACY) {
+		/* Отправка команды 43 BC и кода глобального стирания FF 00 */
+		xfer_command(host, DFU_HOST_CMD_ID_ERASE);
+
+		uint8_t* frame = xfer_frame(host, 2);
+
+		frame[0] = 0xFF;
+		frame[1] = 0x00;
+
+		xfer_last_timeout(host, CONFIG_DFU_HOST_MASS_ERASE_TIMEOUT_MS);
+
+		return xfer_start(host, req);
+	}
+
+	/* Отправка команды 44 BB */
+	xfer_command(host, DFU_HOST_CMD_ID_WRITE_EXT_ERASE);
+
+	/* Отправить спец значение для стирания всей внутренней Flash */
+	uint8_t* frame = xfer_frame(host, 3);
+
+	frame[0] = 0xFF;
+	frame[1] = 0xFF;
+	frame[2] = calc_xor8(frame, 2);
+
+	xfer_last_timeout(host, CONFIG_DFU_HOST_MASS_ERASE_TIMEOUT_MS);
+
+	return xfer_start(host, req);
+}
+
+int dfu_host_erase_sectors_async(dfu_host_t* host, dfu_host_req_t* req, const uint16_t* sectors, size_t count)
+{
+	CHECK(sectors != NULL,                       return DFU_HOST_ERR_EINVAL);
+	CHECK(count   != 0,                          return DFU_HOST_ERR_EINVAL);
+	CHECK(count   <= DFU_HOST_ERASE_SECTORS_MAX, return DFU_HOST_ERR_EINVAL);
+
+	for (size_t i = 0; i < count; ++i) {
+		/* Номера 0xFFFx - спецкоды стирания банков */
+		CHECK(sectors[i] < 0xFFF0, return DFU_HOST_ERR_EINVAL);
+	}
+
+	const dfu_host_erase_t erase = erase_type(host);
+
+	if (erase == DFU_HOST_ERASE_NONE) {
+		return DFU_HOST_ERR_NACK;
+	}
+
+	if (erase == DFU_HOST_ERASE_LEGACY) {
+		/* N = 0xFF зарезервировано для глобального стирания */
+		CHECK(count <= 0xFF, return DFU_HOST_ERR_EINVAL);
+
+		for (size_t i = 0; i < count; ++i) {
+			CHECK(sectors[i] <= 0xFF, return DFU_HOST_ERR_EINVAL);
+		}
+	}
+
+	int rc = xfer_begin(host, req, NULL);
+	if (rc < 0) {
+		return rc;
+	}
+
+	if (erase == DFU_HOST_ERASE_LEGACY) {
+		/* Отправка команды 43 BC */
+		xfer_command(host, DFU_HOST_CMD_ID_ERASE);
+
+		/* N - 1, номера страниц по 1 байту и контрольная сумма всего кадра */
+		uint8_t* frame = xfer_frame(host, 1 + count + 1);
+
+		frame[0] = count - 1;
+
+		for (size_t i = 0; i < count; ++i) {
+			frame[1 + i] = sectors[i];
+		}
+
+		frame[1 + count] = calc_xor8(frame, 1 + count);
+
+		xfer_last_timeout(host, count * CONFIG_DFU_HOST_SECTOR_ERASE_TIMEOUT_MS);
+
+		return xfer_start(host, req);
+	}
+
+	/* Отправка команды 44 BB */
+	xfer_command(host, DFU_HOST_CMD_ID_WRITE_EXT_ERASE);
+
+	/* N - 1, номера секторов по 2 байта старшим вперед и контрольная сумма всего кадра */
+	uint8_t* frame = xfer_frame(host, 2 + 2 * count + 1);
+
+	frame[0] = (count - 1) >> 8;
+	frame[1] = (count - 1) & 0xFF;
+
+	for (size_t i = 0; i < count; ++i) {
+		frame[2 + 2 * i] = sectors[i] >> 8;
+		frame[3 + 2 * i] = sectors[i] & 0xFF;
+	}
+
+	frame[2 + 2 * count] = calc_xor8(frame, 2 + 2 * count);
+
+	xfer_last_timeout(host, count * CONFIG_DFU_HOST_SECTOR_ERASE_TIMEOUT_MS);
+
+	return xfer_start(host, req);
+}
+
+int dfu_host_write_protect_sectors_async(dfu_host_t* host, dfu_host_req_t* req, const uint8_t* sectors, size_t count)
+{
+	CHECK(sectors != NULL, return DFU_HOST_ERR_EINVAL);
+	CHECK(count   != 0,    return DFU_HOST_ERR_EINVAL);
+	CHECK(count   <= 256,  return DFU_HOST_ERR_EINVAL);
+
+	int rc = xfer_begin(host, req, NULL);
+	if (rc < 0) {
+		return rc;
+	}
+
+	/* Отправка команды 63 9C */
+	xfer_command(host, DFU_HOST_CMD_ID_WRITE_PROTECT);
+
+	/* Отправить номера секторов для установки защиты на запись */
+	uint8_t* frame = xfer_frame(host, count + 2);
+
+	frame[0] = count - 1;
+	memcpy(frame + 1, sectors, count);
+	frame[count + 1] = calc_xor8(frame, count + 1);
+
+	return xfer_start(host, req);
+}
+
+int dfu_host_write_protect_area_async(dfu_host_t* host, dfu_host_req_t* req, uint16_t start, uint16_t end)
+{
+	CHECK(start <= end,       return DFU_HOST_ERR_EINVAL);
+	CHECK(end - start < 256,  return DFU_HOST_ERR_EINVAL);
+
+	const size_t count = end - start + 1;
+
+	int rc = xfer_begin(host, req, NULL);
+	if (rc < 0) {
+		return rc;
+	}
+
+	/* Отправка команды 63 9C */
+	xfer_command(host, DFU_HOST_CMD_ID_WRITE_PROTECT);
+
+	/* Отправить номера секторов диапазона */
+	uint8_t* frame = xfer_frame(host, count + 2);
+
+	frame[0] = count - 1;
+	for (size_t i = 0; i < count; ++i) {
+		frame[1 + i] = start + i;
+	}
+	frame[count + 1] = calc_xor8(frame, count + 1);
+
+	return xfer_start(host, req);
+}
+
+/* Команда без параметров, после которой загрузчик отвечает вторым ACK */
+static int command_ack_async(dfu_host_t* host, dfu_host_req_t* req, cmd_id_t cmd)
+{
+	int rc = xfer_begin(host, req, NULL);
+	if (rc < 0) {
+		return rc;
+	}
+
+	xfer_command(host, cmd);
+	xfer_add(host, STEP_RECV, 0);
+	/* Второй ACK - после записи Option bytes или стирания всей Flash */
+	xfer_last_timeout(host, CONFIG_DFU_HOST_MASS_ERASE_TIMEOUT_MS);
+
+	return xfer_start(host, req);
+}
+
+int dfu_host_write_unprotect_async(dfu_host_t* host, dfu_host_req_t* req)
+{
+	/* Отправка команды 73 8C */
+	return command_ack_async(host, req, DFU_HOST_CMD_ID_WRITE_UNPROTECT);
+}
+
+int dfu_host_readout_protect_async(dfu_host_t* host, dfu_host_req_t* req)
+{
+	/* Отправка команды 82 7D */
+	return command_ack_async(host, req, DFU_HOST_CMD_ID_READOUT_PROTECT);
+}
+
+int dfu_host_readout_unprotect_async(dfu_host_t* host, dfu_host_req_t* req)
+{
+	/* Отправка команды 92 6D */
+	return command_ack_async(host, req, DFU_HOST_CMD_ID_READOUT_UNPROTECT);
+}
+
+/*********************** Блокирующие команды ***********************/
+
+int dfu_host_ping(dfu_host_t* host, uint32_t timeout)
+{
+    dfu_host_req_t req = { 0 };
+
+    return xfer_run(host, dfu_host_ping_async(host, &req, timeout), &req);
+}
+
+int dfu_host_resync(dfu_host_t* host, uint32_t timeout)
+{
+    const uint32_t start = HAL_GetTick();
+
+    do {
+        dfu_host_req_t req = { 0 };
+
+        /* Загрузчик, ждущий продолжения кадра, принимает заполнители как его
+         * байты, пока не ответит NACK на контрольную сумму; после NACK он
+         * ждет новую команду */
+        if (xfer_run(host, resync_fill_async(host, &req), &req) != DFU_HOST_ERR_NACK) {
+            continue;
+        }
+
+        /* NACK мог оказаться байтом запоздавшего ответа - проверить командой */
+        if (dfu_host_get_version(host) >= 0) {
+            return DFU_HOST_ERR_NONE;
+        }
+    } while (HAL_GetTick() - start < timeout);
+
+    return DFU_HOST_ERR_TIMEOUT;
+}
+
+int dfu_host_get(dfu_host_t* host, uint8_t* version, const uint8_t** cmds, size_t* count)
+{
+    CHECK(version != NULL, return DFU_HOST_ERR_EINVAL);
+    CHECK(cmds    != NULL, return DFU_HOST_ERR_EINVAL);
+    CHECK(count   != NULL, return DFU_HOST_ERR_EINVAL);
+
+    dfu_host_req_t req = { 0 };
+
+    int rc = xfer_run(host, dfu_host_get_async(host, &req), &req);
+    if (rc < 0) {
+        return rc;
+    }
+
+    *version = req.version;
+    *cmds    = req.data;
+    *count   = req.len;
+
+    return DFU_HOST_ERR_NONE;
+}
+
+int dfu_host_get_version(dfu_host_t* host)
+{
+    dfu_host_req_t req = { 0 };
+
+    return xfer_run(host, dfu_host_get_version_async(host, &req), &req);
+}
+
+int dfu_host_get_id(dfu_host_t* host, const uint8_t** id, size_t* id_len)
+{
+    CHECK(id     != NULL, return DFU_HOST_ERR_EINVAL);
+    CHECK(id_len != NULL, return DFU_HOST_ERR_EINVAL);
+
+    dfu_host_req_t req = { 0 };
+
+    int rc = xfer_run(host, dfu_host_get_id_async(host, &req), &req);
+    if (rc < 0) {
+        return rc;
+    }
+
+    *id     = req.data;
+    *id_len = req.len;
+
+    return DFU_HOST_ERR_NONE;
+}
+
+/* Заполнить запись возможностей по ответу GET */
+static int caps_fill(dfu_host_t* host, dfu_host_caps_t* caps, uint16_t pid)
+{
+    uint8_t version = 0;
+    const uint8_t* cmds = NULL;
+    size_t count = 0;
+
+    int rc = dfu_host_get(host, &version, &cmds, &count);
+    if (rc < 0) {
+        return rc;
+    }
+
+    if (count > ARRAY_SIZE(caps->cmds)) {
+        return DFU_HOST_ERR_WRONG_ANS;
+    }
+
+    memset(caps, 0, sizeof(*caps));
+
+    caps->pid       = pid;
+    caps->version   = version;
+    caps->cmd_count = count;
+    memcpy(caps->cmds, cmds, count);
+
+    caps->read  = dfu_host_caps_has(caps, DFU_HOST_CMD_ID_READ_MEM);
+    caps->write = dfu_host_caps_has(caps, DFU_HOST_CMD_ID_WRITE_MEM);
+    caps->go    = dfu_host_caps_has(caps, DFU_HOST_CMD_ID_GO);
+
+    if (dfu_host_caps_has(caps, DFU_HOST_CMD_ID_WRITE_EXT_ERASE)) {
+        caps->erase = DFU_HOST_ERASE_EXTENDED;
+    } else if (dfu_host_caps_has(caps, DFU_HOST_CMD_ID_ERASE)) {
+        caps->erase = DFU_HOST_ERASE_LEGACY;
+    } else {
+        caps->erase = DFU_HOST_ERASE_NONE;
+    }
+
+    return DFU_HOST_ERR_NONE;
+}
+
+int dfu_host_discover(dfu_host_t* host, const dfu_host_caps_t** caps)
+{
+    CHECK(caps != NULL, return DFU_HOST_ERR_EINVAL);
+
+    host->caps_cur = NULL;
+
+    const uint8_t* id = NULL;
+    size_t id_len = 0;
+
+    int rc = dfu_host_get_id(host, &id, &id_len);
+    if (rc < 0) {
+        return rc;
+    }
+
+    if (id_len != 2) {
+        return DFU_HOST_ERR_WRONG_ANS;
+    }
+
+    const uint16_t pid = ((uint16_t)id[0] << 8) | id[1];
+
+    for (size_t i = 0; i < host->caps_used; ++i) {
+        if (host->caps_cache[i].pid == pid) {
+            host->caps_cur = &host->caps_cache[i];
+            *caps = host->caps_cur;
+            return DFU_HOST_ERR_NONE;
+        }
+    }
+
+    /* Промах: запросить GET и вытеснить самую старую запись */
+    dfu_host_caps_t* entry = &host->caps_cache[host->caps_next];
+
+    rc = caps_fill(host, entry, pid);
+    if (rc < 0) {
+        return rc;
+    }
+
+    host->caps_next = (host->caps_next + 1) % ARRAY_SIZE(host->caps_cache);
+    if (host->caps_used < ARRAY_SIZE(host->caps_cache)) {
+        host->caps_used += 1;
+    }
+
+    LOG_DBG("Caps %04X: v%X.%X, %u commands", pid, entry->version >> 4,
+            entry->version & 0x0F, entry->cmd_count);
+
+    host->caps_cur = entry;
+    *caps = host->caps_cur;
+
+    return DFU_HOST_ERR_NONE;
+}
+
+bool dfu_host_caps_has(const dfu_host_caps_t* caps, uint8_t cmd)
+{
+    CHECK(caps != NULL, return false);
+
+    return memchr(caps->cmds, cmd, caps->cmd_count) != NULL;
+}
+
+int dfu_host_read_memory(dfu_host_t* host, uint32_t address, const uint8_t** result, size_t len)
+{
+    CHECK(result != NULL, return DFU_HOST_ERR_EINVAL);
+
+    dfu_host_req_t req = { 0 };
+
+    int rc = xfer_run(host, dfu_host_read_memory_async(host, &req, address, len), &req);
+    if (rc < 0) {
+        return rc;
+    }
+
+    *result = req.data;
+
+    return rc;
+}
+
+int dfu_host_write_memory(dfu_host_t* host, uint32_t address, const uint8_t* data, size_t len)
+{
+    dfu_host_req_t req = { 0 };
+
+    return xfer_run(host, dfu_host_write_memory_async(host, &req, address, data, len), &req);
+}
+
+int dfu_host_go(dfu_host_t* host, uint32_t address)
+{
+    dfu_host_req_t req = { 0 };
+
+    return xfer_run(host, dfu_host_go_async(host, &req, address), &req);
+}
+
+int dfu_host_erase_all(dfu_host_t* host)
+{
+	dfu_host_req_t req = { 0 };
+
+	return xfer_run(host, dfu_host_erase_all_async(host, &req), &req);
+}
+
+int dfu_host_erase_sectors(dfu_host_t* host, const uint16_t* sectors, size_t count)
+{
+	dfu_host_req_t req = { 0 };
+
+	return xfer_run(host, dfu_host_erase_sectors_async(host, &req, sectors, count), &req);
+}
+
+int dfu_host_write_protect_sectors(dfu_host_t* host, const uint8_t* sectors, size_t count)
+{
+	dfu_host_req_t req = { 0 };
+
+	return xfer_run(host, dfu_host_write_protect_sectors_async(host, &req, sectors, count), &req);
+}
+
+int dfu_host_write_protect_area(dfu_host_t* host, uint16_t start, uint16_t end)
+{
+	dfu_host_req_t req = { 0 };
+
+	return xfer_run(host, dfu_host_write_protect_area_async(host, &req, start, end), &req);
+}
+
+int dfu_host_write_unprotect(dfu_host_t* host)
+{
+	dfu_host_req_t req = { 0 };
+
+	return xfer_run(host, dfu_host_write_unprotect_async(host, &req), &req);
+}
+
+int dfu_host_readout_protect(dfu_host_t* host)
+{
+	dfu_host_req_t req = { 0 };
+
+	return xfer_run(host, dfu_host_readout_protect_async(host, &req), &req);
+}
+
+int dfu_host_readout_unprotect(dfu_host_t* host)
+{
+	dfu_host_req_t req = { 0 };
+
+	return xfer_run(host, dfu_host_readout_unprotect_async(host, &req), &req);
+}
@@ -0,0 +1,142 @@
+#include <string.h>
+
+#include "dfu_host.h"
+#include "dfu_host_crc.h"
+#include "dfu_host_crc_helper.h"
+#include "dfu_host_proto.h"
+#include "core/assert.h"
+
+/************************* LOG SETTINGS ****************************/
+
+#define LOG_MODULE_PRINTABLE_NAME "DFU"
+#define LOG_MODULE_LOG_LEVEL 4U
+#define LOG_MODULE_IS_ENABLED (!defined(NDEBUG))
+#define LOG_MODULE_IS_TIMESTAMP_ENABLED 1
+#define LOG_MODULE_IS_FUNC_NAME_ENABLED 1
+
+#include "logging.h"
+
+/*******************************************************************/
+
+/* Стек помощнику не нужен, SP указывает на слово за образом */
+#define CRC_HELPER_STACK_SIZE 64
+/* Таймаут одной попытки синхронизации после запуска помощника, мс */
+#define CRC_HELPER_PING_TIMEOUT_MS 10
+/* Полином аппаратного блока CRC STM32 */
+#define CRC_HW_POLY 0x04C11DB7U
+
+/* Размер образа помощника, кратный 4 байтам (требование WRITE_MEM) */
+#define CRC_HELPER_IMAGE_SIZE \
+    ((sizeof(dfu_host_crc_helper_params_t) + sizeof(crc_helper_code) + 3U) & ~3U)
+
+/* Аппаратный блок считает только регистр CRC-32/MPEG-2 с начальным 0xFFFFFFFF */
+static inline bool crc_hw_usable(const struct crc_model* model, uint32_t state)
+{
+    return model->width == 32 && !model->refin && model->poly == CRC_HW_POLY &&
+           state == 0xFFFFFFFFU;
+}
+
+int dfu_host_crc_remote(dfu_host_t* host, const struct crc_engine* engine,
+    uint32_t address, uint32_t len, const dfu_host_target_t* target, uint32_t* crc)
+{
+    CHECK(engine != NULL, return DFU_HOST_ERR_EINVAL);
+    CHECK(crc    != NULL, return DFU_HOST_ERR_EINVAL);
+    CHECK(len    != 0,    return DFU_HOST_ERR_EINVAL);
+
+    const struct crc_model* model = engine->model;
+    const uint32_t base = CONFIG_DFU_HOST_CRC_HELPER_ADDR;
+    const uint32_t state = crc_engine_begin(engine);
+
+    /* Не затереть данные системного загрузчика */
+    if (target != NULL && !dfu_host_target_sram_fits(target, base,
+            CRC_HELPER_IMAGE_SIZE + CRC_HELPER_STACK_SIZE)) {
+        LOG_ERROR("Helper does not fit %s SRAM", target->name);
+        return DFU_HOST_ERR_EINVAL;
+    }
+
+    const dfu_host_crc_hw_t* hw = (target != NULL && target->crc.crc_base != 0) ? &target->crc : NULL;
+
+    uint8_t image[CRC_HELPER_IMAGE_SIZE] = { 0 };
+    uint32_t flags = 0;
+
+    /* Полином в форме регистра crc_engine */
+    uint32_t poly = model->poly << (32U - model->width);
+    if (model->refin) {
+        poly  = crc_reflect(model->poly, model->width);
+        flags = DFU_HOST_CRC_HELPER_FLAG_REFIN;
+    }
+
+    if (hw != NULL && crc_hw_usable(model, state)) {
+        flags |= DFU_HOST_CRC_HELPER_FLAG_HW;
+    } else {
+        hw = NULL;
+    }
+
+    put_le32(image + offsetof(dfu_host_crc_helper_params_t, sp),
+        base + CRC_HELPER_IMAGE_SIZE + CRC_HELPER_STACK_SIZE);
+    put_le32(image + offsetof(dfu_host_crc_helper_params_t, entry),
+        (base + sizeof(dfu_host_crc_helper_params_t)) | 1U);
+    put_le32(image + offsetof(dfu_host_crc_helper_params_t, magic), DFU_HOST_CRC_HELPER_MAGIC);
+    put_le32(image + offsetof(dfu_host_crc_helper_params_t, address), address);
+    put_le32(image + offsetof(dfu_host_crc_helper_params_t, length), len);
+    put_le32(image + offsetof(dfu_host_crc_helper_params_t, poly), poly);
+    put_le32(image + offsetof(dfu_host_crc_helper_params_t, state), state);
+    put_le32(image + offsetof(dfu_host_crc_helper_params_t, flags), flags);
+
+    if (hw != NULL) {
+        put_le32(image + offsetof(dfu_host_crc_helper_params_t, hw_crc), hw->crc_base);
+        put_le32(image + offsetof(dfu_host_crc_helper_params_t, rcc_reg), hw->rcc_reg);
+        put_le32(image + offsetof(dfu_host_crc_helper_params_t, rcc_bit), hw->rcc_bit);
+    }
+
+    memcpy(image + sizeof(dfu_host_crc_helper_params_t), crc_helper_code, sizeof(crc_helper_code));
+
+    /* Загрузить и запустить помощника */
+    for (size_t offset = 0; offset < sizeof(image); offset += 256) {
+        int rc = dfu_host_write_memory(host, base + offset, image + offset, MIN(sizeof(image) - offset, 256));
+        if (rc < 0) {
+            LOG_ERROR("Helper upload error: %d", rc);
+            return rc;
+        }
+    }
+
+    int rc = dfu_host_go(host, base);
+    if (rc < 0) {
+        LOG_ERROR("Helper start error: %d", rc);
+        return rc;
+    }
+
+    /* Пока помощник считает, загрузчик не отвечает; после сброса он снова
+     * ждет синхронизации */
+    const uint32_t start = HAL_GetTick();
+
+    do {
+        rc = dfu_host_ping(host, CRC_HELPER_PING_TIMEOUT_MS);
+    } while (rc < 0 && HAL_GetTick() - start < CONFIG_DFU_HOST_CRC_HELPER_TIMEOUT_MS);
+
+    if (rc < 0) {
+        LOG_ERROR("No bootloader after helper: %d", rc);
+        return DFU_HOST_ERR_TIMEOUT;
+    }
+
+    /* Прочитать регистр CRC и признак окончания */
+    const uint32_t result_offset = offsetof(dfu_host_crc_helper_params_t, state);
+    uint8_t result[sizeof(dfu_host_crc_helper_params_t) - offsetof(dfu_host_crc_helper_params_t, state)];
+
+    rc = dfu_host_read_range_buf(host, base + result_offset, result, sizeof(result));
+    if (rc < 0) {
+        return rc;
+    }
+
+    if (get_le32(result + offsetof(dfu_host_crc_helper_params_t, status) - result_offset) !=
+        DFU_HOST_CRC_HELPER_DONE) {
+        LOG_ERROR("Helper did not finish");
+        return DFU_HOST_ERR_WRONG_ANS;
+    }
+
+    *crc = crc_engine_final(engine, get_le32(result));
+
+    LOG_DBG("Helper CRC: %08lX (%s), %lu ms", *crc, (hw != NULL) ? "HW" : "SW", HAL_GetTick() - start);
+
+    return DFU_HOST_ERR_NONE;
+}
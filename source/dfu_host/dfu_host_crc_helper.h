@@ -0,0 +1,28 @@
+#ifndef SOURCE_DFU_HOST_DFU_HOST_CRC_HELPER_H_
+#define SOURCE_DFU_HOST_DFU_HOST_CRC_HELPER_H_
+
+/*
+ * Машинный код помощника расчета CRC (dfu_host_crc_helper.S) без блока
+ * параметров, используется только в dfu_host_crc.c. Код располагается в образе
+ * сразу за dfu_host_crc_helper_params_t.
+ */
+
+#include <stdint.h>
+
+static const uint8_t crc_helper_code[] = {
+    0x72U, 0xb6U, 0xafU, 0xf2U, 0x34U, 0x07U, 0xf8U, 0x68U, 0x39U, 0x69U, 0x7aU, 0x69U,
+    0xbbU, 0x69U, 0xfcU, 0x69U, 0x14U, 0xf0U, 0x02U, 0x0fU, 0x13U, 0xd0U, 0x7dU, 0x6aU,
+    0xbeU, 0x6aU, 0xd5U, 0xf8U, 0x00U, 0xc0U, 0x4cU, 0xeaU, 0x06U, 0x0cU, 0xc5U, 0xf8U,
+    0x00U, 0xc0U, 0x3dU, 0x6aU, 0x01U, 0x26U, 0xaeU, 0x60U, 0x04U, 0x29U, 0x05U, 0xd3U,
+    0x50U, 0xf8U, 0x04U, 0x6bU, 0x36U, 0xbaU, 0x2eU, 0x60U, 0x04U, 0x39U, 0xf7U, 0xe7U,
+    0x2bU, 0x68U, 0x00U, 0x29U, 0x1aU, 0xd0U, 0x14U, 0xf0U, 0x01U, 0x0fU, 0x0bU, 0xd0U,
+    0x10U, 0xf8U, 0x01U, 0x6bU, 0x73U, 0x40U, 0x08U, 0x25U, 0x5bU, 0x08U, 0x28U, 0xbfU,
+    0x53U, 0x40U, 0x01U, 0x3dU, 0xfaU, 0xd1U, 0x01U, 0x39U, 0xf4U, 0xd1U, 0x0bU, 0xe0U,
+    0x10U, 0xf8U, 0x01U, 0x6bU, 0x83U, 0xeaU, 0x06U, 0x63U, 0x08U, 0x25U, 0x5bU, 0x00U,
+    0x28U, 0xbfU, 0x53U, 0x40U, 0x01U, 0x3dU, 0xfaU, 0xd1U, 0x01U, 0x39U, 0xf3U, 0xd1U,
+    0xbbU, 0x61U, 0x05U, 0x4eU, 0xfeU, 0x62U, 0xbfU, 0xf3U, 0x4fU, 0x8fU, 0x04U, 0x4dU,
+    0x04U, 0x4eU, 0x2eU, 0x60U, 0xbfU, 0xf3U, 0x4fU, 0x8fU, 0xfeU, 0xe7U, 0x00U, 0x00U,
+    0x44U, 0x4fU, 0x4eU, 0x45U, 0x0cU, 0xedU, 0x00U, 0xe0U, 0x04U, 0x00U, 0xfaU, 0x05U,
+};
+
+#endif /* SOURCE_DFU_HOST_DFU_HOST_CRC_HELPER_H_ */
@@ -0,0 +1,180 @@
+#include "dfu_host_transport.h"
+#include "dfu_host_proto.h"
+#include "core/assert.h"
+
+#ifdef HAL_I2C_MODULE_ENABLED
+
+/* Таймаут одной транзакции I2C в милисекундах */
+#ifndef CONFIG_DFU_HOST_I2C_XFER_TIMEOUT_MS
+#define CONFIG_DFU_HOST_I2C_XFER_TIMEOUT_MS 10
+#endif /* CONFIG_DFU_HOST_I2C_XFER_TIMEOUT_MS */
+
+/* Количество устройств I2C, с которыми одновременно работают экземпляры
+ * dfu_host. Устройства с разными адресами могут быть на одной шине */
+#ifndef CONFIG_DFU_HOST_I2C_PORTS
+#define CONFIG_DFU_HOST_I2C_PORTS 1
+#endif /* CONFIG_DFU_HOST_I2C_PORTS */
+
+/* Транспорт до одного устройства, ctx транспорта указывает на порт */
+typedef struct {
+    I2C_HandleTypeDef* hi2c;  /* NULL - порт свободен                */
+    uint16_t i2c_addr;        /* Адрес устройства, сдвинутый для HAL */
+    dfu_host_transport_t transport;
+} i2c_port_t;
+
+static i2c_port_t ports[CONFIG_DFU_HOST_I2C_PORTS];
+
+/* Прочитать len байт. Пока ответ не готов, загрузчик не подтверждает свой адрес */
+static int i2c_read(const i2c_port_t* port, uint8_t* buf, size_t len, uint32_t start, uint32_t timeout)
+{
+    while (HAL_I2C_Master_Receive(port->hi2c, port->i2c_addr, buf, len,
+        CONFIG_DFU_HOST_I2C_XFER_TIMEOUT_MS) != HAL_OK) {
+        if (HAL_GetTick() - start >= timeout) {
+            return DFU_HOST_ERR_TIMEOUT;
+        }
+    }
+
+    return DFU_HOST_ERR_NONE;
+}
+
+static int i2c_send(void* ctx, const uint8_t* data, size_t len, bool cmd)
+{
+    const i2c_port_t* port = ctx;
+
+    (void)cmd;
+
+    if (HAL_I2C_Master_Transmit(port->hi2c, port->i2c_addr, (uint8_t*)data, len,
+        CONFIG_DFU_HOST_I2C_XFER_TIMEOUT_MS) != HAL_OK) {
+        return DFU_HOST_ERR_EIO;
+    }
+
+    return DFU_HOST_ERR_NONE;
+}
+
+static int i2c_sync(void* ctx, uint32_t timeout)
+{
+    const i2c_port_t* port = ctx;
+
+    /* Синхронизация не нужна: достаточно, чтобы загрузчик ответил на свой адрес */
+    if (HAL_I2C_IsDeviceReady(port->hi2c, port->i2c_addr, 1, timeout) != HAL_OK) {
+        return DFU_HOST_ERR_TIMEOUT;
+    }
+
+    return DFU_HOST_ERR_NONE;
+}
+
+static ssize_t i2c_recv_exact(void* ctx, uint8_t* buf, size_t len, uint32_t timeout)
+{
+    int rc = i2c_read(ctx, buf, len, HAL_GetTick(), timeout);
+
+    return (rc < 0) ? rc : (ssize_t)len;
+}
+
+static ssize_t i2c_recv_until_ack(void* ctx, uint8_t* buf, size_t size, uint32_t timeout)
+{
+    const uint32_t start = HAL_GetTick();
+    size_t count = 0;
+
+    /* ACK читается отдельной транзакцией, поэтому ответ читается по байту */
+    while (1) {
+        uint8_t data = 0;
+
+        int rc = i2c_read(ctx, &data, 1, start, timeout);
+        if (rc < 0) {
+            return rc;
+        }
+
+        switch (data) {
+        case DFU_HOST_RESP_NACK:
+            return DFU_HOST_ERR_NACK;
+
+        case DFU_HOST_RESP_ACK:
+            return count;
+
+        case DFU_HOST_RESP_BUSY:
+            /* Команда еще выполняется - ACK придет позже */
+            if (count == 0) {
+                if (HAL_GetTick() - start >= timeout) {
+                    return DFU_HOST_ERR_TIMEOUT;
+                }
+
+                break;
+            }
+
+            /* fall through */
+        default:
+            if (count == size) {
+                return DFU_HOST_ERR_OVERFLOW;
+            }
+
+            buf[count++] = data;
+            break;
+        }
+    }
+}
+
+static ssize_t i2c_recv_sized(void* ctx, uint8_t* buf, size_t size, uint32_t timeout)
+{
+    CHECK(buf != NULL && size >= 2, return DFU_HOST_ERR_EINVAL);
+
+    const uint32_t start = HAL_GetTick();
+
+    int rc = i2c_read(ctx, buf, 1, start, timeout);
+    if (rc < 0) {
+        return rc;
+    }
+
+    const size_t len = (size_t)buf[0] + 2;
+
+    if (len > size) {
+        return DFU_HOST_ERR_OVERFLOW;
+    }
+
+    /* Данные - одной транзакцией, ACK - отдельной */
+    rc = i2c_read(ctx, buf + 1, len - 1, start, timeout);
+    if (rc < 0) {
+        return rc;
+    }
+
+    rc = i2c_recv_until_ack(ctx, NULL, 0, timeout);
+
+    return (rc < 0) ? rc : (ssize_t)len;
+}
+
+static const dfu_host_transport_t i2c_transport = {
+    .sync           = i2c_sync,
+    .send           = i2c_send,
+    .recv_exact     = i2c_recv_exact,
+    .recv_until_ack = i2c_recv_until_ack,
+    .recv_sized     = i2c_recv_sized,
+    .name           = "I2C",
+};
+
+const dfu_host_transport_t* dfu_host_transport_i2c(I2C_HandleTypeDef* handle, uint16_t address)
+{
+    ASSERT_NO_MSG(handle != NULL);
+
+    i2c_port_t* port = NULL;
+
+    /* Порт этого устройства или первый свободный */
+    for (size_t i = 0; i < ARRAY_SIZE(ports); i++) {
+        if (ports[i].hi2c == handle && ports[i].i2c_addr == (uint16_t)(address << 1)) {
+            port = &ports[i];
+            break;
+        }
+        if (ports[i].hi2c == NULL && port == NULL) {
+            port = &ports[i];
+        }
+    }
+
+    CHECK(port != NULL, return NULL);
+
+    port->hi2c          = handle;
+    port->i2c_addr      = address << 1;
+    port->transport     = i2c_transport;
+    port->transport.ctx = port;
+
+    return &port->transport;
+}
+
+#endif /* HAL_I2C_MODULE_ENABLED */
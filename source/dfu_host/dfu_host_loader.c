@@ -0,0 +1,785 @@
+#include <string.h>
+
+#include "dfu_host_loader.h"
+#include "dfu_host_loader_f4.h"
+#include "dfu_host_proto.h"
+#include "dfu_host_target.h"
+#include "dfu_host_transport.h"
+#include "core/crc.h"
+#include "core/util.h"
+#include "core/assert.h"
+
+/************************* LOG SETTINGS ****************************/
+
+#define LOG_MODULE_PRINTABLE_NAME "DFU"
+#define LOG_MODULE_LOG_LEVEL 4U
+#define LOG_MODULE_IS_ENABLED (!defined(NDEBUG))
+#define LOG_MODULE_IS_TIMESTAMP_ENABLED 1
+#define LOG_MODULE_IS_FUNC_NAME_ENABLED 1
+
+#include "logging.h"
+
+/*******************************************************************/
+
+/* Размер кадра с заголовком и CRC */
+#define LOADER_FRAME_SIZE (DFU_HOST_LOADER_PAYLOAD_MAX + DFU_HOST_LOADER_OVERHEAD)
+/* Смещение данных в кадре */
+#define LOADER_PAYLOAD 5
+/* Ожидание HELLO после GO, мс */
+#define LOADER_HELLO_TIMEOUT_MS 100
+/* Допустимая ошибка скорости USART устройства, 1/1000 */
+#define LOADER_BAUD_ERROR_PERMILLE 20
+/* Минимальный BRR USART при оверсэмплинге 16 */
+#define LOADER_BRR_MIN 16
+/* Бит на байт по линии: 8E1 */
+#define LOADER_FRAME_BITS 11
+
+/* Загрузчики устройств */
+typedef struct {
+    uint16_t pid;
+    const uint8_t* code;
+    size_t size;
+} loader_image_t;
+
+static const loader_image_t loader_table[] = {
+    { .pid = 0x0413, .code = loader_f4_code, .size = sizeof(loader_f4_code) }, /* F405/F407 */
+};
+
+static const uint32_t loader_baud_rates[] = { CONFIG_DFU_HOST_LOADER_BAUD_RATES };
+
+/* Сеанс с загрузчиком одного устройства: память под буферы кадров выделена
+ * один раз, поэтому загрузчик одновременно работает только с одним экземпляром */
+static struct {
+    dfu_host_t* host;
+    const dfu_host_transport_t* tp;
+    bool     active;
+    uint8_t  window;        /* Кадров без подтверждения                   */
+    uint16_t data_max;      /* Данных в кадре WRITE/DATA                  */
+    uint32_t boot_baud;     /* Скорость системного загрузчика              */
+    uint32_t timeout;       /* Ожидание продвижения окна, мс               */
+    uint8_t  wr_seq;        /* seq следующего кадра WRITE                  */
+    bool     wr_sync;       /* wr_seq нужно уточнить командой PING         */
+    uint8_t  cmd_seq;       /* seq следующей команды                       */
+
+    volatile bool tx_busy;
+    uint8_t  tx[LOADER_FRAME_SIZE];
+    uint8_t  rx[LOADER_FRAME_SIZE];
+    size_t   rx_count;
+} ldr;
+
+static const loader_image_t* loader_find(uint16_t pid)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(loader_table); ++i) {
+        if (loader_table[i].pid == pid) {
+            return &loader_table[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void tx_done(void* arg, int rc)
+{
+    (void)arg;
+    (void)rc;
+
+    ldr.tx_busy = false;
+}
+
+/* Дождаться окончания передачи кадра, буфер ldr.tx освобождается. Отмена
+ * передачи (abort()) не вызывает tx_done, поэтому ожидание ограничено */
+static int tx_wait(void)
+{
+    const uint32_t start = HAL_GetTick();
+
+    while (ldr.tx_busy) {
+        if (HAL_GetTick() - start >= ldr.timeout) {
+            ldr.tx_busy = false;
+            return DFU_HOST_ERR_TIMEOUT;
+        }
+    }
+
+    return DFU_HOST_ERR_NONE;
+}
+
+/* Сформировать кадр в ldr.tx: данные - head и data подряд. Возвращает длину
+ * кадра или DFU_HOST_ERR_TIMEOUT, если не освободился буфер передачи */
+static int frame_build(uint8_t type, uint8_t seq, const uint8_t* head, size_t head_len,
+    const uint8_t* data, size_t data_len)
+{
+    const size_t len = head_len + data_len;
+    uint8_t* frame = ldr.tx;
+
+    int rc = tx_wait();
+    if (rc < 0) {
+        return rc;
+    }
+
+    frame[0] = DFU_HOST_LOADER_SOF;
+    frame[1] = type;
+    frame[2] = seq;
+    frame[3] = len;
+    frame[4] = len >> 8;
+
+    if (head_len != 0) {
+        memcpy(frame + LOADER_PAYLOAD, head, head_len);
+    }
+
+    if (data_len != 0) {
+        memcpy(frame + LOADER_PAYLOAD + head_len, data, data_len);
+    }
+
+    put_le32(frame + LOADER_PAYLOAD + len, crc32_ieee(frame + 1, LOADER_PAYLOAD - 1 + len));
+
+    return len + DFU_HOST_LOADER_OVERHEAD;
+}
+
+/* Передать кадр из ldr.tx длиной len - результат frame_build() */
+static int frame_send(int len)
+{
+    if (len < 0) {
+        return len;
+    }
+
+    ldr.tx_busy = true;
+
+    int rc = ldr.tp->stream_send_async(ldr.tp->ctx, ldr.tx, len, tx_done, NULL);
+    if (rc < 0) {
+        ldr.tx_busy = false;
+    }
+
+    return rc;
+}
+
+static inline int reply_send(uint8_t type, uint8_t seq)
+{
+    return frame_send(frame_build(type, seq, NULL, 0, NULL, 0));
+}
+
+static inline uint8_t rx_type(void)
+{
+    return ldr.rx[1];
+}
+
+static inline uint8_t rx_seq(void)
+{
+    return ldr.rx[2];
+}
+
+static inline size_t rx_len(void)
+{
+    return get_le16(ldr.rx + 3);
+}
+
+static inline const uint8_t* rx_payload(void)
+{
+    return ldr.rx + LOADER_PAYLOAD;
+}
+
+/* Разобрать принятые байты: 1 - кадр в ldr.rx, -1 - искаженный кадр, 0 - кадра еще нет */
+static int rx_poll(void)
+{
+    uint8_t data = 0;
+
+    while (ldr.tp->stream_recv(ldr.tp->ctx, &data, 1) == 1) {
+        if (ldr.rx_count == 0 && data != DFU_HOST_LOADER_SOF) {
+            continue;
+        }
+
+        ldr.rx[ldr.rx_count++] = data;
+
+        if (ldr.rx_count < LOADER_PAYLOAD) {
+            continue;
+        }
+
+        const size_t len = rx_len();
+
+        /* Длина искажена - искать следующий SOF */
+        if (len > DFU_HOST_LOADER_PAYLOAD_MAX) {
+            ldr.rx_count = 0;
+            continue;
+        }
+
+        if (ldr.rx_count < len + DFU_HOST_LOADER_OVERHEAD) {
+            continue;
+        }
+
+        ldr.rx_count = 0;
+
+        return (crc32_ieee(ldr.rx + 1, LOADER_PAYLOAD - 1 + len) ==
+                get_le32(ldr.rx + LOADER_PAYLOAD + len)) ? 1 : -1;
+    }
+
+    return 0;
+}
+
+/**
+ *  @brief  Одна попытка команды. Ответ остается в ldr.rx.
+ *  @param  reply  Ожидаемый ответ: ACK или STATUS. STATUS с ошибкой
+ *                 загрузчик может передать на любую команду.
+ *  @return 0, DFU_HOST_ERR_NACK - STATUS с ошибкой, DFU_HOST_ERR_TIMEOUT -
+ *          нет ответа, команда или ответ искажены.
+ */
+static int command_try(uint8_t type, const uint8_t* payload, size_t len, uint8_t reply,
+    uint32_t timeout)
+{
+    const uint8_t seq = ldr.cmd_seq++;
+
+    int rc = frame_send(frame_build(type, seq, payload, len, NULL, 0));
+    if (rc < 0) {
+        return rc;
+    }
+
+    const uint32_t start = HAL_GetTick();
+
+    while (HAL_GetTick() - start < timeout) {
+
+        rc = rx_poll();
+        if (rc == 0) {
+            continue;
+        }
+
+        /* Команда или ответ искажены */
+        if (rc < 0 || rx_type() == DFU_HOST_LOADER_NAK) {
+            break;
+        }
+
+        /* Ответ на предыдущую попытку или остаток потока DATA */
+        if (rx_seq() != seq) {
+            continue;
+        }
+
+        if (rx_type() == DFU_HOST_LOADER_STATUS && rx_len() >= 1) {
+            return (rx_payload()[0] == DFU_HOST_LOADER_ST_OK) ? DFU_HOST_ERR_NONE
+                                                              : DFU_HOST_ERR_NACK;
+        }
+
+        if (rx_type() == reply) {
+            return DFU_HOST_ERR_NONE;
+        }
+    }
+
+    return DFU_HOST_ERR_TIMEOUT;
+}
+
+/**
+ *  @brief  Команда с повторами до CONFIG_DFU_HOST_LOADER_RETRIES раз.
+ */
+static int command(uint8_t type, const uint8_t* payload, size_t len, uint8_t reply,
+    uint32_t timeout)
+{
+    int rc = DFU_HOST_ERR_TIMEOUT;
+
+    for (int attempt = 0; attempt < CONFIG_DFU_HOST_LOADER_RETRIES &&
+                          rc == DFU_HOST_ERR_TIMEOUT; ++attempt) {
+        rc = command_try(type, payload, len, reply, timeout);
+    }
+
+    return rc;
+}
+
+/* Время передачи n кадров с данными по линии, мс */
+static uint32_t frames_ms(uint32_t baudrate, uint32_t n)
+{
+    const uint32_t bits = (ldr.data_max + DFU_HOST_LOADER_OVERHEAD) * LOADER_FRAME_BITS * n;
+
+    return (uint32_t)((uint64_t)bits * 1000U / baudrate) + 1;
+}
+
+/* Выбрать скорость и BRR устройства для нее. pclk - частота USART устройства */
+static uint32_t baud_select(uint64_t pclk, uint32_t* brr)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(loader_baud_rates); ++i) {
+        const uint32_t rate = loader_baud_rates[i];
+
+        if (rate > CONFIG_DFU_HOST_LOADER_BAUD_MAX) {
+            continue;
+        }
+
+        const uint32_t div = (pclk + rate / 2) / rate;
+        if (div < LOADER_BRR_MIN) {
+            continue;
+        }
+
+        const uint32_t actual = pclk / div;
+        const uint32_t error = (actual > rate) ? actual - rate : rate - actual;
+
+        if ((uint64_t)error * 1000U <= (uint64_t)rate * LOADER_BAUD_ERROR_PERMILLE) {
+            *brr = div;
+            return rate;
+        }
+    }
+
+    return 0;
+}
+
+/* Размер образа загрузчика, кратный 4 байтам (требование WRITE_MEM) */
+static inline size_t image_size(const loader_image_t* image)
+{
+    return (sizeof(dfu_host_loader_params_t) + image->size + 3U) & ~3U;
+}
+
+/* Загрузить образ: блок параметров и код */
+static int image_upload(const loader_image_t* image)
+{
+    const uint32_t base = CONFIG_DFU_HOST_LOADER_ADDR;
+    const size_t size = image_size(image);
+
+    uint8_t params[sizeof(dfu_host_loader_params_t)] = { 0 };
+
+    put_le32(params + offsetof(dfu_host_loader_params_t, sp), base + size + DFU_HOST_LOADER_RAM_SIZE);
+    put_le32(params + offsetof(dfu_host_loader_params_t, entry), (base + sizeof(params)) | 1U);
+    put_le32(params + offsetof(dfu_host_loader_params_t, magic), DFU_HOST_LOADER_MAGIC);
+
+    for (size_t offset = 0; offset < size; offset += 256) {
+        uint8_t chunk[256];
+        const size_t len = MIN(size - offset, sizeof(chunk));
+
+        for (size_t i = 0; i < len; ++i) {
+            const size_t pos = offset + i;
+
+            if (pos < sizeof(params)) {
+                chunk[i] = params[pos];
+            } else if (pos - sizeof(params) < image->size) {
+                chunk[i] = image->code[pos - sizeof(params)];
+            } else {
+                chunk[i] = 0;
+            }
+        }
+
+        /* Искаженная команда WRITE_MEM отклоняется NACK, ее можно повторить */
+        int rc = DFU_HOST_ERR_NACK;
+
+        for (int attempt = 0; attempt < CONFIG_DFU_HOST_LOADER_RETRIES && rc < 0; ++attempt) {
+            rc = dfu_host_write_memory(ldr.host, base + offset, chunk, len);
+        }
+
+        if (rc < 0) {
+            LOG_ERROR("Loader upload error: %d", rc);
+            return rc;
+        }
+    }
+
+    return dfu_host_go(ldr.host, base);
+}
+
+/* Дождаться HELLO загрузчика и принять его параметры. Возвращает BRR устройства */
+static int hello_wait(uint32_t* brr)
+{
+    const uint32_t start = HAL_GetTick();
+
+    while (HAL_GetTick() - start < LOADER_HELLO_TIMEOUT_MS) {
+        if (rx_poll() <= 0 || rx_type() != DFU_HOST_LOADER_HELLO || rx_len() < 8) {
+            continue;
+        }
+
+        const uint8_t* p = rx_payload();
+
+        if (p[0] != DFU_HOST_LOADER_VERSION) {
+            LOG_ERROR("Loader version %u", p[0]);
+            return DFU_HOST_ERR_WRONG_ANS;
+        }
+
+        ldr.window   = MIN(p[1], CONFIG_DFU_HOST_LOADER_WINDOW);
+        ldr.data_max = MIN(get_le16(p + 2), DFU_HOST_LOADER_DATA_MAX) & ~3U;
+        *brr         = get_le32(p + 4);
+
+        if (ldr.window == 0 || ldr.data_max == 0 || *brr == 0) {
+            return DFU_HOST_ERR_WRONG_ANS;
+        }
+
+        return DFU_HOST_ERR_NONE;
+    }
+
+    return DFU_HOST_ERR_TIMEOUT;
+}
+
+/**
+ *  @brief  Перейти на скорость baudrate. ACK команды BAUD может потеряться
+ *  уже после смены BRR загрузчиком, поэтому результат проверяется командой
+ *  PING на новой скорости, а BAUD при неудаче повторяется на старой.
+ */
+static int baud_switch(uint32_t baudrate, uint32_t brr)
+{
+    const uint32_t timeout = frames_ms(baudrate, ldr.window + 1) + CONFIG_DFU_HOST_LOADER_TIMEOUT_MS;
+    uint8_t payload[8];
+    int rc = DFU_HOST_ERR_TIMEOUT;
+
+    put_le32(payload, baudrate);
+    put_le32(payload + 4, brr);
+
+    for (int attempt = 0; attempt < CONFIG_DFU_HOST_LOADER_RETRIES &&
+                          rc == DFU_HOST_ERR_TIMEOUT; ++attempt) {
+
+        if (dfu_host_get_baudrate(ldr.host) != ldr.boot_baud) {
+            rc = dfu_host_set_baudrate(ldr.host, ldr.boot_baud);
+            if (rc < 0) {
+                return rc;
+            }
+        }
+
+        rc = command_try(DFU_HOST_LOADER_BAUD, payload, sizeof(payload), DFU_HOST_LOADER_ACK,
+            ldr.timeout);
+        if (rc < 0 && rc != DFU_HOST_ERR_TIMEOUT) {
+            return rc;
+        }
+
+        rc = dfu_host_set_baudrate(ldr.host, baudrate);
+        if (rc < 0) {
+            return rc;
+        }
+
+        rc = command(DFU_HOST_LOADER_PING, NULL, 0, DFU_HOST_LOADER_ACK, timeout);
+    }
+
+    if (rc == DFU_HOST_ERR_NONE) {
+        ldr.timeout = timeout;
+    }
+
+    return rc;
+}
+
+int dfu_host_loader_start(dfu_host_t* host, uint16_t pid)
+{
+    CHECK(host != NULL, return DFU_HOST_ERR_EINVAL);
+
+    const dfu_host_transport_t* tp = dfu_host_get_transport(host);
+
+    CHECK(tp != NULL, return DFU_HOST_ERR_EINVAL);
+
+    if (ldr.active && ldr.host != host) {
+        return DFU_HOST_ERR_BUSY;
+    }
+
+    if (tp->stream_send_async == NULL || tp->stream_recv == NULL || tp->get_baudrate == NULL) {
+        return DFU_HOST_ERR_EINVAL;
+    }
+
+    if (dfu_host_busy(host)) {
+        return DFU_HOST_ERR_BUSY;
+    }
+
+    const loader_image_t* image = loader_find(pid);
+    if (image == NULL) {
+        return DFU_HOST_ERR_EINVAL;
+    }
+
+    /* Образ, буферы и стек не должны задевать данные системного загрузчика */
+    const dfu_host_target_t* target = dfu_host_target_find(pid);
+    if (target == NULL || !dfu_host_target_sram_fits(target, CONFIG_DFU_HOST_LOADER_ADDR,
+            image_size(image) + DFU_HOST_LOADER_RAM_SIZE)) {
+        LOG_ERROR("Loader does not fit SRAM of %04X", pid);
+        return DFU_HOST_ERR_EINVAL;
+    }
+
+    memset(&ldr, 0, sizeof(ldr));
+    ldr.host = host;
+    ldr.tp   = tp;
+    ldr.boot_baud = tp->get_baudrate(tp->ctx);
+
+    int rc = image_upload(image);
+    if (rc < 0) {
+        return rc;
+    }
+
+    uint32_t brr = 0;
+
+    rc = hello_wait(&brr);
+    if (rc < 0) {
+        LOG_ERROR("No loader HELLO: %d", rc);
+        return rc;
+    }
+
+    /* Частота USART устройства - по BRR, заданному системным загрузчиком */
+    const uint64_t pclk = (uint64_t)brr * ldr.boot_baud;
+    uint32_t baudrate = baud_select(pclk, &brr);
+
+    ldr.timeout = frames_ms(ldr.boot_baud, ldr.window + 1) + CONFIG_DFU_HOST_LOADER_TIMEOUT_MS;
+
+    if (baudrate > ldr.boot_baud) {
+        rc = baud_switch(baudrate, brr);
+        if (rc < 0) {
+            LOG_ERROR("No loader answer at %lu baud", baudrate);
+            return rc;
+        }
+    } else {
+        baudrate = ldr.boot_baud;
+    }
+
+    ldr.active = true;
+
+    LOG_INF("Loader started: %lu baud, window %u x %u B", baudrate, ldr.window, ldr.data_max);
+
+    return DFU_HOST_ERR_NONE;
+}
+
+void dfu_host_loader_reset(void)
+{
+    if (ldr.tp != NULL && ldr.boot_baud != 0 && dfu_host_get_baudrate(ldr.host) != ldr.boot_baud) {
+        dfu_host_set_baudrate(ldr.host, ldr.boot_baud);
+    }
+
+    ldr.active = false;
+}
+
+bool dfu_host_loader_active(void)
+{
+    return ldr.active;
+}
+
+int dfu_host_loader_read_range(uint32_t address, size_t len, dfu_host_read_sink_t sink, void* ctx)
+{
+    CHECK(sink != NULL, return DFU_HOST_ERR_EINVAL);
+    CHECK(len  != 0,    return DFU_HOST_ERR_EINVAL);
+
+    if (!ldr.active) {
+        return DFU_HOST_ERR_EINVAL;
+    }
+
+    size_t done = 0;
+    int retries = 0;
+
+    /* Каждый проход - READ оставшейся части, повтор после таймаута */
+    while (done < len) {
+
+        if (retries++ > CONFIG_DFU_HOST_LOADER_RETRIES) {
+            return DFU_HOST_ERR_TIMEOUT;
+        }
+
+        const size_t left = len - done;
+        const uint8_t seq0 = ldr.cmd_seq;
+        uint8_t head[8];
+
+        /* seq кадров DATA не пересекаются с кадрами предыдущего чтения */
+        ldr.cmd_seq += (left + ldr.data_max - 1) / ldr.data_max + 1;
+
+        put_le32(head, address + done);
+        put_le32(head + 4, left);
+
+        int rc = frame_send(frame_build(DFU_HOST_LOADER_READ, seq0, head, sizeof(head), NULL, 0));
+        if (rc < 0) {
+            return rc;
+        }
+
+        uint8_t frame = 0;       /* Номер ожидаемого кадра от seq0   */
+        uint8_t reply = 0;       /* Отложенный ответ: ACK, NAK или 0 */
+        bool nak_sent = false;
+        uint8_t stale = 0;       /* Кадров после NAK                 */
+        uint32_t progress = HAL_GetTick();
+
+        while (done < len && HAL_GetTick() - progress < ldr.timeout) {
+
+            if (reply != 0 && !ldr.tx_busy) {
+                rc = reply_send(reply, seq0 + frame);
+                if (rc < 0) {
+                    return rc;
+                }
+
+                reply = 0;
+            }
+
+            rc = rx_poll();
+            if (rc == 0) {
+                continue;
+            }
+
+            if (rc > 0 && rx_type() == DFU_HOST_LOADER_STATUS && rx_seq() == seq0) {
+                LOG_ERROR("Loader read 0x%08lX: status %u", address + done, rx_payload()[0]);
+                return DFU_HOST_ERR_NACK;
+            }
+
+            if (rc > 0 && rx_type() == DFU_HOST_LOADER_DATA && rx_seq() == (uint8_t)(seq0 + frame)) {
+                const size_t n = rx_len();
+
+                if (n == 0 || n > len - done) {
+                    return DFU_HOST_ERR_WRONG_ANS;
+                }
+
+                rc = sink(ctx, address + done, rx_payload(), n);
+                if (rc < 0) {
+                    return rc;
+                }
+
+                done += n;
+                frame += 1;
+                reply = DFU_HOST_LOADER_ACK;
+                nak_sent = false;
+                retries = 0;
+                progress = HAL_GetTick();
+                continue;
+            }
+
+            /* Искажение или пропуск кадра: повтор с ожидаемого. Кадры, переданные
+             * до NAK (не больше окна), повторного NAK не вызывают */
+            if (rc < 0 || rx_type() == DFU_HOST_LOADER_DATA) {
+                if (nak_sent && ++stale > ldr.window) {
+                    nak_sent = false;
+                }
+
+                if (!nak_sent) {
+                    reply = DFU_HOST_LOADER_NAK;
+                    nak_sent = true;
+                    stale = 0;
+                }
+            }
+        }
+
+        /* Подтвердить последний кадр, чтобы загрузчик закончил передачу */
+        if (done == len && reply != 0) {
+            rc = reply_send(reply, seq0 + frame);
+            if (rc < 0) {
+                return rc;
+            }
+        }
+    }
+
+    return tx_wait();
+}
+
+static int read_buf_sink(void* ctx, uint32_t address, const uint8_t* data, size_t len)
+{
+    (void)address;
+
+    uint8_t** dst = ctx;
+
+    memcpy(*dst, data, len);
+    *dst += len;
+
+    return 0;
+}
+
+int dfu_host_loader_read_range_buf(uint32_t address, uint8_t* buf, size_t len)
+{
+    CHECK(buf != NULL, return DFU_HOST_ERR_EINVAL);
+
+    return dfu_host_loader_read_range(address, len, read_buf_sink, &buf);
+}
+
+int dfu_host_loader_write(uint32_t address, const uint8_t* data, size_t len)
+{
+    CHECK(data != NULL, return DFU_HOST_ERR_EINVAL);
+    CHECK(len  != 0,    return DFU_HOST_ERR_EINVAL);
+
+    if (!ldr.active) {
+        return DFU_HOST_ERR_EINVAL;
+    }
+
+    /* После прерванной записи seq загрузчика неизвестен */
+    if (ldr.wr_sync) {
+        int rc = command(DFU_HOST_LOADER_PING, NULL, 0, DFU_HOST_LOADER_ACK, ldr.timeout);
+        if (rc < 0) {
+            return rc;
+        }
+
+        if (rx_len() >= 1) {
+            ldr.wr_seq = rx_payload()[0];
+        }
+
+        ldr.wr_sync = false;
+    }
+
+    const size_t frames = (len + ldr.data_max - 1) / ldr.data_max;
+    const uint8_t base = ldr.wr_seq;
+    size_t next = 0;
+    size_t acked = 0;
+    int retries = 0;
+    uint32_t progress = HAL_GetTick();
+
+    /* Без ACK уходит не больше окна, по NAK или таймауту - повтор с первого
+     * неподтвержденного кадра */
+    ldr.wr_sync = true;
+
+    while (acked < frames) {
+
+        if (!ldr.tx_busy && next < frames && next - acked < ldr.window) {
+            const size_t offset = next * ldr.data_max;
+            uint8_t head[4];
+
+            put_le32(head, address + offset);
+
+            int rc = frame_send(frame_build(DFU_HOST_LOADER_WRITE, base + next, head, sizeof(head),
+                data + offset, MIN(len - offset, ldr.data_max)));
+            if (rc < 0) {
+                return rc;
+            }
+
+            next += 1;
+        }
+
+        if (rx_poll() > 0) {
+            const uint8_t type = rx_type();
+            const size_t ahead = (uint8_t)(rx_seq() - (uint8_t)(base + acked));
+
+            if (type == DFU_HOST_LOADER_STATUS && rx_len() >= 1 &&
+                rx_payload()[0] != DFU_HOST_LOADER_ST_OK) {
+                LOG_ERROR("Loader write 0x%08lX: status %u", address + (acked * ldr.data_max),
+                    rx_payload()[0]);
+                return DFU_HOST_ERR_NACK;
+            }
+
+            if ((type == DFU_HOST_LOADER_ACK || type == DFU_HOST_LOADER_NAK) && ahead <= next - acked) {
+                if (ahead != 0) {
+                    acked += ahead;
+                    retries = 0;
+                    progress = HAL_GetTick();
+                }
+
+                if (type == DFU_HOST_LOADER_NAK) {
+                    next = acked;
+                }
+            }
+        }
+
+        if (HAL_GetTick() - progress > ldr.timeout) {
+            if (++retries > CONFIG_DFU_HOST_LOADER_RETRIES) {
+                return DFU_HOST_ERR_TIMEOUT;
+            }
+
+            next = acked;
+            progress = HAL_GetTick();
+        }
+    }
+
+    ldr.wr_seq = base + frames;
+    ldr.wr_sync = false;
+
+    return DFU_HOST_ERR_NONE;
+}
+
+int dfu_host_loader_erase(uint32_t address, size_t len)
+{
+    CHECK(len != 0, return DFU_HOST_ERR_EINVAL);
+
+    if (!ldr.active) {
+        return DFU_HOST_ERR_EINVAL;
+    }
+
+    uint8_t payload[8];
+
+    put_le32(payload, address);
+    put_le32(payload + 4, len);
+
+    return command(DFU_HOST_LOADER_ERASE, payload, sizeof(payload), DFU_HOST_LOADER_STATUS,
+        CONFIG_DFU_HOST_LOADER_ERASE_TIMEOUT_MS);
+}
+
+int dfu_host_loader_go(uint32_t address)
+{
+    if (!ldr.active) {
+        return DFU_HOST_ERR_EINVAL;
+    }
+
+    uint8_t payload[4];
+
+    put_le32(payload, address);
+
+    int rc = command(DFU_HOST_LOADER_GO, payload, sizeof(payload), DFU_HOST_LOADER_ACK,
+        ldr.timeout);
+    if (rc < 0) {
+        return rc;
+    }
+
+    ldr.active = false;
+
+    return DFU_HOST_ERR_NONE;
+}
@@ -0,0 +1,107 @@
+#ifndef SOURCE_DFU_HOST_DFU_HOST_LOADER_F4_H_
+#define SOURCE_DFU_HOST_DFU_HOST_LOADER_F4_H_
+
+/*
+ * Машинный код загрузчика в SRAM для STM32F40x/41x (dfu_host_loader_f4.S) без
+ * блока параметров, используется только в dfu_host_loader.c. Код располагается
+ * в образе сразу за dfu_host_loader_params_t.
+ */
+
+#include <stdint.h>
+
+static const uint8_t loader_f4_code[] = {
+    0x72U, 0xb6U, 0xdfU, 0xf8U, 0x0cU, 0xb4U, 0xdfU, 0xf8U, 0x0cU, 0x84U, 0x0fU, 0xf2U,
+    0x3cU, 0x47U, 0x07U, 0xf5U, 0x82U, 0x6aU, 0x5fU, 0xf0U, 0x00U, 0x09U, 0x00U, 0x26U,
+    0xffU, 0x48U, 0x01U, 0x68U, 0x41U, 0xf4U, 0x80U, 0x01U, 0x01U, 0x60U, 0xfeU, 0x48U,
+    0x00U, 0x21U, 0x01U, 0x60U, 0x01U, 0x68U, 0x11U, 0xf0U, 0x01U, 0x0fU, 0xfbU, 0xd1U,
+    0xfbU, 0x49U, 0x4fU, 0xf4U, 0x74U, 0x12U, 0x0aU, 0x60U, 0x42U, 0xf2U, 0x00U, 0x01U,
+    0x41U, 0x60U, 0x0bU, 0xf1U, 0x04U, 0x01U, 0x81U, 0x60U, 0xc0U, 0xf8U, 0x0cU, 0xa0U,
+    0xf6U, 0x49U, 0x01U, 0x60U, 0xdbU, 0xf8U, 0x14U, 0x10U, 0x41U, 0xf0U, 0x40U, 0x01U,
+    0xcbU, 0xf8U, 0x14U, 0x10U, 0xf3U, 0x48U, 0x01U, 0x69U, 0x00U, 0x29U, 0x03U, 0xdaU,
+    0xf2U, 0x49U, 0x41U, 0x60U, 0xf2U, 0x49U, 0x41U, 0x60U, 0x0fU, 0xf2U, 0xd4U, 0x32U,
+    0xf1U, 0x49U, 0x11U, 0x60U, 0xdbU, 0xf8U, 0x08U, 0x10U, 0x51U, 0x60U, 0x01U, 0x20U,
+    0x00U, 0x21U, 0x08U, 0x23U, 0x00U, 0xf0U, 0x47U, 0xf9U, 0x00U, 0xf0U, 0x69U, 0xf9U,
+    0x80U, 0xb9U, 0x38U, 0x78U, 0x12U, 0x28U, 0x2cU, 0xd0U, 0x26U, 0xf4U, 0x80U, 0x76U,
+    0x13U, 0x28U, 0x00U, 0xf0U, 0x8cU, 0x80U, 0x10U, 0x28U, 0x11U, 0xd0U, 0x14U, 0x28U,
+    0x45U, 0xd0U, 0x11U, 0x28U, 0x16U, 0xd0U, 0x15U, 0x28U, 0x6aU, 0xd0U, 0xebU, 0xe7U,
+    0x16U, 0xf4U, 0x80U, 0x7fU, 0xe8U, 0xd1U, 0x46U, 0xf4U, 0x80U, 0x76U, 0x03U, 0x20U,
+    0xf1U, 0xb2U, 0x00U, 0x23U, 0x00U, 0xf0U, 0x29U, 0xf9U, 0xe0U, 0xe7U, 0x0fU, 0xf2U,
+    0x80U, 0x32U, 0x16U, 0x70U, 0x02U, 0x20U, 0x79U, 0x78U, 0x01U, 0x23U, 0x00U, 0xf0U,
+    0x20U, 0xf9U, 0xd7U, 0xe7U, 0x02U, 0x20U, 0x79U, 0x78U, 0x00U, 0x23U, 0x00U, 0xf0U,
+    0x1aU, 0xf9U, 0x00U, 0xf0U, 0x92U, 0xf9U, 0xb8U, 0x68U, 0xcbU, 0xf8U, 0x08U, 0x00U,
+    0xccU, 0xe7U, 0x79U, 0x78U, 0xf0U, 0xb2U, 0x81U, 0x42U, 0x13U, 0xd1U, 0x78U, 0x68U,
+    0x07U, 0xf1U, 0x08U, 0x02U, 0x7bU, 0x88U, 0x04U, 0x3bU, 0x00U, 0xf0U, 0xbbU, 0xf8U,
+    0x38U, 0xb9U, 0x01U, 0x36U, 0xf6U, 0xb2U, 0x02U, 0x20U, 0x31U, 0x46U, 0x00U, 0x23U,
+    0x00U, 0xf0U, 0x01U, 0xf9U, 0xb8U, 0xe7U, 0x79U, 0x78U, 0x00U, 0xf0U, 0xf7U, 0xf8U,
+    0xb4U, 0xe7U, 0x40U, 0x1aU, 0xc0U, 0xb2U, 0x80U, 0x28U, 0xc4U, 0xd8U, 0x02U, 0x20U,
+    0xf1U, 0xb2U, 0x00U, 0x23U, 0x00U, 0xf0U, 0xf3U, 0xf8U, 0xaaU, 0xe7U, 0x7cU, 0x68U,
+    0xbdU, 0x68U, 0xa4U, 0xf1U, 0x00U, 0x64U, 0xf5U, 0xb1U, 0x60U, 0x19U, 0x1cU, 0xd2U,
+    0xb0U, 0xf5U, 0x80U, 0x1fU, 0x19U, 0xd8U, 0x01U, 0x38U, 0x00U, 0xf0U, 0xd2U, 0xf8U,
+    0x05U, 0x46U, 0x20U, 0x46U, 0x00U, 0xf0U, 0xceU, 0xf8U, 0x04U, 0x46U, 0xb6U, 0x4aU,
+    0xe1U, 0x00U, 0x41U, 0xf4U, 0x00U, 0x71U, 0x41U, 0xf0U, 0x02U, 0x01U, 0x11U, 0x61U,
+    0x41U, 0xf4U, 0x80U, 0x31U, 0x11U, 0x61U, 0x00U, 0xf0U, 0xb4U, 0xf8U, 0x28U, 0xb9U,
+    0x01U, 0x34U, 0xacU, 0x42U, 0xf0U, 0xd9U, 0x00U, 0x20U, 0x00U, 0xe0U, 0x01U, 0x20U,
+    0x79U, 0x78U, 0x00U, 0xf0U, 0xc4U, 0xf8U, 0x81U, 0xe7U, 0x02U, 0x20U, 0x79U, 0x78U,
+    0x00U, 0x23U, 0x00U, 0xf0U, 0xc4U, 0xf8U, 0x00U, 0xf0U, 0x3cU, 0xf9U, 0xa4U, 0x48U,
+    0x00U, 0x21U, 0x01U, 0x60U, 0xdbU, 0xf8U, 0x14U, 0x10U, 0x21U, 0xf0U, 0x40U, 0x01U,
+    0xcbU, 0xf8U, 0x14U, 0x10U, 0x78U, 0x68U, 0xa6U, 0x49U, 0x08U, 0x60U, 0x01U, 0x68U,
+    0x81U, 0xf3U, 0x08U, 0x88U, 0x41U, 0x68U, 0x62U, 0xb6U, 0x08U, 0x47U, 0x7cU, 0x68U,
+    0xbdU, 0x68U, 0x20U, 0x46U, 0x29U, 0x46U, 0x00U, 0xf0U, 0x49U, 0xf8U, 0x18U, 0xb1U,
+    0x79U, 0x78U, 0x00U, 0xf0U, 0xa0U, 0xf8U, 0x5dU, 0xe7U, 0x79U, 0x78U, 0x00U, 0x20U,
+    0x03U, 0xb4U, 0x01U, 0xb4U, 0x01U, 0x98U, 0xa8U, 0x42U, 0x3aU, 0xd2U, 0x00U, 0x99U,
+    0xa9U, 0x42U, 0x17U, 0xd2U, 0x0aU, 0x1aU, 0xb2U, 0xf5U, 0x80U, 0x5fU, 0x13U, 0xd2U,
+    0x6bU, 0x1aU, 0xb3U, 0xf5U, 0x80U, 0x6fU, 0x88U, 0xbfU, 0x40U, 0xf2U, 0x00U, 0x43U,
+    0xc8U, 0x18U, 0x00U, 0x90U, 0x62U, 0x18U, 0x02U, 0x98U, 0x00U, 0xebU, 0x91U, 0x21U,
+    0xc9U, 0xb2U, 0x20U, 0x20U, 0x00U, 0xf0U, 0x87U, 0xf8U, 0x00U, 0xf0U, 0xd2U, 0xf8U,
+    0x48U, 0x45U, 0xe1U, 0xd0U, 0x00U, 0xf0U, 0xa5U, 0xf8U, 0x00U, 0x28U, 0xddU, 0xd1U,
+    0x38U, 0x78U, 0x02U, 0x28U, 0x04U, 0xd0U, 0x03U, 0x28U, 0x02U, 0xd0U, 0x03U, 0xb0U,
+    0x00U, 0x20U, 0x31U, 0xe7U, 0x79U, 0x78U, 0x02U, 0x9aU, 0x89U, 0x1aU, 0x01U, 0x9aU,
+    0x93U, 0x0aU, 0xc9U, 0x1aU, 0xc9U, 0xb2U, 0x19U, 0x44U, 0x89U, 0x02U, 0xa9U, 0x42U,
+    0x88U, 0xbfU, 0x29U, 0x46U, 0x00U, 0x9bU, 0x99U, 0x42U, 0xc6U, 0xd8U, 0x01U, 0x91U,
+    0x03U, 0x28U, 0x08U, 0xbfU, 0x00U, 0x91U, 0xc1U, 0xe7U, 0x03U, 0xb0U, 0x19U, 0xe7U,
+    0x69U, 0xb1U, 0xa0U, 0xf1U, 0x00U, 0x62U, 0x53U, 0x18U, 0x02U, 0xd2U, 0xb3U, 0xf5U,
+    0x80U, 0x1fU, 0x08U, 0xd9U, 0xa0U, 0xf1U, 0x00U, 0x52U, 0x53U, 0x18U, 0x02U, 0xd2U,
+    0xb3U, 0xf5U, 0x00U, 0x3fU, 0x01U, 0xd9U, 0x01U, 0x20U, 0x70U, 0x47U, 0x00U, 0x20U,
+    0x70U, 0x47U, 0x00U, 0xb5U, 0x19U, 0x46U, 0x0dU, 0xb4U, 0xffU, 0xf7U, 0xe8U, 0xffU,
+    0x0eU, 0xbcU, 0x28U, 0xbbU, 0xa1U, 0xf1U, 0x00U, 0x60U, 0xb0U, 0xf5U, 0x80U, 0x1fU,
+    0x07U, 0xd3U, 0x12U, 0xf8U, 0x01U, 0x0bU, 0x01U, 0xf8U, 0x01U, 0x0bU, 0x01U, 0x3bU,
+    0xf9U, 0xd1U, 0x00U, 0x20U, 0x00U, 0xbdU, 0x41U, 0xeaU, 0x03U, 0x00U, 0x10U, 0xf0U,
+    0x03U, 0x0fU, 0x12U, 0xd1U, 0x60U, 0x48U, 0x40U, 0xf2U, 0x01U, 0x2cU, 0xc0U, 0xf8U,
+    0x10U, 0xc0U, 0x52U, 0xf8U, 0x04U, 0xcbU, 0x41U, 0xf8U, 0x04U, 0xcbU, 0xd0U, 0xf8U,
+    0x0cU, 0xc0U, 0x1cU, 0xf4U, 0x80U, 0x3fU, 0xfaU, 0xd1U, 0x04U, 0x3bU, 0xf4U, 0xd1U,
+    0x5dU, 0xf8U, 0x04U, 0xebU, 0x01U, 0xe0U, 0x01U, 0x20U, 0x00U, 0xbdU, 0x56U, 0x4aU,
+    0xd0U, 0x68U, 0x10U, 0xf4U, 0x80U, 0x3fU, 0xfbU, 0xd1U, 0x00U, 0x21U, 0x11U, 0x61U,
+    0x10U, 0xf0U, 0xf0U, 0x00U, 0x01U, 0xd0U, 0xd0U, 0x60U, 0x02U, 0x20U, 0x70U, 0x47U,
+    0xb0U, 0xf5U, 0x80U, 0x3fU, 0x01U, 0xd2U, 0x80U, 0x0bU, 0x70U, 0x47U, 0xb0U, 0xf5U,
+    0x00U, 0x3fU, 0x01U, 0xd2U, 0x04U, 0x20U, 0x70U, 0x47U, 0x40U, 0x0cU, 0x04U, 0x30U,
+    0x70U, 0x47U, 0x0fU, 0xf2U, 0x3cU, 0x12U, 0x10U, 0x70U, 0x04U, 0x20U, 0x01U, 0x23U,
+    0xffU, 0xe7U, 0x30U, 0xb5U, 0x0cU, 0x46U, 0x05U, 0x46U, 0xa5U, 0x20U, 0x00U, 0xf0U,
+    0x6cU, 0xf8U, 0x28U, 0x46U, 0x4fU, 0xf0U, 0xffU, 0x35U, 0x00U, 0xf0U, 0x62U, 0xf8U,
+    0x20U, 0x46U, 0x00U, 0xf0U, 0x5fU, 0xf8U, 0xd8U, 0xb2U, 0x00U, 0xf0U, 0x5cU, 0xf8U,
+    0x18U, 0x0aU, 0x00U, 0xf0U, 0x59U, 0xf8U, 0x2bU, 0xb1U, 0x12U, 0xf8U, 0x01U, 0x0bU,
+    0x00U, 0xf0U, 0x54U, 0xf8U, 0x01U, 0x3bU, 0xf9U, 0xd1U, 0xecU, 0x43U, 0x04U, 0x23U,
+    0xe0U, 0xb2U, 0x00U, 0xf0U, 0x52U, 0xf8U, 0x24U, 0x0aU, 0x01U, 0x3bU, 0xf9U, 0xd1U,
+    0x30U, 0xbdU, 0x30U, 0xb5U, 0x00U, 0xf0U, 0x2fU, 0xf8U, 0xa5U, 0x28U, 0xfbU, 0xd1U,
+    0x4fU, 0xf0U, 0xffU, 0x35U, 0x3cU, 0x46U, 0x04U, 0x23U, 0x00U, 0xf0U, 0x27U, 0xf8U,
+    0x04U, 0xf8U, 0x01U, 0x0bU, 0x00U, 0xf0U, 0x2fU, 0xf8U, 0x01U, 0x3bU, 0xf7U, 0xd1U,
+    0x7bU, 0x88U, 0xb3U, 0xf5U, 0x81U, 0x6fU, 0xebU, 0xd8U, 0x3bU, 0xb1U, 0x00U, 0xf0U,
+    0x1aU, 0xf8U, 0x04U, 0xf8U, 0x01U, 0x0bU, 0x00U, 0xf0U, 0x22U, 0xf8U, 0x01U, 0x3bU,
+    0xf7U, 0xd1U, 0x00U, 0x22U, 0x00U, 0xf0U, 0x11U, 0xf8U, 0x98U, 0x40U, 0x02U, 0x43U,
+    0x08U, 0x33U, 0x20U, 0x2bU, 0xf8U, 0xd1U, 0xedU, 0x43U, 0x50U, 0x1bU, 0x30U, 0xbdU,
+    0xd8U, 0xf8U, 0x00U, 0x00U, 0xc0U, 0xf5U, 0x00U, 0x50U, 0xb0U, 0xf5U, 0x00U, 0x5fU,
+    0x08U, 0xbfU, 0x00U, 0x20U, 0x70U, 0x47U, 0x00U, 0xb5U, 0xffU, 0xf7U, 0xf4U, 0xffU,
+    0x48U, 0x45U, 0xfbU, 0xd0U, 0x1aU, 0xf8U, 0x09U, 0x00U, 0x09U, 0xf1U, 0x01U, 0x09U,
+    0x6fU, 0xf3U, 0x5fU, 0x39U, 0x00U, 0xbdU, 0x45U, 0x40U, 0x19U, 0x49U, 0x4fU, 0xf0U,
+    0x08U, 0x0cU, 0x6dU, 0x08U, 0x28U, 0xbfU, 0x4dU, 0x40U, 0xbcU, 0xf1U, 0x01U, 0x0cU,
+    0xf9U, 0xd1U, 0x70U, 0x47U, 0x01U, 0xb5U, 0xffU, 0xf7U, 0xf2U, 0xffU, 0xbdU, 0xe8U,
+    0x01U, 0x40U, 0xdbU, 0xf8U, 0x00U, 0x10U, 0x11U, 0xf0U, 0x80U, 0x0fU, 0xfaU, 0xd0U,
+    0xcbU, 0xf8U, 0x04U, 0x00U, 0x70U, 0x47U, 0xdbU, 0xf8U, 0x00U, 0x10U, 0x11U, 0xf0U,
+    0x40U, 0x0fU, 0xfaU, 0xd0U, 0x70U, 0x47U, 0x00U, 0x00U, 0x00U, 0x10U, 0x01U, 0x40U,
+    0x44U, 0x64U, 0x02U, 0x40U, 0x30U, 0x38U, 0x02U, 0x40U, 0x40U, 0x64U, 0x02U, 0x40U,
+    0x08U, 0x64U, 0x02U, 0x40U, 0x01U, 0x05U, 0x00U, 0x08U, 0x00U, 0x3cU, 0x02U, 0x40U,
+    0x23U, 0x01U, 0x67U, 0x45U, 0xabU, 0x89U, 0xefU, 0xcdU, 0x01U, 0x04U, 0x00U, 0x04U,
+    0x08U, 0xedU, 0x00U, 0xe0U, 0x20U, 0x83U, 0xb8U, 0xedU, 0x00U, 0x00U, 0x00U, 0x00U,
+    0x00U, 0x00U, 0x00U, 0x00U,
+};
+
+#endif /* SOURCE_DFU_HOST_DFU_HOST_LOADER_F4_H_ */
@@ -0,0 +1,48 @@
+#ifndef DFU_HOST_PROTO_H__
+#define DFU_HOST_PROTO_H__
+
+/*
+ * Служебные байты протокола системного загрузчика STM32, общие для
+ * транспортов dfu_host (AN3155, AN4221, AN4286).
+ */
+
+#include <stdint.h>
+
+/**
+ * @brief  Перечисление возможных ответов бутлоадера.
+ */
+typedef enum {
+    DFU_HOST_RESP_ACK  = 0x79,
+    DFU_HOST_RESP_NACK = 0x1F,
+    DFU_HOST_RESP_BUSY = 0x76, /* I2C: команда еще выполняется (AN4221) */
+} resp_value_t;
+
+/* Байт синхронизации USART: по нему загрузчик определяет скорость */
+#define DFU_HOST_UART_SYNC  0x7F
+
+/* Байт начала кадра команды SPI (и синхронизации) */
+#define DFU_HOST_SPI_SOF    0x5A
+/* Байт, передаваемый хостом при чтении по SPI */
+#define DFU_HOST_SPI_DUMMY  0x00
+
+/* Поля little-endian образов и кадров, загружаемых в устройство */
+static inline void put_le32(uint8_t* dst, uint32_t value)
+{
+    dst[0] = value;
+    dst[1] = value >> 8;
+    dst[2] = value >> 16;
+    dst[3] = value >> 24;
+}
+
+static inline uint32_t get_le32(const uint8_t* src)
+{
+    return (uint32_t)src[0] | ((uint32_t)src[1] << 8) | ((uint32_t)src[2] << 16) |
+           ((uint32_t)src[3] << 24);
+}
+
+static inline uint16_t get_le16(const uint8_t* src)
+{
+    return (uint16_t)(src[0] | (src[1] << 8));
+}
+
+#endif /* !DFU_HOST_PROTO_H__ */
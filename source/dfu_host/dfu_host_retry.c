@@ -0,0 +1,86 @@
+#include <stddef.h>
+
+#include "dfu_host.h"
+#include "dfu_host_retry.h"
+#include "dfu_host_transport.h"
+#include "core/assert.h"
+#include "core/util.h"
+
+/* xorshift32: разброс задержек не требует качественного генератора */
+static uint32_t retry_random(dfu_host_retry_t* retry)
+{
+    uint32_t x = retry->rng;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+
+    retry->rng = x;
+
+    return x;
+}
+
+void dfu_host_retry_init(dfu_host_retry_t* retry, const dfu_host_retry_cfg_t* cfg)
+{
+    ASSERT_NO_MSG(retry != NULL);
+    ASSERT_NO_MSG(cfg != NULL && cfg->attempts != 0);
+
+    retry->cfg         = cfg;
+    retry->failures    = 0;
+    retry->first_tick  = 0;
+    retry->resume_tick = HAL_GetTick();
+    /* Нулевое состояние xorshift не меняется */
+    retry->rng         = (retry->resume_tick ^ (uint32_t)(uintptr_t)retry) | 1U;
+}
+
+bool dfu_host_retry_failed(dfu_host_retry_t* retry, int rc)
+{
+    const dfu_host_retry_cfg_t* cfg = retry->cfg;
+    const uint32_t now = HAL_GetTick();
+
+    /* Ошибка вызова повтором не исправится */
+    if (rc == DFU_HOST_ERR_EINVAL || rc == DFU_HOST_ERR_BUSY) {
+        return false;
+    }
+
+    if (retry->failures == 0) {
+        retry->first_tick = now;
+    }
+
+    if (++retry->failures >= cfg->attempts) {
+        return false;
+    }
+
+    if (cfg->budget_ms != 0 && now - retry->first_tick >= cfg->budget_ms) {
+        return false;
+    }
+
+    /* Ошибка приема обнаружена сразу, а не по таймауту: линия свободна,
+     * запрос можно повторить без задержки */
+    if (rc == DFU_HOST_ERR_LINE) {
+        retry->resume_tick = now;
+        return true;
+    }
+
+    uint32_t bound = cfg->backoff_ms;
+
+    for (uint8_t i = 1; i < retry->failures && bound < cfg->backoff_max_ms; ++i) {
+        bound <<= 1;
+    }
+
+    bound = MIN(bound, cfg->backoff_max_ms);
+    retry->resume_tick = now + ((bound != 0) ? retry_random(retry) % (bound + 1) : 0);
+
+    return true;
+}
+
+bool dfu_host_retry_ready(const dfu_host_retry_t* retry)
+{
+    /* Без ошибок задержки нет, время не читается */
+    return retry->failures == 0 || (int32_t)(HAL_GetTick() - retry->resume_tick) >= 0;
+}
+
+void dfu_host_retry_success(dfu_host_retry_t* retry)
+{
+    retry->failures = 0;
+}
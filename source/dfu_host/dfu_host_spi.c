@@ -0,0 +1,256 @@
+#include <string.h>
+
+#include "dfu_host_transport.h"
+#include "dfu_host_proto.h"
+#include "core/assert.h"
+
+#ifdef HAL_SPI_MODULE_ENABLED
+
+/* Таймаут обмена одним блоком по SPI в милисекундах */
+#ifndef CONFIG_DFU_HOST_SPI_XFER_TIMEOUT_MS
+#define CONFIG_DFU_HOST_SPI_XFER_TIMEOUT_MS 10
+#endif /* CONFIG_DFU_HOST_SPI_XFER_TIMEOUT_MS */
+
+/* Количество SPI, на которых одновременно работают экземпляры dfu_host */
+#ifndef CONFIG_DFU_HOST_SPI_PORTS
+#define CONFIG_DFU_HOST_SPI_PORTS 1
+#endif /* CONFIG_DFU_HOST_SPI_PORTS */
+
+/* Байт, который выдает загрузчик, пока ему нечего передать */
+#define SPI_IDLE 0xA5
+
+/* Транспорт на одном SPI, ctx транспорта - его handle */
+typedef struct {
+    SPI_HandleTypeDef* hspi; /* NULL - порт свободен */
+    dfu_host_transport_t transport;
+} spi_port_t;
+
+static spi_port_t ports[CONFIG_DFU_HOST_SPI_PORTS];
+
+/* Обменяться одним байтом с устройством */
+static int spi_xfer(SPI_HandleTypeDef* hspi, uint8_t tx, uint8_t* rx)
+{
+    uint8_t data = 0;
+
+    if (HAL_SPI_TransmitReceive(hspi, &tx, &data, 1, CONFIG_DFU_HOST_SPI_XFER_TIMEOUT_MS) != HAL_OK) {
+        return DFU_HOST_ERR_EIO;
+    }
+
+    if (rx != NULL) {
+        *rx = data;
+    }
+
+    return DFU_HOST_ERR_NONE;
+}
+
+/* Подтвердить загрузчику прием ACK/NACK и вернуть результат */
+static int spi_ack_confirm(SPI_HandleTypeDef* hspi, uint8_t resp)
+{
+    int rc = spi_xfer(hspi, DFU_HOST_RESP_ACK, NULL);
+    if (rc < 0) {
+        return rc;
+    }
+
+    return (resp == DFU_HOST_RESP_ACK) ? DFU_HOST_ERR_NONE : DFU_HOST_ERR_NACK;
+}
+
+/* Процедура получения ACK (AN4286): опрашивать устройство, пока оно не выдаст ACK/NACK */
+static int spi_get_ack(SPI_HandleTypeDef* hspi, uint32_t timeout)
+{
+    const uint32_t start = HAL_GetTick();
+
+    while (1) {
+        uint8_t resp = 0;
+
+        int rc = spi_xfer(hspi, DFU_HOST_SPI_DUMMY, &resp);
+        if (rc < 0) {
+            return rc;
+        }
+
+        if (resp == DFU_HOST_RESP_ACK || resp == DFU_HOST_RESP_NACK) {
+            return spi_ack_confirm(hspi, resp);
+        }
+
+        if (HAL_GetTick() - start >= timeout) {
+            return DFU_HOST_ERR_TIMEOUT;
+        }
+    }
+}
+
+static int spi_send(void* ctx, const uint8_t* data, size_t len, bool cmd)
+{
+    SPI_HandleTypeDef* hspi = ctx;
+
+    /* Кадр команды начинается с байта 0x5A */
+    if (cmd) {
+        int rc = spi_xfer(hspi, DFU_HOST_SPI_SOF, NULL);
+        if (rc < 0) {
+            return rc;
+        }
+    }
+
+    for (size_t i = 0; i < len; ++i) {
+        int rc = spi_xfer(hspi, data[i], NULL);
+        if (rc < 0) {
+            return rc;
+        }
+    }
+
+    return DFU_HOST_ERR_NONE;
+}
+
+static int spi_sync(void* ctx, uint32_t timeout)
+{
+    SPI_HandleTypeDef* hspi = ctx;
+
+    int rc = spi_xfer(hspi, DFU_HOST_SPI_SOF, NULL);
+    if (rc < 0) {
+        return rc;
+    }
+
+    return spi_get_ack(hspi, timeout);
+}
+
+static ssize_t spi_recv_exact(void* ctx, uint8_t* buf, size_t len, uint32_t timeout)
+{
+    SPI_HandleTypeDef* hspi = ctx;
+    (void)timeout;
+
+    /* Данные следуют за одним холостым байтом */
+    int rc = spi_xfer(hspi, DFU_HOST_SPI_DUMMY, NULL);
+    if (rc < 0) {
+        return rc;
+    }
+
+    /* Передаваемые при чтении байты устройство не анализирует */
+    memset(buf, DFU_HOST_SPI_DUMMY, len);
+
+    if (HAL_SPI_TransmitReceive(hspi, buf, buf, len, CONFIG_DFU_HOST_SPI_XFER_TIMEOUT_MS) != HAL_OK) {
+        return DFU_HOST_ERR_EIO;
+    }
+
+    return len;
+}
+
+static ssize_t spi_recv_sized(void* ctx, uint8_t* buf, size_t size, uint32_t timeout)
+{
+    SPI_HandleTypeDef* hspi = ctx;
+
+    CHECK(buf != NULL && size >= 2, return DFU_HOST_ERR_EINVAL);
+
+    /* Холостой байт и байт длины */
+    ssize_t rc = spi_recv_exact(ctx, buf, 1, timeout);
+    if (rc < 0) {
+        return rc;
+    }
+
+    const size_t len = (size_t)buf[0] + 2;
+
+    if (len > size) {
+        return DFU_HOST_ERR_OVERFLOW;
+    }
+
+    memset(buf + 1, DFU_HOST_SPI_DUMMY, len - 1);
+
+    if (HAL_SPI_TransmitReceive(hspi, buf + 1, buf + 1, len - 1,
+        CONFIG_DFU_HOST_SPI_XFER_TIMEOUT_MS) != HAL_OK) {
+        return DFU_HOST_ERR_EIO;
+    }
+
+    rc = spi_get_ack(hspi, timeout);
+
+    return (rc < 0) ? rc : (ssize_t)len;
+}
+
+static ssize_t spi_recv_until_ack(void* ctx, uint8_t* buf, size_t size, uint32_t timeout)
+{
+    SPI_HandleTypeDef* hspi = ctx;
+
+    if (size == 0) {
+        return spi_get_ack(hspi, timeout);
+    }
+
+    const uint32_t start = HAL_GetTick();
+    bool   data  = false; /* Холостой байт начала данных уже принят */
+    size_t count = 0;
+
+    while (1) {
+        uint8_t resp = 0;
+
+        int rc = spi_xfer(hspi, DFU_HOST_SPI_DUMMY, &resp);
+        if (rc < 0) {
+            return rc;
+        }
+
+        if (!data) {
+            /* Устройство еще не готово к ответу */
+            if (resp == SPI_IDLE) {
+                if (HAL_GetTick() - start >= timeout) {
+                    return DFU_HOST_ERR_TIMEOUT;
+                }
+
+                continue;
+            }
+
+            /* Ответ без данных */
+            if (resp == DFU_HOST_RESP_ACK || resp == DFU_HOST_RESP_NACK) {
+                return spi_ack_confirm(hspi, resp);
+            }
+
+            data = true;
+            continue;
+        }
+
+        if (resp == DFU_HOST_RESP_ACK || resp == DFU_HOST_RESP_NACK) {
+            rc = spi_ack_confirm(hspi, resp);
+            return (rc < 0) ? rc : (ssize_t)count;
+        }
+
+        if (count == size) {
+            return DFU_HOST_ERR_OVERFLOW;
+        }
+
+        buf[count++] = resp;
+
+        if (HAL_GetTick() - start >= timeout) {
+            return DFU_HOST_ERR_TIMEOUT;
+        }
+    }
+}
+
+static const dfu_host_transport_t spi_transport = {
+    .sync           = spi_sync,
+    .send           = spi_send,
+    .recv_exact     = spi_recv_exact,
+    .recv_until_ack = spi_recv_until_ack,
+    .recv_sized     = spi_recv_sized,
+    .name           = "SPI",
+};
+
+const dfu_host_transport_t* dfu_host_transport_spi(SPI_HandleTypeDef* handle)
+{
+    ASSERT_NO_MSG(handle != NULL);
+
+    spi_port_t* port = NULL;
+
+    /* Порт этого SPI или первый свободный */
+    for (size_t i = 0; i < ARRAY_SIZE(ports); i++) {
+        if (ports[i].hspi == handle) {
+            port = &ports[i];
+            break;
+        }
+        if (ports[i].hspi == NULL && port == NULL) {
+            port = &ports[i];
+        }
+    }
+
+    CHECK(port != NULL, return NULL);
+
+    port->hspi          = handle;
+    port->transport     = spi_transport;
+    port->transport.ctx = handle;
+
+    return &port->transport;
+}
+
+#endif /* HAL_SPI_MODULE_ENABLED */
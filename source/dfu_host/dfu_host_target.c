@@ -0,0 +1,155 @@
+#include "dfu_host_target.h"
+#include "core/assert.h"
+
+/* Идентификаторы продуктов STM32 (DBGMCU_IDCODE.DEV_ID) лежат в 0x400..0x4FF */
+#define TARGET_PID_BASE  0x0400U
+#define TARGET_PID_RANGE 0x0100U
+
+/* Блок CRC STM32F1/F3: тактирование в RCC_AHBENR */
+#define CRC_HW_F1 { .crc_base = 0x40023000, .rcc_reg = 0x40021014, .rcc_bit = 1U << 6 }
+/* Блок CRC STM32F4: тактирование в RCC_AHB1ENR */
+#define CRC_HW_F4 { .crc_base = 0x40023000, .rcc_reg = 0x40023830, .rcc_bit = 1U << 12 }
+/* Блок CRC STM32L4: тактирование в RCC_AHB1ENR */
+#define CRC_HW_L4 { .crc_base = 0x40023000, .rcc_reg = 0x40021048, .rcc_bit = 1U << 12 }
+
+/* Секторы STM32F4 (RM0090): банк 1, у двухбанковых F42x/F43x за ним такой же банк 2.
+ * Устройства с меньшей Flash используют начало списка */
+static const uint32_t f4_sectors[] = {
+    0x4000, 0x4000, 0x4000, 0x4000, 0x10000,
+    0x20000, 0x20000, 0x20000, 0x20000, 0x20000, 0x20000, 0x20000,
+    0x4000, 0x4000, 0x4000, 0x4000, 0x10000,
+    0x20000, 0x20000, 0x20000, 0x20000, 0x20000, 0x20000, 0x20000,
+};
+
+/* Flash STM32F4 из первых count секторов f4_sectors */
+#define FLASH_F4(size_, count) \
+    { .base = 0x08000000, .size = (size_), .sector_sizes = f4_sectors, .sector_count = (count) }
+/* Flash из страниц одного размера */
+#define FLASH_PAGES(page, count) \
+    { .base = 0x08000000, .size = (page) * (count), .sector_size = (page), .sector_count = (count) }
+
+/* Устройства в таблице; номер - индекс в target_table */
+typedef enum {
+    TARGET_F10X_MD,
+    TARGET_F10X_HD,
+    TARGET_F30X,
+    TARGET_F37X,
+    TARGET_F401XC,
+    TARGET_F401XE,
+    TARGET_F405,
+    TARGET_F411,
+    TARGET_F42X,
+    TARGET_F446,
+    TARGET_L47X,
+    TARGET_COUNT,
+} target_id_t;
+
+/* Карты памяти (AN2606: область SRAM системного загрузчика, RM: остальное) */
+static const dfu_host_target_t target_table[TARGET_COUNT] = {
+    [TARGET_F10X_MD] = {
+        .pid = 0x0410, .name = "F10x medium-density", .flash = FLASH_PAGES(0x400, 128),
+        .sram = { 0x20000000, 0x5000 }, .sram_free = 0x20000200,
+        .system = { 0x1FFFF000, 0x800 }, .option = { 0x1FFFF800, 0x10 }, .crc = CRC_HW_F1,
+    },
+    [TARGET_F10X_HD] = {
+        .pid = 0x0414, .name = "F10x high-density", .flash = FLASH_PAGES(0x800, 256),
+        .sram = { 0x20000000, 0x10000 }, .sram_free = 0x20000800,
+        .system = { 0x1FFFF000, 0x800 }, .option = { 0x1FFFF800, 0x10 }, .crc = CRC_HW_F1,
+    },
+    [TARGET_F30X] = {
+        .pid = 0x0422, .name = "F30x/F31x", .flash = FLASH_PAGES(0x800, 128),
+        .sram = { 0x20000000, 0x8000 }, .sram_free = 0x20001800,
+        .system = { 0x1FFFD800, 0x2000 }, .option = { 0x1FFFF800, 0x10 }, .crc = CRC_HW_F1,
+    },
+    [TARGET_F37X] = {
+        .pid = 0x0432, .name = "F37x", .flash = FLASH_PAGES(0x800, 128),
+        .sram = { 0x20000000, 0x8000 }, .sram_free = 0x20001800,
+        .system = { 0x1FFFD800, 0x2000 }, .option = { 0x1FFFF800, 0x10 }, .crc = CRC_HW_F1,
+    },
+    [TARGET_F401XC] = {
+        .pid = 0x0423, .name = "F401xB/C", .flash = FLASH_F4(0x40000, 6),
+        .sram = { 0x20000000, 0x10000 }, .sram_free = 0x20003000,
+        .system = { 0x1FFF0000, 0x7800 }, .option = { 0x1FFFC000, 0x10 }, .crc = CRC_HW_F4,
+    },
+    [TARGET_F401XE] = {
+        .pid = 0x0433, .name = "F401xD/E", .flash = FLASH_F4(0x80000, 8),
+        .sram = { 0x20000000, 0x18000 }, .sram_free = 0x20003000,
+        .system = { 0x1FFF0000, 0x7800 }, .option = { 0x1FFFC000, 0x10 }, .crc = CRC_HW_F4,
+    },
+    [TARGET_F405] = {
+        .pid = 0x0413, .name = "F405/F407", .flash = FLASH_F4(0x100000, 12),
+        .sram = { 0x20000000, 0x20000 }, .sram_free = 0x20003000,
+        .system = { 0x1FFF0000, 0x7800 }, .option = { 0x1FFFC000, 0x10 }, .crc = CRC_HW_F4,
+    },
+    [TARGET_F411] = {
+        .pid = 0x0431, .name = "F411", .flash = FLASH_F4(0x80000, 8),
+        .sram = { 0x20000000, 0x20000 }, .sram_free = 0x20003000,
+        .system = { 0x1FFF0000, 0x7800 }, .option = { 0x1FFFC000, 0x10 }, .crc = CRC_HW_F4,
+    },
+    [TARGET_F42X] = {
+        .pid = 0x0419, .name = "F42x/F43x", .flash = FLASH_F4(0x200000, 24),
+        .sram = { 0x20000000, 0x30000 }, .sram_free = 0x20003000,
+        .system = { 0x1FFF0000, 0x7800 }, .option = { 0x1FFFC000, 0x10 }, .crc = CRC_HW_F4,
+    },
+    [TARGET_F446] = {
+        .pid = 0x0421, .name = "F446", .flash = FLASH_F4(0x80000, 8),
+        .sram = { 0x20000000, 0x20000 }, .sram_free = 0x20003000,
+        .system = { 0x1FFF0000, 0x7800 }, .option = { 0x1FFFC000, 0x10 }, .crc = CRC_HW_F4,
+    },
+    [TARGET_L47X] = {
+        .pid = 0x0415, .name = "L47x/L48x", .flash = FLASH_PAGES(0x800, 512),
+        .sram = { 0x20000000, 0x18000 }, .sram_free = 0x20003000,
+        .system = { 0x1FFF0000, 0x7000 }, .option = { 0x1FFF7800, 0x10 }, .crc = CRC_HW_L4,
+    },
+};
+
+/* Номер устройства + 1 по (PID - TARGET_PID_BASE), 0 - устройство неизвестно */
+static const uint8_t target_index[TARGET_PID_RANGE] = {
+    [0x0410 - TARGET_PID_BASE] = TARGET_F10X_MD + 1,
+    [0x0414 - TARGET_PID_BASE] = TARGET_F10X_HD + 1,
+    [0x0422 - TARGET_PID_BASE] = TARGET_F30X + 1,
+    [0x0432 - TARGET_PID_BASE] = TARGET_F37X + 1,
+    [0x0423 - TARGET_PID_BASE] = TARGET_F401XC + 1,
+    [0x0433 - TARGET_PID_BASE] = TARGET_F401XE + 1,
+    [0x0413 - TARGET_PID_BASE] = TARGET_F405 + 1,
+    [0x0431 - TARGET_PID_BASE] = TARGET_F411 + 1,
+    [0x0419 - TARGET_PID_BASE] = TARGET_F42X + 1,
+    [0x0421 - TARGET_PID_BASE] = TARGET_F446 + 1,
+    [0x0415 - TARGET_PID_BASE] = TARGET_L47X + 1,
+};
+
+const dfu_host_target_t* dfu_host_target_find(uint16_t pid)
+{
+    if (pid < TARGET_PID_BASE || pid - TARGET_PID_BASE >= TARGET_PID_RANGE) {
+        return NULL;
+    }
+
+    const uint8_t index = target_index[pid - TARGET_PID_BASE];
+    if (index == 0) {
+        return NULL;
+    }
+
+    const dfu_host_target_t* target = &target_table[index - 1];
+
+    ASSERT_NO_MSG(target->pid == pid);
+
+    return target;
+}
+
+bool dfu_host_target_sram_fits(const dfu_host_target_t* target, uint32_t address, size_t len)
+{
+    CHECK(target != NULL, return false);
+
+    const uint32_t end = target->sram.base + target->sram.size;
+
+    return address >= target->sram_free && address < end && len <= end - address;
+}
+
+bool dfu_host_target_in_flash(const dfu_host_target_t* target, uint32_t address, size_t len)
+{
+    CHECK(target != NULL, return false);
+
+    const uint32_t end = target->flash.base + target->flash.size;
+
+    return address >= target->flash.base && address < end && len <= end - address;
+}
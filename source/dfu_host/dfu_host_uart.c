@@ -0,0 +1,555 @@
+#include <string.h>
+
+#include "dfu_host_transport.h"
+#include "dfu_host_proto.h"
+#include "core/assert.h"
+
+#ifdef CONFIG_DFU_LOADER
+#include "dfu_host_loader.h"
+#endif /* CONFIG_DFU_LOADER */
+
+/************************* LOG SETTINGS ****************************/
+
+#define LOG_MODULE_PRINTABLE_NAME "DFU"
+#define LOG_MODULE_LOG_LEVEL 4U
+#define LOG_MODULE_IS_ENABLED (!defined(NDEBUG))
+#define LOG_MODULE_IS_TIMESTAMP_ENABLED 1
+#define LOG_MODULE_IS_FUNC_NAME_ENABLED 1
+
+#include "logging.h"
+
+/*******************************************************************/
+
+/* Размер кольцевого буфера приема, больше самого длинного ответа */
+#ifndef CONFIG_DFU_HOST_RX_RING_SIZE
+#define CONFIG_DFU_HOST_RX_RING_SIZE 512
+#endif /* CONFIG_DFU_HOST_RX_RING_SIZE */
+
+#ifdef CONFIG_DFU_LOADER
+/* Загрузчик передает окно кадров DATA, не дожидаясь подтверждения: если хост
+ * отстал, DMA не должен затереть непрочитанные кадры */
+BUILD_ASSERT(CONFIG_DFU_HOST_RX_RING_SIZE >=
+    CONFIG_DFU_HOST_LOADER_WINDOW * (DFU_HOST_LOADER_DATA_MAX + DFU_HOST_LOADER_OVERHEAD),
+    "CONFIG_DFU_HOST_RX_RING_SIZE must hold a full loader window");
+#endif /* CONFIG_DFU_LOADER */
+
+/* Тишина на линии, после которой искаженный ответ считается законченным, мс.
+ * Загрузчик не принимает команды, пока передает ответ, поэтому повтор
+ * запроса нужно отправить после его окончания */
+#ifndef CONFIG_DFU_HOST_UART_IDLE_MS
+#define CONFIG_DFU_HOST_UART_IDLE_MS 2
+#endif /* CONFIG_DFU_HOST_UART_IDLE_MS */
+
+/* Количество UART, на которых одновременно работают экземпляры dfu_host */
+#ifndef CONFIG_DFU_HOST_UART_PORTS
+#define CONFIG_DFU_HOST_UART_PORTS 1
+#endif /* CONFIG_DFU_HOST_UART_PORTS */
+
+/* Текущая операция приема */
+typedef enum {
+    RX_OP_NONE,       /* Прием не запрошен, байты копятся в кольцевом буфере */
+    RX_OP_EXACT,      /* Ровно rx_size байт */
+    RX_OP_UNTIL_ACK,  /* Данные до ACK/NACK, не больше rx_size байт */
+    RX_OP_SIZED,      /* Байт длины N, еще N + 1 байт и ACK/NACK */
+} rx_op_t;
+
+/* Порт UART: состояние транспорта на одном UART */
+typedef struct {
+    UART_HandleTypeDef* huart;       /* NULL - порт свободен */
+    dfu_host_transport_t transport;  /* Транспорт с ctx, указывающим на порт */
+
+    /* Кольцевой буфер, в который непрерывно пишет DMA или прерывание приема */
+    uint8_t rx_ring[CONFIG_DFU_HOST_RX_RING_SIZE];
+    size_t  rx_ring_tail;            /* Позиция чтения из кольцевого буфера */
+    volatile size_t rx_it_head;      /* Позиция записи при приеме по прерываниям */
+    uint8_t rx_it_byte;              /* Байт, принимаемый по прерыванию */
+#ifdef CONFIG_DFU_HOST_RX_DMA
+    bool    rx_dma;                  /* Прием идет по DMA, иначе - по прерываниям */
+#endif /* CONFIG_DFU_HOST_RX_DMA */
+
+    /* Текущий асинхронный прием, его продвигает uart_poll() */
+    volatile rx_op_t rx_op;
+    uint8_t* rx_buf;
+    size_t   rx_size;
+    size_t   rx_count;
+    size_t   rx_need;                /* Байт, которые копируются без разбора (EXACT, SIZED) */
+    dfu_host_transport_done_t rx_done;
+    void*    rx_arg;
+
+    /* Текущая передача, завершается из прерывания */
+    volatile dfu_host_transport_done_t tx_done;
+    void*    tx_arg;
+
+    /* Ошибки приема: флаг для uart_poll(), остаток искаженного ответа и счетчики */
+    volatile bool rx_error;
+    bool     rx_drain;               /* Ждать тишины перед окончанием приема */
+    uint32_t rx_drain_tick;          /* Последний байт остатка ответа        */
+    dfu_host_link_stats_t link_stats;
+} uart_port_t;
+
+static uart_port_t ports[CONFIG_DFU_HOST_UART_PORTS];
+
+/* Порт, которому принадлежит UART. Функции HAL получают только handle */
+static uart_port_t* port_find(UART_HandleTypeDef* handle)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(ports); i++) {
+        if (ports[i].huart == handle) {
+            return &ports[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* Принят очередной байт по прерыванию - сохранить и продолжить прием */
+static void rx_it_complete_cb(UART_HandleTypeDef* handle)
+{
+    uart_port_t* port = port_find(handle);
+
+    if (port == NULL) {
+        return;
+    }
+
+    port->rx_ring[port->rx_it_head] = port->rx_it_byte;
+    port->rx_it_head = (port->rx_it_head + 1) % ARRAY_SIZE(port->rx_ring);
+
+    HAL_UART_Receive_IT(handle, &port->rx_it_byte, 1);
+}
+
+/* Ошибка приема: при приеме по DMA HAL уже остановил прием, его перезапустит
+ * rx_ring_get(). Текущий прием прерывается в uart_poll() */
+static void rx_error_cb(UART_HandleTypeDef* handle)
+{
+    uart_port_t* port = port_find(handle);
+    const uint32_t error = handle->ErrorCode;
+
+    if (port == NULL) {
+        return;
+    }
+
+    if (error & HAL_UART_ERROR_PE) {
+        port->link_stats.parity += 1;
+    }
+    if (error & HAL_UART_ERROR_FE) {
+        port->link_stats.framing += 1;
+    }
+    if (error & HAL_UART_ERROR_NE) {
+        port->link_stats.noise += 1;
+    }
+    if (error & HAL_UART_ERROR_ORE) {
+        port->link_stats.overrun += 1;
+    }
+
+    port->rx_error = true;
+}
+
+/* Запустить непрерывный прием в кольцевой буфер */
+static void rx_start(uart_port_t* port)
+{
+    UART_HandleTypeDef* huart = port->huart;
+
+    port->rx_ring_tail = 0;
+    port->rx_it_head   = 0;
+
+#ifdef CONFIG_DFU_HOST_RX_DMA
+    /* Прием по прерыванию на каждый байт остается запасным вариантом,
+     * если к UART не подключен канал DMA */
+    port->rx_dma = huart->hdmarx != NULL &&
+                   HAL_UART_Receive_DMA(huart, port->rx_ring, ARRAY_SIZE(port->rx_ring)) == HAL_OK;
+
+    if (port->rx_dma) {
+        return;
+    }
+#endif /* CONFIG_DFU_HOST_RX_DMA */
+
+    HAL_UART_RegisterCallback(huart, HAL_UART_RX_COMPLETE_CB_ID, rx_it_complete_cb);
+    HAL_UART_Receive_IT(huart, &port->rx_it_byte, 1);
+}
+
+/* Позиция записи в кольцевом буфере */
+static inline size_t rx_ring_head(const uart_port_t* port)
+{
+#ifdef CONFIG_DFU_HOST_RX_DMA
+    if (port->rx_dma) {
+        const size_t head = ARRAY_SIZE(port->rx_ring) - __HAL_DMA_GET_COUNTER(port->huart->hdmarx);
+
+        /* В момент перезагрузки счетчика CNDTR может кратковременно быть 0 */
+        return (head == ARRAY_SIZE(port->rx_ring)) ? 0 : head;
+    }
+#endif /* CONFIG_DFU_HOST_RX_DMA */
+
+    return port->rx_it_head;
+}
+
+/* Забрать из кольцевого буфера до len уже принятых байт. Возвращает
+ * количество прочитанных байт */
+static size_t rx_ring_read(uart_port_t* port, uint8_t* buf, size_t len)
+{
+    /* Ошибка приема (например, переполнение) останавливает прием - перезапустить */
+    if (port->huart->RxState != HAL_UART_STATE_BUSY_RX) {
+        rx_start(port);
+        return 0;
+    }
+
+    const size_t head = rx_ring_head(port);
+    size_t count = 0;
+
+    /* Не больше двух копирований: до конца буфера и с его начала */
+    while (count < len && port->rx_ring_tail != head) {
+        const size_t end = (head > port->rx_ring_tail) ? head : ARRAY_SIZE(port->rx_ring);
+        const size_t chunk = MIN(len - count, end - port->rx_ring_tail);
+
+        memcpy(buf + count, &port->rx_ring[port->rx_ring_tail], chunk);
+
+        count             += chunk;
+        port->rx_ring_tail = (port->rx_ring_tail + chunk) % ARRAY_SIZE(port->rx_ring);
+    }
+
+    return count;
+}
+
+/* Забрать очередной байт из кольцевого буфера: false - новых байт нет */
+static inline bool rx_ring_get(uart_port_t* port, uint8_t* data)
+{
+    return rx_ring_read(port, data, 1) == 1;
+}
+
+/* Отбросить принятые, но еще не прочитанные байты и их ошибки */
+static inline void rx_ring_flush(uart_port_t* port)
+{
+    port->rx_error     = false;
+    port->rx_drain     = false;
+    port->rx_ring_tail = rx_ring_head(port);
+}
+
+/* Завершить текущий прием с результатом rc */
+static void rx_finish(uart_port_t* port, int rc)
+{
+    port->rx_op    = RX_OP_NONE;
+    port->rx_drain = false;
+    port->rx_done(port->rx_arg, rc);
+}
+
+/* Отбросить остаток искаженного ответа. true - линия затихла, прием можно
+ * завершить с ошибкой */
+static bool rx_drained(uart_port_t* port)
+{
+    uint8_t data = 0;
+    const uint32_t now = HAL_GetTick();
+
+    if (!port->rx_drain) {
+        port->rx_drain      = true;
+        port->rx_drain_tick = now;
+    }
+
+    while (rx_ring_get(port, &data)) {
+        port->rx_drain_tick = now;
+    }
+
+    return now - port->rx_drain_tick >= CONFIG_DFU_HOST_UART_IDLE_MS;
+}
+
+/* Скопировать принятые данные ответа известной длины. false - данных больше нет */
+static bool rx_op_copy(uart_port_t* port)
+{
+    const size_t count = rx_ring_read(port, port->rx_buf + port->rx_count,
+        port->rx_need - port->rx_count);
+
+    if (count == 0) {
+        return false;
+    }
+
+    port->rx_count += count;
+
+    if (port->rx_op == RX_OP_EXACT) {
+        if (port->rx_count == port->rx_need) {
+            rx_finish(port, port->rx_count);
+        }
+    } else if (port->rx_count == 1) {
+        /* Принят байт длины: за ним N + 1 байт данных */
+        port->rx_need = (size_t)port->rx_buf[0] + 2;
+
+        if (port->rx_need > port->rx_size) {
+            rx_finish(port, DFU_HOST_ERR_OVERFLOW);
+        }
+    }
+
+    return true;
+}
+
+/* Обработать байт ответа после данных известной длины или до ACK */
+static void rx_op_byte(uart_port_t* port, uint8_t data)
+{
+    switch (data) {
+    case DFU_HOST_RESP_NACK:
+        rx_finish(port, DFU_HOST_ERR_NACK);
+        break;
+
+    case DFU_HOST_RESP_ACK:
+        rx_finish(port, port->rx_count);
+        break;
+
+    default:
+        /* После данных известной длины ожидается только ACK/NACK */
+        if (port->rx_op == RX_OP_SIZED) {
+            rx_finish(port, DFU_HOST_ERR_WRONG_ANS);
+            break;
+        }
+
+        if (port->rx_count == port->rx_size) {
+            rx_finish(port, DFU_HOST_ERR_OVERFLOW);
+            break;
+        }
+
+        port->rx_buf[port->rx_count++] = data;
+        break;
+    }
+}
+
+/* Начать асинхронный прием, байты из кольцевого буфера разбирает uart_poll() */
+static int rx_op_start(uart_port_t* port, rx_op_t op, uint8_t* buf, size_t size,
+    dfu_host_transport_done_t done, void* arg)
+{
+    CHECK(done        != NULL,       return DFU_HOST_ERR_EINVAL);
+    CHECK(port->rx_op == RX_OP_NONE, return DFU_HOST_ERR_BUSY);
+
+    port->rx_buf   = buf;
+    port->rx_size  = size;
+    port->rx_count = 0;
+    port->rx_need  = (op == RX_OP_EXACT) ? size : (op == RX_OP_SIZED) ? 1 : 0;
+    port->rx_done  = done;
+    port->rx_arg   = arg;
+    port->rx_op    = op;
+
+    return DFU_HOST_ERR_NONE;
+}
+
+static void tx_complete_cb(UART_HandleTypeDef* handle)
+{
+    uart_port_t* port = port_find(handle);
+
+    if (port == NULL) {
+        return;
+    }
+
+    dfu_host_transport_done_t done = port->tx_done;
+
+    port->tx_done = NULL;
+
+    if (done != NULL) {
+        done(port->tx_arg, DFU_HOST_ERR_NONE);
+    }
+}
+
+/* Подключить функции окончания передачи и ошибки приема */
+static void callbacks_register(uart_port_t* port)
+{
+    HAL_UART_RegisterCallback(port->huart, HAL_UART_TX_COMPLETE_CB_ID, tx_complete_cb);
+    HAL_UART_RegisterCallback(port->huart, HAL_UART_ERROR_CB_ID, rx_error_cb);
+}
+
+static int uart_stream_send_async(void* ctx, const uint8_t* data, size_t len,
+    dfu_host_transport_done_t done, void* arg)
+{
+    uart_port_t* port = ctx;
+
+    CHECK(done          != NULL, return DFU_HOST_ERR_EINVAL);
+    CHECK(port->tx_done == NULL, return DFU_HOST_ERR_BUSY);
+
+    port->tx_arg  = arg;
+    port->tx_done = done;
+
+    if (HAL_UART_Transmit_IT(port->huart, data, len) != HAL_OK) {
+        port->tx_done = NULL;
+        return DFU_HOST_ERR_EIO;
+    }
+
+    return DFU_HOST_ERR_NONE;
+}
+
+static int uart_send_async(void* ctx, const uint8_t* data, size_t len, bool cmd,
+    dfu_host_transport_done_t done, void* arg)
+{
+    (void)cmd;
+
+    /* Байты, пришедшие до запроса, к ответу не относятся */
+    rx_ring_flush(ctx);
+
+    return uart_stream_send_async(ctx, data, len, done, arg);
+}
+
+static int uart_recv_exact_async(void* ctx, uint8_t* buf, size_t len,
+    dfu_host_transport_done_t done, void* arg)
+{
+    CHECK(len != 0, return DFU_HOST_ERR_EINVAL);
+
+    return rx_op_start(ctx, RX_OP_EXACT, buf, len, done, arg);
+}
+
+static int uart_recv_until_ack_async(void* ctx, uint8_t* buf, size_t size,
+    dfu_host_transport_done_t done, void* arg)
+{
+    return rx_op_start(ctx, RX_OP_UNTIL_ACK, buf, size, done, arg);
+}
+
+static int uart_recv_sized_async(void* ctx, uint8_t* buf, size_t size,
+    dfu_host_transport_done_t done, void* arg)
+{
+    CHECK(buf != NULL && size >= 2, return DFU_HOST_ERR_EINVAL);
+
+    return rx_op_start(ctx, RX_OP_SIZED, buf, size, done, arg);
+}
+
+static int uart_sync_async(void* ctx, dfu_host_transport_done_t done, void* arg)
+{
+    uart_port_t* port = ctx;
+
+    static const uint8_t sync = DFU_HOST_UART_SYNC;
+
+    rx_ring_flush(port);
+
+    /* Ответ на 0x7F - ACK без данных, окончания передачи ждать не нужно */
+    int rc = rx_op_start(port, RX_OP_UNTIL_ACK, NULL, 0, done, arg);
+    if (rc < 0) {
+        return rc;
+    }
+
+    if (HAL_UART_Transmit_IT(port->huart, &sync, sizeof(sync)) != HAL_OK) {
+        port->rx_op = RX_OP_NONE;
+        return DFU_HOST_ERR_EIO;
+    }
+
+    return DFU_HOST_ERR_NONE;
+}
+
+static size_t uart_stream_recv(void* ctx, uint8_t* buf, size_t size)
+{
+    return rx_ring_read(ctx, buf, size);
+}
+
+static void uart_poll(void* ctx)
+{
+    uart_port_t* port = ctx;
+    uint8_t data = 0;
+
+    /* Искаженный ответ не ждать до таймаута: прием завершается, как только
+     * закончится его передача */
+    if (port->rx_error && port->rx_op != RX_OP_NONE) {
+        if (rx_drained(port)) {
+            port->rx_error = false;
+            port->link_stats.aborted += 1;
+            rx_finish(port, DFU_HOST_ERR_LINE);
+        }
+        return;
+    }
+
+    while (port->rx_op != RX_OP_NONE) {
+        /* Данные известной длины копируются блоками, побайтно разбирается
+         * только то, что идет до ACK */
+        if (port->rx_count < port->rx_need) {
+            if (!rx_op_copy(port)) {
+                break;
+            }
+            continue;
+        }
+
+        if (!rx_ring_get(port, &data)) {
+            break;
+        }
+
+        rx_op_byte(port, data);
+    }
+}
+
+static void uart_abort(void* ctx)
+{
+    uart_port_t* port = ctx;
+
+    port->rx_op    = RX_OP_NONE;
+    port->rx_drain = false;
+    port->tx_done  = NULL;
+
+    /* Непрерывный прием в кольцевой буфер не останавливается */
+    HAL_UART_AbortTransmit_IT(port->huart);
+}
+
+static int uart_set_baudrate(void* ctx, uint32_t baudrate)
+{
+    uart_port_t* port = ctx;
+
+    /* Остановить обмен и перенастроить UART без повторного MspInit */
+    uart_abort(port);
+    HAL_UART_AbortReceive(port->huart);
+
+    port->huart->Init.BaudRate = baudrate;
+
+    if (HAL_UART_Init(port->huart) != HAL_OK) {
+        return DFU_HOST_ERR_EIO;
+    }
+
+    callbacks_register(port);
+    rx_start(port);
+
+    return DFU_HOST_ERR_NONE;
+}
+
+static uint32_t uart_get_baudrate(void* ctx)
+{
+    const uart_port_t* port = ctx;
+
+    return port->huart->Init.BaudRate;
+}
+
+static const dfu_host_link_stats_t* uart_link_stats(void* ctx)
+{
+    const uart_port_t* port = ctx;
+
+    return &port->link_stats;
+}
+
+static const dfu_host_transport_t uart_transport = {
+    .sync_async           = uart_sync_async,
+    .send_async           = uart_send_async,
+    .recv_exact_async     = uart_recv_exact_async,
+    .recv_until_ack_async = uart_recv_until_ack_async,
+    .recv_sized_async     = uart_recv_sized_async,
+    .poll                 = uart_poll,
+    .abort                = uart_abort,
+    .set_baudrate         = uart_set_baudrate,
+    .get_baudrate         = uart_get_baudrate,
+    .link_stats           = uart_link_stats,
+    .stream_send_async    = uart_stream_send_async,
+    .stream_recv          = uart_stream_recv,
+    .name                 = "UART",
+    .version_options      = 2,
+};
+
+const dfu_host_transport_t* dfu_host_transport_uart(UART_HandleTypeDef* handle)
+{
+    ASSERT_NO_MSG(handle != NULL);
+
+    /* Повторный вызов для того же UART заново запускает его порт */
+    uart_port_t* port = port_find(handle);
+    if (port == NULL) {
+        port = port_find(NULL);
+    }
+
+    CHECK(port != NULL, return NULL);
+
+    memset(port, 0, sizeof(*port));
+
+    port->huart         = handle;
+    port->transport     = uart_transport;
+    port->transport.ctx = port;
+
+    callbacks_register(port);
+    rx_start(port);
+
+#ifdef CONFIG_DFU_HOST_RX_DMA
+    LOG_DBG("UART %u RX mode: %s", (unsigned)(port - ports), port->rx_dma ? "DMA" : "IT");
+#else
+    LOG_DBG("UART %u RX mode: IT", (unsigned)(port - ports));
+#endif /* CONFIG_DFU_HOST_RX_DMA */
+
+    return &port->transport;
+}
@@ -0,0 +1,291 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "dfu_host.h"
+#include "dfu_host_crc.h"
+#include "dfu_host_update.h"
+#include "core/crc_model.h"
+#include "core/assert.h"
+#include "core/util.h"
+
+/************************* LOG SETTINGS ****************************/
+
+#define LOG_MODULE_PRINTABLE_NAME "DFU"
+#define LOG_MODULE_LOG_LEVEL 4U
+#define LOG_MODULE_IS_ENABLED (!defined(NDEBUG))
+#define LOG_MODULE_IS_TIMESTAMP_ENABLED 1
+#define LOG_MODULE_IS_FUNC_NAME_ENABLED 1
+
+#include "logging.h"
+
+/*******************************************************************/
+
+/* Алгоритм дайджеста сектора: его же считает аппаратный блок CRC STM32 */
+#define UPDATE_DIGEST_MODEL "CRC-32/MPEG-2"
+
+/* Расчет дайджеста на стороне хоста, таблица строится при первом обновлении */
+static struct crc_engine digest_engine;
+/* Блок стертой Flash: дополнение образа до границ сектора */
+static uint8_t erased[DFU_HOST_UPDATE_WRITE_BLOCK];
+
+static void digest_init(void)
+{
+    if (digest_engine.model == NULL) {
+        crc_engine_init(&digest_engine, crc_model_find(UPDATE_DIGEST_MODEL));
+        memset(erased, 0xFF, sizeof(erased));
+    }
+}
+
+/* Начало и размер сектора с номером index */
+static void layout_sector(const dfu_host_flash_layout_t* layout, size_t index,
+    uint32_t* address, uint32_t* size)
+{
+    uint32_t offset = 0;
+
+    if (layout->sector_sizes == NULL) {
+        offset = index * layout->sector_size;
+        *size  = layout->sector_size;
+    } else {
+        for (size_t i = 0; i < index; ++i) {
+            offset += layout->sector_sizes[i];
+        }
+        *size = layout->sector_sizes[index];
+    }
+
+    *address = layout->base + offset;
+}
+
+static int readback_sink(void* ctx, uint32_t address, const uint8_t* data, size_t len)
+{
+    (void)address;
+
+    uint32_t* state = ctx;
+
+    *state = crc_engine_update(&digest_engine, *state, data, len);
+
+    return 0;
+}
+
+int dfu_host_digest_readback(dfu_host_t* host, void* ctx, uint32_t address, size_t len, uint32_t* digest)
+{
+    (void)ctx;
+
+    CHECK(digest != NULL, return DFU_HOST_ERR_EINVAL);
+
+    digest_init();
+
+    uint32_t state = crc_engine_begin(&digest_engine);
+
+    int rc = dfu_host_read_range(host, address, len, readback_sink, &state);
+    if (rc < 0) {
+        return rc;
+    }
+
+    *digest = crc_engine_final(&digest_engine, state);
+
+    return DFU_HOST_ERR_NONE;
+}
+
+int dfu_host_digest_helper(dfu_host_t* host, void* ctx, uint32_t address, size_t len, uint32_t* digest)
+{
+    digest_init();
+
+    return dfu_host_crc_remote(host, &digest_engine, address, len, ctx, digest);
+}
+
+/* Дайджест сектора эталона: образ, вне образа - стертые байты */
+static uint32_t image_digest(uint32_t sector, uint32_t size, uint32_t address,
+    const uint8_t* image, size_t len)
+{
+    uint32_t state = crc_engine_begin(&digest_engine);
+
+    for (uint32_t offset = 0; offset < size;) {
+        const uint32_t at = sector + offset;
+        size_t chunk;
+
+        if (at >= address && at - address < len) {
+            chunk = MIN(len - (at - address), size - offset);
+            state = crc_engine_update(&digest_engine, state, image + (at - address), chunk);
+        } else {
+            chunk = MIN(size - offset, sizeof(erased));
+            /* Не заходить за начало образа */
+            if (at < address) {
+                chunk = MIN(chunk, address - at);
+            }
+            state = crc_engine_update(&digest_engine, state, erased, chunk);
+        }
+
+        offset += chunk;
+    }
+
+    return crc_engine_final(&digest_engine, state);
+}
+
+/* Записать стертый сектор блоками WRITE_MEM, пропуская блоки из одних 0xFF */
+static int sector_write(dfu_host_t* host, uint32_t sector, uint32_t size, uint32_t address,
+    const uint8_t* image, size_t len, size_t* written)
+{
+    uint8_t block[DFU_HOST_UPDATE_WRITE_BLOCK];
+
+    for (uint32_t at = sector; at < sector + size; at += sizeof(block)) {
+        /* Часть блока, которую покрывает образ */
+        const uint32_t from = MAX(at, address);
+        const uint32_t to   = MIN(at + sizeof(block), address + len);
+
+        if (from >= to) {
+            continue;
+        }
+
+        memset(block, 0xFF, sizeof(block));
+        memcpy(block + (from - at), image + (from - address), to - from);
+
+        /* Записать только отрезок от первого до последнего не 0xFF байта,
+         * выровненный на слово */
+        size_t first = 0;
+        size_t last  = sizeof(block);
+
+        while (first < last && block[first] == 0xFF) {
+            first += 1;
+        }
+        while (last > first && block[last - 1] == 0xFF) {
+            last -= 1;
+        }
+
+        if (first == last) {
+            continue;
+        }
+
+        first &= ~(size_t)3;
+        last   = (last + 3) & ~(size_t)3;
+
+        int rc = dfu_host_write_memory(host, at + first, block + first, last - first);
+        if (rc < 0) {
+            LOG_ERROR("Write 0x%08lX error: %d", at + first, rc);
+            return rc;
+        }
+
+        *written += last - first;
+    }
+
+    return DFU_HOST_ERR_NONE;
+}
+
+/* Стереть, записать и проверить накопленные отличающиеся секторы */
+static int update_flush(dfu_host_t* host, const dfu_host_update_cfg_t* cfg,
+    const uint16_t* sectors, size_t count, uint32_t address, const uint8_t* image, size_t len,
+    dfu_host_update_stats_t* stats)
+{
+    int rc = dfu_host_erase_sectors(host, sectors, count);
+    if (rc < 0) {
+        LOG_ERROR("Erase of %u sectors error: %d", count, rc);
+        return rc;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t sector, size;
+
+        layout_sector(cfg->layout, sectors[i], &sector, &size);
+
+        rc = sector_write(host, sector, size, address, image, len, &stats->bytes_written);
+        if (rc < 0) {
+            return rc;
+        }
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t sector, size, digest;
+
+        layout_sector(cfg->layout, sectors[i], &sector, &size);
+
+        rc = cfg->digest(host, cfg->digest_ctx, sector, size, &digest);
+        if (rc < 0) {
+            return rc;
+        }
+
+        if (digest != image_digest(sector, size, address, image, len)) {
+            LOG_ERROR("Sector %u mismatch after write", sectors[i]);
+            return DFU_HOST_ERR_EIO;
+        }
+    }
+
+    stats->sectors_changed += count;
+
+    return DFU_HOST_ERR_NONE;
+}
+
+int dfu_host_update(dfu_host_t* host, const dfu_host_update_cfg_t* cfg, uint32_t address,
+    const uint8_t* image, size_t len, dfu_host_update_stats_t* stats)
+{
+    CHECK(host        != NULL, return DFU_HOST_ERR_EINVAL);
+    CHECK(cfg         != NULL, return DFU_HOST_ERR_EINVAL);
+    CHECK(cfg->layout != NULL, return DFU_HOST_ERR_EINVAL);
+    CHECK(cfg->digest != NULL, return DFU_HOST_ERR_EINVAL);
+    CHECK(image       != NULL, return DFU_HOST_ERR_EINVAL);
+    CHECK(len         != 0,    return DFU_HOST_ERR_EINVAL);
+
+    const dfu_host_flash_layout_t* layout = cfg->layout;
+
+    const uint32_t flash_end = layout->base + layout->size;
+
+    CHECK(address >= layout->base && address < flash_end && len <= flash_end - address,
+        return DFU_HOST_ERR_EINVAL);
+
+    digest_init();
+
+    const uint32_t start = HAL_GetTick();
+    dfu_host_update_stats_t result = { 0 };
+    uint16_t changed[DFU_HOST_ERASE_SECTORS_MAX];
+    size_t count = 0;
+    int rc = DFU_HOST_ERR_NONE;
+
+    for (size_t s = 0; s < layout->sector_count; ++s) {
+        uint32_t sector, size, digest;
+
+        layout_sector(layout, s, &sector, &size);
+
+        if (sector + size <= address) {
+            continue;
+        }
+        if (sector >= address && sector - address >= len) {
+            break;
+        }
+
+        result.sectors_total += 1;
+
+        rc = cfg->digest(host, cfg->digest_ctx, sector, size, &digest);
+        if (rc < 0) {
+            break;
+        }
+
+        if (digest == image_digest(sector, size, address, image, len)) {
+            continue;
+        }
+
+        LOG_DBG("Sector %u (0x%08lX) differs", s, sector);
+        changed[count++] = s;
+
+        /* Стирать пачками по размеру одной команды Extended Erase */
+        if (count == ARRAY_SIZE(changed)) {
+            rc = update_flush(host, cfg, changed, count, address, image, len, &result);
+            if (rc < 0) {
+                break;
+            }
+            count = 0;
+        }
+    }
+
+    if (rc == DFU_HOST_ERR_NONE && count != 0) {
+        rc = update_flush(host, cfg, changed, count, address, image, len, &result);
+    }
+
+    result.elapsed_ms = HAL_GetTick() - start;
+
+    LOG_INF("Update: %u of %u sectors changed, %u B written in %lu ms",
+        result.sectors_changed, result.sectors_total, result.bytes_written, result.elapsed_ms);
+
+    if (stats != NULL) {
+        *stats = result;
+    }
+
+    return rc;
+}
@@ -0,0 +1,134 @@
+#include <string.h>
+
+#include "fw_reader.h"
+#include "core/util.h"
+#include "core/assert.h"
+
+const dfu_host_retry_cfg_t fw_read_retry = {
+    .attempts       = FW_READ_RETRIES,
+    .backoff_ms     = CONFIG_DFU_READ_BACKOFF_MS,
+    .backoff_max_ms = CONFIG_DFU_READ_BACKOFF_MAX_MS,
+    .budget_ms      = CONFIG_DFU_READ_RETRY_BUDGET_MS,
+};
+
+/* Окончание чтения блока: поставить его в очередь и сразу запросить следующий */
+static void fw_reader_done(dfu_host_req_t* req)
+{
+    fw_reader_t* r = req->arg;
+
+    if (req->rc > 0) {
+        r->ready[r->ready_head % ARRAY_SIZE(r->ready)].data = req->data;
+        r->ready[r->ready_head % ARRAY_SIZE(r->ready)].len  = req->len;
+        r->ready_head += 1;
+
+        r->addr += req->len;
+        r->left -= req->len;
+        dfu_host_retry_success(&r->retry);
+
+        fw_reader_next(r);
+        return;
+    }
+
+    /* Повторить чтение того же блока после случайной задержки */
+    if (!dfu_host_retry_failed(&r->retry, req->rc)) {
+        r->failed = true;
+        return;
+    }
+
+    if (r->on_error != NULL && r->on_error(r->on_error_ctx)) {
+        r->failed  = true;
+        r->aborted = true;
+        return;
+    }
+
+    fw_reader_next(r);
+}
+
+void fw_reader_init(fw_reader_t* r, dfu_host_t* host, fw_reader_error_cb_t on_error, void* ctx)
+{
+    CHECK(r != NULL && host != NULL, return);
+
+    memset(r, 0, sizeof(*r));
+
+    r->host         = host;
+    r->on_error     = on_error;
+    r->on_error_ctx = ctx;
+}
+
+void fw_reader_start(fw_reader_t* r, uint32_t addr, uint32_t len)
+{
+    /* Привязка к dfu_host сохраняется, состояние чтения - с начала */
+    fw_reader_init(r, r->host, r->on_error, r->on_error_ctx);
+
+    r->req.cb  = fw_reader_done;
+    r->req.arg = r;
+    r->addr    = addr;
+    r->left    = len;
+    dfu_host_retry_init(&r->retry, &fw_read_retry);
+
+    fw_reader_next(r);
+}
+
+void fw_reader_next(fw_reader_t* r)
+{
+    if (r->failed || r->left == 0 || dfu_host_busy(r->host) || !dfu_host_retry_ready(&r->retry) ||
+        r->ready_head - r->ready_tail == ARRAY_SIZE(r->ready)) {
+        return;
+    }
+
+    int rc = dfu_host_read_memory_async(r->host, &r->req, r->addr,
+        MIN(r->left, FW_READ_BLOCK_SIZE));
+    if (rc < 0) {
+        r->failed = true;
+    }
+}
+
+bool fw_reader_get(fw_reader_t* r, const uint8_t** data, size_t* len)
+{
+    if (r->ready_head == r->ready_tail) {
+        return false;
+    }
+
+    *data = r->ready[r->ready_tail % ARRAY_SIZE(r->ready)].data;
+    *len  = r->ready[r->ready_tail % ARRAY_SIZE(r->ready)].len;
+
+    return true;
+}
+
+void fw_reader_release(fw_reader_t* r)
+{
+    r->ready_tail += 1;
+
+    /* Чтение могло остановиться из-за заполненной очереди */
+    fw_reader_next(r);
+}
+
+bool fw_checkpoint_begin(fw_checkpoint_t* cp, const fw_meta_t* meta, uint32_t base,
+    const struct crc_engine* crc)
+{
+    if (cp->valid && cp->base == base && memcmp(&cp->meta, meta, sizeof(*meta)) == 0) {
+        return true;
+    }
+
+    cp->meta  = *meta;
+    cp->base  = base;
+    cp->addr  = base;
+    cp->value = crc_engine_begin(crc);
+    cp->valid = true;
+
+    return false;
+}
+
+bool fw_meta_addr_valid(const dfu_host_target_t* target, uint32_t meta_addr)
+{
+    return target == NULL || dfu_host_target_in_flash(target, meta_addr, sizeof(fw_meta_t));
+}
+
+bool fw_meta_size_valid(const dfu_host_target_t* target, const fw_meta_t* meta)
+{
+    if (meta->fw_size == 0) {
+        return false;
+    }
+
+    return target == NULL || dfu_host_target_in_flash(target, target->flash.base, meta->fw_size);
+}
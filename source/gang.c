@@ -0,0 +1,382 @@
+#include <string.h>
+
+#include "board.h"
+#include "gang.h"
+#include "dfu_host.h"
+#include "dfu_host_target.h"
+#include "fw_reader.h"
+#include "core/util.h"
+#include "core/assert.h"
+
+/************************* LOG SETTINGS ****************************/
+
+#define LOG_MODULE_PRINTABLE_NAME "GANG"
+#define LOG_MODULE_LOG_LEVEL 4U
+#define LOG_MODULE_IS_ENABLED (defined(DEBUG))
+#define LOG_MODULE_IS_TIMESTAMP_ENABLED 1
+#define LOG_MODULE_IS_FUNC_NAME_ENABLED 0
+
+#include "logging.h"
+
+/*******************************************************************/
+
+/* Скорость UART каналов. Загрузчик определяет ее по первому 0x7F */
+#ifndef CONFIG_DFU_GANG_BAUD
+#define CONFIG_DFU_GANG_BAUD 115200
+#endif /* CONFIG_DFU_GANG_BAUD */
+
+/* Удержание линии RST и ожидание запуска загрузчика после ее отпускания, мс */
+#ifndef CONFIG_DFU_GANG_RESET_MS
+#define CONFIG_DFU_GANG_RESET_MS 100
+#endif /* CONFIG_DFU_GANG_RESET_MS */
+#ifndef CONFIG_DFU_GANG_BOOT_DELAY_MS
+#define CONFIG_DFU_GANG_BOOT_DELAY_MS 100
+#endif /* CONFIG_DFU_GANG_BOOT_DELAY_MS */
+
+/* Таймаут ответа на 0x7F, мс, и попыток синхронизации после одного сброса */
+#ifndef CONFIG_DFU_GANG_PING_TIMEOUT_MS
+#define CONFIG_DFU_GANG_PING_TIMEOUT_MS 100
+#endif /* CONFIG_DFU_GANG_PING_TIMEOUT_MS */
+#define GANG_SYNC_ATTEMPTS 5
+
+/* Сбросов устройства, после которых канал считается неисправным */
+#ifndef CONFIG_DFU_GANG_RESETS
+#define CONFIG_DFU_GANG_RESETS 3
+#endif /* CONFIG_DFU_GANG_RESETS */
+
+/* Состояния автомата канала */
+typedef enum {
+    GANG_STATE_RESET,     /* Линия RST в 0                          */
+    GANG_STATE_BOOT,      /* Линия RST отпущена, запуск загрузчика  */
+    GANG_STATE_SYNC,      /* Синхронизация 0x7F                     */
+    GANG_STATE_GET_ID,    /* Идентификатор продукта                 */
+    GANG_STATE_READ_META, /* Метаинформация прошивки                */
+    GANG_STATE_READ_FW,   /* Чтение прошивки и расчет CRC           */
+    GANG_STATE_GO,        /* Запуск прошивки                        */
+    GANG_STATE_DONE,      /* Проверка окончена, итог в result       */
+} gang_state_t;
+
+static const char* const gang_status_names[] = {
+    [GANG_STATUS_PASS]         = "PASS",
+    [GANG_STATUS_NO_ANSWER]    = "no bootloader answer",
+    [GANG_STATUS_PROTECTED]    = "readout protected",
+    [GANG_STATUS_BAD_META]     = "bad firmware meta",
+    [GANG_STATUS_READ_ERROR]   = "read error",
+    [GANG_STATUS_CRC_MISMATCH] = "CRC mismatch",
+    [GANG_STATUS_GO_ERROR]     = "GO error",
+};
+
+/* Канал: устройство, его экземпляр dfu_host и состояние проверки */
+typedef struct {
+    size_t index;
+    dfu_host_t host;
+    dfu_host_req_t req;
+    bool     req_done;      /* Операция req завершена, результат не разобран */
+
+    gang_state_t state;
+    uint32_t wait_start;    /* Начало ожидания в RESET и BOOT                */
+    uint8_t  resets;        /* Сбросов устройства                            */
+    uint8_t  syncs;         /* Попыток синхронизации после сброса            */
+
+    const dfu_host_target_t* target;
+    fw_meta_t meta;
+
+    /* Чтение прошивки, как у одного устройства. После сброса продолжается
+     * с точки cp: содержимое Flash не меняется */
+    fw_reader_t reader;
+    fw_checkpoint_t cp;
+
+    uint32_t start;         /* Начало проверки                               */
+    gang_result_t result;
+} gang_channel_t;
+
+static gang_channel_t channels[CONFIG_DFU_GANG_CHANNELS];
+static size_t channel_count;
+
+/* Алгоритм CRC прошивки */
+static const struct crc_engine* gang_crc;
+
+static void req_done_cb(dfu_host_req_t* req)
+{
+    gang_channel_t* ch = req->arg;
+
+    ch->req_done = true;
+}
+
+/* Учесть результат запуска операции: ошибка запуска завершает ее сразу */
+static void req_started(gang_channel_t* ch, int rc)
+{
+    if (rc < 0) {
+        ch->req.rc   = rc;
+        ch->req_done = true;
+    }
+}
+
+/* Окончить проверку канала */
+static void channel_finish(gang_channel_t* ch, gang_status_t status)
+{
+    ch->state             = GANG_STATE_DONE;
+    ch->result.status     = status;
+    ch->result.elapsed_ms = HAL_GetTick() - ch->start;
+}
+
+/* Сбросить устройство с BOOT0 = 1 */
+static void channel_reset(gang_channel_t* ch)
+{
+    board_channel_reset_write(ch->index, false);
+
+    ch->state      = GANG_STATE_RESET;
+    ch->wait_start = HAL_GetTick();
+    ch->syncs      = 0;
+}
+
+/* Сбросить устройство после ошибки или окончить проверку, если сбросы исчерпаны */
+static void channel_retry(gang_channel_t* ch, gang_status_t status)
+{
+    if (++ch->resets >= CONFIG_DFU_GANG_RESETS) {
+        channel_finish(ch, status);
+        return;
+    }
+
+    LOG_WRN("Channel %u: %s, resetting", ch->index, gang_status_name(status));
+    channel_reset(ch);
+}
+
+/* Прошивка прочитана: сравнить CRC и запустить прошивку */
+static void read_finished(gang_channel_t* ch)
+{
+    const uint32_t crc = crc_engine_final(gang_crc, ch->cp.value);
+
+    ch->cp.valid = false;
+    ch->result.crc_read = (uint16_t)crc;
+
+    if (crc != ch->meta.crc16) {
+        LOG_ERROR("Channel %u: CRC %04lX, expected %04X", ch->index, crc, ch->meta.crc16);
+        channel_finish(ch, GANG_STATUS_CRC_MISMATCH);
+        return;
+    }
+
+    ch->state = GANG_STATE_GO;
+    req_started(ch, dfu_host_go_async(&ch->host, &ch->req, ch->cp.base));
+}
+
+/* Рассчитать CRC принятых блоков прошивки, как fw_read_crc() основного автомата */
+static void read_step(gang_channel_t* ch)
+{
+    fw_reader_t* r = &ch->reader;
+    fw_checkpoint_t* cp = &ch->cp;
+
+    /* Повтор блока после задержки запускается здесь */
+    fw_reader_next(r);
+
+    /* Повторы исчерпаны: сбросить устройство, когда закончится запрос. Все
+     * принятые до ошибки блоки уже учтены в точке cp */
+    if (r->failed) {
+        if (!dfu_host_busy(&ch->host)) {
+            channel_retry(ch, GANG_STATUS_READ_ERROR);
+        }
+        return;
+    }
+
+    const uint8_t* data = NULL;
+    size_t len = 0;
+
+    while (fw_reader_get(r, &data, &len)) {
+        cp->value = crc_engine_update(gang_crc, cp->value, data, len);
+        cp->addr += len;
+        fw_reader_release(r);
+    }
+
+    if (fw_reader_finished(r)) {
+        read_finished(ch);
+    }
+}
+
+/* Проверить метаинформацию и начать или продолжить чтение прошивки */
+static void meta_done(gang_channel_t* ch)
+{
+    if (ch->req.rc == DFU_HOST_ERR_NACK) {
+        channel_finish(ch, GANG_STATUS_PROTECTED);
+        return;
+    }
+
+    if (ch->req.rc < 0) {
+        channel_retry(ch, GANG_STATUS_READ_ERROR);
+        return;
+    }
+
+    memcpy(&ch->meta, ch->req.data, sizeof(ch->meta));
+    ch->result.fw_size = ch->meta.fw_size;
+    ch->result.crc     = ch->meta.crc16;
+
+    if (!fw_meta_size_valid(ch->target, &ch->meta)) {
+        channel_finish(ch, GANG_STATUS_BAD_META);
+        return;
+    }
+
+    /* Продолжить с первого непроверенного блока той же прошивки */
+    fw_checkpoint_t* cp = &ch->cp;
+
+    if (fw_checkpoint_begin(cp, &ch->meta, fw_flash_base(ch->target), gang_crc)) {
+        LOG_DBG("Channel %u: resuming at 0x%08lX", ch->index, cp->addr);
+    }
+
+    ch->state = GANG_STATE_READ_FW;
+    fw_reader_start(&ch->reader, cp->addr, ch->meta.fw_size - (cp->addr - cp->base));
+}
+
+/* Выполнить очередной шаг автомата канала */
+static void channel_step(gang_channel_t* ch)
+{
+    switch (ch->state) {
+    case GANG_STATE_RESET:
+        if (HAL_GetTick() - ch->wait_start < CONFIG_DFU_GANG_RESET_MS) {
+            break;
+        }
+
+        board_channel_reset_write(ch->index, true);
+        ch->state      = GANG_STATE_BOOT;
+        ch->wait_start = HAL_GetTick();
+        break;
+
+    case GANG_STATE_BOOT:
+        if (HAL_GetTick() - ch->wait_start < CONFIG_DFU_GANG_BOOT_DELAY_MS) {
+            break;
+        }
+
+        ch->state = GANG_STATE_SYNC;
+        req_started(ch, dfu_host_ping_async(&ch->host, &ch->req, CONFIG_DFU_GANG_PING_TIMEOUT_MS));
+        break;
+
+    case GANG_STATE_SYNC:
+        if (!ch->req_done) {
+            break;
+        }
+        ch->req_done = false;
+
+        if (ch->req.rc < 0) {
+            if (++ch->syncs < GANG_SYNC_ATTEMPTS) {
+                req_started(ch, dfu_host_ping_async(&ch->host, &ch->req,
+                    CONFIG_DFU_GANG_PING_TIMEOUT_MS));
+            } else {
+                channel_retry(ch, GANG_STATUS_NO_ANSWER);
+            }
+            break;
+        }
+
+        ch->state = GANG_STATE_GET_ID;
+        req_started(ch, dfu_host_get_id_async(&ch->host, &ch->req));
+        break;
+
+    case GANG_STATE_GET_ID:
+        if (!ch->req_done) {
+            break;
+        }
+        ch->req_done = false;
+
+        if (ch->req.rc < 0 || ch->req.len < 2) {
+            channel_retry(ch, GANG_STATUS_NO_ANSWER);
+            break;
+        }
+
+        ch->result.pid = ((uint16_t)ch->req.data[0] << 8) | ch->req.data[1];
+        ch->target     = dfu_host_target_find(ch->result.pid);
+
+        if (!fw_meta_addr_valid(ch->target, board_get_fw_meta_addr())) {
+            channel_finish(ch, GANG_STATUS_BAD_META);
+            break;
+        }
+
+        ch->state = GANG_STATE_READ_META;
+        req_started(ch, dfu_host_read_memory_async(&ch->host, &ch->req, board_get_fw_meta_addr(),
+            sizeof(fw_meta_t)));
+        break;
+
+    case GANG_STATE_READ_META:
+        if (!ch->req_done) {
+            break;
+        }
+        ch->req_done = false;
+
+        meta_done(ch);
+        break;
+
+    case GANG_STATE_READ_FW:
+        read_step(ch);
+        break;
+
+    case GANG_STATE_GO:
+        if (!ch->req_done) {
+            break;
+        }
+        ch->req_done = false;
+
+        channel_finish(ch, (ch->req.rc < 0) ? GANG_STATUS_GO_ERROR : GANG_STATUS_PASS);
+        break;
+
+    case GANG_STATE_DONE:
+        break;
+    }
+}
+
+const char* gang_status_name(gang_status_t status)
+{
+    return (status < ARRAY_SIZE(gang_status_names)) ? gang_status_names[status] : "unknown";
+}
+
+size_t gang_run(const struct crc_engine* crc, gang_result_t* results, size_t count)
+{
+    CHECK(crc != NULL && results != NULL, return 0);
+
+    gang_crc      = crc;
+    channel_count = MIN(board_get_channel_count(), MIN(ARRAY_SIZE(channels), count));
+
+    const uint32_t start = HAL_GetTick();
+
+    for (size_t i = 0; i < channel_count; ++i) {
+        gang_channel_t* ch = &channels[i];
+
+        memset(ch, 0, sizeof(*ch));
+        ch->index   = i;
+        ch->start   = start;
+        ch->req.cb  = req_done_cb;
+        ch->req.arg = ch;
+        fw_reader_init(&ch->reader, &ch->host, NULL, NULL);
+
+        if (dfu_host_init(&ch->host, board_get_channel_serial_handle(i)) < 0 ||
+            dfu_host_set_baudrate(&ch->host, CONFIG_DFU_GANG_BAUD) < 0) {
+            channel_finish(ch, GANG_STATUS_NO_ANSWER);
+            continue;
+        }
+
+        board_channel_boot0_write(i, true);
+        channel_reset(ch);
+    }
+
+    /* Автоматы всех каналов продвигаются в одном цикле */
+    bool active = true;
+
+    while (active) {
+        active = false;
+
+        for (size_t i = 0; i < channel_count; ++i) {
+            gang_channel_t* ch = &channels[i];
+
+            if (ch->state == GANG_STATE_DONE) {
+                continue;
+            }
+
+            active = true;
+            dfu_host_poll(&ch->host);
+            channel_step(ch);
+        }
+    }
+
+    LOG_INF("%u targets checked in %lu ms", channel_count, HAL_GetTick() - start);
+
+    for (size_t i = 0; i < channel_count; ++i) {
+        results[i] = channels[i].result;
+    }
+
+    return channel_count;
+}
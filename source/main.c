@@ -1,11 +1,103 @@
 #include <errno.h>
+#include <string.h>
 
 #include "board.h"
 #include "dfu_host.h"
+#include "dfu_host_retry.h"
+#include "dfu_host_target.h"
+#include "dfu_host_transport.h"
+#include "fw_reader.h"
 #include "core/crc.h"
+#include "core/crc_model.h"
 #include "core/util.h"
 #include "core/assert.h"
 
+#ifdef CONFIG_CRC_HW_DMA
+#include "core/crc_hw.h"
+#endif /* CONFIG_CRC_HW_DMA */
+
+#ifdef CONFIG_CRC_BENCHMARK
+#include "crc_bench.h"
+#endif /* CONFIG_CRC_BENCHMARK */
+
+#ifdef CONFIG_DFU_CRC_HELPER
+#include "dfu_host_crc.h"
+#endif /* CONFIG_DFU_CRC_HELPER */
+
+#ifdef CONFIG_DFU_LOADER
+#ifndef CONFIG_DFU_HOST_TRANSPORT_UART
+#error "DFU_LOADER requires DFU_HOST_TRANSPORT=uart"
+#endif /* CONFIG_DFU_HOST_TRANSPORT_UART */
+#include "dfu_host_loader.h"
+#endif /* CONFIG_DFU_LOADER */
+
+#ifdef CONFIG_DFU_UPDATE
+#include "dfu_host_update.h"
+#endif /* CONFIG_DFU_UPDATE */
+
+#ifdef CONFIG_DFU_GANG_CHANNELS
+#ifndef CONFIG_DFU_HOST_TRANSPORT_UART
+#error "DFU_GANG_CHANNELS requires DFU_HOST_TRANSPORT=uart"
+#endif /* CONFIG_DFU_HOST_TRANSPORT_UART */
+#include "gang.h"
+#endif /* CONFIG_DFU_GANG_CHANNELS */
+
+/* Алгоритм CRC метаинформации прошивки (имя из каталога crc_model_catalogue) */
+#ifndef CONFIG_FW_META_CRC_MODEL
+#define CONFIG_FW_META_CRC_MODEL "CRC-16/MODBUS"
+#endif
+
+/* 7-битный адрес I2C загрузчика проверяемого устройства (AN2606) */
+#ifndef CONFIG_DFU_HOST_I2C_ADDR
+#define CONFIG_DFU_HOST_I2C_ADDR 0x39
+#endif
+
+/* Время восстановления связи с загрузчиком после ошибок чтения, после
+ * которого устройство сбрасывается, мс */
+#ifndef CONFIG_DFU_RESYNC_TIMEOUT_MS
+#define CONFIG_DFU_RESYNC_TIMEOUT_MS 1000
+#endif
+
+/* Бит на байт на линии USART загрузчика: старт, 8 бит данных, четность, стоп (8E1) */
+#define DFU_UART_FRAME_BITS 11
+
+/* Скорость согласуется только на USART */
+#if defined(CONFIG_DFU_BAUD_NEGOTIATE) && !defined(CONFIG_DFU_HOST_TRANSPORT_UART)
+#undef CONFIG_DFU_BAUD_NEGOTIATE
+#endif
+
+#ifdef CONFIG_DFU_BAUD_NEGOTIATE
+
+/* Скорости UART, которые пробуются при согласовании, по убыванию */
+#ifndef CONFIG_DFU_BAUD_RATES
+#define CONFIG_DFU_BAUD_RATES 921600, 460800, 230400, 115200
+#endif
+
+/* Максимальная скорость, на которой синхронизируется загрузчик устройства */
+#ifndef CONFIG_DFU_BAUD_MAX
+#define CONFIG_DFU_BAUD_MAX 921600
+#endif
+
+/* Ошибок чтения на текущей скорости, после которых она понижается */
+#ifndef CONFIG_DFU_BAUD_DEMOTE_ERRORS
+#define CONFIG_DFU_BAUD_DEMOTE_ERRORS 4
+#endif
+
+/* Ожидание запуска загрузчика после сброса при согласовании, мс */
+#ifndef CONFIG_DFU_BAUD_BOOT_DELAY_MS
+#define CONFIG_DFU_BAUD_BOOT_DELAY_MS 100
+#endif
+
+/* Таймаут ответа на 0x7F при согласовании, мс */
+#ifndef CONFIG_DFU_BAUD_PING_TIMEOUT_MS
+#define CONFIG_DFU_BAUD_PING_TIMEOUT_MS 100
+#endif
+
+/* Размер блока, которым проверяется линия на новой скорости */
+#define DFU_BAUD_CHECK_SIZE 256
+
+#endif /* CONFIG_DFU_BAUD_NEGOTIATE */
+
 /************************* LOG SETTINGS ****************************/
 
 #define LOG_MODULE_PRINTABLE_NAME "MAIN"
@@ -25,22 +117,90 @@ typedef enum {
     APP_STATE_INITIAL,
     APP_STATE_READ_META,
     APP_STATE_CHECK_FW_CRC,
+#ifdef CONFIG_DFU_UPDATE
+    APP_STATE_UPDATE,
+#endif /* CONFIG_DFU_UPDATE */
     APP_STATE_CHECK_DONE,
     APP_STATE_CHECK_FAILURE,
 } app_state_t;
 
-/**
- *  @brief  Структура метаинформации прошивки.
- */
-typedef struct __packed {
-    uint32_t fw_size; /* Размер прошивки в байтах      */
-    uint16_t crc16; /* CRC16 (ANSI) области прошивки */
-} fw_meta_t;
-
 /* Текущее состояние автомата приложения */
 static app_state_t app_state = APP_STATE_INITIAL;
+/* Сеанс с системным загрузчиком проверяемого устройства */
+static dfu_host_t host;
 /* Прочитанная метаинформация о прошивке проверяемого устройства */
 static fw_meta_t fw_meta;
+/* Точка продолжения проверки */
+static fw_checkpoint_t fw_checkpoint;
+/* Конвейерное чтение прошивки через host */
+static fw_reader_t fw_reader;
+
+/* Табличный расчет CRC выбранного алгоритма */
+static struct crc_engine fw_crc;
+/* Алгоритм - отраженный CRC16, его можно считать через crc16_reflect() */
+static bool fw_crc_reflect16;
+/* Отраженный полином для crc16_reflect() */
+static uint16_t fw_crc_rpoly;
+
+/* Возможности загрузчика устройства (GET), определяются при чтении метаинформации */
+static const dfu_host_caps_t* target_caps;
+
+/* Карта памяти устройства по идентификатору продукта или NULL, если он
+ * неизвестен: начало Flash, блок CRC, место в SRAM и разбиение Flash */
+static const dfu_host_target_t* target;
+
+#ifdef CONFIG_DFU_LOADER
+/* Загрузчик в SRAM не заработал - дальше только системный загрузчик */
+static bool loader_failed;
+#endif /* CONFIG_DFU_LOADER */
+
+#ifdef CONFIG_DFU_UPDATE
+/* Flash устройства уже обновлена до эталонного образа платы */
+static bool fw_updated;
+#endif /* CONFIG_DFU_UPDATE */
+
+#ifdef CONFIG_DFU_BAUD_NEGOTIATE
+
+/* Скорости UART для согласования */
+static const uint32_t baud_rates[] = { CONFIG_DFU_BAUD_RATES };
+/* Индекс скорости, с которой начинается согласование */
+static size_t baud_first;
+/* Скорость, заданная платой, - используется, если согласование не удалось */
+static uint32_t baud_default;
+/* Ошибок чтения на текущей скорости */
+static uint8_t link_errors;
+/* Блок памяти устройства, прочитанный при проверке линии */
+static uint8_t link_ref[DFU_BAUD_CHECK_SIZE];
+
+#endif /* CONFIG_DFU_BAUD_NEGOTIATE */
+
+#ifdef CONFIG_CRC_HW_DMA
+
+/* Результат последнего завершенного DMA-расчета CRC */
+static uint16_t crc_dma_value;
+/* Флаг ошибки DMA-расчета CRC */
+static bool crc_dma_failed;
+
+/**
+ *  @brief  Дождаться окончания DMA-расчета CRC очередного блока.
+ *
+ *  Вызывается модулем dfu_host перед перезаписью приемного буфера, поэтому
+ *  расчет CRC блока идет параллельно с отправкой команды чтения следующего.
+ */
+static void crc_dma_sync(void* ctx)
+{
+    (void)ctx;
+
+    if (!crc16_reflect_dma_pending()) {
+        return;
+    }
+
+    if (crc16_reflect_dma_finish(&crc_dma_value) < 0) {
+        crc_dma_failed = true;
+    }
+}
+
+#endif /* CONFIG_CRC_HW_DMA */
 
 /**
  *  @brief  Прочитать метаинформацию о прошивке из внутренней памяти устройства.
@@ -51,19 +211,370 @@ static inline int read_fw_meta(fw_meta_t* fw_meta)
 {
     CHECK(fw_meta, return -EINVAL);
 
-    const fw_meta_t* meta = NULL;
+    /* Метаинформация принимается сразу в fw_meta */
+    return dfu_host_read_range_buf(&host, board_get_fw_meta_addr(), (uint8_t*)fw_meta, sizeof(fw_meta_t));
+}
+
+/**
+ *  @brief  Сбросить подчиненное устройство (BOOT0 = 1 - запуск загрузчика).
+ *  @param  boot_delay  Ожидание после отпускания линии RST в миллисекундах.
+ */
+static void target_reset(uint32_t boot_delay)
+{
+    board_reset_write(0);
+    HAL_Delay(100);
+    board_reset_write(1);
+    HAL_Delay(boot_delay);
+}
+
+#ifdef CONFIG_DFU_BAUD_NEGOTIATE
+
+/**
+ *  @brief  Проверить линию на текущей скорости: команда GET и два чтения
+ *  одного блока памяти с совпадающим результатом.
+ *  @return 0 - линия исправна, отрицательный код ошибки в противном случае.
+ */
+static int link_check(void)
+{
+    uint8_t version = 0;
+    const uint8_t* cmds = NULL;
+    size_t count = 0;
+
+    int rc = dfu_host_get(&host, &version, &cmds, &count);
+    if (rc < 0) {
+        return rc;
+    }
+
+    rc = dfu_host_read_range_buf(&host, board_get_fw_meta_addr(), link_ref, sizeof(link_ref));
+
+    /* Чтение запрещено защитой RDP, но NACK принят без искажений */
+    if (rc == DFU_HOST_ERR_NACK) {
+        return 0;
+    }
+
+    if (rc < 0) {
+        return rc;
+    }
+
+    const uint8_t* rd = NULL;
 
-    int rc = dfu_host_read_memory(
-        board_get_fw_meta_addr(), (const uint8_t**)&meta, sizeof(fw_meta_t));
+    rc = dfu_host_read_memory(&host, board_get_fw_meta_addr(), &rd, sizeof(link_ref));
     if (rc < 0) {
         return rc;
     }
 
-    *fw_meta = *meta;
+    return (memcmp(link_ref, rd, sizeof(link_ref)) == 0) ? 0 : -EIO;
+}
+
+/**
+ *  @brief  Подобрать максимальную скорость, на которой устройство стабильно отвечает.
+ *
+ *  Загрузчик определяет скорость по первому 0x7F после сброса, поэтому перед
+ *  каждой попыткой устройство перезапускается.
+ *
+ *  @return true - устройство синхронизировано на подобранной скорости.
+ */
+static bool link_negotiate(void)
+{
+    for (size_t i = baud_first; i < ARRAY_SIZE(baud_rates); ++i) {
+        if (dfu_host_set_baudrate(&host, baud_rates[i]) < 0) {
+            continue;
+        }
+
+        target_reset(CONFIG_DFU_BAUD_BOOT_DELAY_MS);
+
+        if (dfu_host_ping(&host, CONFIG_DFU_BAUD_PING_TIMEOUT_MS) == 0 && link_check() == 0) {
+            LOG_DBG("Link: %lu baud", baud_rates[i]);
+            link_errors = 0;
+            return true;
+        }
+
+        LOG_DBG("Link check failed at %lu baud", baud_rates[i]);
+    }
+
+    return false;
+}
+
+/**
+ *  @brief  Учесть ошибку чтения на текущей скорости.
+ *  @return true - скорость понижена, нужно заново согласовать линию.
+ */
+static bool link_error(void)
+{
+    if (++link_errors < CONFIG_DFU_BAUD_DEMOTE_ERRORS) {
+        return false;
+    }
+
+    link_errors = 0;
 
+    const uint32_t baudrate = dfu_host_get_baudrate(&host);
+    size_t next = baud_first;
+
+    while (next < ARRAY_SIZE(baud_rates) && baud_rates[next] >= baudrate) {
+        next += 1;
+    }
+
+    /* Ниже скорости некуда - продолжать на текущей */
+    if (next == ARRAY_SIZE(baud_rates)) {
+        return false;
+    }
+
+    LOG_ERROR("Link errors at %lu baud, falling back to %lu", baudrate, baud_rates[next]);
+    baud_first = next;
+
+    return true;
+}
+
+#endif /* CONFIG_DFU_BAUD_NEGOTIATE */
+
+#ifdef CONFIG_DFU_BAUD_NEGOTIATE
+/* Ошибка чтения блока: прервать чтение, если скорость понижена */
+static bool fw_read_error(void* ctx)
+{
+    (void)ctx;
+
+    /* Линия не держит текущую скорость - согласовать более низкую */
+    return link_error();
+}
+#endif /* CONFIG_DFU_BAUD_NEGOTIATE */
+
+/**
+ *  @brief  Вывести скорость чтения и ее долю от скорости линии.
+ *
+ *  Только в отладочный лог: без него скорость не рассчитывается.
+ *  @param  bytes    Прочитано байт.
+ *  @param  elapsed  Время чтения в миллисекундах.
+ */
+static void fw_read_report(uint32_t bytes, uint32_t elapsed)
+{
+#if LOG_MODULE_IS_ENABLED
+    if (elapsed == 0) {
+        return;
+    }
+
+    const uint32_t rate = (uint64_t)bytes * 1000U / elapsed;
+    const uint32_t baudrate = dfu_host_get_baudrate(&host);
+
+    /* Скорость линии известна только для USART */
+    if (baudrate == 0) {
+        LOG_DBG("Read %lu B in %lu ms: %lu B/s", bytes, elapsed, rate);
+        return;
+    }
+
+    const uint32_t permille = (uint64_t)rate * DFU_UART_FRAME_BITS * 1000U / baudrate;
+
+    LOG_DBG("Read %lu B in %lu ms: %lu B/s, %lu.%lu%% of link rate",
+        bytes, elapsed, rate, permille / 10, permille % 10);
+#endif /* LOG_MODULE_IS_ENABLED */
+}
+
+/**
+ *  @brief  Прочитать прошивку с устройства и рассчитать ее CRC.
+ *
+ *  Чтение продолжается с точки fw_checkpoint, если она относится к той же
+ *  прошивке. При ошибке в точке сохраняются адрес и CRC последнего
+ *  обработанного блока.
+ *
+ *  @param  addr  Начальный адрес.
+ *  @param  len   Размер в байтах.
+ *  @param  crc   Окончательное значение CRC.
+ *  @return 0 или -1, если чтение или расчет не удались.
+ */
+static int fw_read_crc(uint32_t addr, uint32_t len, uint32_t* crc)
+{
+    fw_checkpoint_t* cp = &fw_checkpoint;
+
+    if (fw_checkpoint_begin(cp, &fw_meta, addr, &fw_crc)) {
+        LOG_DBG("Resuming at 0x%08lX", cp->addr);
+    }
+
+    uint32_t value = cp->value;
+    uint32_t pos = cp->addr;
+    bool failed = false;
+
+#ifdef CONFIG_CRC_HW_DMA
+    crc_dma_value = (uint16_t)value;
+    crc_dma_failed = false;
+#endif /* CONFIG_CRC_HW_DMA */
+
+    const uint32_t read_start = HAL_GetTick();
+
+    fw_reader_start(&fw_reader, pos, len - (pos - addr));
+
+    while (!fw_reader_finished(&fw_reader)) {
+
+        const uint8_t* rd = NULL;
+        size_t rc = 0;
+
+        /* Прием и запуск следующих чтений идут в dfu_host_poll(), повтор
+         * после задержки запускается здесь */
+        dfu_host_poll(&host);
+        fw_reader_next(&fw_reader);
+
+        /* В процессе чтения блока возникло много ошибок - перезапуск всего автомата */
+        if (fw_reader.failed) {
+            LOG_ERROR("To many IO errors!");
+            failed = true;
+            break;
+        }
+
+        if (!fw_reader_get(&fw_reader, &rd, &rc)) {
+            continue;
+        }
+
+        if (fw_crc_reflect16) {
+#ifdef CONFIG_CRC_HW_DMA
+            /* Отдать блок CRC-блоку через DMA: расчет идет во время запроса следующего */
+            crc_dma_sync(NULL);
+            if (crc16_reflect_dma_start(fw_crc_rpoly, crc_dma_value, rd, rc) < 0) {
+                crc_dma_failed = true;
+            }
+#else
+            /* Рассчитать CRC16 для очередного блока прочитанных данных */
+            value = crc16_reflect(fw_crc_rpoly, (uint16_t)value, rd, rc);
+#endif /* CONFIG_CRC_HW_DMA */
+        } else {
+            value = crc_engine_update(&fw_crc, value, rd, rc);
+        }
+
+        pos += rc;
+        fw_reader_release(&fw_reader);
+    }
+
+    /* Дождаться окончания запущенного чтения, если оно было прервано */
+    while (dfu_host_busy(&host)) {
+        dfu_host_poll(&host);
+    }
+
+    if (!failed) {
+        fw_read_report(pos - cp->addr, HAL_GetTick() - read_start);
+    }
+
+    dfu_host_link_stats_t link;
+
+    if (dfu_host_get_link_stats(&host, &link) == 0 && link.aborted != 0) {
+        LOG_DBG("Line errors: PE %lu, FE %lu, NE %lu, ORE %lu, aborted %lu replies",
+            link.parity, link.framing, link.noise, link.overrun, link.aborted);
+    }
+
+#ifdef CONFIG_CRC_HW_DMA
+    if (fw_crc_reflect16) {
+        crc_dma_sync(NULL);
+        value = crc_dma_value;
+
+        /* Результат неизвестен - проверить прошивку заново */
+        if (crc_dma_failed) {
+            LOG_ERROR("CRC DMA error");
+            cp->valid = false;
+            return -1;
+        }
+    }
+#endif /* CONFIG_CRC_HW_DMA */
+
+    if (failed) {
+        /* Все принятые блоки учтены в value */
+        cp->addr  = pos;
+        cp->value = value;
+        return -1;
+    }
+
+    cp->valid = false;
+
+    *crc = crc_engine_final(&fw_crc, value);
+    return 0;
+}
+
+/**
+ *  @brief  Восстановить обмен с загрузчиком после прерванного чтения.
+ *  @return true - можно продолжать чтение, false - нужен сброс устройства.
+ */
+static bool fw_read_resync(void)
+{
+#ifdef CONFIG_DFU_BAUD_NEGOTIATE
+    /* Скорость понижена - согласовать ее заново после сброса */
+    if (fw_reader.aborted) {
+        return false;
+    }
+#endif /* CONFIG_DFU_BAUD_NEGOTIATE */
+
+    const int rc = dfu_host_resync(&host, CONFIG_DFU_RESYNC_TIMEOUT_MS);
+
+    LOG_WRN_IF(rc < 0, "Resync failed: %d", rc);
+
+    return rc == 0;
+}
+
+#ifdef CONFIG_DFU_LOADER
+
+static int loader_crc_sink(void* ctx, uint32_t address, const uint8_t* data, size_t len)
+{
+    (void)address;
+
+    uint32_t* value = ctx;
+
+    *value = crc_engine_update(&fw_crc, *value, data, len);
+    return 0;
+}
+
+/**
+ *  @brief  Прочитать прошивку через загрузчик в SRAM и рассчитать ее CRC.
+ *  Загрузчик запускается при первом чтении после сброса устройства.
+ *  @return 0 или код ошибки dfu_host_err_t.
+ */
+static int loader_read_crc(uint32_t addr, uint32_t len, uint32_t* crc)
+{
+    int rc = 0;
+
+    if (!dfu_host_loader_active()) {
+        rc = dfu_host_loader_start(&host, target_caps->pid);
+        if (rc < 0) {
+            return rc;
+        }
+    }
+
+    uint32_t value = crc_engine_begin(&fw_crc);
+    const uint32_t read_start = HAL_GetTick();
+
+    rc = dfu_host_loader_read_range(addr, len, loader_crc_sink, &value);
+    if (rc < 0) {
+        return rc;
+    }
+
+    fw_read_report(len, HAL_GetTick() - read_start);
+
+    *crc = crc_engine_final(&fw_crc, value);
     return 0;
 }
 
+#endif /* CONFIG_DFU_LOADER */
+
+#ifdef CONFIG_DFU_UPDATE
+/**
+ *  @brief  Проверить, нужно ли обновлять устройство по эталонному образу платы.
+ *
+ *  @param  by_meta  true - только если метаинформация образа отличается от
+ *                   прочитанной, false - если образ вообще есть.
+ */
+static bool fw_update_needed(bool by_meta)
+{
+    uint32_t addr = 0;
+    const uint8_t* image = NULL;
+    size_t len = 0;
+
+    if (fw_updated || !board_get_fw_image(&addr, &image, &len)) {
+        return false;
+    }
+
+    const uint32_t meta_addr = board_get_fw_meta_addr();
+
+    if (!by_meta || meta_addr < addr || meta_addr - addr + sizeof(fw_meta_t) > len) {
+        return true;
+    }
+
+    return memcmp(image + (meta_addr - addr), &fw_meta, sizeof(fw_meta_t)) != 0;
+}
+#endif /* CONFIG_DFU_UPDATE */
+
 /**
  *  @brief  Выполнить очередную итерацию основного цикла приложения.
  */
@@ -72,19 +583,31 @@ static void app_dispatch(void)
     switch (app_state) {
     /* Начальное состояние автомата - сброс подчиненного устройства */
     case APP_STATE_INITIAL: {
+#ifdef CONFIG_DFU_LOADER
+        /* Сброс устройства останавливает загрузчик - вернуть скорость системного */
+        dfu_host_loader_reset();
+#endif /* CONFIG_DFU_LOADER */
+
+#ifdef CONFIG_DFU_BAUD_NEGOTIATE
+        if (link_negotiate()) {
+            app_state = APP_STATE_READ_META;
+            return;
+        }
+
+        /* Ни одна скорость не прошла проверку - работать на скорости платы */
+        dfu_host_set_baudrate(&host, baud_default);
+#endif /* CONFIG_DFU_BAUD_NEGOTIATE */
+
         LOG_DBG("Rebooting...");
 
         /* Начальный сброс внешнего MCU */
-        board_reset_write(0);
-        HAL_Delay(100);
-        board_reset_write(1);
-        HAL_Delay(1000);
+        target_reset(1000);
 
         int rc = 0;
 
         /* Получить ответ на Ping */
         for (int i = 0; i < 5; ++i) {
-            rc = dfu_host_ping(1000);
+            rc = dfu_host_ping(&host, 1000);
 
             if (rc == 0) {
                 LOG_DBG("Device found!");
@@ -101,24 +624,25 @@ static void app_dispatch(void)
     /* Запрос у устройства вспомогательной информации */
     case APP_STATE_READ_META: {
 
-        const uint8_t* id = NULL;
-        size_t id_len = 0;
-
-        /* Прочитать ID продукта */
-        int rc = dfu_host_get_id(&id, &id_len);
+        /* Прочитать ID продукта и возможности загрузчика: GET только для
+         * нового ID, версия протокола приходит в ответе GET */
+        int rc = dfu_host_discover(&host, &target_caps);
         if (rc < 0) {
             return;
         }
 
-        LOG_DBG_IF(id_len == 2, "Product ID: %02X %02X", id[0], id[1]);
+        LOG_DBG("Product ID: %04X", target_caps->pid);
+        LOG_DBG("Bootloader version: %d.%d", target_caps->version >> 4, target_caps->version & 0x0F);
 
-        /* Прочитать версию загрузчика */
-        rc = dfu_host_get_version();
-        if (rc < 0) {
-            return;
-        }
+        target = dfu_host_target_find(target_caps->pid);
+        LOG_WRN_IF(target == NULL, "Unknown memory map of %04X", target_caps->pid);
 
-        LOG_DBG("Bootloader version: %d.%d", rc / 10, rc % 10);
+        /* Метаинформация за пределами Flash - ошибка конфигурации платы */
+        if (!fw_meta_addr_valid(target, board_get_fw_meta_addr())) {
+            LOG_ERROR("Firmware meta is outside %s flash", target->name);
+            app_state = APP_STATE_CHECK_FAILURE;
+            break;
+        }
 
         /* Прочитать метаинформацию о прошивке */
         rc = read_fw_meta(&fw_meta);
@@ -128,7 +652,7 @@ static void app_dispatch(void)
             
             /* Ошибка чтения, возможно, произошла из-за выставленной защиты памяти
              * устройства на чтение. Снять защиту чтения памяти на устройстве. */
-            dfu_host_readout_unprotect();
+            dfu_host_readout_unprotect(&host);
             HAL_Delay(1000);
             LOG_DBG("Readout unprotected");
             return;
@@ -136,6 +660,21 @@ static void app_dispatch(void)
 
         LOG_DBG("Firmware size: %lu, CRC: %04X", fw_meta.fw_size, fw_meta.crc16);
 
+#ifdef CONFIG_DFU_UPDATE
+        /* Метаинформация эталонного образа отличается - обновить устройство */
+        if (fw_update_needed(true)) {
+            app_state = APP_STATE_UPDATE;
+            break;
+        }
+#endif /* CONFIG_DFU_UPDATE */
+
+        /* Размер из стертой или испорченной метаинформации */
+        if (!fw_meta_size_valid(target, &fw_meta)) {
+            LOG_ERROR("Firmware size %lu does not fit flash", fw_meta.fw_size);
+            app_state = APP_STATE_CHECK_FAILURE;
+            break;
+        }
+
         /* Переход в сосотояние валидации памяти устройства */
         app_state = APP_STATE_CHECK_FW_CRC;
         break;
@@ -144,56 +683,73 @@ static void app_dispatch(void)
     /* Проверка целостности прошивки на устройстве */
     case APP_STATE_CHECK_FW_CRC: {
 
-        uint32_t data_left = fw_meta.fw_size;
-        uint16_t crc = 0xFFFF;
-        uint32_t addr = 0x08000000;
+        const uint32_t addr = fw_flash_base(target);
+        uint32_t crc = 0;
+        int rc = -1;
+
+#if defined(CONFIG_DFU_CRC_HELPER) || defined(CONFIG_DFU_LOADER)
+        /* Помощник и загрузчик в SRAM запускаются через WRITE_MEM и GO */
+        const bool can_run = target_caps->write && target_caps->go;
+#endif /* CONFIG_DFU_CRC_HELPER || CONFIG_DFU_LOADER */
 
-        while (data_left != 0) {
+#ifdef CONFIG_DFU_CRC_HELPER
+        /* Посчитать CRC на самом устройстве: по линии идет только результат */
+        if (can_run) {
+            rc = dfu_host_crc_remote(&host, &fw_crc, addr, fw_meta.fw_size, target, &crc);
+            LOG_WRN_IF(rc < 0, "CRC helper error: %d, reading firmware", rc);
+        }
+#endif /* CONFIG_DFU_CRC_HELPER */
 
-            size_t sz = MIN(data_left, 256);
+#ifdef CONFIG_DFU_LOADER
+        /* Прочитать прошивку через загрузчик в SRAM на максимальной скорости линии */
+        if (rc < 0 && can_run && !loader_failed) {
+            rc = loader_read_crc(addr, fw_meta.fw_size, &crc);
 
-            const uint8_t* rd = NULL;
-            uint8_t err_cnt = 0;
-            int rc = 0;
+            if (rc < 0) {
+                LOG_WRN("Loader error: %d, using system bootloader", rc);
+                loader_failed = true;
 
-            /* Прочитать очередной блок памяти устройства */
-            for (uint8_t i = 0; i < 5; ++i) {
-                rc = dfu_host_read_memory(addr, &rd, sz);
-                if (rc > 0) {
-                    err_cnt = 0;
+                /* Загрузчик мог остаться запущенным - сбросить устройство */
+                if (rc != DFU_HOST_ERR_EINVAL) {
+                    app_state = APP_STATE_INITIAL;
                     break;
                 }
-
-                err_cnt += 1;
             }
+        }
+#endif /* CONFIG_DFU_LOADER */
 
-            /* В процессе чтения блока возникло много ошибок - перезапуск всего автомата */
-            if (err_cnt) {
-                LOG_ERROR("To many IO errors!");
+        if (rc < 0 && fw_read_crc(addr, fw_meta.fw_size, &crc) < 0) {
+            /* Продолжить с точки fw_checkpoint без сброса, если загрузчик отвечает.
+             * После сброса проверка тоже продолжается с нее */
+            if (!fw_read_resync()) {
                 app_state = APP_STATE_INITIAL;
-                break;
             }
-
-            /* Рассчитать CRC16 (MODBUS) для очередного блока прочитанных данных */
-            crc = crc16_reflect(0xA001, crc, rd, rc);
-
-            data_left -= sz;
-            addr += sz;
+            break;
         }
 
-        LOG_DBG("CRC calculated: %04X", crc);
+        LOG_DBG("CRC calculated: %04lX", crc);
 
         /* Проверить корректность CRC прошивки */
         if (fw_meta.crc16 != crc) {
             LOG_ERROR("Wrong CRC value");
             app_state = APP_STATE_CHECK_FAILURE;
+#ifdef CONFIG_DFU_UPDATE
+            /* Прошивка повреждена - восстановить ее по эталонному образу */
+            if (fw_update_needed(false)) {
+                app_state = APP_STATE_UPDATE;
+            }
+#endif /* CONFIG_DFU_UPDATE */
             break;
         }
 
         LOG_DBG("CRC match");
 
         /* Запустить программу на устройстве с начального адреса Flash */
-        int rc = dfu_host_go(0x08000000);
+#ifdef CONFIG_DFU_LOADER
+        rc = dfu_host_loader_active() ? dfu_host_loader_go(addr) : dfu_host_go(&host, addr);
+#else
+        rc = dfu_host_go(&host, addr);
+#endif /* CONFIG_DFU_LOADER */
         if (rc < 0) {
             LOG_ERROR("Error while starting application: %d", rc);
             app_state = APP_STATE_CHECK_FAILURE;
@@ -206,6 +762,58 @@ static void app_dispatch(void)
         break;
     }
 
+#ifdef CONFIG_DFU_UPDATE
+    /* Обновление отличающихся секторов Flash по эталонному образу */
+    case APP_STATE_UPDATE: {
+
+        uint32_t addr = 0;
+        const uint8_t* image = NULL;
+        size_t len = 0;
+
+        board_get_fw_image(&addr, &image, &len);
+
+        dfu_host_update_cfg_t cfg = {
+            .layout = (target != NULL) ? &target->flash : NULL,
+#ifdef CONFIG_DFU_CRC_HELPER
+            /* Дайджест сектора считает помощник, по линии идет только результат */
+            .digest = dfu_host_digest_helper,
+            .digest_ctx = (void*)target,
+#else
+            .digest = dfu_host_digest_readback,
+#endif /* CONFIG_DFU_CRC_HELPER */
+        };
+
+        if (cfg.layout == NULL) {
+            LOG_ERROR("Unknown flash layout of %04X", target_caps->pid);
+            app_state = APP_STATE_CHECK_FAILURE;
+            break;
+        }
+
+        if (!target_caps->write || target_caps->erase == DFU_HOST_ERASE_NONE) {
+            LOG_ERROR("Bootloader of %04X cannot write flash", target_caps->pid);
+            app_state = APP_STATE_CHECK_FAILURE;
+            break;
+        }
+
+        dfu_host_update_stats_t stats;
+        int rc = dfu_host_update(&host, &cfg, addr, image, len, &stats);
+        if (rc < 0) {
+            LOG_ERROR("Update error: %d", rc);
+            /* NACK - адрес или сектор защищен, повтор не поможет */
+            app_state = (rc == DFU_HOST_ERR_NACK) ? APP_STATE_CHECK_FAILURE : APP_STATE_INITIAL;
+            break;
+        }
+
+        LOG_DBG("Updated %u of %u sectors, %u B in %lu ms", stats.sectors_changed,
+            stats.sectors_total, stats.bytes_written, stats.elapsed_ms);
+
+        /* Проверить обновленную прошивку заново */
+        fw_updated = true;
+        app_state = APP_STATE_READ_META;
+        break;
+    }
+#endif /* CONFIG_DFU_UPDATE */
+
     /* Приложение успешно проверено и запущено */
     case APP_STATE_CHECK_DONE: {
         static bool value = false;
@@ -236,7 +844,74 @@ int main(void)
     /* Начальная инициализация системы */
     board_init();
 
-    dfu_host_init(board_get_serial_handle());
+#ifdef CONFIG_CRC_BENCHMARK
+    crc_bench_run();
+#endif /* CONFIG_CRC_BENCHMARK */
+
+    /* Выбрать алгоритм CRC прошивки; неизвестное имя или слишком широкий
+     * для поля fw_meta_t.crc16 алгоритм заменяется на CRC-16/MODBUS */
+    const struct crc_model *model = crc_model_find(CONFIG_FW_META_CRC_MODEL);
+    CHECK(model != NULL && model->width <= 16, model = crc_model_find("CRC-16/MODBUS"));
+
+    /* Построить таблицы CRC до начала проверки */
+    crc_engine_init(&fw_crc, model);
+    fw_crc_reflect16 = model->width == 16 && model->refin && model->refout;
+    if (fw_crc_reflect16) {
+        fw_crc_rpoly = (uint16_t)crc_reflect(model->poly, 16);
+        crc16_reflect_init(fw_crc_rpoly);
+    }
+
+    LOG_DBG("Firmware CRC: %s", model->name);
+
+#ifdef CONFIG_DFU_GANG_CHANNELS
+    /* Проверить устройства всех каналов и сообщить итог платой */
+    static gang_result_t gang_results[CONFIG_DFU_GANG_CHANNELS];
+
+    const size_t gang_count = gang_run(&fw_crc, gang_results, ARRAY_SIZE(gang_results));
+    size_t passed = 0;
+
+    for (size_t i = 0; i < gang_count; ++i) {
+        passed += (gang_results[i].status == GANG_STATUS_PASS) ? 1 : 0;
+    }
+
+    board_gang_report(gang_results, gang_count);
+
+    /* Светодиод мигает так же, как после проверки одного устройства:
+     * медленно - все прошивки верны */
+    const uint32_t blink_ms = (gang_count != 0 && passed == gang_count) ? 1000 : 150;
+    bool value = false;
+
+    while (1) {
+        board_led_write(value = !value);
+        HAL_Delay(blink_ms);
+    }
+#endif /* CONFIG_DFU_GANG_CHANNELS */
+
+#if defined(CONFIG_DFU_HOST_TRANSPORT_SPI)
+    dfu_host_init_transport(&host, dfu_host_transport_spi(board_get_spi_handle()));
+#elif defined(CONFIG_DFU_HOST_TRANSPORT_I2C)
+    dfu_host_init_transport(&host, dfu_host_transport_i2c(board_get_i2c_handle(), CONFIG_DFU_HOST_I2C_ADDR));
+#else
+    dfu_host_init(&host, board_get_serial_handle());
+#endif
+
+#ifdef CONFIG_DFU_BAUD_NEGOTIATE
+    baud_default = dfu_host_get_baudrate(&host);
+
+    while (baud_first < ARRAY_SIZE(baud_rates) - 1 && baud_rates[baud_first] > CONFIG_DFU_BAUD_MAX) {
+        baud_first += 1;
+    }
+#endif /* CONFIG_DFU_BAUD_NEGOTIATE */
+
+#ifdef CONFIG_DFU_BAUD_NEGOTIATE
+    fw_reader_init(&fw_reader, &host, fw_read_error, NULL);
+#else
+    fw_reader_init(&fw_reader, &host, NULL, NULL);
+#endif /* CONFIG_DFU_BAUD_NEGOTIATE */
+
+#ifdef CONFIG_CRC_HW_DMA
+    dfu_host_set_rx_wait_cb(&host, crc_dma_sync, NULL);
+#endif /* CONFIG_CRC_HW_DMA */
 
     /* Установить линию BOOT0 внешнего MCU в 1 */
     board_boot0_write(true);
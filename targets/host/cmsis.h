@@ -0,0 +1,6 @@
+#ifndef MCU_TARGET_CMSIS_H
+#define MCU_TARGET_CMSIS_H
+
+#include "host_hal.h"
+
+#endif /* !MCU_TARGET_CMSIS_H */
@@ -0,0 +1,35 @@
+#ifndef HOST_CMSIS_GCC_H
+#define HOST_CMSIS_GCC_H
+
+/*
+ * Эмуляция регистров ядра Cortex-M, используемых core/critical_section.c.
+ * "Прерывания" хостовой сборки - это обработчики UART, которые вызывает
+ * host_hal.c; пока PRIMASK установлен, они не вызываются.
+ */
+
+#include <stdint.h>
+
+extern volatile uint32_t host_primask;
+extern volatile uint32_t host_ipsr;
+
+static inline uint32_t __get_PRIMASK(void)
+{
+    return host_primask;
+}
+
+static inline uint32_t __get_IPSR(void)
+{
+    return host_ipsr;
+}
+
+static inline void __disable_irq(void)
+{
+    host_primask = 1;
+}
+
+static inline void __enable_irq(void)
+{
+    host_primask = 0;
+}
+
+#endif /* !HOST_CMSIS_GCC_H */
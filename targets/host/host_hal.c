@@ -0,0 +1,582 @@
+#include <string.h>
+
+#include "host_hal.h"
+
+/* Эмулируемые регистры PRIMASK и IPSR (см. cmsis_gcc.h) */
+volatile uint32_t host_primask = 0;
+volatile uint32_t host_ipsr    = 0;
+
+/* Виртуальное время в миллисекундах */
+static uint32_t host_tick = 0;
+/* Доля текущей миллисекунды виртуального времени, мкс */
+static uint32_t host_us_frac = 0;
+/* С последнего вызова HAL_GetTick() были обмены по SPI/I2C */
+static bool host_bus_activity = false;
+
+/* UART, для которых моделируются прерывания и модели устройств */
+#define HOST_UART_MAX 4
+static UART_HandleTypeDef* host_uarts[HOST_UART_MAX];
+
+static void uart_default_cb(UART_HandleTypeDef* huart)
+{
+    (void)huart;
+}
+
+static inline size_t fifo_level(const UART_HandleTypeDef* huart)
+{
+    return huart->rx_head - huart->rx_tail;
+}
+
+/* Забрать байт из FIFO, ошибка его приема добавляется в *error */
+static inline uint8_t fifo_pop(UART_HandleTypeDef* huart, uint32_t* error)
+{
+    const size_t i = huart->rx_tail++ % CONFIG_HOST_UART_FIFO_SIZE;
+
+    *error |= huart->rx_fifo_err[i];
+
+    return huart->rx_fifo[i];
+}
+
+/* Дать моделям устройств отработать текущий тик */
+static void peers_poll(void)
+{
+    for (size_t i = 0; i < HOST_UART_MAX; ++i) {
+        UART_HandleTypeDef* huart = host_uarts[i];
+
+        if (huart != NULL && huart->peer != NULL && huart->peer->poll != NULL) {
+            huart->peer->poll(huart->peer->ctx, host_tick);
+        }
+    }
+}
+
+/* Обработать "прерывания" приема по всем UART; true - прием продвинулся */
+static bool uart_irq_dispatch(void)
+{
+    bool progress = false;
+
+    if (host_primask != 0 || host_ipsr != 0) {
+        return false;
+    }
+
+    for (size_t i = 0; i < HOST_UART_MAX; ++i) {
+        UART_HandleTypeDef* huart = host_uarts[i];
+
+        if (huart == NULL) {
+            continue;
+        }
+
+        if (huart->gState == HAL_UART_STATE_BUSY_TX) {
+            huart->gState = HAL_UART_STATE_READY;
+
+            host_ipsr = 1;
+            huart->TxCpltCallback(huart);
+            host_ipsr = 0;
+
+            progress = true;
+        }
+
+        while (huart->RxState == HAL_UART_STATE_BUSY_RX && !huart->rx_dma &&
+               fifo_level(huart) > 0) {
+            uint32_t error = HAL_UART_ERROR_NONE;
+
+            *huart->pRxBuffPtr++ = fifo_pop(huart, &error);
+            progress = true;
+
+            if (--huart->RxXferCount == 0) {
+                huart->RxState = HAL_UART_STATE_READY;
+
+                /* Коллбэк может сразу начать следующий прием */
+                host_ipsr = 1;
+                huart->RxCpltCallback(huart);
+                host_ipsr = 0;
+            }
+
+            /* Как в HAL STM32, ошибка сообщается сразу после приема байта */
+            if (error != HAL_UART_ERROR_NONE) {
+                huart->ErrorCode |= error;
+                break;
+            }
+        }
+
+        if (huart->ErrorCode != HAL_UART_ERROR_NONE &&
+            huart->RxState == HAL_UART_STATE_BUSY_RX) {
+            huart->RxState = HAL_UART_STATE_READY;
+            huart->rx_dma  = false;
+
+            host_ipsr = 1;
+            huart->ErrorCallback(huart);
+            host_ipsr = 0;
+
+            progress = true;
+        }
+    }
+
+    return progress;
+}
+
+/* Продвинуть виртуальное время на 1 мс */
+static void tick_advance(void)
+{
+    host_tick += 1;
+    peers_poll();
+}
+
+/* Продвинуть виртуальное время на us микросекунд */
+static void time_advance_us(uint32_t us)
+{
+    host_us_frac += us;
+
+    while (host_us_frac >= 1000U) {
+        host_us_frac -= 1000U;
+        tick_advance();
+    }
+
+    peers_poll();
+}
+
+HAL_StatusTypeDef HAL_Init(void)
+{
+    host_tick    = 0;
+    host_us_frac = 0;
+    host_primask = 0;
+    host_ipsr    = 0;
+
+    return HAL_OK;
+}
+
+uint32_t HAL_GetTick(void)
+{
+    peers_poll();
+
+    /* Обмены по SPI/I2C сами продвигают время */
+    if (!uart_irq_dispatch() && !host_bus_activity) {
+        time_advance_us(CONFIG_HOST_IDLE_STEP_US);
+
+        /* Прерывания по байтам, принятым за это время, срабатывают до
+         * возврата, как на USART: ошибку байта, уже записанного DMA, код
+         * увидит раньше самого байта */
+        uart_irq_dispatch();
+    }
+
+    host_bus_activity = false;
+
+    return host_tick;
+}
+
+uint32_t host_tick_now(void)
+{
+    return host_tick;
+}
+
+uint64_t host_time_us(void)
+{
+    return (uint64_t)host_tick * 1000U + host_us_frac;
+}
+
+/* Учесть время передачи bits бит на частоте clock_hz */
+static void bus_time_advance(uint64_t bits, uint32_t clock_hz)
+{
+    time_advance_us((uint32_t)((bits * 1000000U + clock_hz - 1) / clock_hz));
+    host_bus_activity = true;
+}
+
+void HAL_Delay(uint32_t delay)
+{
+    const uint32_t start = host_tick;
+
+    while ((host_tick - start) < delay) {
+        tick_advance();
+        uart_irq_dispatch();
+    }
+}
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef* huart)
+{
+    if (huart == NULL) {
+        return HAL_ERROR;
+    }
+
+    huart->rx_dma    = false;
+    huart->rx_head   = 0;
+    huart->rx_tail   = 0;
+    huart->gState    = HAL_UART_STATE_READY;
+    huart->RxState   = HAL_UART_STATE_READY;
+    huart->ErrorCode = HAL_UART_ERROR_NONE;
+
+    /* Повторная инициализация (например, смена скорости) сохраняет
+     * подключенную модель, коллбэки и канал DMA, как и HAL_UART_Init() */
+    for (size_t i = 0; i < HOST_UART_MAX; ++i) {
+        if (host_uarts[i] == huart) {
+            return HAL_OK;
+        }
+    }
+
+    huart->peer           = NULL;
+    huart->TxCpltCallback = uart_default_cb;
+    huart->RxCpltCallback = uart_default_cb;
+    huart->ErrorCallback  = uart_default_cb;
+
+    for (size_t i = 0; i < HOST_UART_MAX; ++i) {
+        if (host_uarts[i] == NULL) {
+            host_uarts[i] = huart;
+            return HAL_OK;
+        }
+    }
+
+    return HAL_ERROR;
+}
+
+void host_uart_attach(UART_HandleTypeDef* huart, const host_uart_peer_t* peer)
+{
+    huart->peer = peer;
+}
+
+/* Записать байт в буфер DMA, как это делает циклический канал */
+static void dma_rx_put(UART_HandleTypeDef* huart, uint8_t data)
+{
+    DMA_HandleTypeDef* hdma = huart->hdmarx;
+
+    huart->pRxBuffPtr[huart->RxXferSize - hdma->CNDTR] = data;
+
+    if (--hdma->CNDTR == 0) {
+        hdma->CNDTR = huart->RxXferSize;
+    }
+}
+
+size_t host_uart_rx_push(UART_HandleTypeDef* huart, const uint8_t* data, size_t len)
+{
+    size_t i = 0;
+
+    if (huart->rx_dma && huart->RxState == HAL_UART_STATE_BUSY_RX) {
+        for (; i < len; ++i) {
+            dma_rx_put(huart, data[i]);
+        }
+
+        return i;
+    }
+
+    for (; i < len; ++i) {
+        if (fifo_level(huart) == CONFIG_HOST_UART_FIFO_SIZE) {
+            huart->ErrorCode |= HAL_UART_ERROR_ORE;
+            break;
+        }
+
+        huart->rx_fifo_err[huart->rx_head % CONFIG_HOST_UART_FIFO_SIZE] = HAL_UART_ERROR_NONE;
+        huart->rx_fifo[huart->rx_head++ % CONFIG_HOST_UART_FIFO_SIZE]   = data[i];
+    }
+
+    return i;
+}
+
+void host_uart_rx_error(UART_HandleTypeDef* huart, uint32_t error)
+{
+    /* Байт еще в FIFO - ошибка остается при нем */
+    if (fifo_level(huart) > 0) {
+        huart->rx_fifo_err[(huart->rx_head - 1) % CONFIG_HOST_UART_FIFO_SIZE] |= error;
+        return;
+    }
+
+    if (huart->RxState == HAL_UART_STATE_BUSY_RX) {
+        huart->ErrorCode |= error;
+    }
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef* huart, const uint8_t* data,
+    uint16_t size, uint32_t timeout)
+{
+    (void)timeout;
+
+    if (data == NULL || size == 0) {
+        return HAL_ERROR;
+    }
+
+    if (huart->peer != NULL && huart->peer->receive != NULL) {
+        huart->peer->receive(huart->peer->ctx, data, size);
+    }
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit_IT(UART_HandleTypeDef* huart, const uint8_t* data,
+    uint16_t size)
+{
+    if (data == NULL || size == 0) {
+        return HAL_ERROR;
+    }
+
+    if (huart->gState != HAL_UART_STATE_READY) {
+        return HAL_BUSY;
+    }
+
+    huart->gState = HAL_UART_STATE_BUSY_TX;
+
+    if (huart->peer != NULL && huart->peer->receive != NULL) {
+        huart->peer->receive(huart->peer->ctx, data, size);
+    }
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_AbortTransmit_IT(UART_HandleTypeDef* huart)
+{
+    huart->gState = HAL_UART_STATE_READY;
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Receive(UART_HandleTypeDef* huart, uint8_t* data,
+    uint16_t size, uint32_t timeout)
+{
+    if (data == NULL || size == 0) {
+        return HAL_ERROR;
+    }
+
+    if (huart->RxState != HAL_UART_STATE_READY) {
+        return HAL_BUSY;
+    }
+
+    const uint32_t start = host_tick;
+    /* Блокирующий прием HAL STM32 ошибки приема не проверяет */
+    uint32_t error = HAL_UART_ERROR_NONE;
+
+    while (size > 0) {
+        peers_poll();
+
+        if (fifo_level(huart) > 0) {
+            *data++ = fifo_pop(huart, &error);
+            size -= 1;
+            continue;
+        }
+
+        if ((host_tick - start) >= timeout) {
+            return HAL_TIMEOUT;
+        }
+
+        tick_advance();
+    }
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Receive_IT(UART_HandleTypeDef* huart, uint8_t* data,
+    uint16_t size)
+{
+    if (data == NULL || size == 0) {
+        return HAL_ERROR;
+    }
+
+    if (huart->RxState != HAL_UART_STATE_READY) {
+        return HAL_BUSY;
+    }
+
+    huart->pRxBuffPtr  = data;
+    huart->RxXferSize  = size;
+    huart->RxXferCount = size;
+    huart->ErrorCode   = HAL_UART_ERROR_NONE;
+    huart->RxState     = HAL_UART_STATE_BUSY_RX;
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Receive_DMA(UART_HandleTypeDef* huart, uint8_t* data,
+    uint16_t size)
+{
+    if (data == NULL || size == 0 || huart->hdmarx == NULL) {
+        return HAL_ERROR;
+    }
+
+    if (huart->RxState != HAL_UART_STATE_READY) {
+        return HAL_BUSY;
+    }
+
+    huart->pRxBuffPtr    = data;
+    huart->RxXferSize    = size;
+    huart->RxXferCount   = size;
+    huart->hdmarx->CNDTR = size;
+    huart->ErrorCode     = HAL_UART_ERROR_NONE;
+    huart->rx_dma        = true;
+    huart->RxState       = HAL_UART_STATE_BUSY_RX;
+
+    /* Уже принятые байты DMA забирает сразу после запуска, их ошибки
+     * останавливают прием */
+    uint32_t error = HAL_UART_ERROR_NONE;
+
+    while (fifo_level(huart) > 0) {
+        dma_rx_put(huart, fifo_pop(huart, &error));
+    }
+
+    huart->ErrorCode = error;
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_AbortReceive(UART_HandleTypeDef* huart)
+{
+    huart->RxState = HAL_UART_STATE_READY;
+    huart->rx_dma  = false;
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_AbortReceive_IT(UART_HandleTypeDef* huart)
+{
+    huart->RxState = HAL_UART_STATE_READY;
+    huart->rx_dma  = false;
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_RegisterCallback(UART_HandleTypeDef* huart,
+    HAL_UART_CallbackIDTypeDef id, pUART_CallbackTypeDef callback)
+{
+    if (callback == NULL) {
+        return HAL_ERROR;
+    }
+
+    switch (id) {
+    case HAL_UART_TX_COMPLETE_CB_ID:
+        huart->TxCpltCallback = callback;
+        break;
+
+    case HAL_UART_RX_COMPLETE_CB_ID:
+        huart->RxCpltCallback = callback;
+        break;
+
+    case HAL_UART_ERROR_CB_ID:
+        huart->ErrorCallback = callback;
+        break;
+
+    default:
+        return HAL_ERROR;
+    }
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_Init(SPI_HandleTypeDef* hspi)
+{
+    if (hspi == NULL) {
+        return HAL_ERROR;
+    }
+
+    hspi->peer = NULL;
+
+    return HAL_OK;
+}
+
+void host_spi_attach(SPI_HandleTypeDef* hspi, const host_spi_peer_t* peer)
+{
+    hspi->peer = peer;
+}
+
+HAL_StatusTypeDef HAL_SPI_TransmitReceive(SPI_HandleTypeDef* hspi, uint8_t* tx, uint8_t* rx,
+    uint16_t size, uint32_t timeout)
+{
+    (void)timeout;
+
+    if (tx == NULL || rx == NULL || size == 0) {
+        return HAL_ERROR;
+    }
+
+    const uint32_t clock_hz = CONFIG_HOST_SPI_PCLK_HZ / (2U << (hspi->Init.BaudRatePrescaler >> 3));
+
+    /* По байту: модель видит каждый байт в момент окончания его передачи.
+     * tx и rx могут совпадать, как и в HAL */
+    for (uint16_t i = 0; i < size; ++i) {
+        const uint8_t out = tx[i];
+        uint8_t in = 0xFF;
+
+        bus_time_advance(8, clock_hz);
+
+        if (hspi->peer != NULL) {
+            hspi->peer->exchange(hspi->peer->ctx, &out, &in, 1);
+        }
+
+        rx[i] = in;
+    }
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef* hi2c)
+{
+    if (hi2c == NULL) {
+        return HAL_ERROR;
+    }
+
+    hi2c->peer      = NULL;
+    hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+
+    return HAL_OK;
+}
+
+void host_i2c_attach(I2C_HandleTypeDef* hi2c, const host_i2c_peer_t* peer)
+{
+    hi2c->peer = peer;
+}
+
+/* Транзакция I2C: адрес и данные, по 9 тактов на байт */
+static HAL_StatusTypeDef i2c_transfer(I2C_HandleTypeDef* hi2c, uint16_t address,
+    uint8_t* data, uint16_t size, bool read)
+{
+    hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+
+    bool acked = false;
+
+    if (hi2c->peer != NULL) {
+        acked = read ? hi2c->peer->read(hi2c->peer->ctx, address >> 1, data, size)
+                     : hi2c->peer->write(hi2c->peer->ctx, address >> 1, data, size);
+    }
+
+    /* На NACK адреса транзакция заканчивается после первого байта */
+    bus_time_advance(9U * (acked ? size + 1U : 1U), CONFIG_HOST_I2C_CLOCK_HZ);
+
+    if (!acked) {
+        hi2c->ErrorCode = HAL_I2C_ERROR_AF;
+        return HAL_ERROR;
+    }
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit(I2C_HandleTypeDef* hi2c, uint16_t address,
+    uint8_t* data, uint16_t size, uint32_t timeout)
+{
+    (void)timeout;
+
+    if (data == NULL || size == 0) {
+        return HAL_ERROR;
+    }
+
+    return i2c_transfer(hi2c, address, data, size, false);
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Receive(I2C_HandleTypeDef* hi2c, uint16_t address,
+    uint8_t* data, uint16_t size, uint32_t timeout)
+{
+    (void)timeout;
+
+    if (data == NULL || size == 0) {
+        return HAL_ERROR;
+    }
+
+    return i2c_transfer(hi2c, address, data, size, true);
+}
+
+HAL_StatusTypeDef HAL_I2C_IsDeviceReady(I2C_HandleTypeDef* hi2c, uint16_t address,
+    uint32_t trials, uint32_t timeout)
+{
+    const uint32_t start = HAL_GetTick();
+
+    for (uint32_t i = 0; i < trials || trials == 0; ++i) {
+        if (i2c_transfer(hi2c, address, NULL, 0, false) == HAL_OK) {
+            return HAL_OK;
+        }
+
+        if (HAL_GetTick() - start >= timeout) {
+            break;
+        }
+    }
+
+    return HAL_ERROR;
+}
@@ -0,0 +1,355 @@
+#ifndef HOST_HAL_H
+#define HOST_HAL_H
+
+/*
+ * Минимальная замена STM32 HAL для сборки под хост (BOARD=host).
+ *
+ * Реализовано только то, что используют source/ и boards/host: виртуальные
+ * системные часы (HAL_GetTick()/HAL_Delay()) и UART, SPI и I2C, подключаемые
+ * к программной модели устройства (host_*_peer_t). Время виртуальное:
+ * оно идет только пока код ждет данных, поэтому результат не зависит от
+ * загрузки хоста, а таймауты проходят мгновенно.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "cmsis_gcc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HAL_SPI_MODULE_ENABLED
+#define HAL_I2C_MODULE_ENABLED
+
+/* Частота тактирования SPI до предделителя, Гц */
+#ifndef CONFIG_HOST_SPI_PCLK_HZ
+#define CONFIG_HOST_SPI_PCLK_HZ 64000000U
+#endif /* CONFIG_HOST_SPI_PCLK_HZ */
+
+/* Частота шины I2C, Гц */
+#ifndef CONFIG_HOST_I2C_CLOCK_HZ
+#define CONFIG_HOST_I2C_CLOCK_HZ 400000U
+#endif /* CONFIG_HOST_I2C_CLOCK_HZ */
+
+/* Шаг виртуального времени при опросе HAL_GetTick() без событий, мкс.
+ * Должен быть меньше времени байта на линии, иначе ожидание ACK
+ * округляется до шага и искажает измеренную скорость обмена */
+#ifndef CONFIG_HOST_IDLE_STEP_US
+#define CONFIG_HOST_IDLE_STEP_US 10U
+#endif /* CONFIG_HOST_IDLE_STEP_US */
+
+/* Размер приемного FIFO UART в байтах */
+#ifndef CONFIG_HOST_UART_FIFO_SIZE
+#define CONFIG_HOST_UART_FIFO_SIZE 4096
+#endif /* CONFIG_HOST_UART_FIFO_SIZE */
+
+#define HAL_MAX_DELAY 0xFFFFFFFFU
+
+typedef enum {
+    HAL_OK      = 0x00U,
+    HAL_ERROR   = 0x01U,
+    HAL_BUSY    = 0x02U,
+    HAL_TIMEOUT = 0x03U,
+} HAL_StatusTypeDef;
+
+typedef enum {
+    HAL_UART_STATE_RESET   = 0x00U,
+    HAL_UART_STATE_READY   = 0x20U,
+    HAL_UART_STATE_BUSY_TX = 0x21U,
+    HAL_UART_STATE_BUSY_RX = 0x22U,
+} HAL_UART_StateTypeDef;
+
+#define HAL_UART_ERROR_NONE 0x00000000U
+#define HAL_UART_ERROR_PE   0x00000001U
+#define HAL_UART_ERROR_NE   0x00000002U
+#define HAL_UART_ERROR_FE   0x00000004U
+#define HAL_UART_ERROR_ORE  0x00000008U
+
+#define UART_WORDLENGTH_8B  0x00000000U
+#define UART_WORDLENGTH_9B  0x00001000U
+#define UART_STOPBITS_1     0x00000000U
+#define UART_PARITY_NONE    0x00000000U
+#define UART_PARITY_EVEN    0x00000400U
+#define UART_MODE_TX_RX     0x0000000CU
+
+typedef struct {
+    uint32_t BaudRate;
+    uint32_t WordLength;
+    uint32_t StopBits;
+    uint32_t Parity;
+    uint32_t Mode;
+} UART_InitTypeDef;
+
+typedef struct __UART_HandleTypeDef UART_HandleTypeDef;
+
+/**
+ *  @brief  Канал DMA приема UART.
+ *
+ *  Моделируется только циклический режим: байты от модели устройства пишутся
+ *  прямо в буфер приема, минуя FIFO и не дожидаясь снятия PRIMASK.
+ */
+typedef struct __DMA_HandleTypeDef {
+    volatile uint32_t CNDTR;  /* Сколько байт осталось до конца буфера */
+    void* Parent;
+} DMA_HandleTypeDef;
+
+#define __HAL_DMA_GET_COUNTER(__HANDLE__) ((__HANDLE__)->CNDTR)
+
+#define __HAL_LINKDMA(__HANDLE__, __PPP_DMA_FIELD__, __DMA_HANDLE__) \
+    do {                                                             \
+        (__HANDLE__)->__PPP_DMA_FIELD__ = &(__DMA_HANDLE__);         \
+        (__DMA_HANDLE__).Parent = (__HANDLE__);                      \
+    } while (0)
+
+/**
+ *  @brief  Программная модель устройства на другом конце линии UART.
+ */
+typedef struct {
+    /* Байты, отправленные хостом через HAL_UART_Transmit()/HAL_UART_Transmit_IT() */
+    void (*receive)(void* ctx, const uint8_t* data, size_t len);
+    /* Вызывается при каждом шаге виртуального времени (см. host_time_us()),
+     * now - текущий тик */
+    void (*poll)(void* ctx, uint32_t now);
+    void* ctx;
+} host_uart_peer_t;
+
+typedef enum {
+    HAL_UART_TX_COMPLETE_CB_ID = 0x01U,
+    HAL_UART_RX_COMPLETE_CB_ID = 0x03U,
+    HAL_UART_ERROR_CB_ID       = 0x04U,
+} HAL_UART_CallbackIDTypeDef;
+
+typedef void (*pUART_CallbackTypeDef)(UART_HandleTypeDef* huart);
+
+struct __UART_HandleTypeDef {
+    UART_InitTypeDef Init;
+
+    const host_uart_peer_t* peer;
+
+    /* Байты, переданные моделью устройства и еще не прочитанные, и ошибки
+     * их приема (HAL_UART_ERROR_*), как флаги USART при байте в DR */
+    uint8_t rx_fifo[CONFIG_HOST_UART_FIFO_SIZE];
+    uint8_t rx_fifo_err[CONFIG_HOST_UART_FIFO_SIZE];
+    size_t  rx_head;
+    size_t  rx_tail;
+
+    /* Текущий прием по прерыванию или DMA */
+    uint8_t*  pRxBuffPtr;
+    uint16_t  RxXferSize;
+    uint16_t  RxXferCount;
+
+    DMA_HandleTypeDef* hdmarx; /* Канал DMA приема или NULL */
+    bool rx_dma;               /* Текущий прием идет по DMA */
+
+    volatile HAL_UART_StateTypeDef gState;
+    volatile HAL_UART_StateTypeDef RxState;
+    volatile uint32_t ErrorCode;
+
+    pUART_CallbackTypeDef TxCpltCallback;
+    pUART_CallbackTypeDef RxCpltCallback;
+    pUART_CallbackTypeDef ErrorCallback;
+};
+
+HAL_StatusTypeDef HAL_Init(void);
+
+/**
+ *  @brief  Текущее виртуальное время в миллисекундах.
+ *
+ *  Вызов обрабатывает отложенные "прерывания" UART. Если ни одно из них не
+ *  продвинуло прием или передачу, время увеличивается на 1 мс - так циклы ожидания вида
+ *  while (HAL_GetTick() < end) завершаются за конечное число итераций.
+ */
+uint32_t HAL_GetTick(void);
+
+void HAL_Delay(uint32_t delay);
+
+/**
+ *  @brief  Текущее виртуальное время без обработки "прерываний" и его продвижения.
+ *
+ *  Предназначена для моделей устройств, вызываемых из HAL.
+ */
+uint32_t host_tick_now(void);
+
+/**
+ *  @brief  Текущее виртуальное время в микросекундах, с учетом времени
+ *  обменов по SPI и I2C внутри текущей миллисекунды.
+ */
+uint64_t host_time_us(void);
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef* huart);
+
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef* huart, const uint8_t* data,
+    uint16_t size, uint32_t timeout);
+
+/**
+ *  @brief  Передача по прерываниям: модель устройства получает данные сразу,
+ *  коллбэк окончания передачи вызывается из следующего HAL_GetTick().
+ */
+HAL_StatusTypeDef HAL_UART_Transmit_IT(UART_HandleTypeDef* huart, const uint8_t* data,
+    uint16_t size);
+
+HAL_StatusTypeDef HAL_UART_AbortTransmit_IT(UART_HandleTypeDef* huart);
+
+HAL_StatusTypeDef HAL_UART_Receive(UART_HandleTypeDef* huart, uint8_t* data,
+    uint16_t size, uint32_t timeout);
+
+HAL_StatusTypeDef HAL_UART_Receive_IT(UART_HandleTypeDef* huart, uint8_t* data,
+    uint16_t size);
+
+/**
+ *  @brief  Начать циклический прием по DMA (канал подключается __HAL_LINKDMA).
+ */
+HAL_StatusTypeDef HAL_UART_Receive_DMA(UART_HandleTypeDef* huart, uint8_t* data,
+    uint16_t size);
+
+HAL_StatusTypeDef HAL_UART_AbortReceive(UART_HandleTypeDef* huart);
+
+HAL_StatusTypeDef HAL_UART_AbortReceive_IT(UART_HandleTypeDef* huart);
+
+HAL_StatusTypeDef HAL_UART_RegisterCallback(UART_HandleTypeDef* huart,
+    HAL_UART_CallbackIDTypeDef id, pUART_CallbackTypeDef callback);
+
+/**
+ *  @brief  Подключить к UART модель устройства.
+ *
+ *  @param  huart  Инициализированный UART.
+ *  @param  peer   Модель устройства или NULL - линия никуда не подключена.
+ */
+void host_uart_attach(UART_HandleTypeDef* huart, const host_uart_peer_t* peer);
+
+/**
+ *  @brief  Передать байты от модели устройства в приемник UART.
+ *
+ *  Вызывается моделью устройства из receive()/poll(). При активном приеме по
+ *  DMA байты сразу попадают в буфер DMA. При переполнении FIFO лишние байты
+ *  теряются и выставляется HAL_UART_ERROR_ORE.
+ *
+ *  @return Количество принятых в FIFO байт.
+ */
+size_t host_uart_rx_push(UART_HandleTypeDef* huart, const uint8_t* data, size_t len);
+
+/**
+ *  @brief  Отметить ошибку приема последнего переданного байта.
+ *
+ *  Как и в HAL STM32 при приеме по DMA, ошибка останавливает прием и
+ *  вызывает ErrorCallback; байт при этом уже передан в буфер. Если байт еще
+ *  в FIFO, ошибка сообщается, когда его заберет прием по прерыванию или DMA,
+ *  даже если прием запущен позже.
+ *
+ *  @param  error  Флаги HAL_UART_ERROR_PE, HAL_UART_ERROR_NE, HAL_UART_ERROR_FE.
+ */
+void host_uart_rx_error(UART_HandleTypeDef* huart, uint32_t error);
+
+/********************************* SPI *********************************/
+
+#define SPI_MODE_MASTER            0x00000104U
+#define SPI_DIRECTION_2LINES       0x00000000U
+#define SPI_DATASIZE_8BIT          0x00000700U
+#define SPI_POLARITY_LOW           0x00000000U
+#define SPI_PHASE_1EDGE            0x00000000U
+#define SPI_NSS_SOFT               0x00000200U
+#define SPI_FIRSTBIT_MSB           0x00000000U
+#define SPI_BAUDRATEPRESCALER_2    0x00000000U
+#define SPI_BAUDRATEPRESCALER_4    0x00000008U
+#define SPI_BAUDRATEPRESCALER_8    0x00000010U
+#define SPI_BAUDRATEPRESCALER_16   0x00000018U
+#define SPI_BAUDRATEPRESCALER_32   0x00000020U
+
+typedef struct {
+    uint32_t Mode;
+    uint32_t Direction;
+    uint32_t DataSize;
+    uint32_t CLKPolarity;
+    uint32_t CLKPhase;
+    uint32_t NSS;
+    uint32_t BaudRatePrescaler;
+    uint32_t FirstBit;
+} SPI_InitTypeDef;
+
+/**
+ *  @brief  Программная модель устройства на шине SPI.
+ */
+typedef struct {
+    /* Полнодуплексный обмен len байтами: tx - от хоста, rx - от устройства */
+    void (*exchange)(void* ctx, const uint8_t* tx, uint8_t* rx, size_t len);
+    void* ctx;
+} host_spi_peer_t;
+
+typedef struct {
+    SPI_InitTypeDef Init;
+    const host_spi_peer_t* peer;
+} SPI_HandleTypeDef;
+
+HAL_StatusTypeDef HAL_SPI_Init(SPI_HandleTypeDef* hspi);
+
+HAL_StatusTypeDef HAL_SPI_TransmitReceive(SPI_HandleTypeDef* hspi, uint8_t* tx, uint8_t* rx,
+    uint16_t size, uint32_t timeout);
+
+/**
+ *  @brief  Подключить к SPI модель устройства.
+ */
+void host_spi_attach(SPI_HandleTypeDef* hspi, const host_spi_peer_t* peer);
+
+/********************************* I2C *********************************/
+
+#define I2C_ADDRESSINGMODE_7BIT 0x00000001U
+#define I2C_DUALADDRESS_DISABLE 0x00000000U
+#define I2C_GENERALCALL_DISABLE 0x00000000U
+#define I2C_NOSTRETCH_DISABLE   0x00000000U
+
+#define HAL_I2C_ERROR_NONE      0x00000000U
+#define HAL_I2C_ERROR_AF        0x00000004U
+
+typedef struct {
+    uint32_t Timing;
+    uint32_t OwnAddress1;
+    uint32_t AddressingMode;
+    uint32_t DualAddressMode;
+    uint32_t OwnAddress2;
+    uint32_t GeneralCallMode;
+    uint32_t NoStretchMode;
+} I2C_InitTypeDef;
+
+/**
+ *  @brief  Программная модель устройства на шине I2C.
+ *
+ *  Адрес передается 7-битным. Функции возвращают false, если устройство не
+ *  подтвердило адрес (NACK), данные при этом не передаются.
+ */
+typedef struct {
+    bool (*write)(void* ctx, uint16_t address, const uint8_t* data, size_t len);
+    bool (*read)(void* ctx, uint16_t address, uint8_t* data, size_t len);
+    void* ctx;
+} host_i2c_peer_t;
+
+typedef struct {
+    I2C_InitTypeDef Init;
+    const host_i2c_peer_t* peer;
+    volatile uint32_t ErrorCode;
+} I2C_HandleTypeDef;
+
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef* hi2c);
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit(I2C_HandleTypeDef* hi2c, uint16_t address,
+    uint8_t* data, uint16_t size, uint32_t timeout);
+
+HAL_StatusTypeDef HAL_I2C_Master_Receive(I2C_HandleTypeDef* hi2c, uint16_t address,
+    uint8_t* data, uint16_t size, uint32_t timeout);
+
+HAL_StatusTypeDef HAL_I2C_IsDeviceReady(I2C_HandleTypeDef* hi2c, uint16_t address,
+    uint32_t trials, uint32_t timeout);
+
+/**
+ *  @brief  Подключить к I2C модель устройства.
+ */
+void host_i2c_attach(I2C_HandleTypeDef* hi2c, const host_i2c_peer_t* peer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !HOST_HAL_H */
@@ -0,0 +1,99 @@
+# Запуск приложения хостовой сборки с моделью загрузчика (cmake -P).
+# Параметры модели передаются переменными окружения BL_EMU_*.
+#
+#   APP     - путь к приложению
+#   EXPECT  - go: приложение должно завершиться по GO с кодом 0, а CRC из
+#             отладочного лога - совпасть с CRC прошивки во Flash модели;
+#             fail: GO не должно быть, приложение завершается по TIMEOUT
+#   TIMEOUT - ограничение времени, с
+#
+# Сборка с DFU_GANG_CHANNELS проверяется по итогу каналов, который выводит
+# board_gang_report():
+#
+#   GANG_CHANNELS - количество каналов
+#   GANG_FAIL     - маска каналов с неверной CRC (BL_EMU_BAD_CRC), остальные
+#                   должны пройти проверку с CRC прошивки во Flash модели
+
+if(NOT DEFINED TIMEOUT)
+	set(TIMEOUT 30)
+endif()
+
+execute_process(
+	COMMAND "${APP}"
+	RESULT_VARIABLE rc
+	OUTPUT_VARIABLE out
+	ERROR_VARIABLE out
+	TIMEOUT ${TIMEOUT})
+
+message("${out}")
+
+if(DEFINED GANG_CHANNELS)
+	math(EXPR last "${GANG_CHANNELS} - 1")
+
+	foreach(i RANGE ${last})
+		if(GANG_CHANNELS GREATER 1)
+			set(emu "bl_emu\\[${i}\\]")
+		else()
+			set(emu "bl_emu")
+		endif()
+
+		string(REGEX MATCH "${emu}: GO [^\n]*firmware CRC ([0-9A-F]+)" go "${out}")
+		set(flash_crc "${CMAKE_MATCH_1}")
+		string(REGEX MATCH "gang: channel ${i}: ([^,\n]+)[^\n]*read ([0-9A-F]+)" report "${out}")
+		set(status "${CMAKE_MATCH_1}")
+		set(read_crc "${CMAKE_MATCH_2}")
+
+		if(NOT report)
+			message(FATAL_ERROR "No report of channel ${i}")
+		endif()
+
+		math(EXPR bad "(${GANG_FAIL} >> ${i}) & 1")
+
+		if(bad)
+			if(go OR NOT status STREQUAL "CRC mismatch")
+				message(FATAL_ERROR "Channel ${i} with a wrong CRC: ${status}")
+			endif()
+		elseif(NOT go OR NOT status STREQUAL "PASS" OR NOT read_crc STREQUAL flash_crc)
+			message(FATAL_ERROR "Channel ${i}: ${status}, CRC ${read_crc}, firmware CRC ${flash_crc}")
+		endif()
+	endforeach()
+
+	# Код завершения - все ли каналы прошли проверку
+	if(GANG_FAIL EQUAL 0 AND NOT rc EQUAL 0)
+		message(FATAL_ERROR "Exit status: ${rc}")
+	endif()
+	if(NOT GANG_FAIL EQUAL 0 AND rc EQUAL 0)
+		message(FATAL_ERROR "Exit status 0 with failed channels")
+	endif()
+	return()
+endif()
+
+string(REGEX MATCH "bl_emu: GO [^\n]*firmware CRC ([0-9A-F]+)" go "${out}")
+set(flash_crc "${CMAKE_MATCH_1}")
+
+if(EXPECT STREQUAL "fail")
+	if(go)
+		message(FATAL_ERROR "Firmware with a wrong CRC was started")
+	endif()
+	return()
+endif()
+
+if(NOT rc EQUAL 0)
+	message(FATAL_ERROR "Exit status: ${rc}")
+endif()
+
+if(NOT go)
+	message(FATAL_ERROR "No GO report from bl_emu")
+endif()
+
+# Отладочный лог есть только в сборках с DEBUG
+string(REGEX MATCHALL "CRC calculated: [0-9A-F]+" calculated "${out}")
+
+if(calculated)
+	list(GET calculated -1 last)
+	string(REPLACE "CRC calculated: " "" last "${last}")
+
+	if(NOT last STREQUAL flash_crc)
+		message(FATAL_ERROR "CRC calculated ${last}, firmware CRC ${flash_crc}")
+	endif()
+endif()
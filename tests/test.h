@@ -0,0 +1,40 @@
+#ifndef TESTS_TEST_H__
+#define TESTS_TEST_H__
+
+/*
+ * Минимальные проверки для тестов хостовой сборки: ошибка печатается с
+ * местом проверки и не прерывает тест, итог возвращает TEST_RESULT().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Количество не прошедших проверок */
+static unsigned int test_failures;
+
+/* Проверить условие */
+#define TEST_CHECK(cond)                                                        \
+    do {                                                                        \
+        if (!(cond)) {                                                          \
+            printf("%s:%d: FAIL: %s\n", __FILE__, __LINE__, #cond);             \
+            test_failures += 1;                                                 \
+        }                                                                       \
+    } while (0)
+
+/* Проверить равенство целых значений, при ошибке вывести оба */
+#define TEST_CHECK_EQ(actual, expected)                                         \
+    do {                                                                        \
+        const unsigned long long actual_   = (actual);                          \
+        const unsigned long long expected_ = (expected);                        \
+                                                                                \
+        if (actual_ != expected_) {                                             \
+            printf("%s:%d: FAIL: %s == 0x%llX, expected 0x%llX\n", __FILE__,    \
+                __LINE__, #actual, actual_, expected_);                         \
+            test_failures += 1;                                                 \
+        }                                                                       \
+    } while (0)
+
+/* Код завершения теста для CTest */
+#define TEST_RESULT() ((test_failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE)
+
+#endif /* !TESTS_TEST_H__ */
@@ -0,0 +1,170 @@
+/*
+ * CRC: контрольные значения каталога crc_model и табличные реализации
+ * crc16_reflect() и crc32_ieee_update() против побитового эталона.
+ * Собирается для каждого варианта CONFIG_CRC16_REFLECT_SLICES и
+ * CONFIG_CRC32_IEEE_SLICES (tests/CMakeLists.txt).
+ */
+
+#include <string.h>
+
+#include "core/crc.h"
+#include "core/crc_model.h"
+#include "core/util.h"
+#include "test.h"
+
+/* Строка, по которой в каталоге RevEng заданы контрольные значения */
+static const uint8_t check_str[] = "123456789";
+#define CHECK_LEN (sizeof(check_str) - 1)
+
+/* Наибольшая длина проверяемых данных и смещение для невыровненных адресов */
+#define DATA_LEN   600
+#define DATA_SHIFT 8
+
+static uint8_t data[DATA_LEN + DATA_SHIFT];
+
+/* Заполнить данные псевдослучайными байтами */
+static void data_fill(uint32_t seed)
+{
+    for (size_t i = 0; i < sizeof(data); ++i) {
+        seed = seed * 1664525U + 1013904223U;
+        data[i] = (uint8_t)(seed >> 24);
+    }
+}
+
+/* Побитовый эталон CRC-32/ISO-HDLC без начального и конечного XOR */
+static uint32_t crc32_bitwise(uint32_t crc, const uint8_t* src, size_t len)
+{
+    for (size_t i = 0; i < len; ++i) {
+        crc ^= src[i];
+
+        for (int j = 0; j < 8; ++j) {
+            crc = (crc & 1U) ? (crc >> 1) ^ 0xEDB88320U : crc >> 1;
+        }
+    }
+
+    return crc;
+}
+
+/* Каждый алгоритм каталога: значение "123456789" и расчет по частям */
+static void test_catalogue(void)
+{
+    struct crc_engine engine;
+
+    for (size_t i = 0; i < crc_model_catalogue_size; ++i) {
+        const struct crc_model* model = &crc_model_catalogue[i];
+
+        TEST_CHECK(crc_engine_init(&engine, model) == 0);
+        TEST_CHECK(crc_model_find(model->name) == model);
+        if (model->alias != NULL) {
+            TEST_CHECK(crc_model_find(model->alias) == model);
+        }
+
+        TEST_CHECK_EQ(crc_engine_compute(&engine, check_str, CHECK_LEN), model->check);
+
+        for (size_t split = 0; split <= CHECK_LEN; ++split) {
+            uint32_t state = crc_engine_begin(&engine);
+
+            state = crc_engine_update(&engine, state, check_str, split);
+            state = crc_engine_update(&engine, state, check_str + split, CHECK_LEN - split);
+
+            TEST_CHECK_EQ(crc_engine_final(&engine, state), model->check);
+        }
+    }
+
+    TEST_CHECK(crc_model_find("CRC-16/UNKNOWN") == NULL);
+    TEST_CHECK(crc_model_find(NULL) == NULL);
+    TEST_CHECK(crc_engine_init(&engine, NULL) < 0);
+}
+
+/* Функции с фиксированным полиномом на тех же контрольных значениях */
+static void test_check_values(void)
+{
+    TEST_CHECK_EQ(crc16_ansi(check_str, CHECK_LEN), 0x4B37);
+    TEST_CHECK_EQ(crc16_reflect(0xA001, 0x0000, check_str, CHECK_LEN), 0xBB3D);
+    TEST_CHECK_EQ(crc16_ccitt(0x0000, check_str, CHECK_LEN), 0x2189);
+    TEST_CHECK_EQ(crc16_ccitt(0xFFFF, check_str, CHECK_LEN) ^ 0xFFFF, 0x906E);
+    TEST_CHECK_EQ(crc16_itu_t(0xFFFF, check_str, CHECK_LEN), 0x29B1);
+    TEST_CHECK_EQ(crc16_itu_t(0x0000, check_str, CHECK_LEN), 0x31C3);
+    TEST_CHECK_EQ(crc16(0x1021, 0xFFFF, check_str, CHECK_LEN), 0x29B1);
+    TEST_CHECK_EQ(crc8_ccitt(0x00, check_str, CHECK_LEN), 0xF4);
+    TEST_CHECK_EQ(crc32_ieee(check_str, CHECK_LEN), 0xCBF43926);
+    TEST_CHECK_EQ(crc32_ieee_update(0, check_str, CHECK_LEN), 0xCBF43926);
+}
+
+/* crc16_reflect() и ее таблицы против побитового расчета на всех длинах и
+ * выравниваниях, включая смену полинома */
+static void test_crc16_reflect(void)
+{
+    static const uint16_t polys[] = { 0xA001, 0x8408, 0xA6BC };
+    static const uint16_t seeds[] = { 0x0000, 0xFFFF, 0x1D0F };
+    static struct crc16_reflect_table table;
+
+    data_fill(16);
+
+    for (size_t p = 0; p < ARRAY_SIZE(polys); ++p) {
+        crc16_reflect_table_init(&table, polys[p]);
+        TEST_CHECK_EQ(table.poly, polys[p]);
+
+        for (size_t s = 0; s < ARRAY_SIZE(seeds); ++s) {
+            for (size_t shift = 0; shift < DATA_SHIFT; ++shift) {
+                for (size_t len = 0; len <= DATA_LEN; len += (len < 64) ? 1 : 37) {
+                    const uint8_t* src = data + shift;
+                    const uint16_t ref = crc16_reflect_bitwise(polys[p], seeds[s], src, len);
+
+                    TEST_CHECK_EQ(crc16_reflect(polys[p], seeds[s], src, len), ref);
+                    TEST_CHECK_EQ(crc16_reflect_sw(polys[p], seeds[s], src, len), ref);
+                    TEST_CHECK_EQ(crc16_reflect_table(&table, seeds[s], src, len), ref);
+                }
+            }
+        }
+    }
+
+    /* Кэш таблиц одного полинома перестраивается при каждой смене */
+    for (int i = 0; i < 4; ++i) {
+        const uint16_t poly = polys[i % ARRAY_SIZE(polys)];
+
+        crc16_reflect_init(poly);
+        TEST_CHECK_EQ(crc16_reflect(poly, 0xFFFF, data, DATA_LEN),
+            crc16_reflect_bitwise(poly, 0xFFFF, data, DATA_LEN));
+    }
+
+    /* Частные случаи с полиномом 0x1021 */
+    for (size_t len = 0; len <= DATA_LEN; len += 23) {
+        TEST_CHECK_EQ(crc16_ccitt(0xFFFF, data, len), crc16_reflect_bitwise(0x8408, 0xFFFF, data, len));
+        TEST_CHECK_EQ(crc16_itu_t(0xFFFF, data, len), crc16(0x1021, 0xFFFF, data, len));
+    }
+}
+
+/* crc32_ieee_update() против побитового расчета, в том числе по частям */
+static void test_crc32(void)
+{
+    data_fill(32);
+
+    for (size_t shift = 0; shift < DATA_SHIFT; ++shift) {
+        for (size_t len = 0; len <= DATA_LEN; len += (len < 64) ? 1 : 37) {
+            const uint8_t* src = data + shift;
+            const uint32_t ref = ~crc32_bitwise(0xFFFFFFFFU, src, len);
+
+            TEST_CHECK_EQ(crc32_ieee(src, len), ref);
+            TEST_CHECK_EQ(crc32_ieee_update_sw(0, src, len), ref);
+
+            const size_t split = len / 3;
+            const uint32_t part = crc32_ieee_update(0, src, split);
+
+            TEST_CHECK_EQ(crc32_ieee_update(part, src + split, len - split), ref);
+        }
+    }
+}
+
+int main(void)
+{
+    printf("CRC16_REFLECT_SLICES %d, CRC32_IEEE_SLICES %d\n", CONFIG_CRC16_REFLECT_SLICES,
+        CONFIG_CRC32_IEEE_SLICES);
+
+    test_catalogue();
+    test_check_values();
+    test_crc16_reflect();
+    test_crc32();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,82 @@
+/*
+ * crc16_combine(), crc16_reflect_combine() и crc32_combine() против расчета
+ * по всему буферу: каждая точка разбиения буферов до 40 байт и выборочные
+ * точки длин до 600 байт, три полинома и три начальных значения.
+ */
+
+#include "core/crc.h"
+#include "core/util.h"
+#include "test.h"
+
+/* Буферы этой длины проверяются на всех точках разбиения */
+#define FULL_LEN 40
+
+static uint8_t data[600];
+
+/* Длины, проверяемые на выборочных точках разбиения */
+static const size_t sampled_lens[] = { 41, 64, 100, 255, 256, 257, 511, 512, 600 };
+
+/* Полиномы в нормальной форме для crc16() и в отраженной для crc16_reflect() */
+static const uint16_t polys[]         = { 0x1021, 0x8005, 0x3D65 };
+static const uint16_t reflect_polys[] = { 0x8408, 0xA001, 0xA6BC };
+static const uint16_t seeds[]         = { 0x0000, 0xFFFF, 0x1D0F };
+
+static void data_fill(uint32_t seed)
+{
+    for (size_t i = 0; i < sizeof(data); ++i) {
+        seed = seed * 1664525U + 1013904223U;
+        data[i] = (uint8_t)(seed >> 24);
+    }
+}
+
+/* Проверить все три функции на буфере len с разбиением в split */
+static void check_split(size_t len, size_t split)
+{
+    const uint8_t* a = data;
+    const uint8_t* b = data + split;
+    const size_t len2 = len - split;
+
+    for (size_t p = 0; p < ARRAY_SIZE(polys); ++p) {
+        for (size_t s = 0; s < ARRAY_SIZE(seeds); ++s) {
+            const uint16_t seed = seeds[s];
+
+            TEST_CHECK_EQ(crc16_combine(polys[p], seed, crc16(polys[p], seed, a, split),
+                crc16(polys[p], seed, b, len2), len2), crc16(polys[p], seed, a, len));
+
+            const uint16_t rpoly = reflect_polys[p];
+
+            TEST_CHECK_EQ(crc16_reflect_combine(rpoly, seed,
+                crc16_reflect_bitwise(rpoly, seed, a, split),
+                crc16_reflect_bitwise(rpoly, seed, b, len2), len2),
+                crc16_reflect_bitwise(rpoly, seed, a, len));
+        }
+    }
+
+    TEST_CHECK_EQ(crc32_combine(crc32_ieee(a, split), crc32_ieee(b, len2), len2),
+        crc32_ieee(a, len));
+}
+
+int main(void)
+{
+    /* Для CRC-32 полином один - вместо полиномов разные данные */
+    for (uint32_t pattern = 1; pattern <= 3; ++pattern) {
+        data_fill(pattern);
+
+        for (size_t len = 0; len <= FULL_LEN; ++len) {
+            for (size_t split = 0; split <= len; ++split) {
+                check_split(len, split);
+            }
+        }
+
+        for (size_t i = 0; i < ARRAY_SIZE(sampled_lens); ++i) {
+            const size_t len = sampled_lens[i];
+            const size_t splits[] = { 0, 1, len / 3, len / 2, len - 1, len };
+
+            for (size_t k = 0; k < ARRAY_SIZE(splits); ++k) {
+                check_split(len, splits[k]);
+            }
+        }
+    }
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,102 @@
+/*
+ * Проверка аргументов dfu_host_update(): образ должен целиком лежать во
+ * Flash устройства. Обмен с устройством заменен заглушками, дайджест
+ * сектора считается вызовом cfg->digest.
+ */
+
+#include "dfu_host_crc.h"
+#include "dfu_host_update.h"
+#include "test.h"
+
+#define FLASH_BASE 0x08000000U
+#define FLASH_SIZE 0x10000U
+#define SECTOR     0x800U
+
+static const dfu_host_flash_layout_t layout = {
+    .base         = FLASH_BASE,
+    .size         = FLASH_SIZE,
+    .sector_size  = SECTOR,
+    .sector_count = FLASH_SIZE / SECTOR,
+};
+
+/* Количество запросов дайджеста */
+static unsigned int digest_calls;
+
+/* Вызов означает, что проверка диапазона пропустила образ. Ошибка завершает
+ * обновление до стирания и записи */
+static int digest_stub(dfu_host_t* host, void* ctx, uint32_t address, size_t len, uint32_t* digest)
+{
+    digest_calls += 1;
+
+    return DFU_HOST_ERR_EIO;
+}
+
+static int update(uint32_t address, size_t len)
+{
+    static const uint8_t image[64];
+    static dfu_host_t host;
+
+    const dfu_host_update_cfg_t cfg = {
+        .layout = &layout,
+        .digest = digest_stub,
+    };
+
+    digest_calls = 0;
+
+    return dfu_host_update(&host, &cfg, address, image, len, NULL);
+}
+
+static void test_update_range(void)
+{
+    const uint32_t end = FLASH_BASE + FLASH_SIZE;
+
+    /* Вне Flash: устройство не запрашивается */
+    TEST_CHECK_EQ(update(FLASH_BASE - 16, 16), DFU_HOST_ERR_EINVAL);
+    TEST_CHECK_EQ(update(end, 16), DFU_HOST_ERR_EINVAL);
+    TEST_CHECK_EQ(update(end + SECTOR, 16), DFU_HOST_ERR_EINVAL);
+    TEST_CHECK_EQ(update(0xFFFFFFF0U, 16), DFU_HOST_ERR_EINVAL);
+    TEST_CHECK_EQ(update(end - 16, 32), DFU_HOST_ERR_EINVAL);
+    TEST_CHECK_EQ(digest_calls, 0);
+
+    /* Внутри Flash, в том числе вплотную к концу: доходит до дайджеста */
+    TEST_CHECK_EQ(update(FLASH_BASE, 64), DFU_HOST_ERR_EIO);
+    TEST_CHECK_EQ(digest_calls, 1);
+    TEST_CHECK_EQ(update(end - 16, 16), DFU_HOST_ERR_EIO);
+    TEST_CHECK_EQ(digest_calls, 1);
+}
+
+int main(void)
+{
+    test_update_range();
+
+    return TEST_RESULT();
+}
+
+/* Заглушки обмена с устройством: тест до них не доходит */
+
+uint32_t HAL_GetTick(void)
+{
+    return 0;
+}
+
+int dfu_host_read_range(dfu_host_t* host, uint32_t address, size_t len,
+    dfu_host_read_sink_t sink, void* ctx)
+{
+    return DFU_HOST_ERR_EIO;
+}
+
+int dfu_host_crc_remote(dfu_host_t* host, const struct crc_engine* engine,
+    uint32_t address, uint32_t len, const dfu_host_target_t* target, uint32_t* crc)
+{
+    return DFU_HOST_ERR_EIO;
+}
+
+int dfu_host_write_memory(dfu_host_t* host, uint32_t address, const uint8_t* data, size_t len)
+{
+    return DFU_HOST_ERR_EIO;
+}
+
+int dfu_host_erase_sectors(dfu_host_t* host, const uint16_t* sectors, size_t count)
+{
+    return DFU_HOST_ERR_EIO;
+}
@@ -0,0 +1,141 @@
+/*
+ * Преобразования hex.c и вспомогательные функции и макросы core/util.h.
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include "core/util.h"
+#include "test.h"
+
+static void test_hex_chars(void)
+{
+    uint8_t x = 0xAA;
+    char c = 0;
+
+    TEST_CHECK(char2hex('0', &x) == 0 && x == 0);
+    TEST_CHECK(char2hex('9', &x) == 0 && x == 9);
+    TEST_CHECK(char2hex('a', &x) == 0 && x == 10);
+    TEST_CHECK(char2hex('F', &x) == 0 && x == 15);
+    TEST_CHECK(char2hex('g', &x) == -EINVAL);
+    TEST_CHECK(char2hex(' ', &x) == -EINVAL);
+
+    TEST_CHECK(hex2char(0, &c) == 0 && c == '0');
+    TEST_CHECK(hex2char(9, &c) == 0 && c == '9');
+    TEST_CHECK(hex2char(10, &c) == 0 && c == 'a');
+    TEST_CHECK(hex2char(15, &c) == 0 && c == 'f');
+    TEST_CHECK(hex2char(16, &c) == -EINVAL);
+}
+
+static void test_hex_strings(void)
+{
+    static const uint8_t bin[] = { 0x00, 0x12, 0xAB, 0xFF };
+    uint8_t out[8];
+    char hex[16];
+
+    TEST_CHECK_EQ(bin2hex(bin, sizeof(bin), hex, sizeof(hex)), 8);
+    TEST_CHECK(strcmp(hex, "0012abff") == 0);
+
+    /* Нет места под завершающий ноль */
+    TEST_CHECK_EQ(bin2hex(bin, sizeof(bin), hex, 8), 0);
+
+    memset(out, 0, sizeof(out));
+    TEST_CHECK_EQ(hex2bin("0012ABff", 8, out, sizeof(out)), 4);
+    TEST_CHECK(memcmp(out, bin, sizeof(bin)) == 0);
+
+    /* Нечетная длина: старший полубайт первого байта - ноль */
+    TEST_CHECK_EQ(hex2bin("abc", 3, out, sizeof(out)), 2);
+    TEST_CHECK_EQ(out[0], 0x0A);
+    TEST_CHECK_EQ(out[1], 0xBC);
+
+    TEST_CHECK_EQ(hex2bin("12x4", 4, out, sizeof(out)), 0);
+    TEST_CHECK_EQ(hex2bin("123456", 6, out, 2), 0);
+
+    /* Обратимость на всех значениях байта */
+    uint8_t all[256];
+    uint8_t back[256];
+    char all_hex[2 * sizeof(all) + 1];
+
+    for (size_t i = 0; i < sizeof(all); ++i) {
+        all[i] = (uint8_t)i;
+    }
+
+    TEST_CHECK_EQ(bin2hex(all, sizeof(all), all_hex, sizeof(all_hex)), 2 * sizeof(all));
+    TEST_CHECK_EQ(hex2bin(all_hex, 2 * sizeof(all), back, sizeof(back)), sizeof(back));
+    TEST_CHECK(memcmp(all, back, sizeof(all)) == 0);
+}
+
+static void test_bcd(void)
+{
+    for (uint8_t i = 0; i < 100; ++i) {
+        TEST_CHECK_EQ(bcd2bin(bin2bcd(i)), i);
+    }
+
+    TEST_CHECK_EQ(bin2bcd(59), 0x59);
+    TEST_CHECK_EQ(bcd2bin(0x42), 42);
+}
+
+static void test_bits(void)
+{
+    TEST_CHECK_EQ(GENMASK(7, 4), 0xF0);
+    TEST_CHECK_EQ(GENMASK(31, 0), 0xFFFFFFFFUL);
+    TEST_CHECK_EQ(GENMASK64(63, 60), 0xF000000000000000ULL);
+    TEST_CHECK_EQ(LSB_GET(0x68U), 0x08);
+    TEST_CHECK_EQ(FIELD_GET(0x0F00U, 0x1234U), 0x2);
+    TEST_CHECK_EQ(FIELD_PREP(0x0F00U, 0x5U), 0x0500);
+
+    TEST_CHECK(is_power_of_two(1));
+    TEST_CHECK(is_power_of_two(0x80000000U));
+    TEST_CHECK(!is_power_of_two(0));
+    TEST_CHECK(!is_power_of_two(6));
+
+    TEST_CHECK(arithmetic_shift_right(-16, 2) == -4);
+    TEST_CHECK(arithmetic_shift_right(16, 2) == 4);
+    TEST_CHECK(arithmetic_shift_right(-1, 63) == -1);
+    TEST_CHECK(arithmetic_shift_right(-5, 0) == -5);
+}
+
+static void test_arith(void)
+{
+    TEST_CHECK_EQ(MIN(3, 7), 3);
+    TEST_CHECK_EQ(MAX(3, 7), 7);
+    TEST_CHECK_EQ(CLAMP(5, 1, 3), 3);
+    TEST_CHECK_EQ(CLAMP(0, 1, 3), 1);
+    TEST_CHECK(IN_RANGE(3, 3, 4));
+    TEST_CHECK(!IN_RANGE(5, 3, 4));
+
+    TEST_CHECK_EQ(ROUND_UP(0x1001, 0x100), 0x1100);
+    TEST_CHECK_EQ(ROUND_UP(0x1000, 0x100), 0x1000);
+    TEST_CHECK_EQ(ROUND_DOWN(0x10FF, 0x100), 0x1000);
+    TEST_CHECK_EQ(ceiling_fraction(10, 4), 3);
+    TEST_CHECK_EQ(ceiling_fraction(8, 4), 2);
+
+    static const uint32_t arr[5];
+
+    TEST_CHECK_EQ(ARRAY_SIZE(arr), 5);
+}
+
+static void test_bytes(void)
+{
+    uint8_t a[4] = { 1, 2, 3, 4 };
+    uint8_t b[4] = { 5, 6, 7, 8 };
+    uint8_t c[4] = { 0 };
+
+    byteswp(a, b, sizeof(a));
+    TEST_CHECK(a[0] == 5 && a[3] == 8 && b[0] == 1 && b[3] == 4);
+
+    bytecpy(c, a, sizeof(c));
+    TEST_CHECK(memcmp(c, a, sizeof(c)) == 0);
+}
+
+int main(void)
+{
+    test_hex_chars();
+    test_hex_strings();
+    test_bcd();
+    test_bits();
+    test_arith();
+    test_bytes();
+
+    return TEST_RESULT();
+}